@@ -1,7 +1,15 @@
 #include "Blueprints.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <iostream>
-#include <stack>
+#include <set>
+#include <sstream>
 //#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/work/dispatcher.h>
 #include <pxr/usd/sdf/fileFormat.h>
 
 #if defined(__cplusplus) && __cplusplus >= 201703L && defined(__has_include) && __has_include(<filesystem>)
@@ -15,68 +23,228 @@ namespace fs = ghc::filesystem;
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
-void Blueprints::SetBlueprintsLocations(const std::vector<std::string> &locations) {
+// Header of the index file, the version must be incremented when the format changes
+static constexpr const char *BlueprintsIndexHeader = "usdtweak blueprints index 1";
+
+// Content of a blueprint directory, as stored in the index file
+struct BlueprintsDirectory {
+    std::int64_t writeTime = 0;
+    std::vector<std::string> subDirectories;
+    std::vector<std::string> layers;
+};
+
+using BlueprintsIndex = std::unordered_map<std::string, BlueprintsDirectory>;
+
+// The index file is a list of directories with their modification time, the number of sub directories and layers,
+// followed by one path per line
+static BlueprintsIndex ReadBlueprintsIndex(const std::string &indexFilePath) {
+    BlueprintsIndex index;
+    std::ifstream indexFile(indexFilePath);
+    std::string line;
+    if (indexFilePath.empty() || !std::getline(indexFile, line) || line != BlueprintsIndexHeader) {
+        return index;
+    }
+    while (std::getline(indexFile, line)) {
+        std::istringstream directoryLine(line);
+        BlueprintsDirectory directory;
+        size_t subDirectoriesCount = 0;
+        size_t layersCount = 0;
+        std::string directoryPath;
+        if (!(directoryLine >> directory.writeTime >> subDirectoriesCount >> layersCount) || directoryLine.get() != ' ' ||
+            !std::getline(directoryLine, directoryPath)) {
+            return {}; // Corrupted index, everything is read again
+        }
+        directory.subDirectories.resize(subDirectoriesCount);
+        directory.layers.resize(layersCount);
+        for (auto &path : directory.subDirectories) {
+            std::getline(indexFile, path);
+        }
+        for (auto &path : directory.layers) {
+            std::getline(indexFile, path);
+        }
+        if (!indexFile) {
+            return {};
+        }
+        index[directoryPath] = std::move(directory);
+    }
+    return index;
+}
+
+static void WriteBlueprintsIndex(const std::string &indexFilePath, const BlueprintsIndex &index) {
+    if (indexFilePath.empty()) {
+        return;
+    }
+    std::ofstream indexFile(indexFilePath, std::ios::trunc);
+    indexFile << BlueprintsIndexHeader << "\n";
+    for (const auto &directory : index) {
+        indexFile << directory.second.writeTime << " " << directory.second.subDirectories.size() << " "
+                  << directory.second.layers.size() << " " << directory.first << "\n";
+        for (const auto &path : directory.second.subDirectories) {
+            indexFile << path << "\n";
+        }
+        for (const auto &path : directory.second.layers) {
+            indexFile << path << "\n";
+        }
+    }
+    if (!indexFile) {
+        std::cerr << "unable to write blueprints index " << indexFilePath << std::endl;
+    }
+}
+
+// List the sub directories and the usd layers of a blueprint directory
+static bool ReadBlueprintsDirectory(const std::string &directoryPath, const std::set<std::string> &allUsdExt,
+                                    BlueprintsDirectory &directory) {
+    std::error_code ec;
+    fs::directory_iterator it(fs::path(directoryPath), ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        const fs::directory_entry &entry = *it;
+        std::error_code entryEc;
+        if (entry.is_directory(entryEc)) {
+            directory.subDirectories.push_back(entry.path().generic_string());
+        } else if (entry.is_regular_file(entryEc)) {
+            std::string layerPath = entry.path().generic_string();
+            const auto ext = SdfFileFormat::GetFileExtension(layerPath);
+            if (allUsdExt.find(ext) != allUsdExt.end()) {
+                directory.layers.push_back(layerPath);
+            }
+        }
+    }
+    return !ec;
+}
+
+// Menu name of a folder or an item
+static std::string GetBlueprintName(const std::string &path) {
+    std::string name = fs::path(path).stem().generic_string();
+    if (!name.empty()) {
+        name[0] = std::toupper(name[0]);
+    }
+    return name;
+}
+
+void Blueprints::SetBlueprintsLocations(const std::vector<std::string> &locations, const std::string &indexFilePath) {
+    StopIndexing();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _subFolders.clear();
+        _items.clear();
+    }
+    _isCancelled = false;
+    _isIndexing = true;
+    _thread = std::thread(&Blueprints::IndexLocations, this, locations, indexFilePath);
+}
+
+// Background thread
+void Blueprints::IndexLocations(const std::vector<std::string> &locations, const std::string &indexFilePath) {
     std::cout << "Reading blueprints" << std::endl;
+    const auto startTime = std::chrono::steady_clock::now();
     const std::set<std::string> allUsdExt = SdfFileFormat::FindAllFileFormatExtensions();
-    std::stack<std::string> folders;
-    std::stack<std::string> paths;
-    for (const auto &loc : locations) {
-        paths.push(loc);
-        folders.push("");
-    }
-    _subFolders.clear();
-    _items.clear();
-    // TODO: we should measure the time it takes to read all the blueprints as this can affect the application startup time
-    // Also this code could be ran in another thread as it is not essential to have the
-    // blueprint informations at startup time
-    // -> We might just want to read a json file containing a list of file/
-    // if there is a json file; otherwise read the dir ??
-    while (!paths.empty()) {
-        if (!fs::exists(paths.top())) {
-            std::cerr << "unable to find blueprint path " << paths.top() << std::endl;
-            paths.pop();
-            continue;
+    const BlueprintsIndex previousIndex = ReadBlueprintsIndex(indexFilePath);
+    BlueprintsIndex index;
+    std::mutex indexMutex;
+    std::atomic<size_t> listedDirectories{0};
+
+    WorkDispatcher dispatcher;
+    std::function<void(const std::string &, const std::string &)> indexDirectory = [&](const std::string &directoryPath,
+                                                                                       const std::string &folder) {
+        if (_isCancelled) {
+            return;
         }
-        try {
-            fs::is_directory(paths.top());
-        } catch (fs::filesystem_error &) {
-            std::cerr << "unable to read directory " << paths.top() << std::endl;
-            paths.pop();
-            continue;
+        std::error_code ec;
+        const auto writeTime = fs::last_write_time(fs::path(directoryPath), ec);
+        if (ec) {
+            std::cerr << "unable to read directory " << directoryPath << std::endl;
+            return;
+        }
+        // The directory is listed only if it was modified since it was indexed
+        BlueprintsDirectory directory;
+        directory.writeTime = static_cast<std::int64_t>(writeTime.time_since_epoch().count());
+        const auto indexed = previousIndex.find(directoryPath);
+        if (indexed != previousIndex.end() && indexed->second.writeTime == directory.writeTime) {
+            directory.subDirectories = indexed->second.subDirectories;
+            directory.layers = indexed->second.layers;
+        } else if (ReadBlueprintsDirectory(directoryPath, allUsdExt, directory)) {
+            listedDirectories++;
+        } else {
+            std::cerr << "unable to read directory " << directoryPath << std::endl;
+            return;
+        }
+
+        for (const auto &layerPath : directory.layers) {
+            const std::string itemName = GetBlueprintName(layerPath);
+            if (!itemName.empty()) {
+                AddItem(folder, itemName, layerPath);
+            }
         }
-        const auto path = fs::directory_iterator(paths.top());
-        paths.pop();
-        const auto folder = folders.top();
-        folders.pop();
-        for (const auto &entry : fs::directory_iterator(path)) {
-            if (fs::is_directory(entry)) {
-                paths.push(entry.path().generic_string());
-                std::string folderStem = entry.path().stem().generic_string();
-                if (!folderStem.empty()) {
-                    folderStem[0] = std::toupper(folderStem[0]);
-                    std::string subFolderName = folder + "/" + folderStem;
-                    folders.push(subFolderName);
-                    _subFolders[folder].push_back(subFolderName);
-                }
-            } else if (fs::is_regular_file(entry.path())) {
-                std::string layerPath = entry.path().generic_string();
-                const auto ext = SdfFileFormat::GetFileExtension(layerPath);
-                if (allUsdExt.find(ext) != allUsdExt.end()) {
-                    std::string itemName = entry.path().stem().generic_string();
-                    if (!itemName.empty()) {
-                        itemName[0] = std::toupper(itemName[0]);
-                        _items[folder].push_back(std::make_pair(itemName, layerPath));
-                    }
-                }
+        for (const auto &subDirectory : directory.subDirectories) {
+            const std::string folderName = GetBlueprintName(subDirectory);
+            if (!folderName.empty()) {
+                const std::string subFolder = folder + "/" + folderName;
+                AddSubFolder(folder, subFolder);
+                dispatcher.Run(indexDirectory, subDirectory, subFolder);
             }
         }
+        std::lock_guard<std::mutex> lock(indexMutex);
+        index[directoryPath] = std::move(directory);
+    };
+
+    for (const auto &loc : locations) {
+        std::error_code ec;
+        if (!fs::is_directory(fs::path(loc), ec)) {
+            std::cerr << "unable to find blueprint path " << loc << std::endl;
+            continue;
+        }
+        dispatcher.Run(indexDirectory, loc, std::string());
+    }
+    dispatcher.Wait();
+
+    if (!_isCancelled) {
+        WriteBlueprintsIndex(indexFilePath, index);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Blueprints ready, " << index.size() << " directories (" << listedDirectories << " listed) in "
+                  << elapsed.count() << "s" << std::endl;
+    }
+    _isIndexing = false;
+}
+
+// The folders and items are kept sorted as the directories are read in any order
+void Blueprints::AddSubFolder(const std::string &folder, const std::string &subFolder) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &subFolders = _subFolders[folder];
+    const auto it = std::lower_bound(subFolders.begin(), subFolders.end(), subFolder);
+    if (it == subFolders.end() || *it != subFolder) {
+        subFolders.insert(it, subFolder);
+    }
+}
+
+void Blueprints::AddItem(const std::string &folder, const std::string &itemName, const std::string &layerPath) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &items = _items[folder];
+    const auto item = std::make_pair(itemName, layerPath);
+    items.insert(std::upper_bound(items.begin(), items.end(), item), item);
+}
+
+void Blueprints::StopIndexing() {
+    _isCancelled = true;
+    if (_thread.joinable()) {
+        _thread.join();
     }
-    std::cout << "Blueprints ready" << std::endl;
 }
 
+Blueprints::~Blueprints() { StopIndexing(); }
+
 Blueprints &Blueprints::GetInstance() {
     static Blueprints instance;
     return instance;
 }
-const std::vector<std::string> &Blueprints::GetSubFolders(std::string folder) { return _subFolders[folder]; }
-const std::vector<std::pair<std::string, std::string>> &Blueprints::GetItems(std::string folder) { return _items[folder]; }
+
+std::vector<std::string> Blueprints::GetSubFolders(const std::string &folder) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto it = _subFolders.find(folder);
+    return it != _subFolders.end() ? it->second : std::vector<std::string>();
+}
+
+std::vector<std::pair<std::string, std::string>> Blueprints::GetItems(const std::string &folder) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto it = _items.find(folder);
+    return it != _items.end() ? it->second : std::vector<std::pair<std::string, std::string>>();
+}
@@ -1,27 +1,53 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 // Blueprints class
 //   - traverse the blueprint root locations looking for layers organised hierarchically on the disk.
 //   - keep the hierarchy structure, names and paths of the blueprint layers for the whole application time.
+//
+// The locations are traversed in the background, the directories are read in parallel and the folders and items
+// are available as soon as their directory is read, so the menus fill up while the traversal is running.
+// The content of the directories is saved in an index file with their modification time: the next traversals only
+// list the directories modified since, the others are only checked with a stat.
 
 class Blueprints {
   public:
     static Blueprints &GetInstance();
 
-    // Calling SetBlueprintsLocations will reset the stored data and traverse
-    // the root locations looking for blueprints
-    void SetBlueprintsLocations(const std::vector<std::string> &locations);
+    // Calling SetBlueprintsLocations will reset the stored data and start traversing
+    // the root locations looking for blueprints. The index file is not used when its path is empty.
+    void SetBlueprintsLocations(const std::vector<std::string> &locations, const std::string &indexFilePath = "");
 
-    const std::vector<std::string> &GetSubFolders(std::string folder);
-    const std::vector<std::pair<std::string, std::string>> &GetItems(std::string folder);
+    // The folders and items are returned by copy as they can be added while the locations are traversed
+    std::vector<std::string> GetSubFolders(const std::string &folder) const;
+    std::vector<std::pair<std::string, std::string>> GetItems(const std::string &folder) const;
+
+    // Returns true while the locations are traversed
+    bool IsIndexing() const { return _isIndexing; }
+
+    // Cancels and joins the traversal. The owner of the locations calls it before shutting down, so the
+    // thread doesn't outlive the application until the destruction of the static instance
+    void StopIndexing();
 
   private:
+    void IndexLocations(const std::vector<std::string> &locations, const std::string &indexFilePath);
+    void AddSubFolder(const std::string &folder, const std::string &subFolder);
+    void AddItem(const std::string &folder, const std::string &itemName, const std::string &layerPath);
+
+    mutable std::mutex _mutex; // Protects the folders and items
     std::unordered_map<std::string, std::vector<std::string>> _subFolders;
     std::unordered_map<std::string, std::vector<std::pair<std::string, std::string>>> _items;
+
+    std::thread _thread;
+    std::atomic<bool> _isIndexing{false};
+    std::atomic<bool> _isCancelled{false};
+
     Blueprints() = default;
-    ~Blueprints() = default;
+    ~Blueprints();
 };
@@ -1,7 +1,130 @@
 #include "CommandLineOptions.h"
+#include <iostream>
+#include <cstdlib>
+#include <pxr/base/tf/stringUtils.h>
+
+// Parse a frame range like "1-500" or a single frame "10"
+static bool ParseFrameRange(const std::string &arg, double &start, double &end) {
+    char *endPtr = nullptr;
+    start = std::strtod(arg.c_str(), &endPtr);
+    if (endPtr == arg.c_str()) {
+        return false;
+    }
+    if (*endPtr == 0) {
+        end = start;
+        return true;
+    }
+    if (*endPtr != '-') {
+        return false;
+    }
+    const char *endStr = endPtr + 1;
+    end = std::strtod(endStr, &endPtr);
+    return endPtr != endStr && *endPtr == 0 && start <= end;
+}
+
+// Parse a time step given as a fraction "1/240" or a number of seconds "0.004"
+static bool ParseTimeStep(const std::string &arg, double &timeStep) {
+    char *endPtr = nullptr;
+    const double numerator = std::strtod(arg.c_str(), &endPtr);
+    if (endPtr == arg.c_str()) {
+        return false;
+    }
+    if (*endPtr == '/') {
+        const char *denominatorStr = endPtr + 1;
+        const double denominator = std::strtod(denominatorStr, &endPtr);
+        if (endPtr == denominatorStr || denominator == 0.0) {
+            return false;
+        }
+        timeStep = numerator / denominator;
+    } else {
+        timeStep = numerator;
+    }
+    return *endPtr == 0 && timeStep > 0.0;
+}
+
+// Parse the payload loading: all, none or background
+static bool ParsePayloadLoading(const std::string &arg, StageOpenJob::PayloadLoading &payloadLoading) {
+    if (arg == "all") {
+        payloadLoading = StageOpenJob::LoadPayloadsAll;
+    } else if (arg == "none") {
+        payloadLoading = StageOpenJob::LoadPayloadsNone;
+    } else if (arg == "background") {
+        payloadLoading = StageOpenJob::LoadPayloadsInBackground;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parse a comma separated list of absolute prim paths
+static bool ParsePopulationMask(const std::string &arg, SdfPathVector &paths) {
+    for (const std::string &pathString : TfStringSplit(arg, ",")) {
+        if (!SdfPath::IsValidPathString(pathString)) {
+            return false;
+        }
+        const SdfPath path(pathString);
+        if (!path.IsAbsolutePath() || !(path.IsPrimPath() || path.IsAbsoluteRootPath())) {
+            return false;
+        }
+        paths.push_back(path);
+    }
+    return !paths.empty();
+}
 
 CommandLineOptions::CommandLineOptions(int argc, char *const *argv) {
     for (int i = 1; i < argc; ++i) {
-        _stages.push_back(argv[i]);
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--simulate" || arg == "--bake" || arg == "--frames" || arg == "--dt" || arg == "--chunk" ||
+            arg == "--load" || arg == "--mask") {
+            if (!hasValue) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                _isValid = false;
+                continue;
+            }
+            const std::string value(argv[++i]);
+            if (arg == "--simulate") {
+                _simulateStage = value;
+            } else if (arg == "--bake") {
+                _bakeLayer = value;
+            } else if (arg == "--frames") {
+                _hasFrameRange = ParseFrameRange(value, _startFrame, _endFrame);
+                if (!_hasFrameRange) {
+                    std::cerr << "Invalid frame range " << value << ", expected start-end" << std::endl;
+                    _isValid = false;
+                }
+            } else if (arg == "--dt") {
+                if (!ParseTimeStep(value, _timeStep)) {
+                    std::cerr << "Invalid time step " << value << ", expected 1/240 or 0.004" << std::endl;
+                    _isValid = false;
+                }
+            } else if (arg == "--load") {
+                if (!ParsePayloadLoading(value, _payloadLoading)) {
+                    std::cerr << "Invalid payload loading " << value << ", expected all, none or background" << std::endl;
+                    _isValid = false;
+                }
+            } else if (arg == "--mask") {
+                if (!ParsePopulationMask(value, _populationMask)) {
+                    std::cerr << "Invalid population mask " << value << ", expected /path/a,/path/b" << std::endl;
+                    _isValid = false;
+                }
+            } else if (arg == "--chunk") {
+                const long chunkSize = std::strtol(value.c_str(), nullptr, 10);
+                if (chunkSize <= 0) {
+                    std::cerr << "Invalid chunk size " << value << std::endl;
+                    _isValid = false;
+                } else {
+                    _chunkSize = static_cast<size_t>(chunkSize);
+                }
+            }
+        } else if (arg == "--gl-finish") {
+            _forceGlFinish = true;
+        } else {
+            _stages.push_back(arg);
+        }
+    }
+    if (simulate() && _bakeLayer.empty()) {
+        std::cerr << "--simulate requires an output layer, use --bake out.usdc" << std::endl;
+        _isValid = false;
     }
 }
@@ -1,12 +1,46 @@
 #include <vector>
 #include <string>
 
+#include "StageOpenJob.h"
+
 class CommandLineOptions {
   public:
     CommandLineOptions(int argc, char *const *argv);
 
     const std::vector<std::string> &stages() { return _stages; }
 
+    /// Payload loading and population mask of the stages: usdtweak --load background --mask /World/set,/World/chars shot.usd
+    StageOpenJob::PayloadLoading payloadLoading() const { return _payloadLoading; }
+    const SdfPathVector &populationMask() const { return _populationMask; }
+
+    /// Headless simulation: usdtweak --simulate scene.usd --frames 1-500 --dt 1/240 --bake out.usdc
+    bool simulate() const { return !_simulateStage.empty(); }
+    const std::string &simulateStage() const { return _simulateStage; }
+    const std::string &bakeLayer() const { return _bakeLayer; }
+    double startFrame() const { return _startFrame; }
+    double endFrame() const { return _endFrame; }
+    bool hasFrameRange() const { return _hasFrameRange; }
+    double timeStep() const { return _timeStep; }
+    size_t chunkSize() const { return _chunkSize; }
+
+    /// Wait for the gpu at the end of each frame, a workaround for the pcoip driver: usdtweak --gl-finish
+    bool forceGlFinish() const { return _forceGlFinish; }
+
+    /// False if the arguments couldn't be parsed, the errors are printed on stderr
+    bool isValid() const { return _isValid; }
+
   private:
     std::vector<std::string> _stages;
+    StageOpenJob::PayloadLoading _payloadLoading = StageOpenJob::LoadPayloadsAll;
+    SdfPathVector _populationMask;
+
+    std::string _simulateStage;
+    std::string _bakeLayer;
+    double _startFrame = 1.0;
+    double _endFrame = 1.0;
+    bool _hasFrameRange = false;
+    double _timeStep = 1.0 / 240.0;
+    size_t _chunkSize = 50;
+    bool _forceGlFinish = false;
+    bool _isValid = true;
 };
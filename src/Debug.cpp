@@ -1,10 +1,16 @@
+#include "Commands.h"
 #include "Debug.h"
+#include "FramePacer.h"
 #include "Gui.h"
+#include "runtime/profiler.h"
 #include "pxr/base/trace/reporter.h"
 #include "pxr/base/trace/trace.h"
 #include <pxr/base/plug/plugin.h>
 #include <pxr/base/plug/registry.h>
 #include <pxr/base/tf/debug.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
 #include <sstream>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -73,16 +79,250 @@ static void DrawPlugins() {
     }
 }
 
+static void DrawUndoStack() {
+    int maxSizeMB = static_cast<int>(GetUndoStackMaxSize() / (1024 * 1024));
+    if (ImGui::InputInt("Memory budget (MB)", &maxSizeMB, 64, 512, ImGuiInputTextFlags_EnterReturnsTrue)) {
+        SetUndoStackMaxSize(static_cast<size_t>(std::max(maxSizeMB, 1)) * 1024 * 1024);
+    }
+    const std::vector<UndoStackEntry> entries = GetUndoStackEntries();
+    size_t totalSize = 0;
+    for (const auto &entry : entries) {
+        totalSize += entry.size;
+    }
+    ImGui::Text("%zu commands, %.2f MB", entries.size(), static_cast<double>(totalSize) / (1024.0 * 1024.0));
+    const ImVec2 tableSize(-FLT_MIN, -10);
+    if (ImGui::BeginTable("##UndoStack", 3, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, tableSize)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("#", ImGuiTableColumnFlags_WidthFixed, 40);
+        ImGui::TableSetupColumn("Command", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Size (KB)", ImGuiTableColumnFlags_WidthFixed, 100);
+        ImGui::TableHeadersRow();
+        // Most recent first
+        for (int i = static_cast<int>(entries.size()) - 1; i >= 0; --i) {
+            const UndoStackEntry &entry = entries[i];
+            ImGui::TableNextRow();
+            ImGui::BeginDisabled(entry.isUndone);
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%d", i);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%s", entry.name.c_str());
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.1f", static_cast<double>(entry.size) / 1024.0);
+            ImGui::EndDisabled();
+        }
+        ImGui::EndTable();
+    }
+}
+
+static void DrawFramePacing() {
+    FramePacer &framePacer = FramePacer::GetInstance();
+    int mode = framePacer.GetMode();
+    ImGui::PushItemWidth(150);
+    if (ImGui::Combo("Frame pacing", &mode, "Low latency\0High throughput\0")) {
+        framePacer.SetMode(static_cast<FramePacer::Mode>(mode));
+    }
+    ImGui::BeginDisabled(framePacer.GetMode() == FramePacer::LowLatency);
+    int maxFramesInFlight = framePacer.GetMaxFramesInFlight();
+    if (ImGui::SliderInt("Max frames in flight", &maxFramesInFlight, 1, FramePacer::MaxFramesInFlightLimit)) {
+        framePacer.SetMaxFramesInFlight(maxFramesInFlight);
+    }
+    ImGui::EndDisabled();
+    ImGui::PopItemWidth();
+    bool forceFinish = framePacer.GetForceFinish();
+    if (ImGui::Checkbox("Force glFinish (pcoip workaround)", &forceFinish)) {
+        framePacer.SetForceFinish(forceFinish);
+    }
+    ImGui::Text("Frames in flight: %d, gpu wait: %.3f ms", framePacer.GetFramesInFlight(), framePacer.GetLastWaitTime());
+}
+
+static ImU32 GetProfileScopeColor(const char *name) {
+    const float hue = static_cast<float>(std::hash<std::string>()(name) % 360) / 360.f;
+    return ImColor::HSV(hue, 0.45f, 0.75f);
+}
+
+// Frame duration graph, clicking on a frame selects it
+static void DrawProfiledFrames(const std::vector<runtime::Profiler::Event> &frames, int &selectedFrame) {
+    constexpr float graphHeight = 60.f;
+    constexpr double targetMs = 1000.0 / 60.0;
+    double maxMs = 2.0 * targetMs;
+    for (const auto &frame : frames) {
+        maxMs = std::max(maxMs, (frame.endNs - frame.startNs) / 1e6);
+    }
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float width = ImGui::GetContentRegionAvail().x;
+    ImGui::InvisibleButton("##ProfiledFrames", ImVec2(width, graphHeight));
+    const bool isHovered = ImGui::IsItemHovered();
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + graphHeight), ImGui::GetColorU32(ImGuiCol_FrameBg));
+    const float barWidth = width / static_cast<float>(std::max<size_t>(frames.size(), 1));
+    for (int i = 0; i < static_cast<int>(frames.size()); ++i) {
+        const double ms = (frames[i].endNs - frames[i].startNs) / 1e6;
+        const float barHeight = static_cast<float>(ms / maxMs) * graphHeight;
+        const ImVec2 barMin(origin.x + i * barWidth, origin.y + graphHeight - barHeight);
+        const ImVec2 barMax(barMin.x + std::max(barWidth - 1.f, 1.f), origin.y + graphHeight);
+        const ImU32 color = i == selectedFrame       ? IM_COL32(255, 255, 255, 255)
+                            : ms > 2.0 * targetMs ? IM_COL32(220, 70, 70, 255)
+                            : ms > targetMs       ? IM_COL32(220, 180, 70, 255)
+                                                  : IM_COL32(90, 180, 90, 255);
+        drawList->AddRectFilled(barMin, barMax, color);
+        if (isHovered && ImGui::GetIO().MousePos.x >= barMin.x && ImGui::GetIO().MousePos.x < barMin.x + barWidth) {
+            ImGui::SetTooltip("Frame %llu\n%.2f ms", static_cast<unsigned long long>(frames[i].frame), ms);
+            if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+                selectedFrame = i;
+            }
+        }
+    }
+    const float targetY = origin.y + graphHeight - static_cast<float>(targetMs / maxMs) * graphHeight;
+    drawList->AddLine(ImVec2(origin.x, targetY), ImVec2(origin.x + width, targetY), IM_COL32(255, 255, 255, 80));
+}
+
+// Timeline of the scopes recorded during a frame, one lane per thread, the nested scopes stacked like a flame graph
+static void DrawProfiledFrameTimeline(const std::vector<runtime::Profiler::Event> &events,
+                                      const runtime::Profiler::Event &frame) {
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const double frameDurationNs = static_cast<double>(std::max<uint64_t>(frame.endNs - frame.startNs, 1));
+    // Lanes, starting with the thread running the frame
+    std::map<uint32_t, uint32_t> laneDepths;
+    laneDepths[frame.threadIndex] = 0;
+    for (const auto &event : events) {
+        if (event.endNs >= frame.startNs && event.startNs <= frame.endNs) {
+            laneDepths[event.threadIndex] = std::max(laneDepths[event.threadIndex], event.depth + 1);
+        }
+    }
+    std::vector<uint32_t> lanes = {frame.threadIndex};
+    for (const auto &laneDepth : laneDepths) {
+        if (laneDepth.first != frame.threadIndex) {
+            lanes.push_back(laneDepth.first);
+        }
+    }
+    const float width = ImGui::GetContentRegionAvail().x;
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    for (const uint32_t lane : lanes) {
+        ImGui::Text("Thread %u", lane);
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        const float laneHeight = rowHeight * static_cast<float>(std::max<uint32_t>(laneDepths[lane], 1));
+        ImGui::PushID(static_cast<int>(lane));
+        ImGui::InvisibleButton("##Lane", ImVec2(width, laneHeight));
+        ImGui::PopID();
+        const bool isHovered = ImGui::IsItemHovered();
+        drawList->PushClipRect(origin, ImVec2(origin.x + width, origin.y + laneHeight), true);
+        for (const auto &event : events) {
+            if (event.threadIndex != lane || event.endNs < frame.startNs || event.startNs > frame.endNs) {
+                continue;
+            }
+            const double start = std::max<double>(static_cast<double>(event.startNs) - frame.startNs, 0.0);
+            const double end = std::min<double>(static_cast<double>(event.endNs) - frame.startNs, frameDurationNs);
+            const ImVec2 scopeMin(origin.x + static_cast<float>(start / frameDurationNs) * width,
+                                  origin.y + event.depth * rowHeight);
+            const ImVec2 scopeMax(std::max(origin.x + static_cast<float>(end / frameDurationNs) * width, scopeMin.x + 1.f),
+                                  scopeMin.y + rowHeight - 1.f);
+            drawList->AddRectFilled(scopeMin, scopeMax, GetProfileScopeColor(event.name));
+            const ImVec4 textClip(scopeMin.x, scopeMin.y, scopeMax.x - 2.f, scopeMax.y);
+            drawList->AddText(nullptr, 0.f, ImVec2(scopeMin.x + 2.f, scopeMin.y), IM_COL32(0, 0, 0, 255), event.name,
+                              nullptr, 0.f, &textClip);
+            if (isHovered && ImGui::IsMouseHoveringRect(scopeMin, scopeMax)) {
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.endNs - event.startNs) / 1e6);
+            }
+        }
+        drawList->PopClipRect();
+    }
+}
+
+// Time spent in each scope during a frame
+static void DrawProfiledFrameSummary(const std::vector<runtime::Profiler::Event> &events,
+                                     const runtime::Profiler::Event &frame) {
+    std::map<std::string, std::pair<double, int>> scopes;
+    for (const auto &event : events) {
+        if (event.frame == frame.frame) {
+            auto &scope = scopes[event.name];
+            scope.first += (event.endNs - event.startNs) / 1e6;
+            scope.second++;
+        }
+    }
+    std::vector<std::pair<std::string, std::pair<double, int>>> sortedScopes(scopes.begin(), scopes.end());
+    std::sort(sortedScopes.begin(), sortedScopes.end(),
+              [](const auto &a, const auto &b) { return a.second.first > b.second.first; });
+    const ImVec2 tableSize(-FLT_MIN, -10);
+    if (ImGui::BeginTable("##ProfiledScopes", 3, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, tableSize)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Total (ms)", ImGuiTableColumnFlags_WidthFixed, 100);
+        ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed, 60);
+        ImGui::TableHeadersRow();
+        for (const auto &scope : sortedScopes) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", scope.first.c_str());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.3f", scope.second.first);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%d", scope.second.second);
+        }
+        ImGui::EndTable();
+    }
+}
+
+static void DrawFrameProfiler() {
+    runtime::Profiler &profiler = runtime::Profiler::GetInstance();
+    bool isEnabled = profiler.IsEnabled();
+    if (ImGui::Checkbox("Record", &isEnabled)) {
+        profiler.SetEnabled(isEnabled);
+    }
+    ImGui::SameLine();
+    static bool isPaused = false;
+    ImGui::Checkbox("Pause", &isPaused);
+    ImGui::SameLine();
+    static std::string tracePath("usdtweak_trace.json");
+    static std::string exportMessage;
+    ImGui::SetNextItemWidth(300);
+    ImGui::InputText("##ChromeTracePath", &tracePath);
+    ImGui::SameLine();
+    if (ImGui::Button("Export chrome trace")) {
+        exportMessage = profiler.WriteChromeTrace(tracePath) ? "Written " + tracePath : "Unable to write " + tracePath;
+    }
+    if (!exportMessage.empty()) {
+        ImGui::SameLine();
+        ImGui::Text("%s", exportMessage.c_str());
+    }
+
+    static std::vector<runtime::Profiler::Event> events;
+    static int selectedFrame = -1;
+    if (!isPaused) {
+        events = profiler.GetEvents();
+        selectedFrame = -1;
+    }
+    // The frame scopes of the main loop, in order
+    std::vector<runtime::Profiler::Event> frames;
+    for (const auto &event : events) {
+        if (event.depth == 0 && std::strcmp(event.name, "Frame") == 0) {
+            frames.push_back(event);
+        }
+    }
+    if (frames.empty()) {
+        ImGui::Text("No frame recorded");
+        return;
+    }
+    DrawProfiledFrames(frames, selectedFrame);
+    if (selectedFrame >= 0 && !isPaused) {
+        isPaused = true;
+    }
+    const runtime::Profiler::Event &frame = frames[selectedFrame >= 0 ? selectedFrame : frames.size() - 1];
+    ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(frame.frame), (frame.endNs - frame.startNs) / 1e6);
+    DrawProfiledFrameTimeline(events, frame);
+    DrawProfiledFrameSummary(events, frame);
+}
+
 // Draw a preference like panel
 void DrawDebugUI() {
-    static const char *const panels[] = {"Timings", "Debug codes", "Trace reporter", "Plugins"};
+    static const char *const panels[] = {"Timings", "Debug codes", "Trace reporter", "Plugins", "Undo stack", "Frame profiler"};
     static int current_item = 0;
     ImGui::PushItemWidth(100);
-    ImGui::ListBox("##DebugPanels", &current_item, panels, 4);
+    ImGui::ListBox("##DebugPanels", &current_item, panels, 6);
     ImGui::SameLine();
     if (current_item == 0) {
         ImGui::BeginChild("##Timing");
         ImGui::Text("ImGui: %.3f ms/frame  (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        DrawFramePacing();
         ImGui::EndChild();
     } else if (current_item == 1) {
         ImGui::BeginChild("##DebugCodes");
@@ -96,5 +336,13 @@ void DrawDebugUI() {
         ImGui::BeginChild("##Plugins");
         DrawPlugins();
         ImGui::EndChild();
+    } else if (current_item == 4) {
+        ImGui::BeginChild("##UndoStack");
+        DrawUndoStack();
+        ImGui::EndChild();
+    } else if (current_item == 5) {
+        ImGui::BeginChild("##FrameProfiler");
+        DrawFrameProfiler();
+        ImGui::EndChild();
     }
 }
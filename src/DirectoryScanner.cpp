@@ -0,0 +1,315 @@
+#include "DirectoryScanner.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__cplusplus) && __cplusplus >= 201703L && defined(__has_include) && __has_include(<filesystem>)
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#define GHC_WITH_EXCEPTIONS 0
+#include <ghc/filesystem.hpp>
+namespace fs = ghc::filesystem;
+#endif
+
+#ifdef __linux__
+#include <cstdint>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace clk = std::chrono;
+
+// Interval between the partial snapshots published while scanning a directory
+static constexpr clk::milliseconds PartialSnapshotInterval(100);
+
+// Convert different time representation to time_t
+template <typename TimePointT> static std::time_t toTimet(TimePointT timePoint) {
+    const auto sysClockTimePoint =
+        clk::time_point_cast<clk::system_clock::duration>(timePoint - TimePointT::clock::now() + clk::system_clock::now());
+    return clk::system_clock::to_time_t(sysClockTimePoint);
+}
+
+static std::int64_t GetWriteTime(const std::string &directory) {
+    std::error_code ec;
+    const auto writeTime = fs::last_write_time(fs::path(directory), ec);
+    return ec ? 0 : static_cast<std::int64_t>(writeTime.time_since_epoch().count());
+}
+
+// Read the metadata of a directory entry, returns false if the entry must not be listed
+static bool ReadEntry(const fs::directory_entry &item, const std::vector<std::string> &extensions, DirectoryEntry &entry) {
+    const fs::path &path = item.path();
+    entry.fileName = path.filename().string();
+    if (entry.fileName.empty() || entry.fileName[0] == '.') {
+        return false;
+    }
+    std::error_code ec;
+    if (item.is_symlink(ec) || ec) {
+        return false;
+    }
+    entry.isDirectory = item.is_directory(ec);
+    if (ec) {
+        return false;
+    }
+    if (!entry.isDirectory) {
+        if (!extensions.empty() &&
+            std::find(extensions.begin(), extensions.end(), path.extension().string()) == extensions.end()) {
+            return false;
+        }
+        entry.fileSize = item.file_size(ec);
+        if (ec) {
+            entry.fileSize = 0;
+        }
+    }
+    const auto lastWriteTime = item.last_write_time(ec);
+    entry.lastModified = ec ? -1 : toTimet(lastWriteTime);
+    entry.path = path.string();
+    return true;
+}
+
+// Directories first, then by name
+static std::shared_ptr<const DirectorySnapshot> MakeSnapshot(const std::string &directory,
+                                                             const std::vector<DirectoryEntry> &entries, bool isComplete) {
+    auto snapshot = std::make_shared<DirectorySnapshot>();
+    snapshot->directory = directory;
+    snapshot->entries = entries;
+    snapshot->isComplete = isComplete;
+    std::sort(snapshot->entries.begin(), snapshot->entries.end(), [](const DirectoryEntry &a, const DirectoryEntry &b) {
+        return a.isDirectory != b.isDirectory ? a.isDirectory : a.fileName < b.fileName;
+    });
+    return snapshot;
+}
+
+DirectoryScanner::DirectoryScanner() {
+#ifdef __linux__
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    _thread = std::thread(&DirectoryScanner::Run, this);
+}
+
+DirectoryScanner::~DirectoryScanner() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    WakeWorker();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+#ifdef __linux__
+    if (_inotifyFd >= 0) {
+        close(_inotifyFd);
+    }
+    if (_wakeFd >= 0) {
+        close(_wakeFd);
+    }
+#endif
+}
+
+void DirectoryScanner::Scan(const std::string &directory, bool forceRescan) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requestedDirectory = directory;
+        _forceRescan |= forceRescan;
+        _hasRequest = true;
+    }
+    WakeWorker();
+}
+
+void DirectoryScanner::SetValidExtensions(const std::vector<std::string> &extensions) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_validExtensions == extensions) {
+            return;
+        }
+        _validExtensions = extensions;
+        _extensionsChanged = true;
+        // The displayed listing was filtered with the previous extensions
+        if (!_requestedDirectory.empty()) {
+            _forceRescan = true;
+            _hasRequest = true;
+        }
+    }
+    WakeWorker();
+}
+
+void DirectoryScanner::WakeWorker() {
+#ifdef __linux__
+    if (_wakeFd >= 0) {
+        const std::uint64_t value = 1;
+        [[maybe_unused]] const ssize_t written = write(_wakeFd, &value, sizeof(value));
+        return;
+    }
+#endif
+    _condition.notify_one();
+}
+
+std::shared_ptr<const DirectorySnapshot> DirectoryScanner::GetSnapshot() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _snapshot;
+}
+
+// Worker thread, waits for a request or, on Linux, for a change of the watched directory
+void DirectoryScanner::WaitForEvents(std::unique_lock<std::mutex> &lock) {
+#ifdef __linux__
+    if (_wakeFd >= 0) {
+        if (_hasRequest || _isStopping) {
+            return;
+        }
+        // The eventfd counter stays signaled until it is read, a request made after the check above isn't missed
+        lock.unlock();
+        pollfd fds[2] = {{_wakeFd, POLLIN, 0}, {_inotifyFd, POLLIN, 0}};
+        poll(fds, _inotifyFd >= 0 ? 2 : 1, -1);
+        std::uint64_t value = 0;
+        [[maybe_unused]] const ssize_t length = read(_wakeFd, &value, sizeof(value));
+        lock.lock();
+        return;
+    }
+#endif
+    _condition.wait(lock, [this] { return _hasRequest || _isStopping; });
+}
+
+// Worker thread
+void DirectoryScanner::Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_isStopping) {
+        WaitForEvents(lock);
+        if (_isStopping) {
+            break;
+        }
+        if (_extensionsChanged) {
+            _cache.clear();
+            _extensionsChanged = false;
+        }
+        bool hasRequest = _hasRequest;
+        std::string directory = _requestedDirectory;
+        bool forceRescan = _forceRescan;
+        _hasRequest = false;
+        _forceRescan = false;
+        lock.unlock();
+
+        // The watched directory was modified, its cached listing is outdated
+        if (ReadDirectoryEvents() && !hasRequest) {
+            hasRequest = true;
+            directory = _watchedDirectory;
+        }
+        if (hasRequest) {
+            ProcessRequest(directory, forceRescan);
+        }
+        lock.lock();
+    }
+}
+
+void DirectoryScanner::ProcessRequest(const std::string &directory, bool forceRescan) {
+    const std::int64_t writeTime = GetWriteTime(directory);
+    const auto cached = _cache.find(directory);
+    if (cached != _cache.end()) {
+        // Show the cached listing while checking it is still valid
+        Publish(cached->second.snapshot);
+        if (!forceRescan && cached->second.writeTime == writeTime) {
+            WatchDirectory(directory);
+            return;
+        }
+    }
+    std::vector<std::string> extensions;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        extensions = _validExtensions;
+    }
+    WatchDirectory(directory);
+    ScanDirectory(directory, extensions, writeTime);
+}
+
+void DirectoryScanner::ScanDirectory(const std::string &directory, const std::vector<std::string> &extensions,
+                                     std::int64_t writeTime) {
+    // The partial listings are only published when the directory is not already displayed, a refresh keeps showing
+    // the previous listing until the new one is complete
+    bool publishPartialSnapshots = true;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        publishPartialSnapshots = !_snapshot || _snapshot->directory != directory;
+    }
+    if (publishPartialSnapshots) {
+        Publish(MakeSnapshot(directory, {}, false));
+    }
+
+    std::vector<DirectoryEntry> entries;
+    auto lastPublished = clk::steady_clock::now();
+    std::error_code ec;
+    fs::directory_iterator it(fs::path(directory), fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (HasNewRequest()) {
+            return; // Abandoned, the next request is processed instead
+        }
+        DirectoryEntry entry;
+        if (ReadEntry(*it, extensions, entry)) {
+            entries.push_back(std::move(entry));
+        }
+        if (publishPartialSnapshots && clk::steady_clock::now() - lastPublished > PartialSnapshotInterval) {
+            Publish(MakeSnapshot(directory, entries, false));
+            lastPublished = clk::steady_clock::now();
+        }
+    }
+
+    auto snapshot = MakeSnapshot(directory, entries, true);
+    if (!ec) {
+        _cache[directory] = CachedListing{snapshot, writeTime};
+    }
+    Publish(snapshot);
+}
+
+bool DirectoryScanner::HasNewRequest() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hasRequest || _isStopping;
+}
+
+void DirectoryScanner::Publish(std::shared_ptr<const DirectorySnapshot> snapshot) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _snapshot = std::move(snapshot);
+}
+
+// Only the last requested directory is watched
+void DirectoryScanner::WatchDirectory(const std::string &directory) {
+    if (directory == _watchedDirectory) {
+        return;
+    }
+    _watchedDirectory = directory;
+#ifdef __linux__
+    if (_inotifyFd < 0) {
+        return;
+    }
+    if (_watchDescriptor >= 0) {
+        inotify_rm_watch(_inotifyFd, _watchDescriptor);
+    }
+    _watchDescriptor = inotify_add_watch(_inotifyFd, directory.c_str(),
+                                         IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB |
+                                             IN_DELETE_SELF | IN_MOVE_SELF);
+#endif
+}
+
+// Returns true when the watched directory was modified since the last call
+bool DirectoryScanner::ReadDirectoryEvents() {
+    bool isModified = false;
+#ifdef __linux__
+    if (_inotifyFd < 0) {
+        return false;
+    }
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length = 0;
+    while ((length = read(_inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + length;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(ptr);
+            // The events of a previously watched directory can still be in the queue
+            isModified |= event->wd == _watchDescriptor && !(event->mask & IN_IGNORED);
+            ptr += sizeof(inotify_event) + event->len;
+        }
+    }
+    if (isModified) {
+        _cache.erase(_watchedDirectory);
+    }
+#endif
+    return isModified;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Entry of a directory listing, all the metadata is read by the scanner thread
+struct DirectoryEntry {
+    std::string path;
+    std::string fileName;
+    bool isDirectory = false;
+    std::uintmax_t fileSize = 0;
+    std::time_t lastModified = -1; // -1 when it could not be read
+};
+
+/// Listing of a directory, the directories come first and both directories and files are sorted by name.
+/// A snapshot is never modified once published, the scanner publishes a new one with the entries found since.
+struct DirectorySnapshot {
+    std::string directory;
+    std::vector<DirectoryEntry> entries;
+    bool isComplete = false; // False while the directory is still being scanned
+};
+
+/// Directory scanner
+/// The directories are listed on a worker thread so the file browser never blocks on the filesystem, which is
+/// noticeable on network mounts with tens of thousands of files. The hidden files, the symlinks and the files without
+/// a valid extension are filtered on the worker thread.
+/// While a directory is being scanned, partial snapshots are published regularly. The snapshots are cached by
+/// directory with the directory modification time: revisiting a directory shows the cached listing immediately and it
+/// is only scanned again if the directory was modified. On Linux the displayed directory is watched with inotify, the
+/// listing is refreshed when the directory changes instead of being polled: the idle worker blocks in poll on the
+/// inotify descriptor and on an eventfd signaled by the requests.
+class DirectoryScanner {
+  public:
+    DirectoryScanner();
+
+    /// Stops and waits for the worker thread
+    ~DirectoryScanner();
+
+    // Delete copy
+    DirectoryScanner(const DirectoryScanner &) = delete;
+    DirectoryScanner &operator=(const DirectoryScanner &) = delete;
+
+    /// Request the listing of a directory, the cached listing is reused unless forceRescan is true
+    void Scan(const std::string &directory, bool forceRescan = false);
+
+    /// Only the files with one of these extensions are listed, all of them when empty. This invalidates the cache and
+    /// rescans the requested directory.
+    void SetValidExtensions(const std::vector<std::string> &extensions);
+
+    /// Returns the last published snapshot of the requested directory, it can be partial or from a previous request
+    std::shared_ptr<const DirectorySnapshot> GetSnapshot() const;
+
+  private:
+    struct CachedListing {
+        std::shared_ptr<const DirectorySnapshot> snapshot;
+        std::int64_t writeTime = 0; // Modification time of the directory when it was scanned
+    };
+
+    void Run();
+    void WakeWorker();
+    void WaitForEvents(std::unique_lock<std::mutex> &lock);
+    void ProcessRequest(const std::string &directory, bool forceRescan);
+    void ScanDirectory(const std::string &directory, const std::vector<std::string> &extensions, std::int64_t writeTime);
+    bool HasNewRequest();
+    void Publish(std::shared_ptr<const DirectorySnapshot> snapshot);
+    void WatchDirectory(const std::string &directory);
+    bool ReadDirectoryEvents();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    // Protected by _mutex
+    std::string _requestedDirectory;
+    bool _hasRequest = false;
+    bool _forceRescan = false;
+    bool _isStopping = false;
+    std::vector<std::string> _validExtensions;
+    bool _extensionsChanged = false;
+    std::shared_ptr<const DirectorySnapshot> _snapshot;
+
+    // Worker thread only
+    std::unordered_map<std::string, CachedListing> _cache;
+    std::string _watchedDirectory;
+    int _inotifyFd = -1;
+    int _watchDescriptor = -1;
+    int _wakeFd = -1; // Signaled by the requests to wake the worker blocked in poll
+
+    std::thread _thread;
+};
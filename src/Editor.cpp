@@ -1,5 +1,6 @@
 #include <iostream>
 #include <array>
+#include <cmath>
 #include <utility>
 #include <pxr/imaging/garch/glApi.h>
 #include <pxr/base/arch/fileSystem.h>
@@ -34,10 +35,13 @@
 #include "ConnectionEditor.h"
 #include "Playblast.h"
 #include "Blueprints.h"
+#include "LayerRegistry.h"
+#include "FramePacer.h"
 #include "UsdHelpers.h"
 #include "Stamp.h"
 #include "ManipulatorToolbox.h"
 #include "HydraBrowser.h"
+#include "runtime/profiler.h"
 
 namespace clk = std::chrono;
 
@@ -214,7 +218,9 @@ struct OpenUsdFileModalDialog : public ModalDialog {
             ImGui::Checkbox("Open as stage", &openAsStage);
             if (openAsStage) {
                 ImGui::SameLine();
-                ImGui::Checkbox("Load payloads", &openLoaded);
+                const char *payloadLoadings[] = {"Load payloads", "Don't load payloads", "Load payloads in background"};
+                ImGui::SetNextItemWidth(220);
+                ImGui::Combo("##PayloadLoading", &payloadLoading, payloadLoadings, IM_ARRAYSIZE(payloadLoadings));
             }
         } else {
             ImGui::Text("Not found: ");
@@ -224,7 +230,10 @@ struct OpenUsdFileModalDialog : public ModalDialog {
         DrawOkCancelModal([&]() {
             if (!filePath.empty() && FilePathExists()) {
                 if (openAsStage) {
-                    editor.OpenStage(filePath, openLoaded);
+                    StageOpenJob::Parameters parameters;
+                    parameters.path = filePath;
+                    parameters.payloadLoading = static_cast<StageOpenJob::PayloadLoading>(payloadLoading);
+                    editor.OpenStage(parameters);
                 } else {
                     editor.FindOrOpenLayer(filePath);
                 }
@@ -235,7 +244,7 @@ struct OpenUsdFileModalDialog : public ModalDialog {
     const char *DialogId() const override { return "Open layer"; }
     Editor &editor;
     bool openAsStage = true;
-    bool openLoaded = true;
+    int payloadLoading = StageOpenJob::LoadPayloadsAll;
 };
 
 struct SaveLayerAsDialog : public ModalDialog {
@@ -399,10 +408,11 @@ _layerHistoryPointer(0) {
     ExecuteAfterDraw<EditorSetDataPointer>(this); // This is specialized to execute here, not after the draw
     LoadSettings();
     SetFileBrowserDirectory(_settings._lastFileBrowserDirectory);
-    Blueprints::GetInstance().SetBlueprintsLocations(_settings._blueprintLocations);
+    Blueprints::GetInstance().SetBlueprintsLocations(_settings._blueprintLocations, ResourcesLoader::GetBlueprintsIndexFilePath());
 }
 
 Editor::~Editor(){
+    Blueprints::GetInstance().StopIndexing();
     _settings._lastFileBrowserDirectory = GetFileBrowserDirectory();
     SaveSettings();
 }
@@ -443,6 +453,8 @@ void Editor::SetCurrentStage(UsdStageRefPtr stage) {
 void Editor::SetCurrentLayer(SdfLayerRefPtr layer, bool showContentBrowser) {
     if (!layer)
         return;
+    // The layers created or opened from the menus are not part of a stage, no notice tells the registry about them
+    LayerRegistry::GetInstance().AddLayer(layer);
     if (!_layerHistory.empty()) {
         if (GetCurrentLayer() != layer) {
             if (_layerHistoryPointer < _layerHistory.size() - 1) {
@@ -495,13 +507,41 @@ void Editor::FindOrOpenLayer(const std::string &path) {
 
 //
 void Editor::OpenStage(const std::string &path, bool openLoaded) {
-    auto newStage = UsdStage::Open(path, openLoaded ? UsdStage::LoadAll : UsdStage::LoadNone); // TODO: as an option
-    if (newStage) {
-        GetStageCache().Insert(newStage);
-        SetCurrentStage(newStage);
-        _settings._showContentBrowser = true;
-        _settings._showViewport1 = true;
-        _settings.UpdateRecentFiles(path);
+    StageOpenJob::Parameters parameters;
+    parameters.path = path;
+    parameters.payloadLoading = openLoaded ? StageOpenJob::LoadPayloadsAll : StageOpenJob::LoadPayloadsNone;
+    OpenStage(parameters);
+}
+
+void Editor::OpenStage(const StageOpenJob::Parameters &parameters) {
+    _stageOpenJobs.push_back(std::make_unique<StageOpenJob>(parameters));
+}
+
+void Editor::UpdateStageOpenJobs() {
+    RUNTIME_PROFILE_SCOPE("Stage open jobs");
+    for (auto it = _stageOpenJobs.begin(); it != _stageOpenJobs.end();) {
+        StageOpenJob &job = **it;
+        // Stop loading the payloads of a stage closed by the user, and stop all the jobs when shutting down
+        if (!job.IsCancelled() &&
+            (_isShutdown || (job.IsLoadingPayloads() && !GetStageCache().Contains(job.GetStage())))) {
+            job.Cancel();
+        }
+        // Loading the payloads modifies the stage read in the background
+        if (job.IsLoadingPayloads() && !job.IsCancelled()) {
+            WaitStageReads();
+        }
+        if (UsdStageRefPtr newStage = job.Update()) {
+            GetStageCache().Insert(newStage);
+            SetCurrentStage(newStage);
+            _settings._showContentBrowser = true;
+            _settings._showViewport1 = true;
+            _settings.UpdateRecentFiles(job.GetParameters().path);
+        }
+        if (job.IsFinished()) {
+            it = _stageOpenJobs.erase(it);
+        } else {
+            ++it;
+        }
     }
 }
 
@@ -575,6 +615,7 @@ void Editor::SelectScaleManipulator() {
 void Editor::StartPlayback() {
     _isPlaying = true;
     _lastFrameTime = clk::steady_clock::now();
+    _playbackTime = _playbackDisplayedTime = _viewport1.GetCurrentTimeCode().GetValue();
 }
 
 void Editor::StopPlayback() {
@@ -597,20 +638,53 @@ void Editor::TogglePlayback() {
     }
 }
 
+void Editor::WaitStageReads() {
+    _viewport1.WaitStageReads();
+#if ENABLE_MULTIPLE_VIEWPORTS
+    _viewport2.WaitStageReads();
+    _viewport3.WaitStageReads();
+    _viewport4.WaitStageReads();
+#endif
+}
+
+void Editor::ClearPlaybackCache() {
+    _viewport1.ClearPlaybackCache();
+#if ENABLE_MULTIPLE_VIEWPORTS
+    _viewport2.ClearPlaybackCache();
+    _viewport3.ClearPlaybackCache();
+    _viewport4.ClearPlaybackCache();
+#endif
+}
+
+void Editor::StartPlayblast(UsdStageRefPtr stage, const PlayblastJob::Parameters &parameters) {
+    if (!_playblastJob && stage) {
+        _playblastJob = std::make_unique<PlayblastJob>(stage, parameters);
+    }
+}
+
 void Editor::HydraRender() {
 
     if (_isPlaying) {
         auto current = clk::steady_clock::now();
         const auto timesCodePerSec = GetCurrentStage()->GetTimeCodesPerSecond();
         const auto timeDifference = std::chrono::duration<double>(current - _lastFrameTime);
-        // We use viewport 1 as the reference
-        double newFrame =
-            _viewport1.GetCurrentTimeCode().GetValue() + timesCodePerSec * timeDifference.count(); // for now just increment the frame
+        // We use viewport 1 as the reference, the playback continues from the time set in the timeline
+        if (_viewport1.GetCurrentTimeCode().GetValue() != _playbackDisplayedTime) {
+            _playbackTime = _viewport1.GetCurrentTimeCode().GetValue();
+        }
+        double newFrame = _playbackTime + timesCodePerSec * timeDifference.count(); // for now just increment the frame
+        const double startTime = GetCurrentStage()->GetStartTimeCode();
         if (newFrame > GetCurrentStage()->GetEndTimeCode()) {
-            newFrame = GetCurrentStage()->GetStartTimeCode();
-        } else if (newFrame < GetCurrentStage()->GetStartTimeCode()) {
-            newFrame = GetCurrentStage()->GetStartTimeCode();
+            newFrame = startTime;
+        } else if (newFrame < startTime) {
+            newFrame = startTime;
+        }
+        _playbackTime = newFrame;
+        // The cached frames are on the frame grid of the stage, the playback displays the whole frames
+        if (_settings._playbackCache) {
+            newFrame = startTime + std::floor(newFrame - startTime);
         }
+        _playbackDisplayedTime = newFrame;
         //_imagingSettings.frame = UsdTimeCode(newFrame);
         _viewport1.SetCurrentTimeCode(UsdTimeCode(newFrame));
 #if ENABLE_MULTIPLE_VIEWPORTS
@@ -620,30 +694,75 @@ void Editor::HydraRender() {
 #endif
         _lastFrameTime = current;
     }
+
+    if (_playblastJob) {
+        RUNTIME_PROFILE_SCOPE("Playblast");
+        _playblastJob->Update();
+        if (_playblastJob->IsFinished()) {
+            _playblastJob.reset();
+        }
+    }
+
+    UpdateStageOpenJobs();
     
     
     
+    // The viewports only render when what they display changed
+    _hasRenderedViewports = false;
 #if !( __APPLE__ && PXR_VERSION < 2208)
     if (_settings._showViewport1) {
         _viewport1.Update();
-        _viewport1.Render();
+        _hasRenderedViewports |= _viewport1.Render();
     }
 #if ENABLE_MULTIPLE_VIEWPORTS
     if (_settings._showViewport2) {
         _viewport2.Update();
-        _viewport2.Render();
+        _hasRenderedViewports |= _viewport2.Render();
     }
     if (_settings._showViewport3) {
         _viewport3.Update();
-        _viewport3.Render();
+        _hasRenderedViewports |= _viewport3.Render();
     }
     if (_settings._showViewport4) {
         _viewport4.Update();
-        _viewport4.Render();
+        _hasRenderedViewports |= _viewport4.Render();
     }
 #endif
 #endif
 
+    // The next frames of the playback are read while the widgets are drawn, the viewports of a stage share the cache
+    if (_isPlaying && _settings._playbackCache) {
+        const size_t memoryBudget = static_cast<size_t>(_settings._playbackCacheSizeMB) * 1024 * 1024;
+        if (_settings._showViewport1) {
+            _viewport1.PrefetchPlayback(memoryBudget);
+        }
+#if ENABLE_MULTIPLE_VIEWPORTS
+        if (_settings._showViewport2) {
+            _viewport2.PrefetchPlayback(memoryBudget);
+        }
+        if (_settings._showViewport3) {
+            _viewport3.PrefetchPlayback(memoryBudget);
+        }
+        if (_settings._showViewport4) {
+            _viewport4.PrefetchPlayback(memoryBudget);
+        }
+#endif
+    }
+
+}
+
+bool Editor::IsIdle() const {
+    if (_hasRenderedViewports || _isPlaying || _playblastJob || !_stageOpenJobs.empty()) {
+        return false;
+    }
+    // The steps of the simulation are consumed by the main loop, it keeps running while the physics is updated
+    bool isSimulating = _settings._showViewport1 && _viewport1.IsSimulating();
+#if ENABLE_MULTIPLE_VIEWPORTS
+    isSimulating |= _settings._showViewport2 && _viewport2.IsSimulating();
+    isSimulating |= _settings._showViewport3 && _viewport3.IsSimulating();
+    isSimulating |= _settings._showViewport4 && _viewport4.IsSimulating();
+#endif
+    return !isSimulating;
 }
 
 void Editor::ShowDialogSaveLayerAs(SdfLayerHandle layerToSaveAs) { DrawModalDialog<SaveLayerAsDialog>(*this, layerToSaveAs); }
@@ -784,12 +903,14 @@ void Editor::DrawMainMenuBar() {
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Tools")) {
-            // TODO: we should really check if storm is available
-            if (ImGui::MenuItem(ICON_FA_IMAGES " Storm playblast")) {
+            if (ImGui::MenuItem(ICON_FA_IMAGES " Playblast", nullptr, false, !IsPlayblasting())) {
                 if (GetCurrentStage()) {
                     DrawModalDialog<PlayblastModalDialog>(GetCurrentStage());
                 }
             }
+            if (ImGui::MenuItem("Playback cache", nullptr, &_settings._playbackCache) && !_settings._playbackCache) {
+                ClearPlaybackCache();
+            }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Windows")) {
@@ -849,6 +970,7 @@ void Editor::Draw() {
         //
         const ImGuiWindowFlags viewportFlags = GetViewport().HasMenuBar() ? ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar : ImGuiWindowFlags_None;
         TRACE_SCOPE(Viewport1WindowTitle);
+        RUNTIME_PROFILE_SCOPE(Viewport1WindowTitle);
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::Begin(Viewport1WindowTitle, &_settings._showViewport1, viewportFlags);
         ImGui::PopStyleVar();
@@ -859,6 +981,7 @@ void Editor::Draw() {
     if (_settings._showViewport2) {
         const ImGuiWindowFlags viewportFlags = _viewport2.HasMenuBar() ? ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar : ImGuiWindowFlags_None;
         TRACE_SCOPE(Viewport2WindowTitle);
+        RUNTIME_PROFILE_SCOPE(Viewport2WindowTitle);
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::Begin(Viewport2WindowTitle, &_settings._showViewport2, viewportFlags);
         ImGui::PopStyleVar();
@@ -868,6 +991,7 @@ void Editor::Draw() {
     if (_settings._showViewport3) {
         const ImGuiWindowFlags viewportFlags = _viewport3.HasMenuBar() ? ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar : ImGuiWindowFlags_None;
         TRACE_SCOPE(Viewport3WindowTitle);
+        RUNTIME_PROFILE_SCOPE(Viewport3WindowTitle);
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::Begin(Viewport3WindowTitle, &_settings._showViewport3, viewportFlags);
         ImGui::PopStyleVar();
@@ -877,6 +1001,7 @@ void Editor::Draw() {
     if (_settings._showViewport4) {
         const ImGuiWindowFlags viewportFlags = _viewport4.HasMenuBar() ? ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar : ImGuiWindowFlags_None;
         TRACE_SCOPE(Viewport4WindowTitle);
+        RUNTIME_PROFILE_SCOPE(Viewport4WindowTitle);
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::Begin(Viewport4WindowTitle, &_settings._showViewport4, viewportFlags);
         ImGui::PopStyleVar();
@@ -896,6 +1021,7 @@ void Editor::Draw() {
 
     if (_settings._showDebugWindow) {
         TRACE_SCOPE(DebugWindowTitle);
+        RUNTIME_PROFILE_SCOPE(DebugWindowTitle);
         ImGui::Begin(DebugWindowTitle, &_settings._showDebugWindow);
         DrawDebugUI();
         ImGui::End();
@@ -907,6 +1033,14 @@ void Editor::Draw() {
                 ImGui::Text("\xee\x81\x99"
                             " %.3f ms/frame  (%.1f FPS)",
                             1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+                if (_playblastJob) {
+                    ImGui::Separator();
+                    DrawPlayblastProgress(*_playblastJob);
+                }
+                for (auto &stageOpenJob : _stageOpenJobs) {
+                    ImGui::Separator();
+                    DrawStageOpenProgress(*stageOpenJob);
+                }
                 ImGui::EndMenuBar();
             }
         }
@@ -922,6 +1056,7 @@ void Editor::Draw() {
     
     if (_settings._showPropertyEditor) {
         TRACE_SCOPE(UsdPrimPropertiesWindowTitle);
+        RUNTIME_PROFILE_SCOPE(UsdPrimPropertiesWindowTitle);
         ImGuiWindowFlags windowFlags = ImGuiWindowFlags_None;
         // WIP windowFlags |= ImGuiWindowFlags_MenuBar;
         ImGui::Begin(UsdPrimPropertiesWindowTitle, &_settings._showPropertyEditor, windowFlags);
@@ -935,6 +1070,7 @@ void Editor::Draw() {
     if (_settings._showOutliner) {
         const ImGuiWindowFlags windowFlagsWithMenu = ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar;
         TRACE_SCOPE(UsdStageHierarchyWindowTitle);
+        RUNTIME_PROFILE_SCOPE(UsdStageHierarchyWindowTitle);
         ImGui::Begin(UsdStageHierarchyWindowTitle, &_settings._showOutliner, windowFlagsWithMenu);
         DrawStageOutliner(GetCurrentStage(), _selection);
         ImGui::End();
@@ -942,6 +1078,7 @@ void Editor::Draw() {
 
     if (_settings._showTimeline) {
         TRACE_SCOPE(TimelineWindowTitle);
+        RUNTIME_PROFILE_SCOPE(TimelineWindowTitle);
         ImGui::Begin(TimelineWindowTitle, &_settings._showTimeline);
         UsdTimeCode tc = GetViewport().GetCurrentTimeCode();
         DrawTimeline(GetCurrentStage(), tc);
@@ -956,6 +1093,7 @@ void Editor::Draw() {
 
     if (_settings._showLayerHierarchyEditor) {
         TRACE_SCOPE(SdfLayerHierarchyWindowTitle);
+        RUNTIME_PROFILE_SCOPE(SdfLayerHierarchyWindowTitle);
         const std::string title(SdfLayerHierarchyWindowTitle + (rootLayer ? " - " + rootLayer->GetDisplayName() : "") +
                                 "###Layer hierarchy");
         ImGui::Begin(title.c_str(), &_settings._showLayerHierarchyEditor, layerWindowFlag);
@@ -965,6 +1103,7 @@ void Editor::Draw() {
 
     if (_settings._showLayerStackEditor) {
         TRACE_SCOPE(SdfLayerStackWindowTitle);
+        RUNTIME_PROFILE_SCOPE(SdfLayerStackWindowTitle);
         const std::string title(SdfLayerStackWindowTitle "###Layer stack");
         ImGui::Begin(title.c_str(), &_settings._showLayerStackEditor);
         //DrawLayerSublayerStack(rootLayer);
@@ -974,6 +1113,7 @@ void Editor::Draw() {
 
     if (_settings._showContentBrowser) {
         TRACE_SCOPE(ContentBrowserWindowTitle);
+        RUNTIME_PROFILE_SCOPE(ContentBrowserWindowTitle);
         const ImGuiWindowFlags windowFlags = ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar;
         ImGui::Begin(ContentBrowserWindowTitle, &_settings._showContentBrowser, windowFlags);
         DrawContentBrowser(*this);
@@ -984,6 +1124,7 @@ void Editor::Draw() {
     if (_settings._showPrimSpecEditor) {
         const ImGuiWindowFlags windowFlagsWithMenu = ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar;
         TRACE_SCOPE(SdfPrimPropertiesWindowTitle);
+        RUNTIME_PROFILE_SCOPE(SdfPrimPropertiesWindowTitle);
         ImGui::Begin(SdfPrimPropertiesWindowTitle, &_settings._showPrimSpecEditor, windowFlagsWithMenu);
         const SdfPath &primPath = _selection.GetAnchorPrimPath(GetCurrentLayer());
         // Ideally this condition should be moved in a function like DrawLayerProperties()
@@ -1014,6 +1155,7 @@ void Editor::Draw() {
     if (_settings._showUsdConnectionEditor) {
         ImGui::Begin(UsdConnectionEditorWindowTitle, &_settings._showUsdConnectionEditor);
         TRACE_SCOPE(UsdConnectionEditorWindowTitle);
+        RUNTIME_PROFILE_SCOPE(UsdConnectionEditorWindowTitle);
         if (GetCurrentStage()) {
             DrawConnectionEditor(GetCurrentStage());
             //auto prim = GetCurrentStage()->GetPrimAtPath(_selection.GetAnchorPrimPath(GetCurrentStage()));
@@ -1025,6 +1167,7 @@ void Editor::Draw() {
 
     if (_settings._textEditor) {
         TRACE_SCOPE(SdfLayerAsciiEditorWindowTitle);
+        RUNTIME_PROFILE_SCOPE(SdfLayerAsciiEditorWindowTitle);
         ImGui::Begin(SdfLayerAsciiEditorWindowTitle, &_settings._textEditor);
             DrawTextEditor(GetCurrentLayer());
         ImGui::End();
@@ -1032,6 +1175,7 @@ void Editor::Draw() {
 
     if (_settings._showSdfAttributeEditor) {
         TRACE_SCOPE(SdfAttributeWindowTitle);
+        RUNTIME_PROFILE_SCOPE(SdfAttributeWindowTitle);
         ImGui::Begin(SdfAttributeWindowTitle, &_settings._showSdfAttributeEditor);
         DrawSdfAttributeEditor(GetCurrentLayer(), GetSelection());
         ImGui::End();
@@ -1039,6 +1183,7 @@ void Editor::Draw() {
 
     if (_settings._showHydraBrowser) {
         TRACE_SCOPE(HydraBrowserWindowTitle);
+        RUNTIME_PROFILE_SCOPE(HydraBrowserWindowTitle);
         ImGui::Begin(HydraBrowserWindowTitle, &_settings._showHydraBrowser);
         DrawHydraBrowser();
         ImGui::End();
@@ -1098,8 +1243,21 @@ void Editor::RunLauncher(const std::string &launcherName) {
 
 void Editor::LoadSettings() {
     _settings = ResourcesLoader::GetEditorSettings();
+    SetUndoStackMaxSize(static_cast<size_t>(_settings._undoStackMaxSizeMB) * 1024 * 1024);
+    FramePacer &framePacer = FramePacer::GetInstance();
+    framePacer.SetMode(_settings._framePacingMode == FramePacer::LowLatency ? FramePacer::LowLatency
+                                                                           : FramePacer::HighThroughput);
+    framePacer.SetMaxFramesInFlight(_settings._maxFramesInFlight);
+    framePacer.SetForceFinish(_settings._forceGlFinish);
 }
 
 void Editor::SaveSettings() const {
     ResourcesLoader::GetEditorSettings() = _settings;
+    // The undo stack budget can be changed in the debug window
+    ResourcesLoader::GetEditorSettings()._undoStackMaxSizeMB = static_cast<int>(GetUndoStackMaxSize() / (1024 * 1024));
+    // So is the frame pacing
+    const FramePacer &framePacer = FramePacer::GetInstance();
+    ResourcesLoader::GetEditorSettings()._framePacingMode = framePacer.GetMode();
+    ResourcesLoader::GetEditorSettings()._maxFramesInFlight = framePacer.GetMaxFramesInFlight();
+    ResourcesLoader::GetEditorSettings()._forceGlFinish = framePacer.GetForceFinish();
 }
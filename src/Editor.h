@@ -2,6 +2,9 @@
 #include "EditorSettings.h"
 #include "Selection.h"
 #include "Viewport.h"
+#include "Playblast.h"
+#include "PrimSearchIndex.h"
+#include "StageOpenJob.h"
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/primSpec.h>
 #include <pxr/usd/usdUtils/stageCache.h>
@@ -26,9 +29,10 @@ public:
     Editor(const Editor &) = delete;
     Editor &operator=(const Editor &) = delete;
 
-    /// Calling Shutdown will stop the main loop
+    /// Calling Shutdown will stop the main loop, once the stages being opened are cancelled.
+    /// UsdStage::Open can't be interrupted, the editor keeps drawing until the open returns
     void Shutdown() { _isShutdown = true; }
-    bool IsShutdown() const { return _isShutdown; }
+    bool IsShutdown() const { return _isShutdown && _stageOpenJobs.empty(); }
     void RequestShutdown();
     void ConfirmShutdown(std::string why);
 
@@ -53,6 +57,7 @@ public:
     /// Returns the selected primspec
     /// There should be one selected primspec per layer ideally, so it's very likely this function will move
     Selection &GetSelection() { return _selection; }
+    PrimSearchIndex &GetPrimSearchIndex() { return _primSearchIndex; }
     void SetLayerPathSelection(const SdfPath &primPath);
     void AddLayerPathSelection(const SdfPath &primPath);
     void SetStagePathSelection(const SdfPath &primPath);
@@ -63,11 +68,17 @@ public:
     void FindOrOpenLayer(const std::string &path);
     void CreateStage(const std::string &path);
     void OpenStage(const std::string &path, bool openLoaded = true);
+    /// The stage is opened on a worker thread, it becomes the current stage when it is composed
+    void OpenStage(const StageOpenJob::Parameters &parameters);
     void SaveLayerAs(SdfLayerRefPtr layer, const std::string &path);
 
     /// Render the hydra viewport
     void HydraRender();
 
+    /// True when the last frame rendered no viewport and no playback nor job is running, the main loop can then
+    /// wait for the next event instead of drawing frames
+    bool IsIdle() const;
+
     ///
     /// Drawing functions for the main editor
     ///
@@ -94,6 +105,15 @@ public:
     void StopPlayback();
     void TogglePlayback();
 
+    /// The playback frames and the CPU picking hierarchy are read on worker threads while the widgets are drawn, they
+    /// must be waited for before the stage is modified
+    void WaitStageReads();
+    void ClearPlaybackCache();
+
+    /// Playblast running in the background, only one at a time
+    void StartPlayblast(UsdStageRefPtr stage, const PlayblastJob::Parameters &parameters);
+    bool IsPlayblasting() const { return _playblastJob != nullptr; }
+
     void ShowDialogSaveLayerAs(SdfLayerHandle layerToSaveAs);
 
     // Launcher functions
@@ -155,6 +175,9 @@ public:
     /// Selection for stages and layers
     Selection _selection;
 
+    /// Index of the current stage prims for the searches
+    PrimSearchIndex _primSearchIndex;
+
     /// Selected attribute, for showing in the spreadsheet or metadata
     SdfPath _selectedAttribute;
     
@@ -163,6 +186,18 @@ public:
 
     /// Playback controls
     bool _isPlaying = false;
+    double _playbackTime = 0.0;          // Continuous time of the playback
+    double _playbackDisplayedTime = 0.0; // Time of the viewports, on whole frames with the playback cache
+
+    /// A viewport was rendered during the last frame
+    bool _hasRenderedViewports = false;
     std::chrono::time_point<std::chrono::steady_clock> _lastFrameTime;
+
+    /// Playblast recording frames between the editor frames
+    std::unique_ptr<PlayblastJob> _playblastJob;
+
+    /// Stages being opened or loading their payloads
+    void UpdateStageOpenJobs();
+    std::vector<std::unique_ptr<StageOpenJob>> _stageOpenJobs;
     
 };
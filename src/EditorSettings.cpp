@@ -79,6 +79,24 @@ void EditorSettings::ParseLine(const char *line) {
     } else if (strlen(line) > 12 && std::equal(line, line + 12, "RecentFiles=")) {
         std::string recentFilesLine(line + 12);
         SplitSemiColon(recentFilesLine, _recentFiles);
+    } else if (sscanf(line, "UndoStackMaxSize=%i", &value) == 1) {
+        if (value > 0) {
+            _undoStackMaxSizeMB = value;
+        }
+    } else if (sscanf(line, "FramePacingMode=%i", &value) == 1) {
+        _framePacingMode = value;
+    } else if (sscanf(line, "MaxFramesInFlight=%i", &value) == 1) {
+        if (value > 0) {
+            _maxFramesInFlight = value;
+        }
+    } else if (sscanf(line, "ForceGlFinish=%i", &value) == 1) {
+        _forceGlFinish = static_cast<bool>(value);
+    } else if (sscanf(line, "PlaybackCache=%i", &value) == 1) {
+        _playbackCache = static_cast<bool>(value);
+    } else if (sscanf(line, "PlaybackCacheSize=%i", &value) == 1) {
+        if (value > 0) {
+            _playbackCacheSizeMB = value;
+        }
     } else if (sscanf(line, "MainWindowWidth=%i", &value) == 1) {
         if (value > 0) {
             _mainWindowWidth = value;
@@ -129,6 +147,12 @@ void EditorSettings::Dump(ImGuiTextBuffer *buf) {
     if (!_recentFiles.empty()) {
         buf->appendf("RecentFiles=%s\n", JoinSemiColon(_recentFiles).c_str());
     }
+    buf->appendf("UndoStackMaxSize=%d\n", _undoStackMaxSizeMB);
+    buf->appendf("FramePacingMode=%d\n", _framePacingMode);
+    buf->appendf("MaxFramesInFlight=%d\n", _maxFramesInFlight);
+    buf->appendf("ForceGlFinish=%d\n", _forceGlFinish);
+    buf->appendf("PlaybackCache=%d\n", _playbackCache);
+    buf->appendf("PlaybackCacheSize=%d\n", _playbackCacheSizeMB);
     if (_mainWindowWidth > 0) {
         buf->appendf("MainWindowWidth=%d\n", _mainWindowWidth);
     }
@@ -32,6 +32,12 @@ struct EditorSettings {
     bool _showHydraBrowser = false;
     bool _syncPhysics = false;
     bool _unSyncPhysics = false;
+    int _undoStackMaxSizeMB = 512;
+    int _framePacingMode = 1; // FramePacer::Mode
+    int _maxFramesInFlight = 2;
+    bool _forceGlFinish = false;
+    bool _playbackCache = false;
+    int _playbackCacheSizeMB = 1024;
     int _mainWindowWidth;
     int _mainWindowHeight;
 
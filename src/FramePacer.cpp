@@ -0,0 +1,66 @@
+#include "FramePacer.h"
+#include "runtime/profiler.h"
+#include <algorithm>
+#include <chrono>
+
+// The wait is split in one second timeouts, a lost context would otherwise block the application forever
+static constexpr GLuint64 FenceWaitTimeoutNs = 1000000000;
+
+FramePacer &FramePacer::GetInstance() {
+    static FramePacer instance;
+    return instance;
+}
+
+void FramePacer::SetMaxFramesInFlight(int maxFramesInFlight) {
+    _maxFramesInFlight = std::clamp(maxFramesInFlight, 1, MaxFramesInFlightLimit);
+}
+
+// Delete the oldest fence, after waiting for it if wait is true. It is kept if it is not signaled yet
+void FramePacer::PopFence(bool wait) {
+    GLsync fence = _fences.front();
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceWaitTimeoutNs);
+    }
+    if (status != GL_TIMEOUT_EXPIRED) { // Signaled or failed, the fence is not waited again
+        glDeleteSync(fence);
+        _fences.pop_front();
+    }
+}
+
+void FramePacer::BeginFrame() {
+    RUNTIME_PROFILE_SCOPE("Wait gpu frame");
+    const auto startTime = std::chrono::steady_clock::now();
+    // The frames already drawn are released without waiting, the oldest frames are waited only above the limit
+    while (!_fences.empty()) {
+        const size_t framesInFlight = _fences.size();
+        PopFence(framesInFlight >= static_cast<size_t>(GetFrameLatency()));
+        if (_fences.size() == framesInFlight) {
+            break; // The oldest frame is still drawn and the limit is not reached
+        }
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    _lastWaitTime = elapsed.count();
+}
+
+void FramePacer::EndFrame() {
+    if (_forceFinish) {
+        RUNTIME_PROFILE_SCOPE("glFinish");
+        // This forces to wait for the gpu commands to finish.
+        // Normally not required but it fixes a pcoip driver issue
+        glFinish();
+        Reset();
+        return;
+    }
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (fence) {
+        _fences.push_back(fence);
+    }
+}
+
+void FramePacer::Reset() {
+    for (GLsync fence : _fences) {
+        glDeleteSync(fence);
+    }
+    _fences.clear();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+
+#include <pxr/imaging/garch/glApi.h>
+
+/// Frame pacing of the main loop
+/// A fence is inserted in the command stream after each frame is submitted. Before starting a new frame the main loop
+/// waits on the oldest fences until fewer than the allowed number of frames are in flight, so the CPU prepares the
+/// next frame while the GPU draws the previous ones instead of waiting for the GPU to be idle at the end of each frame.
+///   - LowLatency: one frame in flight, the inputs are read once the previous frame is drawn
+///   - HighThroughput: the CPU can be up to GetMaxFramesInFlight frames ahead of the GPU
+/// The glFinish at the end of each frame is kept as an option, it works around a pcoip driver issue.
+class FramePacer {
+  public:
+    enum Mode { LowLatency = 0, HighThroughput = 1 };
+    static constexpr int MaxFramesInFlightLimit = 4;
+
+    static FramePacer &GetInstance();
+
+    /// Wait until fewer frames than the limit of the mode are in flight, to call before reading the inputs
+    void BeginFrame();
+
+    /// Insert the fence of the submitted frame, or wait for the gpu with glFinish if it is forced. Called after the swap
+    void EndFrame();
+
+    /// Delete the pending fences, the opengl context must be current
+    void Reset();
+
+    void SetMode(Mode mode) { _mode = mode; }
+    Mode GetMode() const { return _mode; }
+
+    /// Frames in flight of the HighThroughput mode
+    void SetMaxFramesInFlight(int maxFramesInFlight);
+    int GetMaxFramesInFlight() const { return _maxFramesInFlight; }
+    int GetFramesInFlight() const { return static_cast<int>(_fences.size()); }
+
+    void SetForceFinish(bool forceFinish) { _forceFinish = forceFinish; }
+    bool GetForceFinish() const { return _forceFinish; }
+
+    /// Time spent waiting for the gpu at the last frame, in milliseconds
+    double GetLastWaitTime() const { return _lastWaitTime; }
+
+  private:
+    FramePacer() = default;
+    FramePacer(const FramePacer &) = delete;
+    FramePacer &operator=(const FramePacer &) = delete;
+
+    int GetFrameLatency() const { return _mode == LowLatency ? 1 : _maxFramesInFlight; }
+    void PopFence(bool wait);
+
+    std::deque<GLsync> _fences; // Oldest first
+    Mode _mode = HighThroughput;
+    int _maxFramesInFlight = 2;
+    bool _forceFinish = false;
+    double _lastWaitTime = 0.0;
+};
@@ -0,0 +1,241 @@
+#include "LayerRegistry.h"
+#include <algorithm>
+#include <pxr/usd/sdf/schema.h>
+
+const std::string &LayerRecord::GetAssetName() const {
+    if (!_assetName) {
+        _assetName.reset(new std::string(layer ? layer->GetAssetName() : std::string()));
+    }
+    return *_assetName;
+}
+
+const std::string &LayerRecord::GetDisplayName() const {
+    if (!_displayName) {
+        _displayName.reset(new std::string(layer ? layer->GetDisplayName() : std::string()));
+    }
+    return *_displayName;
+}
+
+const std::string &LayerRecord::GetRealPath() const {
+    if (!_realPath) {
+        _realPath.reset(new std::string(layer ? layer->GetRealPath() : std::string()));
+    }
+    return *_realPath;
+}
+
+void LayerRecord::ClearNames() {
+    _assetName.reset();
+    _displayName.reset();
+    _realPath.reset();
+}
+
+LayerRegistry &LayerRegistry::GetInstance() {
+    static LayerRegistry instance;
+    return instance;
+}
+
+LayerRegistry::LayerRegistry() {
+    const TfWeakPtr<LayerRegistry> self = TfCreateWeakPtr(this);
+    _noticeKeys.push_back(TfNotice::Register(self, &LayerRegistry::OnObjectsChanged));
+    _noticeKeys.push_back(TfNotice::Register(self, &LayerRegistry::OnLayerDirtinessChanged));
+    _noticeKeys.push_back(TfNotice::Register(self, &LayerRegistry::OnLayerIdentifierDidChange));
+    _noticeKeys.push_back(TfNotice::Register(self, &LayerRegistry::OnLayerDidReplaceContent));
+}
+
+LayerRegistry::~LayerRegistry() { TfNotice::Revoke(&_noticeKeys); }
+
+// Only a change of the composition arcs can open layers. The resyncs creating or removing prims don't open any, the
+// layers they release expire and are removed when the list finds them
+void LayerRegistry::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice) {
+    static const TfToken::HashSet compositionFields = {
+        SdfFieldKeys->SubLayers,     SdfFieldKeys->References,       SdfFieldKeys->Payload,
+        SdfFieldKeys->InheritPaths,  SdfFieldKeys->Specializes,      SdfFieldKeys->VariantSelection,
+        SdfFieldKeys->VariantSetNames, SdfFieldKeys->Active};
+    if (_mustListLayers) {
+        return;
+    }
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        for (const TfToken &field : notice.GetChangedFields(path)) {
+            if (compositionFields.count(field)) {
+                _mustListLayers = true;
+                return;
+            }
+        }
+    }
+}
+
+// The notice doesn't say which layer changed, all the records are checked at the next update
+void LayerRegistry::OnLayerDirtinessChanged(const SdfNotice::LayerDirtinessChanged &notice) { _mustUpdateDirtiness = true; }
+
+void LayerRegistry::OnLayerIdentifierDidChange(const SdfNotice::LayerIdentifierDidChange &notice) {
+    std::lock_guard<std::mutex> lock(_identifierChangesMutex);
+    _identifierChanges.emplace_back(notice.GetOldIdentifier(), notice.GetNewIdentifier());
+}
+
+void LayerRegistry::OnLayerDidReplaceContent(const SdfNotice::LayerDidReplaceContent &notice) {
+    _mustListLayers = true;
+    _mustUpdateDirtiness = true;
+}
+
+void LayerRegistry::Update(const UsdStageCache &stageCache) {
+    UpdateIdentifiers();
+    UpdateStages(stageCache);
+    if (_mustListLayers.exchange(false)) {
+        ListLayers();
+    }
+    if (_mustUpdateDirtiness.exchange(false)) {
+        UpdateDirtiness();
+    }
+}
+
+// Only the layers not already in the registry are added, the expired ones are removed
+void LayerRegistry::ListLayers() {
+    for (auto it = _records.begin(); it != _records.end();) {
+        if (!it->second->layer) {
+            _recordsByIdentifier.erase(it->second->identifier);
+            LogChange(it->second, RecordRemoved);
+            it = _records.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const SdfLayerHandle &layer : SdfLayer::GetLoadedLayers()) {
+        AddLayer(layer);
+    }
+}
+
+void LayerRegistry::AddLayer(const SdfLayerHandle &layer) {
+    if (!layer || _records.count(layer->GetUniqueIdentifier())) {
+        return;
+    }
+    auto record = std::make_shared<LayerRecord>();
+    record->layer = layer;
+    record->identifier = layer->GetIdentifier();
+    record->isAnonymous = layer->IsAnonymous();
+    record->isDirty = layer->IsDirty();
+    record->isStage = _stageLayers.count(layer->GetUniqueIdentifier()) != 0;
+    _records[layer->GetUniqueIdentifier()] = record;
+    _recordsByIdentifier[record->identifier] = record;
+    LogChange(record, RecordAdded);
+}
+
+// There are only a few stages, their root layers are compared at every update
+void LayerRegistry::UpdateStages(const UsdStageCache &stageCache) {
+    std::unordered_set<const void *> stageLayers;
+    for (const UsdStageRefPtr &stage : stageCache.GetAllStages()) {
+        stageLayers.insert(stage->GetRootLayer()->GetUniqueIdentifier());
+    }
+    if (stageLayers == _stageLayers) {
+        return;
+    }
+    // The layers of the opened stages are not in the registry yet
+    _mustListLayers = false;
+    ListLayers();
+    for (const void *layerId : stageLayers) {
+        if (!_stageLayers.count(layerId)) {
+            const auto record = _records.find(layerId);
+            if (record != _records.end()) {
+                record->second->isStage = true;
+                LogChange(record->second, RecordModified);
+            }
+        }
+    }
+    for (const void *layerId : _stageLayers) {
+        if (!stageLayers.count(layerId)) {
+            const auto record = _records.find(layerId);
+            if (record != _records.end()) {
+                record->second->isStage = false;
+                LogChange(record->second, RecordModified);
+            }
+        }
+    }
+    _stageLayers.swap(stageLayers);
+}
+
+void LayerRegistry::UpdateDirtiness() {
+    for (auto &record : _records) {
+        const SdfLayerHandle &layer = record.second->layer;
+        if (layer && layer->IsDirty() != record.second->isDirty) {
+            record.second->isDirty = !record.second->isDirty;
+            LogChange(record.second, RecordModified);
+        }
+    }
+}
+
+void LayerRegistry::UpdateIdentifiers() {
+    std::vector<std::pair<std::string, std::string>> identifierChanges;
+    {
+        std::lock_guard<std::mutex> lock(_identifierChangesMutex);
+        identifierChanges.swap(_identifierChanges);
+    }
+    for (const auto &identifierChange : identifierChanges) {
+        const auto it = _recordsByIdentifier.find(identifierChange.first);
+        if (it == _recordsByIdentifier.end()) {
+            continue;
+        }
+        const LayerRecordPtr record = it->second;
+        _recordsByIdentifier.erase(it);
+        record->identifier = identifierChange.second;
+        record->isAnonymous = record->layer && record->layer->IsAnonymous();
+        record->ClearNames();
+        _recordsByIdentifier[record->identifier] = record;
+        LogChange(record, RecordModified);
+    }
+}
+
+void LayerRegistry::LogChange(const LayerRecordPtr &record, ChangeKind kind) {
+    _changes.push_back({++_version, record, kind});
+    // Forget the log when it grows much bigger than the registry, the lists will be rebuilt
+    if (_changes.size() > 4096 && _changes.size() > 2 * _records.size()) {
+        _changes.clear();
+        _changesStartVersion = _version;
+    }
+}
+
+std::vector<LayerRecordPtr> LayerRegistry::GetRecords() const {
+    std::vector<LayerRecordPtr> records;
+    records.reserve(_records.size());
+    for (const auto &record : _records) {
+        records.push_back(record.second);
+    }
+    return records;
+}
+
+bool LayerRegistry::GetChanges(LayerRegistryVersion &lastVersion, LayerRegistryChanges &changes) const {
+    if (lastVersion == _version) {
+        return false;
+    }
+    changes = LayerRegistryChanges();
+    if (lastVersion < _changesStartVersion) {
+        changes.reset = true;
+        changes.added = GetRecords();
+        lastVersion = _version;
+        return true;
+    }
+    // Net change of each record, a record added then removed is not reported
+    const auto firstChange = std::upper_bound(_changes.begin(), _changes.end(), lastVersion,
+                                              [](LayerRegistryVersion version, const Change &change) { return version < change.version; });
+    std::unordered_map<LayerRecord *, int> recordChanges; // Combination of 1 << ChangeKind
+    std::vector<LayerRecordPtr> records;
+    for (auto change = firstChange; change != _changes.end(); ++change) {
+        int &kinds = recordChanges[change->record.get()];
+        if (!kinds) {
+            records.push_back(change->record);
+        }
+        kinds |= 1 << change->kind;
+    }
+    for (const LayerRecordPtr &record : records) {
+        const int kinds = recordChanges[record.get()];
+        const bool added = kinds & (1 << RecordAdded);
+        const bool removed = kinds & (1 << RecordRemoved);
+        if (added && !removed) {
+            changes.added.push_back(record);
+        } else if (removed && !added) {
+            changes.removed.push_back(record);
+        } else if (!added && !removed) {
+            changes.modified.push_back(record);
+        }
+    }
+    lastVersion = _version;
+    return true;
+}
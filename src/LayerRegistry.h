@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/notice.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stageCache.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Loaded layer with the properties used to filter and sort the layers.
+/// The names are copied when first requested, GetDisplayName is slow and the layer can expire while the record is
+/// still sorted in a list.
+///
+struct LayerRecord {
+    SdfLayerHandle layer;
+    std::string identifier;
+    bool isAnonymous = false;
+    bool isDirty = false;
+    bool isStage = false; // Root layer of a stage of the stage cache
+
+    const std::string &GetAssetName() const;
+    const std::string &GetDisplayName() const;
+    const std::string &GetRealPath() const;
+
+  private:
+    friend class LayerRegistry;
+    void ClearNames();
+
+    mutable std::unique_ptr<std::string> _assetName;
+    mutable std::unique_ptr<std::string> _displayName;
+    mutable std::unique_ptr<std::string> _realPath;
+};
+
+using LayerRecordPtr = std::shared_ptr<LayerRecord>;
+using LayerRegistryVersion = std::size_t;
+
+/// Records added, removed and modified since a version
+struct LayerRegistryChanges {
+    bool reset = false; // The previous state must be discarded, all the records are in added
+    std::vector<LayerRecordPtr> added;
+    std::vector<LayerRecordPtr> removed;
+    std::vector<LayerRecordPtr> modified;
+};
+
+///
+/// Registry of the loaded layers.
+/// SdfLayer::GetLoadedLayers builds a set of all the layers and is too slow to call at every frame with tens of
+/// thousands of layers. The registry only lists the loaded layers again when the notices or the stage cache indicate
+/// layers might have been opened: a stage opened or closed, a composition arc changed in a stage, a layer reloaded,
+/// payloads loaded. The layers opened by the editor outside of a stage are added individually with AddLayer.
+/// The dirtiness, the identifiers and the stages are updated in place. Every modification increments a version and
+/// is logged, so the lists built on the registry only process the records changed since their last update.
+///
+class LayerRegistry : public TfWeakBase {
+  public:
+    static LayerRegistry &GetInstance();
+
+    LayerRegistry();
+    ~LayerRegistry();
+
+    LayerRegistry(const LayerRegistry &) = delete;
+    LayerRegistry &operator=(const LayerRegistry &) = delete;
+
+    /// Apply the pending notices and the changes of the stage cache, to call once per frame
+    void Update(const UsdStageCache &stageCache);
+
+    /// List the loaded layers again at the next update, when an expired layer is found or payloads are loaded
+    void Invalidate() { _mustListLayers = true; }
+
+    /// Add a layer opened or created outside of a stage, the registry can't know about it otherwise
+    void AddLayer(const SdfLayerHandle &layer);
+
+    LayerRegistryVersion GetVersion() const { return _version; }
+    std::vector<LayerRecordPtr> GetRecords() const;
+    size_t GetSize() const { return _records.size(); }
+
+    /// Fill changes with the modifications since lastVersion and update it, returns false if nothing changed
+    bool GetChanges(LayerRegistryVersion &lastVersion, LayerRegistryChanges &changes) const;
+
+  private:
+    enum ChangeKind { RecordAdded, RecordRemoved, RecordModified };
+    struct Change {
+        LayerRegistryVersion version;
+        LayerRecordPtr record;
+        ChangeKind kind;
+    };
+
+    void ListLayers();
+    void UpdateStages(const UsdStageCache &stageCache);
+    void UpdateDirtiness();
+    void UpdateIdentifiers();
+    void LogChange(const LayerRecordPtr &record, ChangeKind kind);
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice);
+    void OnLayerDirtinessChanged(const SdfNotice::LayerDirtinessChanged &notice);
+    void OnLayerIdentifierDidChange(const SdfNotice::LayerIdentifierDidChange &notice);
+    void OnLayerDidReplaceContent(const SdfNotice::LayerDidReplaceContent &notice);
+
+    std::unordered_map<const void *, LayerRecordPtr> _records; // By layer unique identifier
+    std::unordered_map<std::string, LayerRecordPtr> _recordsByIdentifier;
+    std::unordered_set<const void *> _stageLayers;
+
+    LayerRegistryVersion _version = 0;
+    std::vector<Change> _changes; // Ordered by version
+    LayerRegistryVersion _changesStartVersion = 0;
+
+    // Set by the notices, which can be sent by other threads
+    std::atomic<bool> _mustListLayers{true};
+    std::atomic<bool> _mustUpdateDirtiness{false};
+    std::mutex _identifierChangesMutex;
+    std::vector<std::pair<std::string, std::string>> _identifierChanges; // Old and new identifiers
+
+    TfNotice::Keys _noticeKeys;
+};
@@ -0,0 +1,295 @@
+#include "PrimSearchIndex.h"
+
+#include <algorithm>
+#include <iterator>
+#include <regex>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/work/dispatcher.h>
+#include <pxr/base/work/loops.h>
+#include <pxr/usd/usd/modelAPI.h>
+#include <pxr/usd/usd/primRange.h>
+
+#include "WildcardsCompare.h"
+
+namespace {
+
+// Same traversal as the stage outliner, instance proxies included
+const Usd_PrimFlagsPredicate &GetSearchPredicate() {
+    static const Usd_PrimFlagsPredicate predicate = UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate);
+    return predicate;
+}
+
+// The subtrees above this depth are indexed by separate tasks, the deeper ones are traversed by their parent task
+constexpr int ParallelIndexingDepth = 4;
+
+// Number of entries matched by a task
+constexpr size_t MatchChunkSize = 4096;
+
+} // namespace
+
+PrimSearchIndex::~PrimSearchIndex() { TfNotice::Revoke(_noticeKey); }
+
+const SdfPathVector &PrimSearchIndex::FindAll(const UsdStageRefPtr &stage, const PrimSearchQuery &query) {
+    Update(stage);
+    UpdateMatches(query);
+    return _matchPaths;
+}
+
+SdfPath PrimSearchIndex::FindNext(const UsdStageRefPtr &stage, const PrimSearchQuery &query, const SdfPath &path,
+                                  bool backward) {
+    Update(stage);
+    UpdateMatches(query);
+    if (_matchIndices.empty()) {
+        return SdfPath();
+    }
+    size_t entryIndex = 0;
+    if (path.IsEmpty() || !GetEntryIndex(path, entryIndex)) {
+        return backward ? _matchPaths.back() : _matchPaths.front();
+    }
+    if (backward) {
+        const auto found = std::lower_bound(_matchIndices.begin(), _matchIndices.end(), entryIndex);
+        return found == _matchIndices.begin() ? _matchPaths.back() : _matchPaths[found - _matchIndices.begin() - 1];
+    }
+    const auto found = std::upper_bound(_matchIndices.begin(), _matchIndices.end(), entryIndex);
+    return found == _matchIndices.end() ? _matchPaths.front() : _matchPaths[found - _matchIndices.begin()];
+}
+
+void PrimSearchIndex::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    std::lock_guard<std::mutex> lock(_pendingChangesMutex);
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        // Resynced properties don't change the indexed fields
+        if (path.IsPrimPath() || path.IsAbsoluteRootPath()) {
+            _pendingResyncedPaths.push_back(path);
+        }
+    }
+    // The kind is metadata, its changes are info only
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        if (path.IsPrimPath()) {
+            _pendingChangedInfoPaths.push_back(path);
+        }
+    }
+}
+
+void PrimSearchIndex::Update(const UsdStageRefPtr &stage) {
+    if (!_stage || get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_noticeKey);
+        _stage = stage;
+        if (stage) {
+            _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &PrimSearchIndex::OnObjectsChanged, _stage);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_pendingChangesMutex);
+            _pendingResyncedPaths.clear();
+            _pendingChangedInfoPaths.clear();
+        }
+        Rebuild();
+        return;
+    }
+
+    SdfPathVector resyncedPaths;
+    SdfPathVector changedInfoPaths;
+    {
+        std::lock_guard<std::mutex> lock(_pendingChangesMutex);
+        std::swap(resyncedPaths, _pendingResyncedPaths);
+        std::swap(changedInfoPaths, _pendingChangedInfoPaths);
+    }
+    if (resyncedPaths.empty() && changedInfoPaths.empty()) {
+        return;
+    }
+    _indexVersion++;
+
+    // Find the indexed subtrees containing the resynced paths. A new or removed prim resyncs its parent subtree.
+    SdfPathVector subtreeRoots;
+    for (const SdfPath &resyncedPath : resyncedPaths) {
+        SdfPath subtreeRoot = resyncedPath;
+        size_t entryIndex = 0;
+        while (!subtreeRoot.IsAbsoluteRootPath() &&
+               (!GetEntryIndex(subtreeRoot, entryIndex) || !_stage->GetPrimAtPath(subtreeRoot))) {
+            subtreeRoot = subtreeRoot.GetParentPath();
+        }
+        if (subtreeRoot.IsAbsoluteRootPath()) {
+            Rebuild();
+            return;
+        }
+        subtreeRoots.push_back(subtreeRoot);
+    }
+    SdfPath::RemoveDescendentPaths(&subtreeRoots);
+
+    // Replace the subtrees starting from the end of the entries so the indices of the others stay valid
+    struct Splice {
+        size_t first;
+        size_t last;
+        SdfPath root;
+    };
+    std::vector<Splice> splices;
+    for (const SdfPath &subtreeRoot : subtreeRoots) {
+        Splice splice{0, 0, subtreeRoot};
+        GetEntryIndex(subtreeRoot, splice.first);
+        splice.last = splice.first + 1;
+        while (splice.last < _entries.size() && _entries[splice.last].path.HasPrefix(subtreeRoot)) {
+            splice.last++;
+        }
+        splices.push_back(splice);
+    }
+    std::sort(splices.begin(), splices.end(), [](const Splice &a, const Splice &b) { return a.first > b.first; });
+    for (const Splice &splice : splices) {
+        std::vector<Entry> subtreeEntries;
+        const UsdPrim prim = _stage->GetPrimAtPath(splice.root);
+        subtreeEntries.push_back(MakeEntry(prim));
+        IndexSubtree(prim, 0, subtreeEntries);
+        _entries.erase(_entries.begin() + splice.first, _entries.begin() + splice.last);
+        _entries.insert(_entries.begin() + splice.first, std::make_move_iterator(subtreeEntries.begin()),
+                        std::make_move_iterator(subtreeEntries.end()));
+    }
+    if (!splices.empty()) {
+        _entryIndicesAreValid = false;
+    }
+
+    for (const SdfPath &changedPath : changedInfoPaths) {
+        size_t entryIndex = 0;
+        const UsdPrim prim = _stage->GetPrimAtPath(changedPath);
+        if (prim && GetEntryIndex(changedPath, entryIndex)) {
+            _entries[entryIndex] = MakeEntry(prim);
+        }
+    }
+}
+
+void PrimSearchIndex::Rebuild() {
+    _indexVersion++;
+    _entries.clear();
+    _entryIndices.clear();
+    _entryIndicesAreValid = false;
+    if (_stage) {
+        IndexSubtree(_stage->GetPseudoRoot(), 0, _entries);
+    }
+}
+
+bool PrimSearchIndex::GetEntryIndex(const SdfPath &path, size_t &index) {
+    if (!_entryIndicesAreValid) {
+        _entryIndices.clear();
+        _entryIndices.reserve(_entries.size());
+        for (size_t i = 0; i < _entries.size(); ++i) {
+            _entryIndices[_entries[i].path] = i;
+        }
+        _entryIndicesAreValid = true;
+    }
+    const auto found = _entryIndices.find(path);
+    if (found == _entryIndices.end()) {
+        return false;
+    }
+    index = found->second;
+    return true;
+}
+
+PrimSearchIndex::Entry PrimSearchIndex::MakeEntry(const UsdPrim &prim) {
+    Entry entry{prim.GetPath(), prim.GetTypeName(), TfToken()};
+    UsdModelAPI(prim).GetKind(&entry.kind);
+    return entry;
+}
+
+// Appends the descendants of prim to the entries in stage order
+void PrimSearchIndex::IndexSubtree(const UsdPrim &prim, int depth, std::vector<Entry> &entries) {
+    const auto children = prim.GetFilteredChildren(GetSearchPredicate());
+    const std::vector<UsdPrim> childPrims(children.begin(), children.end());
+    if (depth < ParallelIndexingDepth && childPrims.size() > 1) {
+        // Each child subtree is indexed by its own task, the waiting tasks steal the work of the others
+        std::vector<std::vector<Entry>> childEntries(childPrims.size());
+        WorkDispatcher dispatcher;
+        for (size_t i = 0; i < childPrims.size(); ++i) {
+            dispatcher.Run([&childPrims, &childEntries, depth, i]() {
+                childEntries[i].push_back(MakeEntry(childPrims[i]));
+                IndexSubtree(childPrims[i], depth + 1, childEntries[i]);
+            });
+        }
+        dispatcher.Wait();
+        for (auto &subtreeEntries : childEntries) {
+            entries.insert(entries.end(), std::make_move_iterator(subtreeEntries.begin()),
+                           std::make_move_iterator(subtreeEntries.end()));
+        }
+    } else {
+        for (const UsdPrim &child : childPrims) {
+            for (const UsdPrim &descendant : UsdPrimRange(child, GetSearchPredicate())) {
+                entries.push_back(MakeEntry(descendant));
+            }
+        }
+    }
+}
+
+void PrimSearchIndex::UpdateMatches(const PrimSearchQuery &query) {
+    if (_matchesVersion == _indexVersion && query == _lastQuery) {
+        return;
+    }
+    _lastQuery = query;
+    _matchesVersion = _indexVersion;
+    _matchIndices.clear();
+    _matchPaths.clear();
+    if (query.pattern.empty() || query.fields == 0) {
+        return;
+    }
+
+    std::regex regex;
+    if (query.matchMode == PrimSearchQuery::MatchRegex) {
+        try {
+            regex = std::regex(query.pattern, std::regex::optimize);
+        } catch (const std::regex_error &error) {
+            TF_WARN("Invalid search expression '%s': %s", query.pattern.c_str(), error.what());
+            return;
+        }
+    }
+    const auto matches = [&query, &regex](const std::string &str) {
+        switch (query.matchMode) {
+        case PrimSearchQuery::MatchExact:
+            return str == query.pattern;
+        case PrimSearchQuery::MatchWildcard:
+            return FastWildComparePortable(query.pattern.c_str(), str.c_str());
+        case PrimSearchQuery::MatchRegex:
+            return std::regex_search(str, regex);
+        }
+        return false;
+    };
+
+    // Types and kinds are shared by many prims, they are matched once per distinct token
+    const auto matchTokens = [&](TfToken Entry::*field) {
+        TfToken::HashSet tokens;
+        for (const Entry &entry : _entries) {
+            tokens.insert(entry.*field);
+        }
+        TfToken::HashSet matchingTokens;
+        for (const TfToken &token : tokens) {
+            if (!token.IsEmpty() && matches(token.GetString())) {
+                matchingTokens.insert(token);
+            }
+        }
+        return matchingTokens;
+    };
+    const TfToken::HashSet matchingTypes =
+        (query.fields & PrimSearchQuery::FieldType) ? matchTokens(&Entry::typeName) : TfToken::HashSet();
+    const TfToken::HashSet matchingKinds =
+        (query.fields & PrimSearchQuery::FieldKind) ? matchTokens(&Entry::kind) : TfToken::HashSet();
+
+    // The names and paths are matched in parallel, each chunk of entries keeps its matches in stage order
+    const size_t chunkCount = (_entries.size() + MatchChunkSize - 1) / MatchChunkSize;
+    std::vector<std::vector<size_t>> chunkMatches(chunkCount);
+    WorkParallelForN(chunkCount, [&](size_t beginChunk, size_t endChunk) {
+        for (size_t chunk = beginChunk; chunk < endChunk; ++chunk) {
+            const size_t endEntry = std::min(_entries.size(), (chunk + 1) * MatchChunkSize);
+            for (size_t i = chunk * MatchChunkSize; i < endEntry; ++i) {
+                const Entry &entry = _entries[i];
+                if (((query.fields & PrimSearchQuery::FieldName) && matches(entry.path.GetName())) ||
+                    ((query.fields & PrimSearchQuery::FieldType) && matchingTypes.count(entry.typeName)) ||
+                    ((query.fields & PrimSearchQuery::FieldKind) && matchingKinds.count(entry.kind)) ||
+                    ((query.fields & PrimSearchQuery::FieldPath) && matches(entry.path.GetString()))) {
+                    chunkMatches[chunk].push_back(i);
+                }
+            }
+        }
+    });
+    for (const auto &matchIndices : chunkMatches) {
+        _matchIndices.insert(_matchIndices.end(), matchIndices.begin(), matchIndices.end());
+    }
+    _matchPaths.reserve(_matchIndices.size());
+    for (const size_t i : _matchIndices) {
+        _matchPaths.push_back(_entries[i].path);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Search of the stage prims by name, type, kind or path
+///
+
+struct PrimSearchQuery {
+    enum MatchMode { MatchExact = 0, MatchWildcard, MatchRegex };
+    enum Field { FieldName = 1 << 0, FieldType = 1 << 1, FieldKind = 1 << 2, FieldPath = 1 << 3 };
+
+    std::string pattern;
+    MatchMode matchMode = MatchExact; // Same default as the previous search, which matched the whole name
+    int fields = FieldName; // Combination of Field
+
+    bool operator==(const PrimSearchQuery &other) const {
+        return pattern == other.pattern && matchMode == other.matchMode && fields == other.fields;
+    }
+    bool operator!=(const PrimSearchQuery &other) const { return !(*this == other); }
+};
+
+enum PrimSearchAction { SelectNextMatch, SelectPreviousMatch, SelectAllMatches };
+
+/// Index of the prims of a stage, including the instance proxies, in stage order.
+/// It is built in parallel, the subtrees are indexed by different tasks, and it is kept up to date with the
+/// UsdNotice::ObjectsChanged notices: the resynced subtrees are indexed again before the next search.
+/// The matches of the last query are cached, selecting the next or previous match is a binary search.
+class PrimSearchIndex : public TfWeakBase {
+  public:
+    PrimSearchIndex() = default;
+    ~PrimSearchIndex();
+
+    PrimSearchIndex(const PrimSearchIndex &) = delete;
+    PrimSearchIndex &operator=(const PrimSearchIndex &) = delete;
+
+    /// Returns all the prims matching the query in stage order
+    const SdfPathVector &FindAll(const UsdStageRefPtr &stage, const PrimSearchQuery &query);
+
+    /// Returns the first match after path, or before if backward is true, wrapping around at the end of the stage.
+    /// Returns an empty path when nothing matches.
+    SdfPath FindNext(const UsdStageRefPtr &stage, const PrimSearchQuery &query, const SdfPath &path, bool backward = false);
+
+    size_t GetIndexedPrimCount() const { return _entries.size(); }
+
+  private:
+    struct Entry {
+        SdfPath path;
+        TfToken typeName;
+        TfToken kind;
+    };
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+    void Update(const UsdStageRefPtr &stage);
+    void UpdateMatches(const PrimSearchQuery &query);
+    void Rebuild();
+    bool GetEntryIndex(const SdfPath &path, size_t &index);
+
+    static Entry MakeEntry(const UsdPrim &prim);
+    static void IndexSubtree(const UsdPrim &prim, int depth, std::vector<Entry> &entries);
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _noticeKey;
+
+    std::vector<Entry> _entries;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _entryIndices; // Built lazily, when searching the next match
+    bool _entryIndicesAreValid = false;
+    size_t _indexVersion = 0;
+
+    // Matches of the last query
+    PrimSearchQuery _lastQuery;
+    size_t _matchesVersion = 0;
+    std::vector<size_t> _matchIndices;
+    SdfPathVector _matchPaths;
+
+    // The notices might be sent by other threads, they are processed before the next search
+    std::mutex _pendingChangesMutex;
+    SdfPathVector _pendingResyncedPaths;
+    SdfPathVector _pendingChangedInfoPaths;
+};
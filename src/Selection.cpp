@@ -1,40 +1,169 @@
 #include "Selection.h"
+#include <algorithm>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 #include <pxr/usd/sdf/attributeSpec.h>
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/usd/stage.h>
 
 #include <iostream>
 
-/// At the moment we use a HdSelection for the stages but this will change as the we want to store additional states
-/// The selection implementation will move outside this header
-#include <pxr/imaging/hd/selection.h>
-
-/// Note the following bit of code might have terrible performances when selecting thousands of paths
-/// This has to be tested at some point
 namespace std {
-template <> struct hash<SdfPathVector> {
-    std::size_t operator()(SdfPathVector const &paths) const noexcept {
-        std::size_t hashValue = 0;
-        for (const auto p : paths) {
-            const auto pathHash = SdfPath::Hash{}(p);
-            hashValue = pathHash ^ (hashValue << 1);
-        }
-        return hashValue;
-    }
-};
-
 template <> struct hash<SdfSpecHandle> {
     std::size_t operator()(SdfSpecHandle const &spec) const noexcept { return hash_value(spec); }
 };
 
 } // namespace std
 
-struct StageSelection : public std::unique_ptr<HdSelection> {
-    // We store a state to know if the selection has changed between frames. Recomputing the hash is not ideal and potentially
-    // a performance killer, so it will likely change in the future
-    SelectionHash selectionHash = 0;
-    bool mustRecomputeHash = true;
+///
+/// Selected prims of a stage.
+/// The membership is a hash set lookup, the paths are kept in their selection order to find the anchor, and every
+/// modification increments a version and is logged, so the renderer and the widgets can only process the paths
+/// added and removed since the version they last saw.
+///
+struct StageSelection {
+
+    void Add(const SdfPath &path) {
+        if (_indices.count(path)) {
+            return;
+        }
+        _indices.emplace(path, _orderedPaths.size());
+        _orderedPaths.push_back(path);
+        LogChange(path, true);
+    }
+
+    void Remove(const SdfPath &path) {
+        auto found = _indices.find(path);
+        if (found == _indices.end()) {
+            return;
+        }
+        // The removed paths are left empty in the ordered list until there are too many of them
+        _orderedPaths[found->second] = SdfPath();
+        _indices.erase(found);
+        if (++_numRemoved > _orderedPaths.size() / 2) {
+            Compact();
+        }
+        LogChange(path, false);
+    }
+
+    void Clear() {
+        if (_indices.empty()) {
+            return;
+        }
+        // A small selection is logged as removed paths, so the consumers only process them. Above the threshold, the
+        // consumers older than this version have to start from the full selection
+        if (_indices.size() <= maxLoggedClearSize) {
+            for (const SdfPath &path : _orderedPaths) {
+                if (!path.IsEmpty()) {
+                    _indices.erase(path);
+                    LogChange(path, false);
+                }
+            }
+        } else {
+            _changes.clear();
+            _changesStartVersion = ++_version;
+        }
+        _indices.clear();
+        _orderedPaths.clear();
+        _numRemoved = 0;
+    }
+
+    // Replaces the selection by a single path, nothing changes if it is already the only selected path
+    void Set(const SdfPath &path) {
+        if (_indices.size() == 1 && Contains(path)) {
+            return;
+        }
+        Clear();
+        Add(path);
+    }
+
+    bool Contains(const SdfPath &path) const { return _indices.count(path) != 0; }
+    bool IsEmpty() const { return _indices.empty(); }
+    SelectionVersion GetVersion() const { return _version; }
+
+    SdfPath GetAnchor() const {
+        for (const SdfPath &path : _orderedPaths) {
+            if (!path.IsEmpty()) {
+                return path;
+            }
+        }
+        return {};
+    }
+
+    SdfPathVector GetPaths() const {
+        SdfPathVector paths;
+        paths.reserve(_indices.size());
+        for (const SdfPath &path : _orderedPaths) {
+            if (!path.IsEmpty()) {
+                paths.push_back(path);
+            }
+        }
+        return paths;
+    }
+
+    void GetChanges(SelectionVersion sinceVersion, SelectionChanges &changes) const {
+        changes = SelectionChanges();
+        if (sinceVersion < _changesStartVersion) {
+            changes.cleared = true;
+            changes.added = GetPaths();
+            return;
+        }
+        // Only the last change of each path counts, a path added then removed is not reported
+        const auto firstChange = std::upper_bound(_changes.begin(), _changes.end(), sinceVersion,
+                                                  [](SelectionVersion version, const Change &change) { return version < change.version; });
+        std::unordered_map<SdfPath, bool, SdfPath::Hash> lastChanges;
+        for (auto change = firstChange; change != _changes.end(); ++change) {
+            lastChanges[change->path] = change->added;
+        }
+        for (auto change = firstChange; change != _changes.end(); ++change) {
+            auto last = lastChanges.find(change->path);
+            if (last == lastChanges.end()) {
+                continue; // already reported
+            }
+            if (last->second && Contains(change->path)) {
+                changes.added.push_back(change->path);
+            } else if (!last->second && !Contains(change->path)) {
+                changes.removed.push_back(change->path);
+            }
+            lastChanges.erase(last);
+        }
+    }
+
+  private:
+    static constexpr size_t maxLoggedClearSize = 1024;
+
+    struct Change {
+        SelectionVersion version;
+        SdfPath path;
+        bool added;
+    };
+
+    void LogChange(const SdfPath &path, bool added) {
+        _changes.push_back({++_version, path, added});
+        // Forget the log when it grows much bigger than the selection, the consumers will get the full selection
+        if (_changes.size() > 4096 && _changes.size() > 2 * _indices.size()) {
+            _changes.clear();
+            _changesStartVersion = _version;
+        }
+    }
+
+    void Compact() {
+        SdfPathVector paths = GetPaths();
+        _orderedPaths.swap(paths);
+        for (size_t i = 0; i < _orderedPaths.size(); ++i) {
+            _indices[_orderedPaths[i]] = i;
+        }
+        _numRemoved = 0;
+    }
+
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _indices; // Position of the selected paths in _orderedPaths
+    SdfPathVector _orderedPaths;
+    size_t _numRemoved = 0;
+
+    SelectionVersion _version = 0;
+    std::vector<Change> _changes; // Ordered by version
+    SelectionVersion _changesStartVersion = 0;
 };
 
 struct Selection::SelectionData {
@@ -46,7 +175,6 @@ struct Selection::SelectionData {
     std::unordered_set<SdfSpecHandle> _sdfPropSelectionDomain;
 
     // Selection data for the stages
-    // TODO: keep an anchor, basically the first selected prim, we would need a list to keep the order
     StageSelection _stageSelection;
 };
 
@@ -63,8 +191,7 @@ template <> void Selection::Clear(const SdfLayerRefPtr &layer) {
 template <> void Selection::Clear(const UsdStageRefPtr &stage) {
     if (!_data || !stage)
         return;
-    _data->_stageSelection.reset(new HdSelection());
-    _data->_stageSelection.mustRecomputeHash = true;
+    _data->_stageSelection.Clear();
 }
 
 // Layer add a selection
@@ -82,21 +209,21 @@ template <> void Selection::AddSelected(const SdfLayerRefPtr &layer, const SdfPa
     template <> void Selection::AddSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        if (!_data->_stageSelection) {                                                                                           \
-            _data->_stageSelection.reset(new HdSelection());                                                                     \
-        }                                                                                                                        \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
+        _data->_stageSelection.Add(selectedPath);                                                                                \
     }
 
 ImplementStageAddSelected(UsdStageRefPtr);
 ImplementStageAddSelected(UsdStageWeakPtr);
 
-// Not called at the moment
-template <> void Selection::RemoveSelected(const UsdStageWeakPtr &stage, const SdfPath &path) {
-    if (!_data || !stage)
-        return;
-}
+#define ImplementStageRemoveSelected(StageT)                                                                                     \
+    template <> void Selection::RemoveSelected(const StageT &stage, const SdfPath &path) {                                        \
+        if (!_data || !stage)                                                                                                    \
+            return;                                                                                                              \
+        _data->_stageSelection.Remove(path);                                                                                     \
+    }
+
+ImplementStageRemoveSelected(UsdStageRefPtr);
+ImplementStageRemoveSelected(UsdStageWeakPtr);
 
 #define ImplementLayerSetSelected(LayerT)                                                                                        \
     template <> void Selection::SetSelected(const LayerT &layer, const SdfPath &selectedPath) {                                  \
@@ -119,9 +246,7 @@ ImplementLayerSetSelected(SdfLayerHandle);
     template <> void Selection::SetSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        _data->_stageSelection.reset(new HdSelection());                                                                         \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
+        _data->_stageSelection.Set(selectedPath);                                                                                \
     }
 
 ImplementStageSetSelected(UsdStageRefPtr);
@@ -141,7 +266,7 @@ ImplementLayerIsSelectionEmpty(SdfLayerRefPtr);
     template <> bool Selection::IsSelectionEmpty(const StageT &stage) const {                                                    \
         if (!_data || !stage)                                                                                                    \
             return true;                                                                                                         \
-        return !_data->_stageSelection || _data->_stageSelection->IsEmpty();                                                     \
+        return _data->_stageSelection.IsEmpty();                                                                                 \
     }
 
 ImplementStageIsSelectionEmpty(UsdStageRefPtr);
@@ -159,32 +284,42 @@ template <> bool Selection::IsSelected(const SdfAttributeSpecHandle &spec) const
     return _data->_sdfPropSelectionDomain.find(spec) != _data->_sdfPropSelectionDomain.end();
 }
 
-template <> bool Selection::IsSelected(const UsdStageWeakPtr &stage, const SdfPath &selectedPath) const {
-    if (!_data || !stage)
-        return false;
-    if (_data->_stageSelection) {
-        if (_data->_stageSelection->GetPrimSelectionState(HdSelection::HighlightModeSelect, selectedPath)) {
-            return true;
-        }
+#define ImplementStageIsSelected(StageT)                                                                                         \
+    template <> bool Selection::IsSelected(const StageT &stage, const SdfPath &selectedPath) const {                             \
+        if (!_data || !stage)                                                                                                    \
+            return false;                                                                                                        \
+        return _data->_stageSelection.Contains(selectedPath);                                                                    \
     }
-    return false;
-}
 
+ImplementStageIsSelected(UsdStageRefPtr);
+ImplementStageIsSelected(UsdStageWeakPtr);
+
+// The hash of the stage selection is its version
 template <> bool Selection::UpdateSelectionHash(const UsdStageRefPtr &stage, SelectionHash &lastSelectionHash) {
     if (!_data || !stage)
         return false;
 
-    if (_data->_stageSelection && _data->_stageSelection.mustRecomputeHash) {
-        auto paths = _data->_stageSelection->GetAllSelectedPrimPaths();
-        _data->_stageSelection.selectionHash = std::hash<SdfPathVector>{}(paths);
-    }
-
-    if (_data->_stageSelection.selectionHash != lastSelectionHash) {
-        lastSelectionHash = _data->_stageSelection.selectionHash;
+    if (_data->_stageSelection.GetVersion() != lastSelectionHash) {
+        lastSelectionHash = _data->_stageSelection.GetVersion();
         return true;
     }
     return false;
 }
+
+template <> SelectionVersion Selection::GetVersion(const UsdStageRefPtr &stage) const {
+    if (!_data || !stage)
+        return 0;
+    return _data->_stageSelection.GetVersion();
+}
+
+template <>
+bool Selection::GetChanges(const UsdStageRefPtr &stage, SelectionVersion &lastVersion, SelectionChanges &changes) const {
+    if (!_data || !stage || _data->_stageSelection.GetVersion() == lastVersion)
+        return false;
+    _data->_stageSelection.GetChanges(lastVersion, changes);
+    lastVersion = _data->_stageSelection.GetVersion();
+    return true;
+}
 // TODO: store anchor for prim and property
 #define ImplementGetAnchorPrimPath(LayerT)\
 template <> SdfPath Selection::GetAnchorPrimPath(const LayerT &layer) const {\
@@ -222,13 +357,7 @@ ImplementGetAnchorPropertyPath(SdfLayerRefPtr);
 template <> SdfPath Selection::GetAnchorPrimPath(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        const auto &paths = _data->_stageSelection->GetSelectedPrimPaths(HdSelection::HighlightModeSelect);
-        if (!paths.empty()) {
-            return paths[0];
-        }
-    }
-    return {};
+    return _data->_stageSelection.GetAnchor();
 }
 
 // This is called only once when there is a drag and drop at the moment
@@ -246,8 +375,5 @@ template <> std::vector<SdfPath> Selection::GetSelectedPaths(const SdfLayerHandl
 template <> std::vector<SdfPath> Selection::GetSelectedPaths(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        return _data->_stageSelection->GetAllSelectedPrimPaths();
-    }
-    return {};
+    return _data->_stageSelection.GetPaths();
 }
@@ -12,6 +12,14 @@ PXR_NAMESPACE_USING_DIRECTIVE
 ///
 
 using SelectionHash = std::size_t;
+using SelectionVersion = std::size_t;
+
+/// Paths added and removed from a selection since a version
+struct SelectionChanges {
+    bool cleared = false; // The previous state must be discarded, all the selected paths are in added
+    SdfPathVector added;
+    SdfPathVector removed;
+};
 
 struct Selection {
 
@@ -30,6 +38,11 @@ struct Selection {
     template <typename OwnerT> bool IsSelected(const OwnerT &, const SdfPath &path) const;
     template <typename ItemT> bool IsSelected(const ItemT &) const;
     template <typename OwnerT> bool UpdateSelectionHash(const OwnerT &, SelectionHash &lastSelectionHash);
+
+    // Version of the selection, incremented by each modification
+    template <typename OwnerT> SelectionVersion GetVersion(const OwnerT &) const;
+    // Fill changes with the modifications since lastVersion and update it, returns false if nothing changed
+    template <typename OwnerT> bool GetChanges(const OwnerT &, SelectionVersion &lastVersion, SelectionChanges &changes) const;
     template <typename OwnerT> SdfPath GetAnchorPrimPath(const OwnerT &) const;
     template <typename OwnerT> SdfPath GetAnchorPropertyPath(const OwnerT &) const;
     template <typename OwnerT> std::vector<SdfPath> GetSelectedPaths(const OwnerT &) const;
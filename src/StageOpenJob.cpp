@@ -0,0 +1,151 @@
+#include "StageOpenJob.h"
+#include "Gui.h"
+#include "LayerRegistry.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/layerUtils.h>
+#include <pxr/usd/sdf/payload.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/stagePopulationMask.h>
+
+// Time spent loading payloads per editor frame
+static constexpr std::chrono::milliseconds StageLoadBudget(20);
+
+StageOpenJob::StageOpenJob(const Parameters &parameters)
+    : _parameters(parameters), _startTime(std::chrono::steady_clock::now()) {
+    _thread = std::thread(&StageOpenJob::Run, this);
+}
+
+StageOpenJob::~StageOpenJob() {
+    Cancel();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+// Worker thread
+void StageOpenJob::Run() {
+    const bool loadInBackground = _parameters.payloadLoading == LoadPayloadsInBackground;
+    const UsdStage::InitialLoadSet loadSet =
+        _parameters.payloadLoading == LoadPayloadsAll ? UsdStage::LoadAll : UsdStage::LoadNone;
+    UsdStageRefPtr stage;
+    if (_parameters.populationMask.empty()) {
+        stage = UsdStage::Open(_parameters.path, loadSet);
+    } else {
+        const UsdStagePopulationMask mask(_parameters.populationMask.begin(), _parameters.populationMask.end());
+        stage = UsdStage::OpenMasked(_parameters.path, mask, loadSet);
+    }
+    if (!stage) {
+        TF_WARN("Unable to open stage %s", _parameters.path.c_str());
+        _isThreadDone = true;
+        return;
+    }
+    // Cancelled while opening, the stage is dropped
+    if (_isCancelled) {
+        _isThreadDone = true;
+        return;
+    }
+
+    // The stage is not shared yet, it can be read safely to find the payloads to load
+    if (loadInBackground) {
+        const SdfPathSet loadable = stage->FindLoadable();
+        _payloadPaths.assign(loadable.begin(), loadable.end());
+        _payloadLayers.resize(_payloadPaths.size());
+        for (size_t i = 0; i < _payloadPaths.size(); ++i) {
+            const UsdPrim prim = stage->GetPrimAtPath(_payloadPaths[i]);
+            for (const SdfPrimSpecHandle &spec : prim.GetPrimStack()) {
+                for (const SdfPayload &payload : spec->GetPayloadList().GetAppliedItems()) {
+                    if (!payload.GetAssetPath().empty()) {
+                        _payloadLayers[i].push_back(SdfComputeAssetPathRelativeToLayer(spec->GetLayer(), payload.GetAssetPath()));
+                    }
+                }
+            }
+        }
+    }
+    _stage = stage;
+    _isOpened = true;
+
+    // Read the payload layers ahead of the main thread composing them
+    for (size_t i = 0; i < _payloadLayers.size() && !_isCancelled; ++i) {
+        for (const std::string &layerPath : _payloadLayers[i]) {
+            if (SdfLayerRefPtr layer = SdfLayer::FindOrOpen(layerPath)) {
+                _prefetchedLayers.push_back(layer);
+            }
+        }
+        _prefetchedPayloads = i + 1;
+    }
+    _isThreadDone = true;
+}
+
+UsdStageRefPtr StageOpenJob::Update() {
+    if (_isCancelled || !_isOpened) {
+        return UsdStageRefPtr();
+    }
+    // The editor gets the stage before any payload is loaded
+    if (!_stageReturned) {
+        _stageReturned = true;
+        return _stage;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    while (_loadedPayloads < _payloadPaths.size() && std::chrono::steady_clock::now() - start < StageLoadBudget) {
+        // Wait for the layers to be read from disk
+        const size_t prefetchedPayloads = _prefetchedPayloads;
+        if (_loadedPayloads >= prefetchedPayloads) {
+            break;
+        }
+        const size_t batchEnd = std::min(prefetchedPayloads, _loadedPayloads + _batchSize);
+        const SdfPathSet batch(_payloadPaths.begin() + _loadedPayloads, _payloadPaths.begin() + batchEnd);
+        const auto batchStart = std::chrono::steady_clock::now();
+        _stage->LoadAndUnload(batch, SdfPathSet());
+        _loadedPayloads = batchEnd;
+        // Loading payloads opens layers without changing any composition field
+        LayerRegistry::GetInstance().Invalidate();
+
+        // Fewer change notifications with bigger batches, as long as they fit in the budget
+        const auto batchDuration = std::chrono::steady_clock::now() - batchStart;
+        if (batchDuration < StageLoadBudget / 4) {
+            _batchSize *= 2;
+        } else if (batchDuration > StageLoadBudget) {
+            _batchSize = std::max<size_t>(1, _batchSize / 2);
+        }
+    }
+    return UsdStageRefPtr();
+}
+
+bool StageOpenJob::IsFinished() const {
+    if (!_isThreadDone) {
+        return false;
+    }
+    return _isCancelled || !_isOpened || (_stageReturned && _loadedPayloads == _payloadPaths.size());
+}
+
+double StageOpenJob::GetElapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+void DrawStageOpenProgress(StageOpenJob &job) {
+    const std::string fileName = TfGetBaseName(job.GetParameters().path);
+    if (job.IsOpening()) {
+        ImGui::Text(ICON_FA_FOLDER_OPEN " %s %s %.1fs", job.IsCancelled() ? "Cancelling" : "Opening", fileName.c_str(),
+                    job.GetElapsedSeconds());
+    } else {
+        const size_t payloadCount = std::max<size_t>(job.GetPayloadCount(), 1);
+        const std::string overlay = job.IsCancelled() ? std::string("Cancelling")
+                                                      : std::to_string(job.GetLoadedPayloadCount()) + "/" +
+                                                            std::to_string(job.GetPayloadCount());
+        ImGui::Text(ICON_FA_FOLDER_OPEN " Loading %s", fileName.c_str());
+        ImGui::ProgressBar(static_cast<float>(job.GetLoadedPayloadCount()) / static_cast<float>(payloadCount),
+                           ImVec2(150, 0), overlay.c_str());
+    }
+    ImGui::PushID(&job);
+    ImGui::BeginDisabled(job.IsCancelled());
+    if (ImGui::SmallButton("Cancel")) {
+        job.Cancel();
+    }
+    ImGui::EndDisabled();
+    ImGui::PopID();
+}
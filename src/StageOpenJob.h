@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+/// Stage open job
+/// The stage is composed on a worker thread so the editor stays responsive while opening large stages.
+/// When the payloads are loaded in the background, the stage is opened without payloads and handed to the editor
+/// first, then the payloads are loaded in small batches between the editor frames:
+///  - the worker thread reads the payload layers from disk ahead of the loading, the job holds them until it is done,
+///  - the main thread composes the payloads already read, as the stage can't be modified while it is being drawn.
+///
+class StageOpenJob {
+  public:
+    enum PayloadLoading { LoadPayloadsAll = 0, LoadPayloadsNone, LoadPayloadsInBackground };
+
+    struct Parameters {
+        std::string path;
+        PayloadLoading payloadLoading = LoadPayloadsAll;
+        /// Only the prims under those paths are composed, all of them when empty
+        SdfPathVector populationMask;
+    };
+
+    StageOpenJob(const Parameters &parameters);
+
+    /// Cancels and joins the worker thread. UsdStage::Open can't be interrupted, the editor lets the cancelled jobs
+    /// finish before shutting down so this doesn't block while a stage is still opening
+    ~StageOpenJob();
+
+    // Delete copy
+    StageOpenJob(const StageOpenJob &) = delete;
+    StageOpenJob &operator=(const StageOpenJob &) = delete;
+
+    /// Returns the stage once, when it has just been opened, then loads the next payloads.
+    /// This must be called on the main thread.
+    UsdStageRefPtr Update();
+
+    /// Stops loading the payloads, or drops the stage when it is still being opened
+    void Cancel() { _isCancelled = true; }
+
+    bool IsCancelled() const { return _isCancelled; }
+    bool IsOpening() const { return !_isOpened && !_isThreadDone; }
+    bool IsLoadingPayloads() const { return _stageReturned && _loadedPayloads < _payloadPaths.size(); }
+
+    /// Returns true when the stage failed to open, when all the payloads are loaded or when the job was cancelled
+    /// and the worker thread is done
+    bool IsFinished() const;
+
+    const Parameters &GetParameters() const { return _parameters; }
+    const UsdStageRefPtr &GetStage() const { return _stage; }
+    size_t GetPayloadCount() const { return _payloadPaths.size(); }
+    size_t GetLoadedPayloadCount() const { return _loadedPayloads; }
+    double GetElapsedSeconds() const;
+
+  private:
+    void Run();
+
+    Parameters _parameters;
+    std::chrono::steady_clock::time_point _startTime;
+
+    // Written by the worker thread before _isOpened is set
+    UsdStageRefPtr _stage;
+    SdfPathVector _payloadPaths;
+    std::vector<std::vector<std::string>> _payloadLayers; // Layers read by each payload
+
+    std::atomic<bool> _isCancelled{false};
+    std::atomic<bool> _isOpened{false};
+    std::atomic<bool> _isThreadDone{false};
+    std::atomic<size_t> _prefetchedPayloads{0};
+    std::vector<SdfLayerRefPtr> _prefetchedLayers; // Kept alive in the registry until the job is done
+
+    // Main thread
+    bool _stageReturned = false;
+    size_t _loadedPayloads = 0;
+    size_t _batchSize = 1;
+
+    std::thread _thread;
+};
+
+/// Draw the progress of a stage being opened with a button to cancel it
+void DrawStageOpenProgress(StageOpenJob &job);
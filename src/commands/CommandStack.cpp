@@ -1,5 +1,8 @@
 #include "CommandStack.h"
+#include "Commands.h"
 #include "SdfCommandGroupRecorder.h"
+#include <pxr/base/arch/demangle.h>
+#include <typeinfo>
 
 CommandStack *CommandStack::instance = nullptr;
 
@@ -29,11 +32,31 @@ void CommandStack::ExecuteCommands() {
 }
 
 void CommandStack::_PushCommand(Command *cmd) {
-    if (undoStackPos != undoStack.size()) {
-        undoStack.resize(undoStackPos);
+    while (undoStack.size() > undoStackPos) {
+        undoStackSize -= commandSizes.back();
+        commandSizes.pop_back();
+        undoStack.pop_back();
     }
-    undoStack.emplace_back(std::move(cmd));
+    commandSizes.push_back(cmd->GetSize());
+    undoStackSize += commandSizes.back();
+    undoStack.emplace_back(cmd);
     undoStackPos++;
+    _EvictCommands();
+}
+
+void CommandStack::SetMaxSize(size_t size) {
+    maxSize = size;
+    _EvictCommands();
+}
+
+void CommandStack::_EvictCommands() {
+    // Only the commands before the current position are removed, the redo commands depend on them.
+    while (undoStackSize > maxSize && undoStackPos > 1) {
+        undoStackSize -= commandSizes.front();
+        commandSizes.pop_front();
+        undoStack.pop_front();
+        undoStackPos--;
+    }
 }
 
 struct UndoCommand : public Command {
@@ -99,6 +122,8 @@ bool ClearUndoRedoCommand::DoIt() {
     CommandStack &commandStack = CommandStack::GetInstance();
     commandStack.undoStackPos = 0;
     commandStack.undoStack.clear();
+    commandStack.commandSizes.clear();
+    commandStack.undoStackSize = 0;
     delete commandStack.lastCmd;
     commandStack.lastCmd = nullptr;
     return false; // Should never be stored in the stack
@@ -136,3 +161,21 @@ template void ExecuteAfterDraw<UsdFunctionCall>(UsdStageRefPtr stage, std::funct
 void ExecuteCommands() {
     CommandStack::GetInstance().ExecuteCommands();
 }
+
+bool HasPendingCommands() { return CommandStack::GetInstance().HasNextCommand(); }
+
+size_t GetUndoStackMaxSize() { return CommandStack::GetInstance().GetMaxSize(); }
+
+void SetUndoStackMaxSize(size_t size) { CommandStack::GetInstance().SetMaxSize(size); }
+
+std::vector<UndoStackEntry> GetUndoStackEntries() {
+    const CommandStack &commandStack = CommandStack::GetInstance();
+    const auto &undoStack = commandStack.GetUndoStack();
+    std::vector<UndoStackEntry> entries;
+    entries.reserve(undoStack.size());
+    for (int i = 0; i < undoStack.size(); ++i) {
+        const Command &command = *undoStack[i];
+        entries.push_back({ArchGetDemangled(typeid(command)), command.GetSize(), i >= commandStack.GetUndoStackPosition()});
+    }
+    return entries;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -24,17 +25,34 @@ struct CommandStack {
     
     // Execute next command and push it on the stack
     void ExecuteCommands();
-    
+
+    /// Memory budget of the undo stack, the oldest commands are removed when the estimated size
+    /// of the stack exceeds it. The last executed command is always kept.
+    size_t GetMaxSize() const { return maxSize; }
+    void SetMaxSize(size_t size);
+
+    /// Estimated size of all the commands in the stack
+    size_t GetSize() const { return undoStackSize; }
+
+    const std::deque<std::unique_ptr<Command>> &GetUndoStack() const { return undoStack; }
+    int GetUndoStackPosition() const { return undoStackPos; }
+
 private:
 
 
     // The undo stack should ultimately belong to an Editor, not be a global variable
-    using UndoStackT = std::vector<std::unique_ptr<Command>>;
+    using UndoStackT = std::deque<std::unique_ptr<Command>>;
     UndoStackT undoStack;
 
+    /// Size of each command when it was pushed and their running total, the stack is not rescanned on each push
+    std::deque<size_t> commandSizes;
+    size_t undoStackSize = 0;
+
     /// The pointer to the current command in the undo stack
     int undoStackPos = 0;
 
+    size_t maxSize = 512 * 1024 * 1024;
+
     // Storing only one command per frame for now, easier to reason about.
     Command *lastCmd = nullptr;
 
@@ -42,6 +60,9 @@ private:
     /// last command. The command passed here now belongs to this stack
     void _PushCommand(Command *cmd);
 
+    /// Remove the oldest commands until the stack fits in the memory budget
+    void _EvictCommands();
+
   private:
     CommandStack();
     ~CommandStack();
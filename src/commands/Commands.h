@@ -7,7 +7,9 @@
 #include <pxr/usd/usdGeom/xformCommonAPI.h>
 #include <pxr/usd/usdGeom/camera.h>
 #include <functional>
+#include <string>
 #include <tuple>
+#include <vector>
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
@@ -48,11 +50,13 @@ struct EditorSetEditTarget;
 struct EditorSetPreviousLayer;
 struct EditorSetNextLayer;
 struct EditorSetSelection;
+struct EditorSetSelectedPaths;
 struct EditorSelectAttributePath;
 struct EditorShutdown;
 struct EditorStartPlayback;
 struct EditorStopPlayback;
 struct EditorTogglePlayback;
+struct EditorStartPlayblast;
 struct EditorFindPrim;
 struct EditorExportUsdz;
 struct EditorExportFlattenedStage;
@@ -63,6 +67,7 @@ struct LayerRenameSubLayer;
 struct LayerMute;
 struct LayerUnmute;
 struct LayerTextEdit;
+struct LayerPrimTextEdit;
 struct LayerCreateOversFromPath;
 
 struct ViewportsSelectMouseHoverManipulator;
@@ -241,6 +246,9 @@ void ExecuteAfterDraw(FuncT &&func, const UsdGeomXformCommonAPI &api, ArgsT &&..
 /// Process the commands waiting in the queue. Only one command would be waiting at the moment
 void ExecuteCommands();
 
+/// Returns true when a command is waiting to be executed
+bool HasPendingCommands();
+
 ///
 /// Allows to record one command spanning multiple frames.
 /// It is used in the manipulators, to record only one command for a translation/rotation etc.
@@ -248,3 +256,17 @@ void ExecuteCommands();
 void BeginEdition(UsdStageRefPtr);
 void BeginEdition(SdfLayerRefPtr);
 void EndEdition();
+
+///
+/// Memory budget of the undo stack in bytes, the oldest commands are removed when it is exceeded.
+///
+size_t GetUndoStackMaxSize();
+void SetUndoStackMaxSize(size_t size);
+
+/// Description of a command in the undo stack, for display
+struct UndoStackEntry {
+    std::string name;
+    size_t size;  // Estimated memory used by the command
+    bool isUndone; // The command is after the current position and can be redone
+};
+std::vector<UndoStackEntry> GetUndoStackEntries();
@@ -10,12 +10,15 @@ struct Command {
     virtual ~Command(){};
     virtual bool DoIt() = 0;
     virtual bool UndoIt() { return false; }
+    /// Estimation of the memory kept by the command in the undo stack
+    virtual size_t GetSize() const { return 0; }
 };
 
 struct SdfLayerCommand : public Command {
     virtual ~SdfLayerCommand(){};
     virtual bool DoIt() override = 0;
     bool UndoIt() override;
+    size_t GetSize() const override { return _undoCommands.GetSize(); }
     SdfCommandGroup _undoCommands;
 };
 
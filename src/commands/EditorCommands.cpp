@@ -11,7 +11,6 @@
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdUtils/dependencies.h>
 #include <string>
-#include "WildcardsCompare.h"
 
 #include "SdfUndoRedoRecorder.h"
 ///
@@ -73,6 +72,31 @@ template void ExecuteAfterDraw<EditorSetSelection>(UsdStageRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerHandle, SdfPath);
 
+/// Select a list of prims in one command, replacing the current selection or adding to it
+struct EditorSetSelectedPaths : public EditorCommand {
+    EditorSetSelectedPaths(UsdStageRefPtr stage, SdfPathVector paths, bool addToSelection)
+        : _stage(stage), _paths(std::move(paths)), _addToSelection(addToSelection) {}
+
+    ~EditorSetSelectedPaths() override {}
+
+    bool DoIt() override {
+        if (_editor && _stage) {
+            auto &selection = _editor->GetSelection();
+            if (!_addToSelection) {
+                selection.Clear(_stage);
+            }
+            for (const SdfPath &path : _paths) {
+                selection.AddSelected(_stage, path);
+            }
+        }
+        return false;
+    }
+    UsdStageRefPtr _stage;
+    SdfPathVector _paths;
+    bool _addToSelection;
+};
+template void ExecuteAfterDraw<EditorSetSelectedPaths>(UsdStageRefPtr, SdfPathVector, bool);
+
 // TODO use setlayerlocation instead ???
 struct EditorSelectAttributePath : public EditorCommand {
 
@@ -273,6 +297,21 @@ struct EditorStopPlayback : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorStopPlayback>();
 
+struct EditorStartPlayblast : public EditorCommand {
+    EditorStartPlayblast(UsdStageRefPtr stage, PlayblastJob::Parameters parameters)
+        : _stage(stage), _parameters(std::move(parameters)) {}
+    ~EditorStartPlayblast() override {}
+    bool DoIt() override {
+        if (_editor) {
+            _editor->StartPlayblast(_stage, _parameters);
+        }
+        return false;
+    }
+    UsdStageRefPtr _stage;
+    PlayblastJob::Parameters _parameters;
+};
+template void ExecuteAfterDraw<EditorStartPlayblast>(UsdStageRefPtr, PlayblastJob::Parameters);
+
 struct EditorTogglePlayback : public EditorCommand {
     EditorTogglePlayback() {}
     ~EditorTogglePlayback() override {}
@@ -327,54 +366,41 @@ struct EditorRemoveLauncher : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorRemoveLauncher>(const std::string);
 
-// This will try to find the next matching prim after the selection
+// Select the next or previous prim matching the query after the selection anchor, or all the matching prims
 struct EditorFindPrim : public EditorCommand {
-    EditorFindPrim(const std::string pattern, bool useRegex) : _pattern(pattern) {
-        if (useRegex) {
-            _matches = [&](const std::string &str) { return FastWildComparePortable(_pattern.c_str(), str.c_str()); };
-        } else {
-            _matches = [&](const std::string &str) { return str == _pattern; };
-        }
-    }
+    EditorFindPrim(const PrimSearchQuery query, PrimSearchAction action) : _query(query), _action(action) {}
     ~EditorFindPrim() override{};
 
     bool DoIt() override {
         if (_editor) {
             const auto &stage = _editor->GetCurrentStage();
+            if (!stage) {
+                return false;
+            }
             auto &selection = _editor->GetSelection();
-            auto anchor = selection.GetAnchorPrimPath(stage);
-            SdfPath found;
-            bool selectedFound = false;
-            // Traverse the stage and set the new selection
-            auto range = UsdPrimRange::Stage(stage, UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate));
-            for (auto iter = range.begin(); iter != range.end(); ++iter) {
-                if (iter->GetPath() == anchor) {
-                    selectedFound = true;
-                } else if (_matches(iter->GetName())) {
-                    // Store the first matching path in case we don't find the one
-                    // after the anchor
-                    if (found == SdfPath()) {
-                        found = iter->GetPath();
-                        // We don't have an anchor, so the first match is the correct one
-                        if (anchor == SdfPath())
-                            break;
-                    }
-                    if (selectedFound) {
-                        found = iter->GetPath();
-                        break;
+            auto &searchIndex = _editor->GetPrimSearchIndex();
+            if (_action == SelectAllMatches) {
+                const SdfPathVector &found = searchIndex.FindAll(stage, _query);
+                if (!found.empty()) {
+                    selection.Clear(stage);
+                    for (const SdfPath &path : found) {
+                        selection.AddSelected(stage, path);
                     }
                 }
-            }
-            if (found != SdfPath()) {
-                selection.SetSelected(stage, found);
+            } else {
+                const SdfPath found =
+                    searchIndex.FindNext(stage, _query, selection.GetAnchorPrimPath(stage), _action == SelectPreviousMatch);
+                if (!found.IsEmpty()) {
+                    selection.SetSelected(stage, found);
+                }
             }
         }
         return false;
     }
-    std::function<bool(const std::string &)> _matches;
-    std::string _pattern;
+    PrimSearchQuery _query;
+    PrimSearchAction _action;
 };
-template void ExecuteAfterDraw<EditorFindPrim>(const std::string, bool useRegex);
+template void ExecuteAfterDraw<EditorFindPrim>(const PrimSearchQuery, PrimSearchAction);
 
 struct EditorExportUsdz : public EditorCommand {
     EditorExportUsdz(const std::string destination, bool useArKit) : _destination(destination), _useArKit(useArKit) {}
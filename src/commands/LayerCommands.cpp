@@ -5,6 +5,8 @@
 #include "CommandsImpl.h"
 #include "SdfUndoRedoRecorder.h"
 #include <pxr/usd/sdf/variantSpec.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/copyUtils.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
@@ -183,6 +185,49 @@ struct LayerTextEdit : public SdfLayerCommand {
 };
 template void ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr layer, std::string newText);
 
+/// Replace a prim of the layer by the prim written in the text, it can be renamed.
+/// Only the prim is re-imported, the undo stores the changes of this prim instead of the whole layer text.
+struct LayerPrimTextEdit : public SdfLayerCommand {
+
+    LayerPrimTextEdit(SdfLayerRefPtr layer, SdfPath primPath, std::string primText)
+        : _layer(layer), _primPath(primPath), _primText(primText) {}
+
+    ~LayerPrimTextEdit() override {}
+
+    bool DoIt() override {
+        if (!_layer || !_layer->GetPrimAtPath(_primPath))
+            return false;
+        auto textLayer = SdfLayer::CreateAnonymous(".usda");
+        if (!textLayer || !textLayer->ImportFromString("#usda 1.0\n" + _primText)) {
+            TF_WARN("Unable to parse the text of %s", _primPath.GetText());
+            return false;
+        }
+        const auto rootPrims = textLayer->GetRootPrims();
+        if (rootPrims.size() != 1) {
+            TF_WARN("The text of %s must define one prim", _primPath.GetText());
+            return false;
+        }
+        const SdfPath destinationPath = _primPath.GetParentPath().AppendChild(rootPrims.front()->GetNameToken());
+        if (destinationPath != _primPath && _layer->GetPrimAtPath(destinationPath)) {
+            TF_WARN("Unable to rename %s, %s already exists", _primPath.GetText(), destinationPath.GetText());
+            return false;
+        }
+        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
+        SdfChangeBlock block;
+        // Renamed in place, the prim keeps its position among its siblings
+        if (destinationPath != _primPath && !_layer->GetPrimAtPath(_primPath)->SetName(destinationPath.GetName())) {
+            TF_WARN("Unable to rename %s", _primPath.GetText());
+            return false;
+        }
+        return SdfCopySpec(textLayer, rootPrims.front()->GetPath(), _layer, destinationPath);
+    };
+
+    SdfLayerRefPtr _layer;
+    SdfPath _primPath;
+    std::string _primText;
+};
+template void ExecuteAfterDraw<LayerPrimTextEdit>(SdfLayerRefPtr layer, SdfPath primPath, std::string primText);
+
 struct LayerCreateOversFromPath : public SdfLayerCommand {
 
     LayerCreateOversFromPath(SdfLayerRefPtr layer, std::string path) : _layer(layer), _path(std::move(path)) {}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include "SdfCommandGroup.h"
@@ -7,16 +8,95 @@
 
 bool SdfCommandGroup::IsEmpty() const { return _instructions.empty(); }
 
-void SdfCommandGroup::Clear() { _instructions.clear(); }
+void SdfCommandGroup::Clear() {
+    _instructions.clear();
+    _size = 0;
+    _lastValueEdits.clear();
+}
+
+namespace {
+
+// Returns the path of an instruction editing a value, or an empty path for the instructions
+// changing the layer structure
+const SdfPath &GetEditedValuePath(InstructionWrapper &instruction) {
+    if (auto *setField = instruction.Get<UndoRedoSetField>()) {
+        return setField->_path;
+    } else if (auto *setTimeSample = instruction.Get<UndoRedoSetTimeSample>()) {
+        return setTimeSample->_path;
+    } else if (auto *setDictValue = instruction.Get<UndoRedoSetFieldDictValueByKey>()) {
+        return setDictValue->_path;
+    }
+    return SdfPath::EmptyPath();
+}
+
+using LastValueEdits = std::unordered_map<SdfPath, size_t, SdfPath::Hash>;
+
+// Merge the value edit with the last edit of the same path. The instructions in between are edits of values
+// on other paths, the structural instructions clear the last edits as the order of the instructions matters.
+template <typename InstructionT>
+bool CoalesceValueEdit(std::vector<InstructionWrapper> &instructions, const LastValueEdits &lastValueEdits,
+                       InstructionT &inst, size_t &size) {
+    const auto lastEdit = lastValueEdits.find(inst._path);
+    if (lastEdit == lastValueEdits.end()) {
+        return false;
+    }
+    InstructionWrapper &previous = instructions[lastEdit->second];
+    if (InstructionT *previousInst = previous.Get<InstructionT>()) {
+        const size_t previousSize = previous.GetSize();
+        if (previousInst->Coalesce(inst)) {
+            size = size - previousSize + previous.GetSize();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only the value edits are coalesced
+template <typename InstructionT>
+bool Coalesce(std::vector<InstructionWrapper> &, const LastValueEdits &, InstructionT &, size_t &) {
+    return false;
+}
+
+bool Coalesce(std::vector<InstructionWrapper> &instructions, const LastValueEdits &lastValueEdits,
+              UndoRedoSetField &inst, size_t &size) {
+    return CoalesceValueEdit(instructions, lastValueEdits, inst, size);
+}
+
+bool Coalesce(std::vector<InstructionWrapper> &instructions, const LastValueEdits &lastValueEdits,
+              UndoRedoSetTimeSample &inst, size_t &size) {
+    return CoalesceValueEdit(instructions, lastValueEdits, inst, size);
+}
+
+bool Coalesce(std::vector<InstructionWrapper> &instructions, const LastValueEdits &lastValueEdits,
+              UndoRedoSetFieldDictValueByKey &inst, size_t &size) {
+    return CoalesceValueEdit(instructions, lastValueEdits, inst, size);
+}
+
+// Only the field and time sample edits can store their arrays as deltas
+template <typename InstructionT> void CompactValues(InstructionT &) {}
+
+void CompactValues(UndoRedoSetField &inst) { inst.CompactValues(); }
+
+void CompactValues(UndoRedoSetTimeSample &inst) { inst.CompactValues(); }
+
+} // namespace
 
 template <typename InstructionT>
 void SdfCommandGroup::StoreInstruction(InstructionT inst) {
-    // TODO: specialize by InstructionT type to compact the instructions in the command,
-    // typically we don't want to store thousand of setField instruction where only the last one matters
-    // One optim would be to look for the previous instruction, check if it is a setfield on the same path, same layer ?
-    // Update the latest instruction instead of inserting a new instruction
-    // As StoreInstruction is templatized, it is possible to specialize it.
+    // Typically we don't want to store thousand of setField instructions when dragging a manipulator
+    // where only the first previous value and the last new value matter
+    if (Coalesce(_instructions, _lastValueEdits, inst, _size)) {
+        return;
+    }
+    CompactValues(inst);
     _instructions.emplace_back(std::move(inst));
+    _size += _instructions.back().GetSize();
+    const SdfPath &editedPath = GetEditedValuePath(_instructions.back());
+    if (editedPath.IsEmpty()) {
+        _lastValueEdits.clear();
+    } else {
+        _lastValueEdits[editedPath] = _instructions.size() - 1;
+    }
 }
 
 
@@ -3,6 +3,8 @@
 #include <functional>
 #include <memory>
 #include <iostream>
+#include <unordered_map>
+#include <pxr/usd/sdf/path.h>
 
 
 class InstructionWrapper {
@@ -26,11 +28,24 @@ public:
         _ref->ShowIt();
     }
 
+    /// Estimation of the memory used by the instruction
+    size_t GetSize() const {
+        return _ref->GetSize();
+    }
+
+    /// Returns the instruction if it is of type InstructionT, nullptr otherwise
+    template <typename InstructionT>
+    InstructionT *Get() {
+        auto *storage = dynamic_cast<Storage<InstructionT> *>(_ref.get());
+        return storage ? &storage->_data : nullptr;
+    }
+
     struct Interface {
         virtual ~Interface() = default;
         virtual void DoIt() = 0;
         virtual void UndoIt() = 0;
         virtual void ShowIt() = 0;
+        virtual size_t GetSize() const = 0;
     };
 
     template <typename InstructionT>
@@ -47,6 +62,10 @@ public:
 
         void ShowIt() override { }
 
+        size_t GetSize() const override {
+            return sizeof(*this) + _data.GetSize();
+        }
+
         InstructionT _data;
     };
 
@@ -67,11 +86,22 @@ public:
     void DoIt();
     void UndoIt();
 
+    /// Store a new instruction. The edits of the same value are coalesced in one instruction keeping the first
+    /// previous value and the last new value, typically when dragging a manipulator, as long as no instruction
+    /// changing the layer structure was stored in between.
     template <typename InstructionT>
     void StoreInstruction(InstructionT);
 
+    /// Estimation of the memory used by the instructions
+    size_t GetSize() const { return _size; }
+
 private:
     std::vector<InstructionWrapper> _instructions;
+    size_t _size = 0;
+
+    // Index of the last value edit of each path since the last structural instruction. A drag on thousands of
+    // prims interleaves the edits of all the prims, they are found without looking back in the instructions
+    std::unordered_map<PXR_NS::SdfPath, size_t, PXR_NS::SdfPath::Hash> _lastValueEdits;
 };
 
 
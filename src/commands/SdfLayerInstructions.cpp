@@ -1,8 +1,152 @@
 #include <iostream>
 #include <pxr/usd/sdf/path.h>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <pxr/base/gf/matrix2d.h>
+#include <pxr/base/gf/matrix3d.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/quatd.h>
+#include <pxr/base/gf/quatf.h>
+#include <pxr/base/gf/quath.h>
+#include <pxr/base/gf/vec2d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec3h.h>
+#include <pxr/base/gf/vec3i.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/gf/vec4i.h>
+#include <pxr/base/vt/array.h>
 #include <pxr/usd/sdf/abstractData.h>
+#include <pxr/usd/sdf/assetPath.h>
+#include <pxr/usd/sdf/schema.h>
+#include <pxr/usd/sdf/valueTypeName.h>
 #include "SdfLayerInstructions.h"
 
+size_t EstimateValueSize(const VtValue &value) {
+    if (value.IsArrayValued()) {
+        const SdfValueTypeName typeName = SdfSchema::GetInstance().FindType(value);
+        const size_t elementSize = typeName ? typeName.GetScalarType().GetType().GetSizeof() : sizeof(double);
+        return value.GetArraySize() * elementSize;
+    } else if (value.IsHolding<std::string>()) {
+        return value.UncheckedGet<std::string>().capacity();
+    } else if (value.IsHolding<VtDictionary>()) {
+        size_t size = 0;
+        for (const auto &entry : value.UncheckedGet<VtDictionary>()) {
+            size += sizeof(entry) + entry.first.capacity() + EstimateValueSize(entry.second);
+        }
+        return size;
+    } else if (value.IsHolding<SdfTimeSampleMap>()) {
+        size_t size = 0;
+        for (const auto &sample : value.UncheckedGet<SdfTimeSampleMap>()) {
+            size += sizeof(sample) + EstimateValueSize(sample.second);
+        }
+        return size;
+    }
+    return 0;
+}
+
+namespace {
+
+// Smaller arrays are stored as is, the delta wouldn't save much
+constexpr size_t ArrayDeltaMinSize = 64;
+// A delta is stored if at most 1/ArrayDeltaMaxChangeRatio of the elements changed
+constexpr size_t ArrayDeltaMaxChangeRatio = 8;
+
+// Bitwise comparison for the plain types, so -0.0 and 0.0 or two nans are different and the replay is identical
+template <typename T> inline typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type
+_IsSameElement(const T &a, const T &b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template <typename T> inline typename std::enable_if<!std::is_trivially_copyable<T>::value, bool>::type
+_IsSameElement(const T &a, const T &b) {
+    return a == b;
+}
+
+template <typename T> struct _TypedArrayDelta : public UndoRedoArrayDelta::Interface {
+    static std::shared_ptr<const UndoRedoArrayDelta::Interface> Compute(const VtArray<T> &previous, const VtArray<T> &next) {
+        if (previous.size() != next.size() || previous.size() < ArrayDeltaMinSize) {
+            return nullptr;
+        }
+        auto delta = std::make_shared<_TypedArrayDelta<T>>();
+        delta->_arraySize = previous.size();
+        // Shared buffers are identical, there is nothing to compare
+        if (previous.cdata() != next.cdata()) {
+            const size_t maxChanges = previous.size() / ArrayDeltaMaxChangeRatio;
+            for (size_t i = 0; i < previous.size(); ++i) {
+                if (!_IsSameElement(previous[i], next[i])) {
+                    if (delta->_indices.size() == maxChanges) {
+                        return nullptr;
+                    }
+                    delta->_indices.push_back(i);
+                    delta->_previousElements.push_back(previous[i]);
+                    delta->_newElements.push_back(next[i]);
+                }
+            }
+        }
+        return delta;
+    }
+
+    VtValue Apply(const VtValue &value, bool forward) const override {
+        if (!value.IsHolding<VtArray<T>>() || value.UncheckedGet<VtArray<T>>().size() != _arraySize) {
+            TF_CODING_ERROR("The array in the layer doesn't match the undo instruction");
+            return value;
+        }
+        VtArray<T> array = value.UncheckedGet<VtArray<T>>();
+        const std::vector<T> &elements = forward ? _newElements : _previousElements;
+        for (size_t i = 0; i < _indices.size(); ++i) {
+            array[_indices[i]] = elements[i];
+        }
+        return VtValue::Take(array);
+    }
+
+    size_t GetSize() const override {
+        return sizeof(*this) + _indices.capacity() * sizeof(size_t) +
+               (_previousElements.capacity() + _newElements.capacity()) * sizeof(T);
+    }
+
+    size_t _arraySize = 0;
+    std::vector<size_t> _indices;
+    std::vector<T> _previousElements;
+    std::vector<T> _newElements;
+};
+
+template <typename T>
+bool _ComputeTypedArrayDelta(const VtValue &previousValue, const VtValue &newValue,
+                             std::shared_ptr<const UndoRedoArrayDelta::Interface> &delta) {
+    if (!previousValue.IsHolding<VtArray<T>>() || !newValue.IsHolding<VtArray<T>>()) {
+        return false;
+    }
+    delta = _TypedArrayDelta<T>::Compute(previousValue.UncheckedGet<VtArray<T>>(), newValue.UncheckedGet<VtArray<T>>());
+    return true;
+}
+
+template <typename... T>
+std::shared_ptr<const UndoRedoArrayDelta::Interface> _ComputeArrayDelta(const VtValue &previousValue, const VtValue &newValue) {
+    std::shared_ptr<const UndoRedoArrayDelta::Interface> delta;
+    // Only the held type computes the delta
+    (void)std::initializer_list<bool>{_ComputeTypedArrayDelta<T>(previousValue, newValue, delta)...};
+    return delta;
+}
+
+} // namespace
+
+UndoRedoArrayDelta UndoRedoArrayDelta::Compute(const VtValue &previousValue, const VtValue &newValue) {
+    UndoRedoArrayDelta arrayDelta;
+    if (previousValue.IsArrayValued() && newValue.IsArrayValued() && previousValue.GetType() == newValue.GetType()) {
+        arrayDelta._delta = _ComputeArrayDelta<GfVec3f, GfVec3d, GfVec3h, GfVec2f, GfVec2d, GfVec4f, GfVec4d, GfVec2i,
+                                               GfVec3i, GfVec4i, GfQuatf, GfQuatd, GfQuath, GfMatrix2d, GfMatrix3d,
+                                               GfMatrix4d, GfHalf, float, double, int, unsigned int, int64_t, uint64_t,
+                                               unsigned char, bool, TfToken, std::string, SdfAssetPath>(previousValue,
+                                                                                                        newValue);
+    }
+    return arrayDelta;
+}
+
 static void _CopySpec(const SdfAbstractData &src, SdfAbstractData *dst, const SdfPath &path) {
     if (!dst) {
         std::cerr << "ERROR: when copying the destination prim is null at path " << path.GetString() << std::endl;
@@ -22,6 +166,20 @@ bool UndoRedoDeleteSpec::_SpecCopier::VisitSpec(const SdfAbstractData &src, cons
 
 void UndoRedoDeleteSpec::_SpecCopier::Done(const SdfAbstractData &) {}
 
+namespace {
+// Sum the estimated size of the values of the copied specs
+struct _SpecSizeEstimator : public SdfAbstractDataSpecVisitor {
+    bool VisitSpec(const SdfAbstractData &data, const SdfPath &path) override {
+        for (const TfToken &field : data.List(path)) {
+            size += sizeof(VtValue) + EstimateValueSize(data.Get(path, field));
+        }
+        return true;
+    }
+    void Done(const SdfAbstractData &) override {}
+    size_t size = 0;
+};
+} // namespace
+
 UndoRedoDeleteSpec::UndoRedoDeleteSpec(SdfLayerHandle layer, const SdfPath &path, bool inert, SdfAbstractDataPtr layerData)
     : _layer(layer), _path(path), _inert(inert), _deletedSpecType(_layer->GetSpecType(path)), _layerData(layerData) {
     // TODO: is there a faster way of copying and restoring the data ?
@@ -31,6 +189,10 @@ UndoRedoDeleteSpec::UndoRedoDeleteSpec(SdfLayerHandle layer, const SdfPath &path
     SdfLayer::TraversalFunction copyFunc = std::bind(&_CopySpec, std::cref(*get_pointer(_layerData)),
                                                      get_pointer(_deletedData), std::placeholders::_1);
     _layer->Traverse(path, copyFunc);
+
+    _SpecSizeEstimator sizeEstimator;
+    _deletedData->VisitSpecs(&sizeEstimator);
+    _deletedDataSize = sizeEstimator.size;
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <memory>
 #include <pxr/usd/sdf/abstractData.h>
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/path.h>
@@ -7,6 +8,36 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+/// Estimation of the memory allocated by a value outside of the VtValue itself, typically the array elements
+size_t EstimateValueSize(const VtValue &value);
+
+/// Sparse difference between two arrays of the same type and size, only the changed elements are stored
+/// with their previous and new values. The undo instructions keep it instead of the two full arrays when only
+/// a few elements of a large array were edited, the arrays are then rebuilt from the value in the layer.
+/// The elements are compared bitwise so the rebuilt arrays are identical to the original ones.
+class UndoRedoArrayDelta {
+public:
+    /// Returns an invalid delta if the values are not arrays of the same type and size or if too many elements changed
+    static UndoRedoArrayDelta Compute(const VtValue &previousValue, const VtValue &newValue);
+
+    explicit operator bool() const { return _delta != nullptr; }
+
+    /// Rebuild the new array from the previous one, and the previous array from the new one
+    VtValue Redo(const VtValue &previousValue) const { return _delta->Apply(previousValue, true); }
+    VtValue Undo(const VtValue &newValue) const { return _delta->Apply(newValue, false); }
+
+    size_t GetSize() const { return _delta ? _delta->GetSize() : 0; }
+
+    struct Interface {
+        virtual ~Interface() = default;
+        virtual VtValue Apply(const VtValue &value, bool forward) const = 0;
+        virtual size_t GetSize() const = 0;
+    };
+
+private:
+    std::shared_ptr<const Interface> _delta;
+};
+
 struct UndoRedoSetField {
     UndoRedoSetField(SdfLayerHandle layer, const SdfPath& path, const TfToken& fieldName, VtValue newValue, VtValue previousValue )
         : _layer(layer), _path(path), _fieldName(fieldName), _newValue(std::move(newValue)), _previousValue(std::move(previousValue)) {}
@@ -16,21 +47,49 @@ struct UndoRedoSetField {
 
     void DoIt() {
         if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->SetField(_path, _fieldName, _newValue);
+            _layer->GetStateDelegate()->SetField(_path, _fieldName,
+                                                 _delta ? _delta.Redo(_layer->GetField(_path, _fieldName)) : _newValue);
         }
     }
 
     void UndoIt() {
         if (_layer && _layer->GetStateDelegate()){
-            _layer->GetStateDelegate()->SetField(_path, _fieldName, _previousValue);
+            _layer->GetStateDelegate()->SetField(_path, _fieldName,
+                                                 _delta ? _delta.Undo(_layer->GetField(_path, _fieldName)) : _previousValue);
         }
     }
 
+    /// Keep the new value of the next edit of the same field
+    bool Coalesce(UndoRedoSetField &next) {
+        if (next._layer != _layer || next._path != _path || next._fieldName != _fieldName) {
+            return false;
+        }
+        // The next edit is not compacted yet, its previous value is our new value
+        if (_delta) {
+            _previousValue = _delta.Undo(next._previousValue);
+            _delta = UndoRedoArrayDelta();
+        }
+        _newValue = std::move(next._newValue);
+        CompactValues();
+        return true;
+    }
+
+    /// Replace the values by their difference when only a few elements of an array changed
+    void CompactValues() {
+        if ((_delta = UndoRedoArrayDelta::Compute(_previousValue, _newValue))) {
+            _newValue = VtValue();
+            _previousValue = VtValue();
+        }
+    }
+
+    size_t GetSize() const { return EstimateValueSize(_newValue) + EstimateValueSize(_previousValue) + _delta.GetSize(); }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const TfToken _fieldName;
     VtValue _newValue;
     VtValue _previousValue;
+    UndoRedoArrayDelta _delta;
 };
 
 
@@ -53,6 +112,16 @@ struct UndoRedoSetFieldDictValueByKey {
         }
     }
 
+    bool Coalesce(UndoRedoSetFieldDictValueByKey &next) {
+        if (next._layer != _layer || next._path != _path || next._fieldName != _fieldName || next._keyPath != _keyPath) {
+            return false;
+        }
+        _newValue = std::move(next._newValue);
+        return true;
+    }
+
+    size_t GetSize() const { return EstimateValueSize(_newValue) + EstimateValueSize(_previousValue); }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const TfToken _fieldName;
@@ -77,14 +146,14 @@ struct UndoRedoSetTimeSample {
 
     void DoIt() {
         if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _newValue);
+            _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _delta ? _delta.Redo(_GetSample()) : _newValue);
         }
     }
 
     void UndoIt() {
         if (_layer && _layer->GetStateDelegate()) {
             if (_hasTimeSamples && _isKeyFrame) {
-                _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _previousValue);
+                _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _delta ? _delta.Undo(_GetSample()) : _previousValue);
             } else if (_hasTimeSamples && !_isKeyFrame) {
                 _layer->EraseTimeSample(_path, _timeCode);
             } else if (!_hasTimeSamples) {
@@ -95,6 +164,38 @@ struct UndoRedoSetTimeSample {
         }
     }
 
+    /// Keep the new value of the next edit of the same sample, the state before the first edit is kept for the undo
+    bool Coalesce(UndoRedoSetTimeSample &next) {
+        if (next._layer != _layer || next._path != _path || next._timeCode != _timeCode) {
+            return false;
+        }
+        // The next edit is not compacted yet, the sample before it is our new value
+        if (_delta) {
+            _previousValue = _delta.Undo(next._previousValue);
+            _delta = UndoRedoArrayDelta();
+        }
+        _newValue = std::move(next._newValue);
+        CompactValues();
+        return true;
+    }
+
+    /// Replace the values by their difference when only a few elements of an array changed.
+    /// It is only possible when a previous sample existed.
+    void CompactValues() {
+        if (_hasTimeSamples && _isKeyFrame && (_delta = UndoRedoArrayDelta::Compute(_previousValue, _newValue))) {
+            _newValue = VtValue();
+            _previousValue = VtValue();
+        }
+    }
+
+    size_t GetSize() const { return EstimateValueSize(_newValue) + EstimateValueSize(_previousValue) + _delta.GetSize(); }
+
+    VtValue _GetSample() const {
+        VtValue sample;
+        _layer->QueryTimeSample(_path, _timeCode, &sample);
+        return sample;
+    }
+
     // TODO: look for reducing the size of this struct
     SdfLayerRefPtr _layer;
     const SdfPath _path;
@@ -103,6 +204,7 @@ struct UndoRedoSetTimeSample {
     VtValue _previousValue;
     bool _isKeyFrame;
     bool _hasTimeSamples;
+    UndoRedoArrayDelta _delta;
 };
 
 
@@ -122,6 +224,8 @@ struct UndoRedoCreateSpec {
         }
     }
 
+    size_t GetSize() const { return 0; }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const SdfSpecType _specType;
@@ -146,6 +250,8 @@ struct UndoRedoDeleteSpec {
     void DoIt();
     void UndoIt();
 
+    size_t GetSize() const { return _deletedDataSize; }
+
     SdfLayerRefPtr _layer;
     const SdfPath _path;
     const bool _inert;
@@ -153,6 +259,7 @@ struct UndoRedoDeleteSpec {
     SdfAbstractDataPtr _layerData; // TODO: this might change ? isn't it ? normally it's retrieved from the delegate
     const SdfSpecType _deletedSpecType;
     SdfDataRefPtr _deletedData;
+    size_t _deletedDataSize = 0;
 };
 
 
@@ -174,6 +281,8 @@ struct UndoRedoMoveSpec {
         }
     };
 
+    size_t GetSize() const { return 0; }
+
     SdfLayerRefPtr _layer;
     const SdfPath _oldPath;
     const SdfPath _newPath;
@@ -197,6 +306,8 @@ struct UndoRedoPushChild {
         }
     }
 
+    size_t GetSize() const { return 0; }
+
     SdfLayerRefPtr _layer;
     const SdfPath _parentPath;
     const TfToken _fieldName;
@@ -221,6 +332,8 @@ struct UndoRedoPopChild {
         }
     }
 
+    size_t GetSize() const { return 0; }
+
     SdfLayerRefPtr _layer;
     const SdfPath _parentPath;
     const TfToken _fieldName;
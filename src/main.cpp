@@ -17,7 +17,10 @@
 #include "Constants.h"
 #include "ResourcesLoader.h"
 #include "CommandLineOptions.h"
+#include "FramePacer.h"
 #include "Gui.h"
+#include "runtime/simulationBaker.h"
+#include "runtime/profiler.h"
 
 #ifdef _WIN64
 #include<process.h>
@@ -28,6 +31,11 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+// Frames drawn after the last event before the main loop waits for the next one, ImGui needs a few frames to settle
+static constexpr int IdleFramesBeforeWaiting = 3;
+// The main loop wakes up regularly while waiting, for the background jobs to show their progress
+static constexpr double IdleWaitTimeout = 0.25;
+
 // https://learn.microsoft.com/en-us/windows/win32/procthread/changing-environment-variables
 #ifdef _WIN64
 static std::vector<char *> ArchCurrentEnviron() {
@@ -55,6 +63,32 @@ static bool InstallApplicationPluginPaths(const std::vector<std::string> &plugin
     return false;
 }
 
+// Headless physics bake, no window, OpenGL context nor render index is created
+static int RunSimulationBake(const CommandLineOptions &options) {
+    UsdStageRefPtr stage = UsdStage::Open(options.simulateStage(), UsdStage::LoadAll);
+    if (!stage) {
+        std::cerr << "Unable to open " << options.simulateStage() << std::endl;
+        return 1;
+    }
+    runtime::SimulationBaker::Parameters params;
+    params.startFrame = options.hasFrameRange() ? options.startFrame() : stage->GetStartTimeCode();
+    params.endFrame = options.hasFrameRange() ? options.endFrame() : stage->GetEndTimeCode();
+    params.timeStep = options.timeStep();
+    params.chunkSize = options.chunkSize();
+
+    runtime::SimulationBaker baker(params);
+    const bool succeeded = baker.Bake(stage, options.bakeLayer());
+    const auto &stats = baker.GetStatistics();
+    std::cout << "Baked " << stats.bodies << " bodies, " << stats.frames << " frames, " << stats.steps << " steps to "
+              << options.bakeLayer() << std::endl;
+    std::cout << "Simulation: " << stats.simulationSeconds << "s";
+    if (stats.simulationSeconds > 0.0) {
+        std::cout << " (" << stats.steps / stats.simulationSeconds << " steps/s)";
+    }
+    std::cout << ", write: " << stats.writeSeconds << "s" << std::endl;
+    return succeeded ? 0 : 1;
+}
+
 static void glfw_error_callback(int error, const char* description) {
     std::cerr << "Error: " << description << std::endl;
 }
@@ -62,6 +96,23 @@ static void glfw_error_callback(int error, const char* description) {
 int main(int argc, char *const *argv) {
 
     CommandLineOptions options(argc, argv);
+    if (!options.isValid()) {
+        return 1;
+    }
+
+    // The bake runs before the ResourcesLoader is created: it doesn't need imgui and must not rewrite the gui
+    // settings when it exits. The plugin paths are the ones of the environment.
+    if (options.simulate()) {
+#ifdef WANTS_PYTHON
+        Py_SetProgramName(argv[0]);
+        Py_Initialize();
+#endif
+        const int exitCode = RunSimulationBake(options);
+#ifdef WANTS_PYTHON
+        Py_Finalize();
+#endif
+        return exitCode;
+    }
 
     // ResourceLoader will load the settings/fonts/textures and create an imgui context
     ResourcesLoader loader;
@@ -174,20 +225,55 @@ int main(int argc, char *const *argv) {
 
         // Process command line options
         for (auto &stage : options.stages()) {
-            editor.OpenStage(stage);
+            StageOpenJob::Parameters parameters;
+            parameters.path = stage;
+            parameters.payloadLoading = options.payloadLoading();
+            parameters.populationMask = options.populationMask();
+            editor.OpenStage(parameters);
+        }
+
+        // The command line option is kept in the settings, it can be disabled in the debug window
+        FramePacer &framePacer = FramePacer::GetInstance();
+        if (options.forceGlFinish()) {
+            framePacer.SetForceFinish(true);
         }
 
         // Loop until the user closes the window
+        int idleFrames = 0;
         while (!editor.IsShutdown()) {
+            runtime::Profiler::GetInstance().BeginFrame();
 
-            // Poll and process events
+            // Don't get too far ahead of the gpu, the inputs would be displayed late.
+            // The waits have their own scopes, they are not counted in the frame time
             glfwMakeContextCurrent(window);
-            glfwPollEvents();
+            {
+                RUNTIME_PROFILE_SCOPE("Wait gpu");
+                framePacer.BeginFrame();
+            }
+
+            // Poll and process events. When nothing changed for a few frames the loop blocks until the next
+            // event, the viewports keep their last image and the editor doesn't use the cpu nor the gpu.
+            if (idleFrames < IdleFramesBeforeWaiting) {
+                RUNTIME_PROFILE_SCOPE("Poll events");
+                glfwPollEvents();
+            } else {
+                RUNTIME_PROFILE_SCOPE("Wait events");
+                const double waitStart = glfwGetTime();
+                glfwWaitEventsTimeout(IdleWaitTimeout);
+                // Woken up before the timeout by an event, the next frames are drawn
+                if (glfwGetTime() - waitStart < IdleWaitTimeout) {
+                    idleFrames = 0;
+                }
+            }
+            RUNTIME_PROFILE_SCOPE("Frame");
 
             // Render the viewports first as textures
             ImGui_ImplGlfw_RestoreCallbacks(window);
             ImGui::SetCurrentContext(hydraUIContext);
-            editor.HydraRender(); // RenderViewports
+            {
+                RUNTIME_PROFILE_SCOPE("HydraRender");
+                editor.HydraRender(); // RenderViewports
+            }
 
             // Render GUI next
             ImGui::SetCurrentContext(mainUIContext);
@@ -198,24 +284,41 @@ int main(int argc, char *const *argv) {
             ImGui_ImplOpenGL3_NewFrame();
             ImGui_ImplGlfw_NewFrame();
             ImGui::NewFrame();
-            editor.Draw();
-            ImGui::Render();
-            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
+            {
+                RUNTIME_PROFILE_SCOPE("Draw");
+                editor.Draw();
+                ImGui::Render();
+            }
+            {
+                RUNTIME_PROFILE_SCOPE("RenderDrawData");
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            }
+
+            {
+                RUNTIME_PROFILE_SCOPE("SwapBuffers");
 #ifndef DISABLE_DOUBLE_BUFFER
-            // Swap front and back buffers
-            glfwSwapBuffers(window);
+                // Swap front and back buffers
+                glfwSwapBuffers(window);
 #else
-            glFlush();
+                glFlush();
 #endif
-            // This forces to wait for the gpu commands to finish.
-            // Normally not required but it fixes a pcoip driver issue
-            glFinish();
+            }
+            framePacer.EndFrame();
 
             // Process edition commands
-            ExecuteCommands();
+            {
+                RUNTIME_PROFILE_SCOPE("ExecuteCommands");
+                // The stage is not read in the background while it is modified, the reads only block the loop
+                // when a command is about to run
+                if (HasPendingCommands()) {
+                    editor.WaitStageReads();
+                    ExecuteCommands();
+                }
+            }
+            idleFrames = editor.IsIdle() ? idleFrames + 1 : 0;
         }
         editor.RemoveCallbacks(window);
+        framePacer.Reset();
     }
     ImGui::DestroyContext(hydraUIContext);
 
@@ -10,6 +10,7 @@
 #include "IBMPlexSansMediumFree.h"
 
 #define GUI_CONFIG_FILE "usdtweak_gui.ini"
+#define BLUEPRINTS_INDEX_FILE "usdtweak_blueprints.idx"
 
 #ifdef _WIN64
 #include <codecvt>
@@ -19,17 +20,17 @@
 #include <sstream>
 #include <winerror.h>
 
-std::string GetConfigFilePath() {
+std::string GetConfigFilePath(const char *fileName = GUI_CONFIG_FILE) {
     PWSTR localAppDataDir = nullptr;
     if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_DEFAULT, nullptr, &localAppDataDir))) {
         std::wstringstream configFilePath;
-        configFilePath << localAppDataDir << L"\\" GUI_CONFIG_FILE;
+        configFilePath << localAppDataDir << L"\\" << fileName;
         CoTaskMemFree(localAppDataDir);
         std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>
             converter; // TODO: this is deprecated in C++17, find another solution
         return converter.to_bytes(configFilePath.str());
     }
-    return GUI_CONFIG_FILE;
+    return fileName;
 }
 #elif defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
 
@@ -38,7 +39,7 @@ std::string GetConfigFilePath() {
 #include <stdlib.h>
 #include <sys/types.h>
 #include <unistd.h>
-std::string GetConfigFilePath() {
+std::string GetConfigFilePath(const char *fileName = GUI_CONFIG_FILE) {
     std::string configPath;
     const char *home = getenv("HOME");
     if (!home) {
@@ -56,13 +57,13 @@ std::string GetConfigFilePath() {
         configPath += "/."; // hide the ini in the home dir
 #endif
     }
-    configPath += GUI_CONFIG_FILE;
+    configPath += fileName;
     return configPath;
 }
 
 #else // Not unix and not windows64
 
-std::string GetConfigFilePath() { return GUI_CONFIG_FILE; }
+std::string GetConfigFilePath(const char *fileName = GUI_CONFIG_FILE) { return fileName; }
 
 #endif
 
@@ -230,6 +231,8 @@ ResourcesLoader::ResourcesLoader() {
 int ResourcesLoader :: GetApplicationWidth() { return ResourcesLoader::GetEditorSettings()._mainWindowWidth; }
 int ResourcesLoader :: GetApplicationHeight() { return ResourcesLoader::GetEditorSettings()._mainWindowHeight; }
 
+std::string ResourcesLoader::GetBlueprintsIndexFilePath() { return GetConfigFilePath(BLUEPRINTS_INDEX_FILE); }
+
 ResourcesLoader::~ResourcesLoader() {
     // Save the configuration file when the application closes the resources
     const std::string configFilePath = GetConfigFilePath();
@@ -13,6 +13,9 @@
     static int GetApplicationWidth();
     static int GetApplicationHeight();
 
+    // Index of the blueprint directories, stored next to the ini settings
+    static std::string GetBlueprintsIndexFilePath();
+
  private:
      static EditorSettings _editorSettings;
      static bool _resourcesLoaded;
@@ -5,6 +5,9 @@
 //  property of any third parties.
 
 #include "engine.h"
+#include "playbackCacheSceneIndex.h"
+#include "simulationSnapshotSceneIndex.h"
+#include "profiler.h"
 
 #include "pxr/usdImaging/usdImaging/delegate.h"
 #include "pxr/usdImaging/usdImaging/selectionSceneIndex.h"
@@ -25,6 +28,7 @@
 #include "pxr/imaging/hd/sceneIndexPluginRegistry.h"
 #include "pxr/imaging/hd/systemMessages.h"
 #include "pxr/imaging/hd/utils.h"
+#include "pxr/imaging/hd/xformSchema.h"
 #include "pxr/imaging/hdsi/primTypePruningSceneIndex.h"
 #include "pxr/imaging/hdsi/legacyDisplayStyleOverrideSceneIndex.h"
 #include "pxr/imaging/hdsi/sceneGlobalsSceneIndex.h"
@@ -47,6 +51,8 @@
 
 #include "fabric_sim/tokens.h"
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 
 using namespace pxr;
@@ -151,15 +157,28 @@ RuntimeEngine::RuntimeEngine(const SdfPath &rootPath,
 }
 
 void RuntimeEngine::_DestroyHydraObjects() {
-    // Destroy objects in opposite order of construction.
+    // The simulation thread steps the physics engine which writes in the
+    // render index fabric, it has to be stopped first.
+    StopSimulation();
+    _simulationEngine = nullptr;
+
+    // Destroy objects in opposite order of construction. The views are
+    // kept, they are recreated with the next render delegate.
     _engine = nullptr;
     _taskController = nullptr;
+    for (_View &view : _views) {
+        view.engine = nullptr;
+        view.taskController = nullptr;
+    }
     if (_renderIndex && _sceneIndex) {
         _renderIndex->RemoveSceneIndex(_sceneIndex);
         _stageSceneIndex = nullptr;
         _rootOverridesSceneIndex = nullptr;
         _selectionSceneIndex = nullptr;
+        _highlightSceneIndex = nullptr;
+        _selectedProxyPaths.clear();
         _displayStyleSceneIndex = nullptr;
+        _simulationSnapshotSceneIndex = nullptr;
         _sceneIndex = nullptr;
     }
 
@@ -198,12 +217,18 @@ void RuntimeEngine::PrepareBatch(const UsdPrim &root, const UsdImagingGLRenderPa
             auto stage = root.GetStage();
             TF_VERIFY(_stageSceneIndex);
             _stageSceneIndex->SetStage(stage);
+            _playbackCache->SetStage(stage);
 
             _isPopulated = true;
         }
 
         _PreSetTime(params);
 
+        // The cached frame is selected before the stage scene index dirties
+        // the animated prims.
+        _playbackCache->WaitPrefetch();
+        _playbackCache->SetTime(params.frame);
+
         // SetTime will only react if time actually changes.
         _stageSceneIndex->SetTime(params.frame);
 
@@ -222,14 +247,6 @@ void RuntimeEngine::_PrepareRender(const UsdImagingGLRenderParams &params) {
     _taskController->SetRenderTags(renderTags);
 
     _taskController->SetRenderParams(_MakeHydraUsdImagingGLRenderParams(params));
-
-    // Forward scene materials enable option.
-    if (_materialPruningSceneIndex) {
-        _materialPruningSceneIndex->SetEnabled(!params.enableSceneMaterials);
-    }
-    if (_lightPruningSceneIndex) {
-        _lightPruningSceneIndex->SetEnabled(!params.enableSceneLights);
-    }
 }
 
 void RuntimeEngine::_SetActiveRenderSettingsPrimFromStageMetadata(UsdStageWeakPtr stage) {
@@ -346,21 +363,147 @@ void RuntimeEngine::Render(const UsdPrim &root, const UsdImagingGLRenderParams &
 }
 
 void RuntimeEngine::Update(float dt) {
+    RUNTIME_PROFILE_SCOPE("Simulation step");
+    std::lock_guard<std::mutex> lock(_simulationMutex);
     _simulationEngine->UpdateAll(dt);
-    FlushDirties();
+    _FlushSimulationDirties();
+
+    _SetDebugDrawParams(_simulationEngine->GetDebugDrawData());
+}
 
-    auto data = _simulationEngine->GetDebugDrawData();
-    _taskController->SetDebugDrawParams(data.points, data.lines, data.triangles);
+void RuntimeEngine::FlushDirties() {
+    RUNTIME_PROFILE_SCOPE("FlushDirties");
+    std::lock_guard<std::mutex> lock(_simulationMutex);
+    _FlushSimulationDirties();
 }
 
-void RuntimeEngine::FlushDirties() { _fabricSceneIndex->FlushDirties(); }
+// The simulation lock is held, the snapshot copies the transforms dirtied by the simulation
+void RuntimeEngine::_FlushSimulationDirties() {
+    _simulationSnapshotSceneIndex->BeginCapture();
+    _fabricSceneIndex->FlushDirties();
+    _simulationSnapshotSceneIndex->EndCapture();
+}
 
-void RuntimeEngine::SyncFabric() { _simulationEngine->Sync(); }
+void RuntimeEngine::SyncFabric() {
+    std::lock_guard<std::mutex> lock(_simulationMutex);
+    _simulationEngine->Sync();
+}
 
-void RuntimeEngine::UnSyncFabric() { _simulationEngine->UnSync(); }
+void RuntimeEngine::UnSyncFabric() {
+    std::lock_guard<std::mutex> lock(_simulationMutex);
+    _simulationEngine->UnSync();
+    _simulationSnapshotSceneIndex->Clear();
+}
 
 void RuntimeEngine::SyncSettings(PhysicsSettings& settings) {
-    settings.Sync(*_simulationEngine);
+    {
+        std::lock_guard<std::mutex> lock(_simulationMutex);
+        settings.Sync(*_simulationEngine);
+    }
+    SetSimulationTimeStep(settings.timeStep);
+    SetSimulationMaxSubSteps(settings.maxSubSteps);
+}
+
+//----------------------------------------------------------------------------
+// Simulation thread
+//----------------------------------------------------------------------------
+
+void RuntimeEngine::StartSimulation() {
+    if (_simulationThread.joinable() || !_simulationEngine) {
+        return;
+    }
+    _simulationStopRequested = false;
+    _simulationStepCount = 0;
+    _simulationThread = std::thread(&RuntimeEngine::_SimulationLoop, this);
+}
+
+void RuntimeEngine::StopSimulation() {
+    if (!_simulationThread.joinable()) {
+        return;
+    }
+    _simulationStopRequested = true;
+    _simulationThread.join();
+}
+
+void RuntimeEngine::SetSimulationTimeStep(float timeStep) {
+    if (timeStep > 0.f) {
+        _simulationTimeStep = timeStep;
+    }
+}
+
+void RuntimeEngine::SetSimulationMaxSubSteps(int maxSubSteps) { _simulationMaxSubSteps = std::max(1, maxSubSteps); }
+
+void RuntimeEngine::_SimulationLoop() {
+    using SimulationClock = std::chrono::steady_clock;
+    auto previousTime = SimulationClock::now();
+    double accumulator = 0.0;
+    while (!_simulationStopRequested) {
+        const float timeStep = _simulationTimeStep;
+        const auto currentTime = SimulationClock::now();
+        accumulator += std::chrono::duration<double>(currentTime - previousTime).count();
+        previousTime = currentTime;
+
+        // When the steps are slower than the wall clock, drop the time we can't catch up with
+        // instead of accumulating more and more steps to run.
+        accumulator = std::min(accumulator, static_cast<double>(timeStep) * _simulationMaxSubSteps);
+
+        while (accumulator >= timeStep && !_simulationStopRequested) {
+            RUNTIME_PROFILE_SCOPE("Simulation step");
+            std::lock_guard<std::mutex> lock(_simulationMutex);
+            _simulationEngine->UpdateAll(timeStep);
+            _simulationDebugDrawBack = _simulationEngine->GetDebugDrawData();
+            _simulationBackBufferReady = true;
+            ++_simulationStepCount;
+            accumulator -= timeStep;
+        }
+
+        // Sleep until the next step is due
+        std::this_thread::sleep_for(std::chrono::duration<double>(timeStep - accumulator));
+    }
+}
+
+bool RuntimeEngine::ConsumeSimulationResults() {
+    if (ARCH_UNLIKELY(!_renderDelegate)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_simulationMutex);
+        if (!_simulationBackBufferReady) {
+            return false;
+        }
+        std::swap(_simulationDebugDrawFront, _simulationDebugDrawBack);
+        _simulationBackBufferReady = false;
+        RUNTIME_PROFILE_SCOPE("FlushDirties");
+        _FlushSimulationDirties();
+    }
+
+    _SetDebugDrawParams(_simulationDebugDrawFront);
+    return true;
+}
+
+// The simulation is shared, all the views draw it
+void RuntimeEngine::_SetDebugDrawParams(const _SimulationDebugDrawData &data) {
+    for (_View &view : _views) {
+        if (view.taskController) {
+            view.taskController->SetDebugDrawParams(data.points, data.lines, data.triangles);
+        }
+    }
+}
+
+bool RuntimeEngine::GetSimulatedTransform(const SdfPath &primPath, GfMatrix4d *outTransform) const {
+    if (ARCH_UNLIKELY(!_sceneIndex) || !outTransform) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_simulationMutex);
+    const SdfPath indexPath = primPath.ReplacePrefix(SdfPath::AbsoluteRootPath(), _sceneDelegateId);
+    const HdSceneIndexPrim prim = _sceneIndex->GetPrim(indexPath);
+    if (HdMatrixDataSourceHandle matrixSource = HdXformSchema::GetFromParent(prim.dataSource).GetMatrix()) {
+        *outTransform = matrixSource->GetTypedValue(0.0f);
+        return true;
+    }
+    return false;
 }
 
 bool RuntimeEngine::IsConverged() const {
@@ -486,34 +629,58 @@ void RuntimeEngine::SetSelected(SdfPathVector const &paths) {
         return;
     }
 
-    _selectionSceneIndex->ClearSelection();
+    ClearSelected();
+    AddSelected(paths);
+}
 
-    for (const SdfPath &path : paths) {
-        _selectionSceneIndex->AddSelection(path);
+void RuntimeEngine::ClearSelected() {
+    if (ARCH_UNLIKELY(!_renderDelegate)) {
+        return;
     }
-    return;
 
-    TF_VERIFY(_sceneDelegate);
+    _highlightSceneIndex->Clear();
+    if (!_selectedProxyPaths.empty()) {
+        _selectedProxyPaths.clear();
+        _selectionSceneIndex->ClearSelection();
+    }
+}
 
-    // populate new selection
-    HdSelectionSharedPtr const selection = std::make_shared<HdSelection>();
-    // XXX: Usdview currently supports selection on click. If we extend to
-    // rollover (locate) selection, we need to pass that mode here.
-    static const HdSelection::HighlightMode mode = HdSelection::HighlightModeSelect;
-    for (SdfPath const &path : paths) {
-        _sceneDelegate->PopulateSelection(mode, path, UsdImagingDelegate::ALL_INSTANCES, selection);
+void RuntimeEngine::AddSelected(SdfPathVector const &paths) {
+    if (ARCH_UNLIKELY(!_renderDelegate) || paths.empty()) {
+        return;
     }
 
-    // set the result back to selection tracker
-    _selTracker->SetSelection(selection);
+    // The instance proxies have no prim in the scene index and the native
+    // instances draw prototypes outside of their subtree, the usd selection
+    // scene index resolves them to their prototype prims
+    SdfPathVector proxyPaths;
+    _highlightSceneIndex->AddPaths(paths, &proxyPaths);
+    for (const SdfPath &path : proxyPaths) {
+        if (_selectedProxyPaths.insert(path).second) {
+            _selectionSceneIndex->AddSelection(path);
+        }
+    }
 }
 
-void RuntimeEngine::ClearSelected() {
-    if (ARCH_UNLIKELY(!_renderDelegate)) {
+void RuntimeEngine::RemoveSelected(SdfPathVector const &paths) {
+    if (ARCH_UNLIKELY(!_renderDelegate) || paths.empty()) {
         return;
     }
 
-    _selectionSceneIndex->ClearSelection();
+    _highlightSceneIndex->RemovePaths(paths);
+
+    // The usd selection scene index can't remove a path, it is
+    // rebuilt with the remaining proxies only when one is removed
+    bool proxyRemoved = false;
+    for (const SdfPath &path : paths) {
+        proxyRemoved |= _selectedProxyPaths.erase(path) != 0;
+    }
+    if (proxyRemoved) {
+        _selectionSceneIndex->ClearSelection();
+        for (const SdfPath &path : _selectedProxyPaths) {
+            _selectionSceneIndex->AddSelection(path);
+        }
+    }
 }
 
 HdSelectionSharedPtr RuntimeEngine::_GetSelection() const {
@@ -525,11 +692,7 @@ HdSelectionSharedPtr RuntimeEngine::_GetSelection() const {
 }
 
 void RuntimeEngine::AddSelected(SdfPath const &path, int instanceIndex) {
-    if (ARCH_UNLIKELY(!_renderDelegate)) {
-        return;
-    }
-
-    _selectionSceneIndex->AddSelection(path);
+    AddSelected(SdfPathVector{path});
 }
 
 void RuntimeEngine::SetSelectionColor(GfVec4f const &color) {
@@ -538,9 +701,29 @@ void RuntimeEngine::SetSelectionColor(GfVec4f const &color) {
     }
 
     _selectionColor = color;
-    _taskController->SetSelectionColor(_selectionColor);
+    for (_View &view : _views) {
+        if (view.taskController) {
+            view.taskController->SetSelectionColor(_selectionColor);
+        }
+    }
 }
 
+//----------------------------------------------------------------------------
+// Playback cache
+//----------------------------------------------------------------------------
+
+void RuntimeEngine::PrefetchPlayback(UsdTimeCode time, size_t memoryBudget) {
+    _playbackCache->Prefetch(time, memoryBudget);
+}
+
+void RuntimeEngine::WaitPlaybackPrefetch() { _playbackCache->WaitPrefetch(); }
+
+void RuntimeEngine::ClearPlaybackCache() { _playbackCache->Clear(); }
+
+size_t RuntimeEngine::GetPlaybackCacheNumFrames() const { return _playbackCache->GetNumFrames(); }
+
+size_t RuntimeEngine::GetPlaybackCacheMemorySize() const { return _playbackCache->GetMemorySize(); }
+
 //----------------------------------------------------------------------------
 // Picking
 //----------------------------------------------------------------------------
@@ -611,6 +794,9 @@ bool RuntimeEngine::TestIntersection(const PickParams &pickParams,
     HdxPickHitVector allHits;
     HdxPickTaskContextParams pickCtxParams;
     pickCtxParams.resolveMode = pickParams.resolveMode;
+    if (pickParams.resolution != GfVec2i(0)) {
+        pickCtxParams.resolution = pickParams.resolution;
+    }
     pickCtxParams.viewMatrix = viewMatrix;
     pickCtxParams.projectionMatrix = projectionMatrix;
     pickCtxParams.clipPlanes = params.clipPlanes;
@@ -806,6 +992,11 @@ void RuntimeEngine::_SetRenderDelegateAndRestoreState(HdPluginRenderDelegateUniq
 
     HdSelectionSharedPtr const selection = _GetSelection();
 
+    // The highlighted paths are shared by all the views, they must survive
+    // a render delegate change requested by any of them.
+    const SdfPathVector highlightedPaths = _highlightSceneIndex ? _highlightSceneIndex->GetPaths() : SdfPathVector();
+    const auto selectedProxyPaths = _selectedProxyPaths;
+
     // Rebuild the imaging stack
     _SetRenderDelegate(std::move(renderDelegate));
 
@@ -813,12 +1004,26 @@ void RuntimeEngine::_SetRenderDelegateAndRestoreState(HdPluginRenderDelegateUniq
     _rootOverridesSceneIndex->SetRootTransform(rootTransform);
     _rootOverridesSceneIndex->SetRootVisibility(rootVisibility);
     _selTracker->SetSelection(selection);
-    _taskController->SetSelectionColor(_selectionColor);
+    // The stage is not populated yet, the paths are restored without looking up their prims
+    _highlightSceneIndex->AddPaths(highlightedPaths);
+    for (const SdfPath &path : selectedProxyPaths) {
+        _selectedProxyPaths.insert(path);
+        _selectionSceneIndex->AddSelection(path);
+    }
+
+    // The AOVs of the views are restored when the new renderer has them
+    for (_View &view : _views) {
+        if (view.taskController && !view.aov.IsEmpty() &&
+            _renderIndex->IsBprimTypeSupported(HdPrimTypeTokens->renderBuffer) &&
+            _renderDelegate->GetDefaultAovDescriptor(view.aov).format != HdFormatInvalid) {
+            view.taskController->SetRenderOutputs({view.aov});
+        }
+    }
 }
 
-SdfPath RuntimeEngine::_ComputeControllerPath(const HdPluginRenderDelegateUniqueHandle &renderDelegate) {
+SdfPath RuntimeEngine::_ComputeControllerPath(const HdPluginRenderDelegateUniqueHandle &renderDelegate, ViewId view) {
     const std::string pluginId = TfMakeValidIdentifier(renderDelegate.GetPluginId().GetText());
-    const TfToken rendererName(TfStringPrintf("_UsdImaging_%s_%p", pluginId.c_str(), this));
+    const TfToken rendererName(TfStringPrintf("_UsdImaging_%s_%p_%zu", pluginId.c_str(), this, view));
 
     return _sceneDelegateId.AppendChild(rendererName);
 }
@@ -865,6 +1070,9 @@ HdSceneIndexBaseRefPtr RuntimeEngine::_AppendSceneGlobalsSceneIndexCallback(
 HdSceneIndexBaseRefPtr RuntimeEngine::_AppendOverridesSceneIndices(HdSceneIndexBaseRefPtr const &inputScene) {
     HdSceneIndexBaseRefPtr sceneIndex = inputScene;
 
+    // First, the values of the animated prims are replaced by the cached ones
+    sceneIndex = PlaybackCacheSceneIndex::New(sceneIndex, _playbackCache);
+
     static HdContainerDataSourceHandle const materialPruningInputArgs = HdRetainedContainerDataSource::New(
             HdsiPrimTypePruningSceneIndexTokens->primTypes,
             HdRetainedTypedSampledDataSource<TfTokenVector>::New({HdPrimTypeTokens->material}),
@@ -885,6 +1093,8 @@ HdSceneIndexBaseRefPtr RuntimeEngine::_AppendOverridesSceneIndices(HdSceneIndexB
 
     sceneIndex = _rootOverridesSceneIndex = UsdImagingRootOverridesSceneIndex::New(sceneIndex);
 
+    sceneIndex = _highlightSceneIndex = HighlightSceneIndex::New(sceneIndex);
+
     return sceneIndex;
 }
 
@@ -935,7 +1145,9 @@ void RuntimeEngine::_SetRenderDelegate(HdPluginRenderDelegateUniqueHandle &&rend
     _sceneIndex = sceneIndices.finalSceneIndex;
 
     _sceneIndex = _displayStyleSceneIndex = HdsiLegacyDisplayStyleOverrideSceneIndex::New(_sceneIndex);
+    _ApplySceneDisplaySettings();
     _sceneIndex = _fabricSceneIndex = FabricSceneIndex::New(_sceneIndex, _renderIndex->fabric());
+    _sceneIndex = _simulationSnapshotSceneIndex = SimulationSnapshotSceneIndex::New(_sceneIndex);
     _simulationEngine = std::make_unique<sim::PhysxEngine>(_renderIndex->fabric());
 
     _renderIndex->InsertSceneIndex(_sceneIndex, _sceneDelegateId);
@@ -946,13 +1158,79 @@ void RuntimeEngine::_SetRenderDelegate(HdPluginRenderDelegateUniqueHandle &&rend
         }
     }
 
-    _taskController = std::make_unique<HdxTaskController>(_renderIndex.get(), _ComputeControllerPath(_renderDelegate),
-                                                          _gpuEnabled);
+    if (_views.empty()) {
+        _views.emplace_back();
+        _views.front().isUsed = true;
+    }
+    for (ViewId view = 0; view < _views.size(); ++view) {
+        if (_views[view].isUsed) {
+            _CreateView(view);
+        }
+    }
+    _taskController = _views[_activeView].taskController.get();
+    _engine = _views[_activeView].engine.get();
+}
+
+void RuntimeEngine::_CreateView(ViewId view) {
+    _views[view].taskController = std::make_unique<HdxTaskController>(
+            _renderIndex.get(), _ComputeControllerPath(_renderDelegate, view), _gpuEnabled);
+    _views[view].taskController->SetSelectionColor(_selectionColor);
 
     // The task context holds on to resources in the render
     // deletegate, so we want to destroy it first and thus
     // create it last.
-    _engine = std::make_unique<HdEngine>();
+    _views[view].engine = std::make_unique<HdEngine>();
+}
+
+//----------------------------------------------------------------------------
+// Views
+//----------------------------------------------------------------------------
+
+RuntimeEngine::ViewId RuntimeEngine::AddView() {
+    ViewId view = 0;
+    while (view < _views.size() && _views[view].isAdded) {
+        ++view;
+    }
+    if (view == _views.size()) {
+        _views.emplace_back();
+    }
+    _views[view].isAdded = true;
+    // The default view already exists
+    if (!_views[view].isUsed) {
+        _views[view].isUsed = true;
+        if (_renderDelegate) {
+            _CreateView(view);
+        }
+    }
+    return view;
+}
+
+void RuntimeEngine::RemoveView(ViewId view) {
+    if (view >= _views.size() || !_views[view].isAdded) {
+        TF_CODING_ERROR("Invalid view %zu", view);
+        return;
+    }
+    _views[view].isAdded = false;
+    if (view == 0) {
+        return;
+    }
+    if (view == _activeView) {
+        SetActiveView(0);
+    }
+    _views[view].engine = nullptr;
+    _views[view].taskController = nullptr;
+    _views[view].aov = TfToken();
+    _views[view].isUsed = false;
+}
+
+void RuntimeEngine::SetActiveView(ViewId view) {
+    if (view >= _views.size() || !_views[view].isUsed) {
+        TF_CODING_ERROR("Invalid view %zu", view);
+        return;
+    }
+    _activeView = view;
+    _taskController = _views[view].taskController.get();
+    _engine = _views[view].engine.get();
 }
 
 //----------------------------------------------------------------------------
@@ -986,6 +1264,7 @@ bool RuntimeEngine::SetRendererAov(TfToken const &id) {
 
     if (_renderIndex->IsBprimTypeSupported(HdPrimTypeTokens->renderBuffer)) {
         _taskController->SetRenderOutputs({id});
+        _views[_activeView].aov = id;
         return true;
     }
     return false;
@@ -1269,7 +1548,11 @@ Hgi *RuntimeEngine::GetHgi() {
 HdRenderIndex *RuntimeEngine::_GetRenderIndex() const { return _renderIndex.get(); }
 
 void RuntimeEngine::_Execute(const UsdImagingGLRenderParams &params, HdTaskSharedPtrVector tasks) {
+    RUNTIME_PROFILE_SCOPE("Hydra execute");
     {
+        // The simulated transforms are read from the render side copy of the
+        // snapshot scene index, the simulation keeps stepping meanwhile.
+
         // Release the GIL before calling into hydra, in case any hydra plugins
         // call into python.
         TF_PY_ALLOW_THREADS_IN_SCOPE();
@@ -1329,13 +1612,28 @@ static int _GetRefineLevel(float c) {
 void RuntimeEngine::_PreSetTime(const UsdImagingGLRenderParams &params) {
     HD_TRACE_FUNCTION();
 
-    const int refineLevel = _GetRefineLevel(params.complexity);
+    _stageSceneIndex->ApplyPendingUpdates();
+}
 
+void RuntimeEngine::SetSceneDisplaySettings(float complexity, bool enableSceneMaterials, bool enableSceneLights) {
+    _refineLevel = _GetRefineLevel(complexity);
+    _enableSceneMaterials = enableSceneMaterials;
+    _enableSceneLights = enableSceneLights;
+    _ApplySceneDisplaySettings();
+}
+
+void RuntimeEngine::_ApplySceneDisplaySettings() {
     // The UsdImagingStageSceneIndex has no complexity opinion.
     // We force the value here upon all prims.
-    _displayStyleSceneIndex->SetRefineLevel({true, refineLevel});
-
-    _stageSceneIndex->ApplyPendingUpdates();
+    if (_displayStyleSceneIndex) {
+        _displayStyleSceneIndex->SetRefineLevel({true, _refineLevel});
+    }
+    if (_materialPruningSceneIndex) {
+        _materialPruningSceneIndex->SetEnabled(!_enableSceneMaterials);
+    }
+    if (_lightPruningSceneIndex) {
+        _lightPruningSceneIndex->SetEnabled(!_enableSceneLights);
+    }
 }
 
 void RuntimeEngine::_PostSetTime(const UsdImagingGLRenderParams &params) { HD_TRACE_FUNCTION(); }
@@ -1494,9 +1792,9 @@ TfToken RuntimeEngine::_GetDefaultRendererPluginId() {
     return TfToken();
 }
 
-HdEngine *RuntimeEngine::_GetHdEngine() { return _engine.get(); }
+HdEngine *RuntimeEngine::_GetHdEngine() { return _engine; }
 
-HdxTaskController *RuntimeEngine::_GetTaskController() const { return _taskController.get(); }
+HdxTaskController *RuntimeEngine::_GetTaskController() const { return _taskController; }
 
 bool RuntimeEngine::PollForAsynchronousUpdates() const {
     class _Observer : public HdSceneIndexObserver {
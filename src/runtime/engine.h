@@ -9,6 +9,9 @@
 #include "pxr/pxr.h"
 #include "pxr/usdImaging/usdImaging/version.h"
 
+#include "highlightSceneIndex.h"
+#include "playbackCache.h"
+#include "simulationSnapshotSceneIndex.h"
 #include "renderParams.h"
 #include "rendererSettings.h"
 #include "physicsSettings.h"
@@ -36,6 +39,7 @@
 
 #include "pxr/base/gf/frustum.h"
 #include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec2i.h"
 #include "pxr/base/gf/vec4d.h"
 #include "pxr/base/gf/vec4f.h"
 #include "pxr/base/gf/vec4i.h"
@@ -43,6 +47,14 @@
 #include "pxr/base/vt/dictionary.h"
 #include "pxr/base/tf/declarePtrs.h"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 namespace PXR_INTERNAL_NS {
 class UsdPrim;
 class HdRenderIndex;
@@ -141,6 +153,9 @@ public:
     /// \name Rendering
     /// @{
     // ---------------------------------------------------------------------
+    /// Advance the simulation by \p dt on the calling thread and flush the
+    /// results to hydra. This should not be used while the simulation thread
+    /// is running.
     void Update(float dt);
 
     void FlushDirties();
@@ -165,6 +180,81 @@ public:
 
     /// @}
 
+    // ---------------------------------------------------------------------
+    /// \name Views
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// A view renders the render index of the engine with its own task
+    /// controller: it has its own camera, framing, render buffers, AOVs and
+    /// presentation. The views share the render index, the scene indices,
+    /// the selection and the simulation, so multiple viewports on the same
+    /// stage cost one scene. The default view 0 always exists, it is
+    /// returned by the first call to AddView.
+    using ViewId = size_t;
+
+    /// Adds a view and returns its id, the ids of the removed views are reused.
+    ViewId AddView();
+
+    /// Removes a view and its render buffers. The default view is kept for
+    /// the next call to AddView.
+    void RemoveView(ViewId view);
+
+    /// The camera, framing, AOV, presentation, color correction, render and
+    /// picking functions apply to the active view.
+    void SetActiveView(ViewId view);
+
+    ViewId GetActiveView() const { return _activeView; }
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Scene display
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// The complexity and the pruning of the scene materials and lights are
+    /// applied by the scene indices, they are shared by all the views. The
+    /// values of the render params are ignored.
+    void SetSceneDisplaySettings(float complexity, bool enableSceneMaterials, bool enableSceneLights);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Simulation
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Start stepping the physics on a dedicated thread, using a fixed
+    /// timestep accumulator. Calling it when the thread is running does nothing.
+    void StartSimulation();
+
+    /// Stop and join the simulation thread.
+    void StopSimulation();
+
+    bool IsSimulationRunning() const { return _simulationThread.joinable(); }
+
+    /// Fixed timestep of one simulation step, in seconds.
+    void SetSimulationTimeStep(float timeStep);
+
+    /// Maximum number of steps the simulation thread runs to catch up with
+    /// the wall clock, the remaining time is dropped.
+    void SetSimulationMaxSubSteps(int maxSubSteps);
+
+    /// Called on the render thread: flush the last completed simulation steps
+    /// to hydra. Returns false if no step was completed since the last call.
+    bool ConsumeSimulationResults();
+
+    /// Number of simulation steps completed since the thread started.
+    size_t GetSimulationStepCount() const { return _simulationStepCount; }
+
+    /// Returns in \p outTransform the world transform of the prim at \p primPath as
+    /// seen by hydra, including the simulated transforms flushed from fabric.
+    /// It only reads the scene index and doesn't need a render to happen.
+    bool GetSimulatedTransform(const pxr::SdfPath& primPath, pxr::GfMatrix4d* outTransform) const;
+
+    /// @}
+
     // ---------------------------------------------------------------------
     /// \name Root Transform and Visibility
     /// @{
@@ -265,11 +355,41 @@ public:
     /// can be used for highlighting all instances if path is an instancer.
     void AddSelected(pxr::SdfPath const& path, int instanceIndex);
 
+    /// Add paths to the selection highlighting. Only the prims of these
+    /// paths are invalidated, whatever the size of the selection.
+    void AddSelected(pxr::SdfPathVector const& paths);
+
+    /// Remove paths from the selection highlighting. Only the prims of these
+    /// paths are invalidated, whatever the size of the selection.
+    void RemoveSelected(pxr::SdfPathVector const& paths);
+
     /// Sets the selection highlighting color.
     void SetSelectionColor(pxr::GfVec4f const& color);
 
     /// @}
 
+    // ---------------------------------------------------------------------
+    /// \name Playback cache
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Reads the animated transforms and points of the next frames after
+    /// \p time on worker threads, keeping at most \p memoryBudget bytes of
+    /// frames. Returns immediately, WaitPlaybackPrefetch must be called
+    /// before the stage is modified.
+    void PrefetchPlayback(pxr::UsdTimeCode time, size_t memoryBudget);
+
+    /// Waits for the frames being read by PrefetchPlayback.
+    void WaitPlaybackPrefetch();
+
+    /// Releases the cached frames, the values are read from the stage.
+    void ClearPlaybackCache();
+
+    size_t GetPlaybackCacheNumFrames() const;
+    size_t GetPlaybackCacheMemorySize() const;
+
+    /// @}
+
     // ---------------------------------------------------------------------
     /// \name Picking
     /// @{
@@ -320,6 +440,8 @@ public:
     // Pick params
     struct PickParams {
         pxr::TfToken resolveMode;
+        // Size in pixels of the picking buffers, the default size of hydra if zero
+        pxr::GfVec2i resolution = pxr::GfVec2i(0);
     };
 
     /// Perform picking by finding the intersection of objects in the scene with a renderered frustum.
@@ -585,6 +707,7 @@ protected:
     bool _CanPrepare(const pxr::UsdPrim& root);
 
     void _PreSetTime(const UsdImagingGLRenderParams& params);
+    void _ApplySceneDisplaySettings();
 
     void _PostSetTime(const UsdImagingGLRenderParams& params);
 
@@ -616,7 +739,9 @@ protected:
 
     void _SetRenderDelegate(pxr::HdPluginRenderDelegateUniqueHandle&&);
 
-    pxr::SdfPath _ComputeControllerPath(const pxr::HdPluginRenderDelegateUniqueHandle&);
+    pxr::SdfPath _ComputeControllerPath(const pxr::HdPluginRenderDelegateUniqueHandle&, ViewId view);
+
+    void _CreateView(ViewId view);
 
     static pxr::TfToken _GetDefaultRendererPluginId();
 
@@ -645,7 +770,20 @@ protected:
 
     pxr::SdfPath const _sceneDelegateId;
 
-    std::unique_ptr<pxr::HdxTaskController> _taskController;
+    // Task controller and hydra engine of every view, the hydra engine holds the
+    // task context data of the view: its AOV textures and its picking results.
+    struct _View {
+        std::unique_ptr<pxr::HdxTaskController> taskController;
+        std::unique_ptr<pxr::HdEngine> engine;
+        pxr::TfToken aov;  // Restored when the render delegate changes
+        bool isUsed = false;
+        bool isAdded = false;  // Returned by AddView, the default view is used before
+    };
+    std::vector<_View> _views;
+    ViewId _activeView = 0;
+
+    // Task controller of the active view
+    pxr::HdxTaskController* _taskController = nullptr;
 
     pxr::HdxSelectionTrackerSharedPtr _selTracker;
     pxr::HdRprimCollection _renderCollection;
@@ -678,6 +816,8 @@ private:
 
     pxr::HdSceneIndexBaseRefPtr _AppendOverridesSceneIndices(const pxr::HdSceneIndexBaseRefPtr& inputScene);
 
+    void _SimulationLoop();
+
     RuntimeEngine_Impl::_AppSceneIndicesSharedPtr _appSceneIndices;
 
     void _DestroyHydraObjects();
@@ -686,17 +826,50 @@ private:
     // at a time.
     pxr::UsdImagingStageSceneIndexRefPtr _stageSceneIndex;
     pxr::UsdImagingSelectionSceneIndexRefPtr _selectionSceneIndex;
+    HighlightSceneIndexRefPtr _highlightSceneIndex;
+    // Animated values of the playback frames, read by the scene indices
+    // appended after the stage scene index
+    std::shared_ptr<PlaybackCache> _playbackCache = std::make_shared<PlaybackCache>();
+    // Selected instance proxies and paths containing native instances,
+    // highlighted by _selectionSceneIndex which can only clear all its paths
+    std::unordered_set<pxr::SdfPath, pxr::SdfPath::Hash> _selectedProxyPaths;
     pxr::UsdImagingRootOverridesSceneIndexRefPtr _rootOverridesSceneIndex;
     pxr::HdsiLegacyDisplayStyleOverrideSceneIndexRefPtr _displayStyleSceneIndex;
     pxr::HdsiPrimTypePruningSceneIndexRefPtr _materialPruningSceneIndex;
     pxr::HdsiPrimTypePruningSceneIndexRefPtr _lightPruningSceneIndex;
+    // Scene display settings shared by the views, applied to the scene
+    // indices above when they are created
+    int _refineLevel = 0;
+    bool _enableSceneMaterials = true;
+    bool _enableSceneLights = true;
     pxr::HdSceneIndexBaseRefPtr _sceneIndex;
     pxr::FabricSceneIndexRefPtr _fabricSceneIndex;
+    SimulationSnapshotSceneIndexRefPtr _simulationSnapshotSceneIndex;
     std::unique_ptr<sim::PhysxEngine> _simulationEngine;
 
+    // Simulation thread. The physics engine writes directly into fabric, so
+    // _simulationMutex serializes the simulation steps with FlushDirties, which
+    // copies the simulated transforms in _simulationSnapshotSceneIndex. The
+    // hydra task execution reads the copies and runs without the lock.
+    using _SimulationDebugDrawData = std::decay_t<decltype(std::declval<sim::PhysxEngine>().GetDebugDrawData())>;
+    void _SetDebugDrawParams(const _SimulationDebugDrawData& data);
+    void _FlushSimulationDirties();
+    std::thread _simulationThread;
+    mutable std::mutex _simulationMutex;
+    std::atomic<bool> _simulationStopRequested{false};
+    std::atomic<float> _simulationTimeStep{1.f / 60.f};
+    std::atomic<int> _simulationMaxSubSteps{4};
+    std::atomic<size_t> _simulationStepCount{0};
+    // Results of the last completed step are written in the back buffer by the simulation
+    // thread and swapped with the front buffer which is only read by the render thread.
+    _SimulationDebugDrawData _simulationDebugDrawFront;
+    _SimulationDebugDrawData _simulationDebugDrawBack;
+    bool _simulationBackBufferReady = false;
+
     std::unique_ptr<pxr::UsdImagingDelegate> _sceneDelegate;
 
-    std::unique_ptr<pxr::HdEngine> _engine;
+    // Hydra engine of the active view
+    pxr::HdEngine* _engine = nullptr;
 
     bool _allowAsynchronousSceneProcessing = false;
 };
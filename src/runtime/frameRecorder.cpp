@@ -16,6 +16,9 @@
 #include "pxr/imaging/hdSt/textureUtils.h"
 #include "pxr/imaging/hdx/tokens.h"
 #include "pxr/imaging/hdx/types.h"
+#include "pxr/imaging/hgi/blitCmds.h"
+#include "pxr/imaging/hgi/blitCmdsOps.h"
+#include "pxr/imaging/hgi/hgi.h"
 #include "pxr/imaging/hio/image.h"
 
 #include "pxr/usd/usd/stage.h"
@@ -27,7 +30,9 @@
 
 #include "pxr/base/arch/fileSystem.h"
 
+#include <chrono>
 #include <string>
+#include <thread>
 
 using namespace pxr;
 
@@ -39,6 +44,7 @@ UsdAppUtilsFrameRecorder::UsdAppUtilsFrameRecorder(const TfToken& rendererPlugin
       _complexity(1.0f),
       _colorCorrectionMode(HdxColorCorrectionTokens->disabled),
       _purposes({UsdGeomTokens->default_, UsdGeomTokens->proxy}),
+      _bboxCache(UsdTimeCode::Default(), _purposes, /* useExtentsHint = */ true),
       _cameraLightEnabled(true),
       _domeLightsVisible(false) {
     // Disable presentation to avoid the need to create an OpenGL context when
@@ -49,6 +55,25 @@ UsdAppUtilsFrameRecorder::UsdAppUtilsFrameRecorder(const TfToken& rendererPlugin
     _imagingEngine.SetRendererSetting(HdRenderSettingsTokens->enableInteractive, VtValue(false));
 }
 
+UsdAppUtilsFrameRecorder::~UsdAppUtilsFrameRecorder() {
+    TfNotice::Revoke(_objectsChangedKey);
+    // The buffers are destroyed before the engine owning the Hgi
+    for (_QueuedImage& queued : _queuedImages) {
+        if (queued.buffer) {
+            _imagingEngine.GetHgi()->DestroyBuffer(&queued.buffer);
+        }
+    }
+    for (HgiBufferHandle& buffer : _readbackBuffers) {
+        _imagingEngine.GetHgi()->DestroyBuffer(&buffer);
+    }
+}
+
+// Any edit can move the prims framed by the camera
+void UsdAppUtilsFrameRecorder::_OnObjectsChanged(const UsdNotice::ObjectsChanged& notice,
+                                                 const UsdStageWeakPtr& sender) {
+    _bboxCache.Clear();
+}
+
 void UsdAppUtilsFrameRecorder::SetActiveRenderSettingsPrimPath(SdfPath const& path) {
     _renderSettingsPrimPath = path;
     if (!_renderSettingsPrimPath.IsEmpty()) {
@@ -100,15 +125,16 @@ void UsdAppUtilsFrameRecorder::SetIncludedPurposes(const TfTokenVector& purposes
             TF_CODING_ERROR("Unrecognized purpose value '%s'.", p.GetText());
         }
     }
+    _bboxCache.SetIncludedPurposes(_purposes);
 }
 
+// The bbox cache is reused between the frames, only the time varying bounds are recomputed
 static GfCamera _ComputeCameraToFrameStage(const UsdStagePtr& stage,
                                            UsdTimeCode timeCode,
-                                           const TfTokenVector& includedPurposes) {
+                                           UsdGeomBBoxCache& bboxCache) {
     // Start with a default (50mm) perspective GfCamera.
     GfCamera gfCamera;
-    UsdGeomBBoxCache bboxCache(timeCode, includedPurposes,
-                               /* useExtentsHint = */ true);
+    bboxCache.SetTime(timeCode);
     GfBBox3d bbox = bboxCache.ComputeWorldBound(stage->GetPseudoRoot());
     GfVec3d center = bbox.ComputeCentroid();
     GfRange3d range = bbox.ComputeAlignedRange();
@@ -155,9 +181,9 @@ static GfCamera _ComputeCameraToFrameStage(const UsdStagePtr& stage,
 
 namespace {
 
-class TextureBufferWriter {
+class TextureBufferReader {
 public:
-    TextureBufferWriter(RuntimeEngine* engine) : _engine(engine), _colorRenderBuffer(nullptr) {
+    TextureBufferReader(RuntimeEngine* engine) : _engine(engine), _colorRenderBuffer(nullptr) {
         // If rendering via Storm or a non-Storm renderer but with the GPU
         // enabled, we will have a color texture to read from.
         //
@@ -179,32 +205,30 @@ public:
         }
     }
 
-    bool Write(const std::string& filename) {
+    bool Read(UsdAppUtilsFrameRecorder::FrameImage* image) {
         if (!_ValidSource()) {
             return false;
         }
 
-        HioImage::StorageSpec storage;
-        storage.width = _GetWidth();
-        storage.height = _GetHeight();
-        storage.format = _GetFormat();
-        storage.flipped = true;
-        storage.data = _Map();
-        TfScoped<> scopedUnmap([this]() { _Unmap(); });
-
-        {
-            TRACE_FUNCTION_SCOPE("writing image");
-
-            const HioImageSharedPtr image = HioImage::OpenForWriting(filename);
-            const bool writeSuccess = image && image->Write(storage);
-
-            if (!writeSuccess) {
-                TF_RUNTIME_ERROR("Failed to write image to %s", filename.c_str());
+        TRACE_FUNCTION_SCOPE("reading image");
+        image->width = _GetWidth();
+        image->height = _GetHeight();
+        image->format = _GetFormat();
+        if (_colorTextureHandle) {
+            size_t size = 0;
+            const HdStTextureUtils::AlignedBuffer<uint8_t> buffer =
+                    HdStTextureUtils::HgiTextureReadback(_engine->GetHgi(), _colorTextureHandle, &size);
+            image->pixels.assign(buffer.get(), buffer.get() + size);
+        } else {
+            const size_t size = size_t(image->width) * image->height * HioGetDataSizeOfFormat(image->format);
+            const uint8_t* data = static_cast<const uint8_t*>(_colorRenderBuffer->Map());
+            TfScoped<> scopedUnmap([this]() { _colorRenderBuffer->Unmap(); });
+            if (!data) {
                 return false;
             }
+            image->pixels.assign(data, data + size);
         }
-
-        return true;
+        return image->IsValid();
     }
 
 private:
@@ -240,33 +264,36 @@ private:
         }
     }
 
-    void* _Map() {
-        if (_colorTextureHandle) {
-            size_t size = 0;
-            _mappedColorTextureBuffer =
-                    HdStTextureUtils::HgiTextureReadback(_engine->GetHgi(), _colorTextureHandle, &size);
-            return _mappedColorTextureBuffer.get();
-        } else if (_colorRenderBuffer) {
-            return _colorRenderBuffer->Map();
-        } else {
-            return nullptr;
-        }
-    }
-
-    void _Unmap() {
-        if (_colorRenderBuffer) {
-            _colorRenderBuffer->Unmap();
-        }
-    }
-
     RuntimeEngine* _engine;
     HgiTextureHandle _colorTextureHandle;
     HdRenderBuffer* _colorRenderBuffer;
-    HdStTextureUtils::AlignedBuffer<uint8_t> _mappedColorTextureBuffer;
 };
 
 }  // namespace
 
+bool UsdAppUtilsFrameRecorder::FrameImage::Write(const std::string& outputImagePath) const {
+    if (!IsValid()) {
+        TF_CODING_ERROR("Invalid image to write to %s", outputImagePath.c_str());
+        return false;
+    }
+
+    TRACE_FUNCTION_SCOPE("writing image");
+    HioImage::StorageSpec storage;
+    storage.width = width;
+    storage.height = height;
+    storage.format = format;
+    storage.flipped = true;
+    storage.data = const_cast<uint8_t*>(pixels.data());
+
+    const HioImageSharedPtr image = HioImage::OpenForWriting(outputImagePath);
+    const bool writeSuccess = image && image->Write(storage);
+    if (!writeSuccess) {
+        TF_RUNTIME_ERROR("Failed to write image to %s", outputImagePath.c_str());
+        return false;
+    }
+    return true;
+}
+
 static bool _RenderProductsGenerated(const UsdStagePtr& stage, const SdfPath& renderSettingsPrimPath) {
     if (renderSettingsPrimPath.IsEmpty()) {
         return false;
@@ -307,13 +334,160 @@ bool UsdAppUtilsFrameRecorder::Record(const UsdStagePtr& stage,
                                       const UsdGeomCamera& usdCamera,
                                       const UsdTimeCode timeCode,
                                       const std::string& outputImagePath) {
-    if (!stage) {
-        TF_CODING_ERROR("Invalid stage");
+    if (outputImagePath.empty()) {
+        TF_CODING_ERROR("Invalid empty output image path");
         return false;
     }
 
-    if (outputImagePath.empty()) {
-        TF_CODING_ERROR("Invalid empty output image path");
+    FrameImage image;
+    if (!RecordImage(stage, usdCamera, timeCode, &image)) {
+        return false;
+    }
+    // If the RenderProducts on RenderSettings Prim successfully generated
+    // images, we do not need to write to the outputImagePath.
+    return !image.IsValid() || image.Write(outputImagePath);
+}
+
+bool UsdAppUtilsFrameRecorder::RecordImage(const UsdStagePtr& stage,
+                                           const UsdGeomCamera& usdCamera,
+                                           const UsdTimeCode timeCode,
+                                           FrameImage* image) {
+    if (!TF_VERIFY(image)) {
+        return false;
+    }
+    image->width = image->height = 0;
+    _lastFrameStatistics = FrameStatistics();
+    if (!_Render(stage, usdCamera, timeCode)) {
+        return false;
+    }
+    if (_RenderProductsGenerated(stage, _renderSettingsPrimPath)) {
+        return true;
+    }
+    const auto readbackStart = std::chrono::steady_clock::now();
+    TextureBufferReader reader(&_imagingEngine);
+    const bool succeeded = reader.Read(image);
+    _lastFrameStatistics.readbackSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - readbackStart).count();
+    return succeeded;
+}
+
+// Reuses a readback buffer of the same size, the images of a sequence usually have the same size
+HgiBufferHandle UsdAppUtilsFrameRecorder::_AcquireReadbackBuffer(size_t byteSize) {
+    Hgi* hgi = _imagingEngine.GetHgi();
+    for (auto it = _readbackBuffers.begin(); it != _readbackBuffers.end(); ++it) {
+        if ((*it)->GetDescriptor().byteSize == byteSize) {
+            const HgiBufferHandle buffer = *it;
+            _readbackBuffers.erase(it);
+            return buffer;
+        }
+    }
+    // The buffers of another size won't be used anymore
+    for (HgiBufferHandle& buffer : _readbackBuffers) {
+        hgi->DestroyBuffer(&buffer);
+    }
+    _readbackBuffers.clear();
+
+    HgiBufferDesc desc;
+    desc.debugName = "FrameRecorder readback";
+    desc.usage = HgiBufferUsageStorage;
+    desc.byteSize = byteSize;
+    return hgi->CreateBuffer(desc);
+}
+
+bool UsdAppUtilsFrameRecorder::QueueImage(const UsdStagePtr& stage,
+                                          const UsdGeomCamera& usdCamera,
+                                          const UsdTimeCode timeCode) {
+    _lastFrameStatistics = FrameStatistics();
+    if (!_Render(stage, usdCamera, timeCode)) {
+        return false;
+    }
+    _QueuedImage queued;
+    queued.timeCode = timeCode;
+    if (_RenderProductsGenerated(stage, _renderSettingsPrimPath)) {
+        _queuedImages.push_back(std::move(queued));
+        return true;
+    }
+    const auto readbackStart = std::chrono::steady_clock::now();
+    if (_imagingEngine.GetGPUEnabled()) {
+        const HgiTextureHandle texture = _imagingEngine.GetAovTexture(HdAovTokens->color);
+        if (!texture) {
+            TF_CODING_ERROR("No color texture to write out.");
+            return false;
+        }
+        TRACE_FUNCTION_SCOPE("queueing image readback");
+        const HgiTextureDesc& textureDesc = texture->GetDescriptor();
+        queued.image.width = textureDesc.dimensions[0];
+        queued.image.height = textureDesc.dimensions[1];
+        queued.image.format = HdxGetHioFormat(textureDesc.format);
+        const size_t byteSize =
+                size_t(queued.image.width) * queued.image.height * HgiGetDataSizeOfFormat(textureDesc.format);
+        queued.buffer = _AcquireReadbackBuffer(byteSize);
+
+        // The copy is only submitted, it runs while the next frames are rendered
+        Hgi* hgi = _imagingEngine.GetHgi();
+        HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+        HgiTextureToBufferOp copyOp;
+        copyOp.gpuSourceTexture = texture;
+        copyOp.sourceTexelOffset = GfVec3i(0);
+        copyOp.mipLevel = 0;
+        copyOp.gpuDestinationBuffer = queued.buffer;
+        copyOp.destinationByteOffset = 0;
+        copyOp.byteSize = byteSize;
+        blitCmds->CopyTextureToBuffer(copyOp);
+        hgi->SubmitCmds(blitCmds.get());
+    } else {
+        // The CPU renderers resolve their render buffer in memory, there is nothing to wait for
+        TextureBufferReader reader(&_imagingEngine);
+        if (!reader.Read(&queued.image)) {
+            return false;
+        }
+    }
+    _lastFrameStatistics.readbackSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - readbackStart).count();
+    _queuedImages.push_back(std::move(queued));
+    return true;
+}
+
+bool UsdAppUtilsFrameRecorder::TakeImage(FrameImage* image, UsdTimeCode* timeCode) {
+    if (!TF_VERIFY(image && timeCode) || _queuedImages.empty()) {
+        return false;
+    }
+    _QueuedImage queued = std::move(_queuedImages.front());
+    _queuedImages.pop_front();
+    *timeCode = queued.timeCode;
+    if (!queued.buffer) {
+        // Swapping keeps the pixel storage of the caller's image cycling through the queue
+        std::swap(*image, queued.image);
+        return true;
+    }
+
+    TRACE_FUNCTION_SCOPE("reading image");
+    const size_t byteSize = queued.buffer->GetDescriptor().byteSize;
+    image->width = queued.image.width;
+    image->height = queued.image.height;
+    image->format = queued.image.format;
+    image->pixels.resize(byteSize);
+
+    // The copy was submitted ReadbackLatency frames ago, it is usually done by now
+    Hgi* hgi = _imagingEngine.GetHgi();
+    HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+    HgiBufferGpuToCpuOp copyOp;
+    copyOp.gpuSourceBuffer = queued.buffer;
+    copyOp.sourceByteOffset = 0;
+    copyOp.byteSize = byteSize;
+    copyOp.cpuDestinationBuffer = image->pixels.data();
+    copyOp.destinationByteOffset = 0;
+    blitCmds->CopyBufferGpuToCpu(copyOp);
+    hgi->SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeWaitUntilCompleted);
+    _readbackBuffers.push_back(queued.buffer);
+    return image->IsValid();
+}
+
+bool UsdAppUtilsFrameRecorder::_Render(const UsdStagePtr& stage,
+                                       const UsdGeomCamera& usdCamera,
+                                       const UsdTimeCode timeCode) {
+    if (!stage) {
+        TF_CODING_ERROR("Invalid stage");
         return false;
     }
 
@@ -327,7 +501,17 @@ bool UsdAppUtilsFrameRecorder::Record(const UsdStagePtr& stage,
     if (usdCamera) {
         gfCamera = usdCamera.GetCamera(timeCode);
     } else {
-        gfCamera = _ComputeCameraToFrameStage(stage, timeCode, _purposes);
+        if (_bboxCacheStage != stage) {
+            _bboxCache.Clear();
+            _bboxCacheStage = stage;
+            TfNotice::Revoke(_objectsChangedKey);
+            _objectsChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &UsdAppUtilsFrameRecorder::_OnObjectsChanged,
+                                                    UsdStageWeakPtr(stage));
+        }
+        const auto framingStart = std::chrono::steady_clock::now();
+        gfCamera = _ComputeCameraToFrameStage(stage, timeCode, _bboxCache);
+        _lastFrameStatistics.framingSeconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - framingStart).count();
     }
 
     // Calculate the imageHeight based on the aspect ratio
@@ -372,6 +556,8 @@ bool UsdAppUtilsFrameRecorder::Record(const UsdStagePtr& stage,
 
     _imagingEngine.SetRendererSetting(HdRenderSettingsTokens->domeLightCameraVisibility, VtValue(_domeLightsVisible));
 
+    _imagingEngine.SetSceneDisplaySettings(_complexity, true, true);
+
     UsdImagingGLRenderParams renderParams;
     renderParams.frame = timeCode;
     renderParams.complexity = _complexity;
@@ -385,8 +571,10 @@ bool UsdAppUtilsFrameRecorder::Record(const UsdStagePtr& stage,
 
     unsigned int sleepTime = 10;  // Initial wait time of 10 ms
 
+    const auto renderStart = std::chrono::steady_clock::now();
     while (true) {
         _imagingEngine.Render(pseudoRoot, renderParams);
+        _lastFrameStatistics.renderPasses++;
 
         if (_imagingEngine.IsConverged()) {
             break;
@@ -397,14 +585,9 @@ bool UsdAppUtilsFrameRecorder::Record(const UsdStagePtr& stage,
             sleepTime = std::min(100u, sleepTime + 5);
         }
     };
-
-    // If the RenderProducts on RenderSettings Prim successfully generated
-    // images, we do not need to write to the outputImagePath.
-    if (_RenderProductsGenerated(stage, _renderSettingsPrimPath)) {
-        return true;
-    }
-    TextureBufferWriter writer(&_imagingEngine);
-    return writer.Write(outputImagePath);
+    _lastFrameStatistics.renderSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+    return true;
 }
 
 }  // namespace runtime
@@ -10,13 +10,22 @@
 #include "pxr/usdImaging/usdAppUtils/api.h"
 
 #include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/notice.h"
 #include "pxr/base/tf/token.h"
+#include "pxr/base/tf/weakBase.h"
+#include "pxr/imaging/hgi/buffer.h"
+#include "pxr/imaging/hio/types.h"
+#include "pxr/usd/usd/notice.h"
 #include "pxr/usd/usd/stage.h"
 #include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
 #include "pxr/usd/usdGeom/camera.h"
 #include "engine.h"
 
+#include <cstdint>
+#include <deque>
 #include <string>
+#include <vector>
 
 namespace runtime {
 
@@ -32,8 +41,33 @@ namespace runtime {
 /// Note that it is assumed that an OpenGL context has already been setup for
 /// the UsdAppUtilsFrameRecorder if OpenGL is being used as the underlying HGI
 /// device. This is not required for Metal or Vulkan.
-class UsdAppUtilsFrameRecorder {
+class UsdAppUtilsFrameRecorder : public pxr::TfWeakBase {
 public:
+    /// Pixels of a recorded image, read back from the color aov.
+    ///
+    /// The pixel storage is kept between reads of images of the same size, so a
+    /// pool of FrameImage can be reused over a whole sequence without reallocating.
+    struct FrameImage {
+        std::vector<uint8_t> pixels;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        pxr::HioFormat format = pxr::HioFormatInvalid;
+
+        bool IsValid() const { return width && height && format != pxr::HioFormatInvalid; }
+
+        /// Encodes and writes the image to \p outputImagePath.
+        /// This doesn't use the imaging engine, so it can be called from any thread.
+        bool Write(const std::string& outputImagePath) const;
+    };
+
+    /// Timings of the last recorded image, in seconds.
+    struct FrameStatistics {
+        double framingSeconds = 0.0;  ///< computing the camera framing the stage, when no camera is given
+        double renderSeconds = 0.0;   ///< rendering until the renderer has converged
+        double readbackSeconds = 0.0; ///< resolving and copying the color aov
+        size_t renderPasses = 0;      ///< number of Render calls needed to converge
+    };
+
     /// The \p rendererPluginId argument indicates the renderer plugin that
     /// Hyrda should use. If the empty token is passed in, a default renderer
     /// plugin will be chosen depending on the value of \p gpuEnabled.
@@ -41,11 +75,16 @@ public:
     /// instance will allow Hydra to use the GPU to produce images.
 
     UsdAppUtilsFrameRecorder(const pxr::TfToken& rendererPluginId = pxr::TfToken(), bool gpuEnabled = true);
+    ~UsdAppUtilsFrameRecorder();
 
     /// Gets the ID of the Hydra renderer plugin that will be used for
     /// recording.
     pxr::TfToken GetCurrentRendererId() const { return _imagingEngine.GetCurrentRendererId(); }
 
+    /// Returns true if the images are rendered with the GPU, otherwise they are
+    /// read back from the resolved render buffer of a CPU renderer.
+    bool GetGPUEnabled() const { return _imagingEngine.GetGPUEnabled(); }
+
     /// Sets the Hydra renderer plugin to be used for recording.
     /// This also resets the presentation flag on the HdxPresentTask to false,
     /// to avoid the need for an OpenGL context.
@@ -137,12 +176,68 @@ public:
                 const pxr::UsdTimeCode timeCode,
                 const std::string& outputImagePath);
 
+    /// Records an image like Record, but reads it back in \p image instead of
+    /// writing it, so the encoding can be done later on another thread.
+    ///
+    /// When the RenderProducts of the active RenderSettings prim generated the
+    /// images, true is returned and \p image is left invalid.
+    bool RecordImage(const pxr::UsdStagePtr& stage,
+                     const pxr::UsdGeomCamera& usdCamera,
+                     const pxr::UsdTimeCode timeCode,
+                     FrameImage* image);
+
+    /// Number of images queued by QueueImage before the oldest one is taken.
+    /// The GPU copies the color aov of a frame while the following frames are
+    /// rendered, so taking it doesn't wait for the copy.
+    static constexpr size_t ReadbackLatency = 2;
+
+    /// Records an image like RecordImage, but only queues the copy of the
+    /// color aov in a readback buffer reused between the frames. The image is
+    /// read back later by TakeImage.
+    bool QueueImage(const pxr::UsdStagePtr& stage,
+                    const pxr::UsdGeomCamera& usdCamera,
+                    const pxr::UsdTimeCode timeCode);
+
+    /// Returns the number of images queued and not taken yet.
+    size_t GetQueuedImageCount() const { return _queuedImages.size(); }
+
+    /// Reads back the oldest queued image in \p image and its time in \p timeCode.
+    ///
+    /// When the RenderProducts of the active RenderSettings prim generated the
+    /// image, true is returned and \p image is left invalid.
+    bool TakeImage(FrameImage* image, pxr::UsdTimeCode* timeCode);
+
+    /// Returns the timings of the last call to Record, RecordImage or QueueImage.
+    const FrameStatistics& GetLastFrameStatistics() const { return _lastFrameStatistics; }
+
+    /// The bounds used to frame the stage when no camera is given are cached
+    /// between the frames of a sequence on the same stage. The cache is cleared
+    /// when the stage is edited.
+    void ClearCaches() { _bboxCache.Clear(); }
+
 private:
+    void _OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged& notice, const pxr::UsdStageWeakPtr& sender);
+    bool _Render(const pxr::UsdStagePtr& stage, const pxr::UsdGeomCamera& usdCamera, const pxr::UsdTimeCode timeCode);
+    pxr::HgiBufferHandle _AcquireReadbackBuffer(size_t byteSize);
+
+    /// Image queued by QueueImage
+    struct _QueuedImage {
+        pxr::UsdTimeCode timeCode;
+        pxr::HgiBufferHandle buffer; ///< GPU copy of the color aov, empty when read back by the CPU renderer
+        FrameImage image;            ///< Size and format of the GPU copy, or the pixels read back from the CPU
+    };
+
     RuntimeEngine _imagingEngine;
     size_t _imageWidth;
     float _complexity;
     pxr::TfToken _colorCorrectionMode;
     pxr::TfTokenVector _purposes;
+    pxr::UsdGeomBBoxCache _bboxCache;
+    pxr::UsdStagePtr _bboxCacheStage;
+    pxr::TfNotice::Key _objectsChangedKey;
+    FrameStatistics _lastFrameStatistics;
+    std::deque<_QueuedImage> _queuedImages;
+    std::vector<pxr::HgiBufferHandle> _readbackBuffers; ///< Buffers of the taken images, reused by the next frames
     pxr::SdfPath _renderPassPrimPath;
     pxr::SdfPath _renderSettingsPrimPath;
     bool _cameraLightEnabled;
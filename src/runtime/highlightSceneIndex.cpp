@@ -0,0 +1,132 @@
+#include "highlightSceneIndex.h"
+#include "profiler.h"
+
+#include "pxr/imaging/hd/overlayContainerDataSource.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
+#include "pxr/imaging/hd/sceneIndexPrimView.h"
+#include "pxr/imaging/hd/selectionSchema.h"
+#include "pxr/imaging/hd/selectionsSchema.h"
+#include "pxr/usdImaging/usdImaging/usdPrimInfoSchema.h"
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+// The same data source is shared by all the highlighted prims
+HdContainerDataSourceHandle _GetSelectionsDataSource() {
+    static const HdContainerDataSourceHandle selectionsDataSource = [] {
+        const HdDataSourceBaseHandle selection =
+                HdSelectionSchema::Builder().SetFullySelected(HdRetainedTypedSampledDataSource<bool>::New(true)).Build();
+        return HdRetainedContainerDataSource::New(HdSelectionsSchemaTokens->selections,
+                                                  HdSelectionsSchema::BuildRetained(1, &selection));
+    }();
+    return selectionsDataSource;
+}
+
+} // namespace
+
+HighlightSceneIndexRefPtr HighlightSceneIndex::New(const HdSceneIndexBaseRefPtr &inputSceneIndex) {
+    return TfCreateRefPtr(new HighlightSceneIndex(inputSceneIndex));
+}
+
+HighlightSceneIndex::HighlightSceneIndex(const HdSceneIndexBaseRefPtr &inputSceneIndex)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex) {}
+
+HdSceneIndexPrim HighlightSceneIndex::GetPrim(const SdfPath &primPath) const {
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+    if (prim.dataSource && IsHighlighted(primPath)) {
+        prim.dataSource = HdOverlayContainerDataSource::New(_GetSelectionsDataSource(), prim.dataSource);
+    }
+    return prim;
+}
+
+SdfPathVector HighlightSceneIndex::GetChildPrimPaths(const SdfPath &primPath) const {
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+bool HighlightSceneIndex::IsHighlighted(const SdfPath &primPath) const {
+    if (_paths.empty()) {
+        return false;
+    }
+    for (SdfPath path = primPath; !path.IsEmpty(); path = path.GetParentPath()) {
+        if (_paths.count(path)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HighlightSceneIndex::AddPaths(const SdfPathVector &paths, SdfPathVector *outInstancingPaths) {
+    RUNTIME_PROFILE_SCOPE("HighlightSceneIndex::AddPaths");
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    for (const SdfPath &path : paths) {
+        if (outInstancingPaths && !_GetInputSceneIndex()->GetPrim(path).dataSource) {
+            outInstancingPaths->push_back(path);
+            continue;
+        }
+        if (_paths.insert(path).second && _AppendSubtreeEntries(path, &entries) && outInstancingPaths) {
+            outInstancingPaths->push_back(path);
+        }
+    }
+    _SendSelectionsDirtied(entries);
+}
+
+void HighlightSceneIndex::RemovePaths(const SdfPathVector &paths) {
+    RUNTIME_PROFILE_SCOPE("HighlightSceneIndex::RemovePaths");
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    for (const SdfPath &path : paths) {
+        if (_paths.erase(path)) {
+            _AppendSubtreeEntries(path, &entries);
+        }
+    }
+    _SendSelectionsDirtied(entries);
+}
+
+void HighlightSceneIndex::Clear() {
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    for (const SdfPath &path : _paths) {
+        _AppendSubtreeEntries(path, &entries);
+    }
+    _paths.clear();
+    _SendSelectionsDirtied(entries);
+}
+
+bool HighlightSceneIndex::_AppendSubtreeEntries(const SdfPath &path,
+                                                HdSceneIndexObserver::DirtiedPrimEntries *entries) const {
+    bool hasInstances = false;
+    for (const SdfPath &primPath : HdSceneIndexPrimView(_GetInputSceneIndex(), path)) {
+        entries->emplace_back(primPath, HdSelectionsSchema::GetDefaultLocator());
+        // The prototype prims drawn by a native instance are not in the subtree
+        const HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+        const HdPathDataSourceHandle prototypePath =
+                UsdImagingUsdPrimInfoSchema::GetFromParent(prim.dataSource).GetNiPrototypePath();
+        hasInstances |= prototypePath && !prototypePath->GetTypedValue(0.0f).IsEmpty();
+    }
+    return hasInstances;
+}
+
+void HighlightSceneIndex::_SendSelectionsDirtied(const HdSceneIndexObserver::DirtiedPrimEntries &entries) {
+    if (!entries.empty() && _IsObserved()) {
+        _SendPrimsDirtied(entries);
+    }
+}
+
+void HighlightSceneIndex::_PrimsAdded(const HdSceneIndexBase &sender,
+                                      const HdSceneIndexObserver::AddedPrimEntries &entries) {
+    _SendPrimsAdded(entries);
+}
+
+// The removed prims stay highlighted, they are still selected if they come back
+void HighlightSceneIndex::_PrimsRemoved(const HdSceneIndexBase &sender,
+                                        const HdSceneIndexObserver::RemovedPrimEntries &entries) {
+    _SendPrimsRemoved(entries);
+}
+
+void HighlightSceneIndex::_PrimsDirtied(const HdSceneIndexBase &sender,
+                                        const HdSceneIndexObserver::DirtiedPrimEntries &entries) {
+    _SendPrimsDirtied(entries);
+}
+
+} // namespace runtime
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <unordered_set>
+
+namespace runtime {
+
+class HighlightSceneIndex;
+using HighlightSceneIndexRefPtr = pxr::TfRefPtr<HighlightSceneIndex>;
+
+/// \class HighlightSceneIndex
+///
+/// Filtering scene index setting the selections data source on the selected prims and their descendants.
+///
+/// UsdImagingSelectionSceneIndex can only add paths or clear all of them, clearing dirties every selected prim.
+/// Here the paths are added and removed individually and only the subtrees whose highlighting changed are dirtied,
+/// so a selection change costs the size of the subtrees added and removed, not the size of the selection.
+///
+/// The paths are prim paths of the input scene index. The usd instance proxies, which have no prim in the
+/// input scene, and the paths containing native instances, whose prototype prims are outside of the subtree, are
+/// reported to the caller to be forwarded to UsdImagingSelectionSceneIndex.
+class HighlightSceneIndex : public pxr::HdSingleInputFilteringSceneIndexBase {
+public:
+    static HighlightSceneIndexRefPtr New(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+    pxr::HdSceneIndexPrim GetPrim(const pxr::SdfPath &primPath) const override;
+    pxr::SdfPathVector GetChildPrimPaths(const pxr::SdfPath &primPath) const override;
+
+    /// Highlight \p paths and their descendants. The paths without prim in the input scene or containing native
+    /// instances are appended to \p outInstancingPaths
+    void AddPaths(const pxr::SdfPathVector &paths, pxr::SdfPathVector *outInstancingPaths = nullptr);
+    void RemovePaths(const pxr::SdfPathVector &paths);
+    void Clear();
+
+    /// True if the prim or one of its ancestors is highlighted
+    bool IsHighlighted(const pxr::SdfPath &primPath) const;
+    size_t GetNumPaths() const { return _paths.size(); }
+    pxr::SdfPathVector GetPaths() const { return pxr::SdfPathVector(_paths.begin(), _paths.end()); }
+
+protected:
+    explicit HighlightSceneIndex(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+    void _PrimsAdded(const pxr::HdSceneIndexBase &sender,
+                     const pxr::HdSceneIndexObserver::AddedPrimEntries &entries) override;
+    void _PrimsRemoved(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries) override;
+    void _PrimsDirtied(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries) override;
+
+private:
+    // Append the prims of the subtree to dirty, returns true if one of them is a native instance
+    bool _AppendSubtreeEntries(const pxr::SdfPath &path, pxr::HdSceneIndexObserver::DirtiedPrimEntries *entries) const;
+    void _SendSelectionsDirtied(const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries);
+
+    std::unordered_set<pxr::SdfPath, pxr::SdfPath::Hash> _paths; // Roots of the highlighted subtrees
+};
+
+} // namespace runtime
@@ -0,0 +1,376 @@
+#include "playbackCache.h"
+#include "profiler.h"
+
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usdGeom/pointBased.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/usdGeom/xformOp.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+// Index of a time on the frame grid of the playback range
+size_t _GetFrameIndex(double time, double startTime, size_t numFrames) {
+    const double index = std::round(time - startTime);
+    return index <= 0.0 ? 0 : std::min(static_cast<size_t>(index), numFrames - 1);
+}
+
+// Number of frames played from the current time before reaching a frame, the playback loops over the range
+size_t _GetPlaybackDistance(double frameTime, double currentTime, double startTime, size_t numFrames) {
+    const size_t frameIndex = _GetFrameIndex(frameTime, startTime, numFrames);
+    const size_t currentIndex = _GetFrameIndex(currentTime, startTime, numFrames);
+    return (frameIndex + numFrames - currentIndex) % numFrames;
+}
+
+// Attributes read in the frames, or which make a prim animated when they get time samples
+bool _IsChannelAttribute(const TfToken &name, bool *outIsXform) {
+    *outIsXform = name == UsdGeomTokens->xformOpOrder || UsdGeomXformOp::IsXformOp(name);
+    return *outIsXform || name == UsdGeomTokens->points;
+}
+
+} // namespace
+
+size_t PlaybackCache::_Frame::GetMemorySize() const {
+    size_t size = sizeof(_Frame) + xforms.capacity() * sizeof(GfMatrix4d) + points.capacity() * sizeof(VtVec3fArray);
+    for (const VtVec3fArray &channelPoints : points) {
+        size += channelPoints.size() * sizeof(GfVec3f);
+    }
+    return size;
+}
+
+PlaybackCache::PlaybackCache() = default;
+
+PlaybackCache::~PlaybackCache() {
+    _isCancelled = true;
+    WaitPrefetch();
+    TfNotice::Revoke(_objectsChangedKey);
+}
+
+void PlaybackCache::SetStage(const UsdStageWeakPtr &stage) {
+    Clear();
+    TfNotice::Revoke(_objectsChangedKey);
+    _stage = stage;
+    if (_stage) {
+        _objectsChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &PlaybackCache::_OnObjectsChanged, _stage);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _channels = nullptr;
+        _channelPaths.clear();
+    }
+    _mustListChannels = true;
+}
+
+void PlaybackCache::Clear() {
+    _isCancelled = true;
+    WaitPrefetch();
+    _isCancelled = false;
+    _ClearFrames();
+}
+
+void PlaybackCache::_ClearFrames() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frames.clear();
+    _memorySize = 0;
+    _generation++;
+    std::atomic_store(&_currentFrame, _FramePtr());
+}
+
+// The frames are cleared when a resync or an edit of a cached attribute makes their values wrong. The animated prims
+// are listed again under the changed paths only: authoring time samples doesn't resync, an xform op or the points of
+// a prim which was not animated can become animated without invalidating the cached frames.
+void PlaybackCache::_OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    bool mustClearFrames = false;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        _channelPaths.insert(path.GetPrimPath());
+        mustClearFrames = true;
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        bool isXform = false;
+        if (!path.IsPropertyPath() || !_IsChannelAttribute(path.GetNameToken(), &isXform)) {
+            continue;
+        }
+        const SdfPath primPath = path.GetPrimPath();
+        _channelPaths.insert(primPath);
+        if (_channels && !mustClearFrames) {
+            const auto index = _channels->indices.find(primPath);
+            if (index != _channels->indices.end()) {
+                const _Channel &channel = _channels->channels[index->second];
+                mustClearFrames = isXform ? channel.hasXform : channel.hasPoints;
+            }
+        }
+    }
+    lock.unlock();
+    if (mustClearFrames) {
+        _ClearFrames();
+    }
+}
+
+void PlaybackCache::SetTime(UsdTimeCode time) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto frame = time.IsNumeric() ? _frames.find(time.GetValue()) : _frames.end();
+    std::atomic_store(&_currentFrame, frame != _frames.end() ? frame->second : _FramePtr());
+}
+
+void PlaybackCache::Prefetch(UsdTimeCode time, size_t memoryBudget) {
+    if (!_stage || !time.IsNumeric() || memoryBudget == 0 || _isPrefetching) {
+        return;
+    }
+    _PrefetchRequest request;
+    request.currentTime = time.GetValue();
+    request.startTime = _stage->GetStartTimeCode();
+    const double endTime = _stage->GetEndTimeCode();
+    if (endTime < request.startTime) {
+        return;
+    }
+    request.numFrames = static_cast<size_t>(std::floor(endTime - request.startTime)) + 1;
+    request.memoryBudget = memoryBudget;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        request.generation = _generation;
+        // Once the budget is reached, only the frames played before the cached ones are worth reading
+        size_t window = std::min(PrefetchWindow, request.numFrames);
+        if (_memorySize >= memoryBudget) {
+            size_t farthest = 0;
+            for (const auto &frame : _frames) {
+                farthest = std::max(farthest, _GetPlaybackDistance(frame.first, request.currentTime, request.startTime,
+                                                                   request.numFrames));
+            }
+            window = std::min(window, farthest);
+        }
+        const size_t currentIndex = _GetFrameIndex(request.currentTime, request.startTime, request.numFrames);
+        for (size_t i = 0; i < window && request.times.size() < FramesPerPrefetch; ++i) {
+            const double frameTime = request.startTime + static_cast<double>((currentIndex + i) % request.numFrames);
+            if (_frames.find(frameTime) == _frames.end()) {
+                request.times.push_back(frameTime);
+            }
+        }
+    }
+    if (request.times.empty()) {
+        return;
+    }
+    _isPrefetching = true;
+    _dispatcher.Run([this, request]() { _PrefetchFrames(request); });
+}
+
+void PlaybackCache::WaitPrefetch() {
+    if (_isPrefetching) {
+        RUNTIME_PROFILE_SCOPE("Wait playback prefetch");
+        _dispatcher.Wait();
+    }
+}
+
+// Worker thread
+void PlaybackCache::_PrefetchFrames(const _PrefetchRequest &request) {
+    RUNTIME_PROFILE_SCOPE("Playback prefetch");
+    _ChannelsPtr channels;
+    SdfPathSet channelPaths;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        channels = _channels;
+        channelPaths.swap(_channelPaths);
+    }
+    if (_mustListChannels.exchange(false) || !channels) {
+        _ListChannels();
+    } else if (!channelPaths.empty()) {
+        _ListChannels(channelPaths);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        channels = _channels;
+    }
+    std::vector<std::pair<double, _FramePtr>> frames;
+    // The frames of a stage without animation are empty, they are still stored to stop the prefetch
+    if (channels) {
+        for (const double time : request.times) {
+            _FramePtr frame = _ReadFrame(channels, time);
+            if (!frame) {
+                break; // Cancelled
+            }
+            frames.emplace_back(time, std::move(frame));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The frames read while the stage was changing are discarded
+        if (_generation == request.generation && !_isCancelled) {
+            for (auto &frame : frames) {
+                _memorySize += frame.second->GetMemorySize();
+                _frames[frame.first] = std::move(frame.second);
+            }
+            // Evict the frames played last
+            while (_memorySize > request.memoryBudget && !_frames.empty()) {
+                const auto farthest = std::max_element(_frames.begin(), _frames.end(), [&](const auto &a, const auto &b) {
+                    return _GetPlaybackDistance(a.first, request.currentTime, request.startTime, request.numFrames) <
+                           _GetPlaybackDistance(b.first, request.currentTime, request.startTime, request.numFrames);
+                });
+                _memorySize -= farthest->second->GetMemorySize();
+                _frames.erase(farthest);
+            }
+        }
+    }
+    _isPrefetching = false;
+}
+
+// Worker thread, lists the animated prims of the whole stage
+void PlaybackCache::_ListChannels() {
+    RUNTIME_PROFILE_SCOPE("Playback cache channels");
+    auto channels = std::make_shared<_Channels>();
+    if (_stage && !_AppendChannels(_stage->GetPseudoRoot(), channels.get())) {
+        _mustListChannels = true;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _channels = channels;
+}
+
+// Worker thread, lists again the animated prims under the changed paths, the others are kept
+void PlaybackCache::_ListChannels(const SdfPathSet &paths) {
+    RUNTIME_PROFILE_SCOPE("Playback cache channels");
+    _ChannelsPtr previous;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        previous = _channels;
+    }
+    // The set is sorted, the descendants of a path follow it and are covered by its traversal
+    SdfPathVector roots;
+    for (const SdfPath &path : paths) {
+        if (roots.empty() || !path.HasPrefix(roots.back())) {
+            roots.push_back(path);
+        }
+    }
+    const auto isUnderRoots = [&roots](const SdfPath &path) {
+        auto it = std::upper_bound(roots.begin(), roots.end(), path);
+        return it != roots.begin() && path.HasPrefix(*std::prev(it));
+    };
+    auto channels = std::make_shared<_Channels>();
+    if (previous) {
+        for (const _Channel &channel : previous->channels) {
+            if (!isUnderRoots(channel.primPath)) {
+                channels->indices[channel.primPath] = channels->channels.size();
+                channels->channels.push_back(channel);
+            }
+        }
+    }
+    for (const SdfPath &root : roots) {
+        const UsdPrim prim = _stage ? _stage->GetPrimAtPath(root) : UsdPrim();
+        if (prim && !_AppendChannels(prim, channels.get())) {
+            _mustListChannels = true;
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _channels = channels;
+}
+
+// Worker thread, returns false when cancelled
+bool PlaybackCache::_AppendChannels(const UsdPrim &root, _Channels *channels) const {
+    for (const UsdPrim &prim : UsdPrimRange(root)) {
+        if (_isCancelled) {
+            return false;
+        }
+        _Channel channel;
+        if (prim.IsA<UsdGeomXformable>()) {
+            channel.xformQuery = UsdGeomXformable::XformQuery(UsdGeomXformable(prim));
+            channel.hasXform = channel.xformQuery.TransformMightBeTimeVarying();
+        }
+        if (prim.IsA<UsdGeomPointBased>()) {
+            const UsdAttribute pointsAttr = UsdGeomPointBased(prim).GetPointsAttr();
+            channel.hasPoints = pointsAttr.ValueMightBeTimeVarying();
+            if (channel.hasPoints) {
+                channel.pointsQuery = UsdAttributeQuery(pointsAttr);
+            }
+        }
+        if (channel.hasXform || channel.hasPoints) {
+            channel.primPath = prim.GetPath();
+            channels->indices[channel.primPath] = channels->channels.size();
+            channels->channels.push_back(std::move(channel));
+        }
+    }
+    return true;
+}
+
+// Worker thread, the prims are read in parallel
+PlaybackCache::_FramePtr PlaybackCache::_ReadFrame(const _ChannelsPtr &channels, double time) const {
+    RUNTIME_PROFILE_SCOPE("Playback cache frame");
+    const size_t numChannels = channels->channels.size();
+    auto frame = std::make_shared<_Frame>();
+    frame->channels = channels;
+    frame->xforms.resize(numChannels, GfMatrix4d(1.0));
+    frame->points.resize(numChannels);
+    WorkParallelForN(numChannels, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && !_isCancelled; ++i) {
+            const _Channel &channel = channels->channels[i];
+            if (channel.hasXform) {
+                channel.xformQuery.GetLocalTransformation(&frame->xforms[i], UsdTimeCode(time));
+            }
+            if (channel.hasPoints) {
+                channel.pointsQuery.Get(&frame->points[i], UsdTimeCode(time));
+            }
+        }
+    });
+    if (_isCancelled) {
+        return nullptr;
+    }
+    return frame;
+}
+
+bool PlaybackCache::IsCached(const SdfPath &primPath, bool *outHasXform, bool *outHasPoints) const {
+    const _FramePtr frame = _GetCurrentFrame();
+    if (!frame) {
+        return false;
+    }
+    const auto index = frame->channels->indices.find(primPath);
+    if (index == frame->channels->indices.end()) {
+        return false;
+    }
+    *outHasXform = frame->channels->channels[index->second].hasXform;
+    *outHasPoints = frame->channels->channels[index->second].hasPoints;
+    return true;
+}
+
+bool PlaybackCache::GetXform(const SdfPath &primPath, GfMatrix4d *outMatrix) const {
+    const _FramePtr frame = _GetCurrentFrame();
+    if (!frame) {
+        return false;
+    }
+    const auto index = frame->channels->indices.find(primPath);
+    if (index == frame->channels->indices.end() || !frame->channels->channels[index->second].hasXform) {
+        return false;
+    }
+    *outMatrix = frame->xforms[index->second];
+    return true;
+}
+
+bool PlaybackCache::GetPoints(const SdfPath &primPath, VtValue *outPoints) const {
+    const _FramePtr frame = _GetCurrentFrame();
+    if (!frame) {
+        return false;
+    }
+    const auto index = frame->channels->indices.find(primPath);
+    if (index == frame->channels->indices.end() || !frame->channels->channels[index->second].hasPoints) {
+        return false;
+    }
+    // The array is shared, it is not copied
+    *outPoints = VtValue(frame->points[index->second]);
+    return true;
+}
+
+size_t PlaybackCache::GetNumFrames() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frames.size();
+}
+
+size_t PlaybackCache::GetMemorySize() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _memorySize;
+}
+
+} // namespace runtime
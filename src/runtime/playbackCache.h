@@ -0,0 +1,146 @@
+#pragma once
+
+#include "pxr/pxr.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/tf/notice.h"
+#include "pxr/base/tf/weakBase.h"
+#include "pxr/base/vt/types.h"
+#include "pxr/base/vt/value.h"
+#include "pxr/base/work/dispatcher.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/usd/usd/attributeQuery.h"
+#include "pxr/usd/usd/notice.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/usdGeom/xformable.h"
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace runtime {
+
+/// \class PlaybackCache
+///
+/// Cache of the animated transforms and points of a stage, at the frames of the playback.
+///
+/// The animated prims are listed once, then the frames ahead of the playhead are read on worker threads in a
+/// sliding window. Each frame stores one matrix and one points array per prim. When the time is set on a cached frame, PlaybackCacheSceneIndex serves the values from memory instead of
+/// resolving them with Usd, so looping and scrubbing over the cached frames doesn't read the stage.
+///
+/// The frames are on the frame grid of the stage, starting at its start time code. When the memory budget is reached,
+/// the frames the playhead will reach last are evicted. The frames are cleared when prims are resynced or when a cached
+/// attribute changes, and only the animated prims under the changed paths are listed again. The other changes, like
+/// metadata or attributes which are not cached, keep the frames.
+///
+/// The prefetch reads the stage while the main thread draws the widgets: WaitPrefetch must be called before the stage
+/// is modified and before hydra syncs the prims.
+class PlaybackCache : public pxr::TfWeakBase {
+public:
+    PlaybackCache();
+    ~PlaybackCache();
+
+    PlaybackCache(const PlaybackCache &) = delete;
+    PlaybackCache &operator=(const PlaybackCache &) = delete;
+
+    /// Clear the cache and list the animated prims of \p stage at the next prefetch
+    void SetStage(const pxr::UsdStageWeakPtr &stage);
+
+    /// Select the cached frame of \p time used by the lookups, if any
+    void SetTime(pxr::UsdTimeCode time);
+
+    /// Start reading the next missing frames after \p time on the worker threads, returns immediately.
+    /// Does nothing if the previous prefetch is still running.
+    void Prefetch(pxr::UsdTimeCode time, size_t memoryBudget);
+
+    /// Wait for the running prefetch
+    void WaitPrefetch();
+
+    void Clear();
+
+    /// Values of the current frame, false if the prim is not animated or the frame is not cached.
+    /// Safe to call from the hydra sync threads.
+    bool IsCached(const pxr::SdfPath &primPath, bool *outHasXform, bool *outHasPoints) const;
+    bool GetXform(const pxr::SdfPath &primPath, pxr::GfMatrix4d *outMatrix) const;
+    bool GetPoints(const pxr::SdfPath &primPath, pxr::VtValue *outPoints) const;
+
+    size_t GetNumFrames() const;
+    size_t GetMemorySize() const;
+
+    /// Number of frames in the window read ahead of the playhead
+    static constexpr size_t PrefetchWindow = 120;
+    /// Frames read by each prefetch, in parallel over the prims
+    static constexpr size_t FramesPerPrefetch = 2;
+
+private:
+    struct _Channel {
+        pxr::SdfPath primPath;
+        pxr::UsdGeomXformable::XformQuery xformQuery;
+        pxr::UsdAttributeQuery pointsQuery;
+        bool hasXform = false;
+        bool hasPoints = false;
+    };
+
+    // Animated prims, never modified once listed, the frames keep the list they were read with
+    struct _Channels {
+        std::vector<_Channel> channels;
+        std::unordered_map<pxr::SdfPath, size_t, pxr::SdfPath::Hash> indices;
+    };
+    using _ChannelsPtr = std::shared_ptr<const _Channels>;
+
+    struct _Frame {
+        _ChannelsPtr channels;
+        std::vector<pxr::GfMatrix4d> xforms;  // By channel
+        std::vector<pxr::VtVec3fArray> points; // By channel, shared with the prims pulling them
+
+        size_t GetMemorySize() const;
+    };
+    using _FramePtr = std::shared_ptr<const _Frame>;
+
+    // Frames to read, with the playback range used to evict the frames over the budget
+    struct _PrefetchRequest {
+        std::vector<double> times;
+        double currentTime = 0.0;
+        double startTime = 0.0;
+        size_t numFrames = 0;
+        size_t memoryBudget = 0;
+        size_t generation = 0;
+    };
+
+    void _OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender);
+    void _ClearFrames();
+    void _ListChannels();
+    void _ListChannels(const pxr::SdfPathSet &paths);
+    bool _AppendChannels(const pxr::UsdPrim &root, _Channels *channels) const;
+    void _PrefetchFrames(const _PrefetchRequest &request);
+    _FramePtr _ReadFrame(const _ChannelsPtr &channels, double time) const;
+
+    pxr::UsdStageWeakPtr _stage;
+    pxr::TfNotice::Key _objectsChangedKey;
+    std::atomic<bool> _mustListChannels{true};
+
+    // Protected by _mutex
+    mutable std::mutex _mutex;
+    _ChannelsPtr _channels;        // Written by the prefetch, read by the notices
+    pxr::SdfPathSet _channelPaths; // Subtrees to list again at the next prefetch
+    std::map<double, _FramePtr> _frames;
+    size_t _memorySize = 0;
+    size_t _generation = 0; // Incremented when the frames are cleared, the running prefetch discards its frames
+
+    // Frame of the current time, read by the hydra sync threads. It is set on the main thread before hydra syncs the
+    // prims and cleared by the notices, the pointer is loaded and stored atomically.
+    _FramePtr _currentFrame;
+    _FramePtr _GetCurrentFrame() const { return std::atomic_load(&_currentFrame); }
+
+    pxr::WorkDispatcher _dispatcher;
+    std::atomic<bool> _isPrefetching{false};
+    std::atomic<bool> _isCancelled{false};
+};
+
+} // namespace runtime
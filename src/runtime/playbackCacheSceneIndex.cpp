@@ -0,0 +1,145 @@
+#include "playbackCacheSceneIndex.h"
+
+#include "pxr/imaging/hd/overlayContainerDataSource.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/imaging/hd/xformSchema.h"
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+// Matrix of the current frame of the cache, or of the input data source
+class _CachedMatrixDataSource : public HdMatrixDataSource {
+public:
+    HD_DECLARE_DATASOURCE(_CachedMatrixDataSource);
+
+    VtValue GetValue(Time shutterOffset) override { return VtValue(GetTypedValue(shutterOffset)); }
+
+    GfMatrix4d GetTypedValue(Time shutterOffset) override {
+        GfMatrix4d matrix(1.0);
+        if (shutterOffset == 0.f && _playbackCache->GetXform(_primPath, &matrix)) {
+            return matrix;
+        }
+        return _input ? _input->GetTypedValue(shutterOffset) : matrix;
+    }
+
+    bool GetContributingSampleTimesForInterval(Time startTime, Time endTime,
+                                               std::vector<Time> *outSampleTimes) override {
+        return _input && _input->GetContributingSampleTimesForInterval(startTime, endTime, outSampleTimes);
+    }
+
+private:
+    _CachedMatrixDataSource(const HdMatrixDataSourceHandle &input, const std::shared_ptr<PlaybackCache> &playbackCache,
+                            const SdfPath &primPath)
+        : _input(input), _playbackCache(playbackCache), _primPath(primPath) {}
+
+    HdMatrixDataSourceHandle _input;
+    std::shared_ptr<PlaybackCache> _playbackCache;
+    SdfPath _primPath;
+};
+
+// Points of the current frame of the cache, or of the input data source
+class _CachedPointsDataSource : public HdSampledDataSource {
+public:
+    HD_DECLARE_DATASOURCE(_CachedPointsDataSource);
+
+    VtValue GetValue(Time shutterOffset) override {
+        VtValue points;
+        if (shutterOffset == 0.f && _playbackCache->GetPoints(_primPath, &points)) {
+            return points;
+        }
+        return _input ? _input->GetValue(shutterOffset) : VtValue();
+    }
+
+    bool GetContributingSampleTimesForInterval(Time startTime, Time endTime,
+                                               std::vector<Time> *outSampleTimes) override {
+        return _input && _input->GetContributingSampleTimesForInterval(startTime, endTime, outSampleTimes);
+    }
+
+private:
+    _CachedPointsDataSource(const HdSampledDataSourceHandle &input, const std::shared_ptr<PlaybackCache> &playbackCache,
+                            const SdfPath &primPath)
+        : _input(input), _playbackCache(playbackCache), _primPath(primPath) {}
+
+    HdSampledDataSourceHandle _input;
+    std::shared_ptr<PlaybackCache> _playbackCache;
+    SdfPath _primPath;
+};
+
+} // namespace
+
+PlaybackCacheSceneIndexRefPtr PlaybackCacheSceneIndex::New(const HdSceneIndexBaseRefPtr &inputSceneIndex,
+                                                           const std::shared_ptr<PlaybackCache> &playbackCache) {
+    return TfCreateRefPtr(new PlaybackCacheSceneIndex(inputSceneIndex, playbackCache));
+}
+
+PlaybackCacheSceneIndex::PlaybackCacheSceneIndex(const HdSceneIndexBaseRefPtr &inputSceneIndex,
+                                                 const std::shared_ptr<PlaybackCache> &playbackCache)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex), _playbackCache(playbackCache) {}
+
+// The values are only wrapped when the prim is animated and its frame is cached, the others are returned as is
+HdSceneIndexPrim PlaybackCacheSceneIndex::GetPrim(const SdfPath &primPath) const {
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+    if (!prim.dataSource) {
+        return prim;
+    }
+    bool hasXform = false;
+    bool hasPoints = false;
+    if (!_playbackCache->IsCached(primPath, &hasXform, &hasPoints)) {
+        return prim;
+    }
+
+    std::vector<TfToken> names;
+    std::vector<HdDataSourceBaseHandle> values;
+    if (hasXform) {
+        const HdMatrixDataSourceHandle input = HdXformSchema::GetFromParent(prim.dataSource).GetMatrix();
+        names.push_back(HdXformSchemaTokens->xform);
+        values.push_back(HdRetainedContainerDataSource::New(
+                HdXformSchemaTokens->matrix, _CachedMatrixDataSource::New(input, _playbackCache, primPath)));
+    }
+    if (hasPoints) {
+        const HdPrimvarSchema pointsPrimvar =
+                HdPrimvarsSchema::GetFromParent(prim.dataSource).GetPrimvar(HdTokens->points);
+        std::vector<TfToken> valueNames = {HdPrimvarSchemaTokens->primvarValue};
+        std::vector<HdDataSourceBaseHandle> valueSources = {
+                _CachedPointsDataSource::New(pointsPrimvar.GetPrimvarValue(), _playbackCache, primPath)};
+        // The indexed value is read first when there is one, the points are never indexed
+        if (const HdSampledDataSourceHandle indexedValue = pointsPrimvar.GetIndexedPrimvarValue()) {
+            valueNames.push_back(HdPrimvarSchemaTokens->indexedPrimvarValue);
+            valueSources.push_back(_CachedPointsDataSource::New(indexedValue, _playbackCache, primPath));
+        }
+        names.push_back(HdPrimvarsSchemaTokens->primvars);
+        values.push_back(HdRetainedContainerDataSource::New(
+                HdTokens->points,
+                HdRetainedContainerDataSource::New(valueNames.size(), valueNames.data(), valueSources.data())));
+    }
+    prim.dataSource = HdOverlayContainerDataSource::New(
+            HdRetainedContainerDataSource::New(names.size(), names.data(), values.data()), prim.dataSource);
+    return prim;
+}
+
+SdfPathVector PlaybackCacheSceneIndex::GetChildPrimPaths(const SdfPath &primPath) const {
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+void PlaybackCacheSceneIndex::_PrimsAdded(const HdSceneIndexBase &sender,
+                                          const HdSceneIndexObserver::AddedPrimEntries &entries) {
+    _SendPrimsAdded(entries);
+}
+
+void PlaybackCacheSceneIndex::_PrimsRemoved(const HdSceneIndexBase &sender,
+                                            const HdSceneIndexObserver::RemovedPrimEntries &entries) {
+    _SendPrimsRemoved(entries);
+}
+
+void PlaybackCacheSceneIndex::_PrimsDirtied(const HdSceneIndexBase &sender,
+                                            const HdSceneIndexObserver::DirtiedPrimEntries &entries) {
+    _SendPrimsDirtied(entries);
+}
+
+} // namespace runtime
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "playbackCache.h"
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <memory>
+
+namespace runtime {
+
+class PlaybackCacheSceneIndex;
+using PlaybackCacheSceneIndexRefPtr = pxr::TfRefPtr<PlaybackCacheSceneIndex>;
+
+/// \class PlaybackCacheSceneIndex
+///
+/// Filtering scene index reading the animated transforms and points from a PlaybackCache.
+///
+/// The xform matrix and the points primvar of the animated prims are wrapped in data sources returning the values
+/// of the current frame of the cache. When the frame is not cached, or for the motion blur samples, the values are
+/// read from the input scene index. The dirty notices of the input are forwarded as is: the stage scene index
+/// already dirties the animated prims when the time changes.
+class PlaybackCacheSceneIndex : public pxr::HdSingleInputFilteringSceneIndexBase {
+public:
+    static PlaybackCacheSceneIndexRefPtr New(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex,
+                                             const std::shared_ptr<PlaybackCache> &playbackCache);
+
+    pxr::HdSceneIndexPrim GetPrim(const pxr::SdfPath &primPath) const override;
+    pxr::SdfPathVector GetChildPrimPaths(const pxr::SdfPath &primPath) const override;
+
+protected:
+    PlaybackCacheSceneIndex(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex,
+                            const std::shared_ptr<PlaybackCache> &playbackCache);
+
+    void _PrimsAdded(const pxr::HdSceneIndexBase &sender,
+                     const pxr::HdSceneIndexObserver::AddedPrimEntries &entries) override;
+    void _PrimsRemoved(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries) override;
+    void _PrimsDirtied(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries) override;
+
+private:
+    std::shared_ptr<PlaybackCache> _playbackCache;
+};
+
+} // namespace runtime
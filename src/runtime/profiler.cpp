@@ -0,0 +1,121 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace runtime {
+
+namespace {
+
+thread_local uint32_t _scopeDepth = 0;
+
+int64_t _SteadyClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void _WriteJsonString(std::ostream &out, const char *str) {
+    out << '"';
+    for (const char *c = str; c && *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+            out << escaped;
+        } else {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+Profiler &Profiler::GetInstance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : _slots(_capacity), _originNs(_SteadyClockNs()) {}
+
+uint64_t Profiler::GetTimeNs() const { return static_cast<uint64_t>(_SteadyClockNs() - _originNs); }
+
+uint32_t Profiler::GetThreadIndex() {
+    static std::atomic<uint32_t> threadCount{0};
+    thread_local const uint32_t threadIndex = threadCount.fetch_add(1, std::memory_order_relaxed);
+    return threadIndex;
+}
+
+void Profiler::Record(const char *name, uint64_t startNs, uint64_t endNs, uint64_t frame, uint32_t depth) {
+    const uint64_t index = _writeIndex.fetch_add(1, std::memory_order_relaxed);
+    _Slot &slot = _slots[index & (_capacity - 1)];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event.name = name;
+    slot.event.startNs = startNs;
+    slot.event.endNs = endNs;
+    slot.event.frame = frame;
+    slot.event.threadIndex = GetThreadIndex();
+    slot.event.depth = depth;
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+std::vector<Profiler::Event> Profiler::GetEvents() const {
+    const uint64_t end = _writeIndex.load(std::memory_order_acquire);
+    const uint64_t begin = end > _capacity ? end - _capacity : 0;
+    std::vector<Event> events;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t index = begin; index < end; ++index) {
+        const _Slot &slot = _slots[index & (_capacity - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            continue; // Being written, or already overwritten by a newer event
+        }
+        const Event event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+bool Profiler::WriteChromeTrace(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const Event &event : GetEvents()) {
+        out << (first ? "" : ",\n") << "{\"name\":";
+        _WriteJsonString(out, event.name);
+        out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadIndex << ",\"ts\":" << event.startNs / 1000.0
+            << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << ",\"args\":{\"frame\":" << event.frame << "}}";
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(out);
+}
+
+ProfileScope::ProfileScope(const char *name) : _name(name) {
+    Profiler &profiler = Profiler::GetInstance();
+    _enabled = profiler.IsEnabled();
+    if (_enabled) {
+        _startNs = profiler.GetTimeNs();
+        _frame = profiler.GetFrame();
+        _scopeDepth++;
+    }
+}
+
+ProfileScope::~ProfileScope() {
+    if (_enabled) {
+        _scopeDepth--;
+        Profiler &profiler = Profiler::GetInstance();
+        profiler.Record(_name, _startNs, profiler.GetTimeNs(), _frame, _scopeDepth);
+    }
+}
+
+} // namespace runtime
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+/// \class Profiler
+///
+/// Frame time profiler recording the begin and end of named scopes in a fixed size ring buffer.
+///
+/// Recording is lock free: each scope reserves a slot with an atomic increment and publishes it with
+/// a sequence number, so the main thread, the simulation thread and the workers can record at the same
+/// time. The oldest events are overwritten, and the reader skips the slots being written.
+/// The scope names must be string literals, only their pointer is stored.
+class Profiler {
+public:
+    struct Event {
+        const char *name = nullptr;
+        uint64_t startNs = 0; ///< Nanoseconds since the profiler creation
+        uint64_t endNs = 0;
+        uint64_t frame = 0;   ///< Frame during which the scope started
+        uint32_t threadIndex = 0;
+        uint32_t depth = 0;   ///< Number of enclosing scopes on the same thread
+    };
+
+    static Profiler &GetInstance();
+
+    void SetEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    /// Start a new frame, the following events are tagged with its number
+    void BeginFrame() { _frame.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t GetFrame() const { return _frame.load(std::memory_order_relaxed); }
+
+    uint64_t GetTimeNs() const;
+
+    /// Record a scope, \p frame is the frame number when the scope started
+    void Record(const char *name, uint64_t startNs, uint64_t endNs, uint64_t frame, uint32_t depth);
+
+    /// Copy of the events currently in the ring buffer, ordered from the oldest
+    std::vector<Event> GetEvents() const;
+
+    /// Write the events in the chrome trace event format, readable by chrome://tracing or Perfetto
+    bool WriteChromeTrace(const std::string &path) const;
+
+    /// Index of the calling thread in the recorded events
+    static uint32_t GetThreadIndex();
+
+private:
+    Profiler();
+
+    static constexpr size_t _capacity = 1 << 15;
+
+    struct _Slot {
+        std::atomic<uint64_t> sequence{0}; // 2 * index + 1 while writing, 2 * index + 2 when published
+        Event event;
+    };
+
+    std::vector<_Slot> _slots;
+    std::atomic<uint64_t> _writeIndex{0};
+    std::atomic<uint64_t> _frame{0};
+    std::atomic<bool> _enabled{true};
+    int64_t _originNs = 0;
+};
+
+/// Records the duration of the enclosing scope
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *_name;
+    uint64_t _startNs = 0;
+    uint64_t _frame = 0;
+    bool _enabled = false;
+};
+
+} // namespace runtime
+
+#define RUNTIME_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RUNTIME_PROFILE_CONCAT(a, b) RUNTIME_PROFILE_CONCAT_IMPL(a, b)
+
+/// Profile the enclosing scope, the name must be a string literal
+#define RUNTIME_PROFILE_SCOPE(name) ::runtime::ProfileScope RUNTIME_PROFILE_CONCAT(_profileScope, __LINE__)(name)
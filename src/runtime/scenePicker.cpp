@@ -0,0 +1,588 @@
+#include "scenePicker.h"
+#include "profiler.h"
+
+#include "pxr/base/gf/bbox3d.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usdGeom/gprim.h"
+#include "pxr/usd/usdGeom/imageable.h"
+#include "pxr/usd/usdGeom/mesh.h"
+#include "pxr/usd/usdGeom/pointInstancer.h"
+#include "pxr/usd/usdGeom/tokens.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+constexpr uint32_t _maxPrimitivesPerLeaf = 4;
+
+bool _IsPickableLeaf(const UsdPrim &prim) { return prim.IsA<UsdGeomGprim>() || prim.IsA<UsdGeomPointInstancer>(); }
+
+// Fan triangulation of the faces of a mesh in world space, returns false if the mesh has too many triangles
+bool _TriangulateMesh(const UsdGeomMesh &mesh, UsdTimeCode timeCode, const GfMatrix4d &localToWorld, size_t maxTriangles,
+                      std::vector<GfVec3f> &worldPoints, std::vector<uint32_t> &triangles) {
+    VtVec3fArray points;
+    VtIntArray faceVertexCounts;
+    VtIntArray faceVertexIndices;
+    mesh.GetPointsAttr().Get(&points, timeCode);
+    mesh.GetFaceVertexCountsAttr().Get(&faceVertexCounts, timeCode);
+    mesh.GetFaceVertexIndicesAttr().Get(&faceVertexIndices, timeCode);
+
+    size_t numTriangles = 0;
+    for (const int count : faceVertexCounts) {
+        numTriangles += count > 2 ? count - 2 : 0;
+    }
+    if (numTriangles == 0 || numTriangles > maxTriangles) {
+        return false;
+    }
+
+    worldPoints.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        worldPoints[i] = GfVec3f(localToWorld.Transform(GfVec3d(points[i])));
+    }
+
+    triangles.reserve(numTriangles * 3);
+    size_t faceStart = 0;
+    for (const int count : faceVertexCounts) {
+        if (count < 0 || faceStart + count > faceVertexIndices.size()) {
+            break; // Invalid topology, keep the faces read so far
+        }
+        for (int corner = 2; corner < count; ++corner) {
+            const int i0 = faceVertexIndices[faceStart];
+            const int i1 = faceVertexIndices[faceStart + corner - 1];
+            const int i2 = faceVertexIndices[faceStart + corner];
+            if (i0 < 0 || i1 < 0 || i2 < 0 || size_t(i0) >= worldPoints.size() || size_t(i1) >= worldPoints.size() ||
+                size_t(i2) >= worldPoints.size()) {
+                continue;
+            }
+            triangles.push_back(static_cast<uint32_t>(i0));
+            triangles.push_back(static_cast<uint32_t>(i1));
+            triangles.push_back(static_cast<uint32_t>(i2));
+        }
+        faceStart += count;
+    }
+    return !triangles.empty();
+}
+
+GfRange3d _TriangleRange(const std::vector<GfVec3f> &points, const uint32_t *triangle) {
+    GfRange3d range(GfVec3d(points[triangle[0]]), GfVec3d(points[triangle[0]]));
+    range.UnionWith(GfVec3d(points[triangle[1]]));
+    range.UnionWith(GfVec3d(points[triangle[2]]));
+    return range;
+}
+
+} // namespace
+
+void ScenePicker::_Bvh::Build(const std::vector<GfRange3d> &ranges) {
+    Clear();
+    if (ranges.empty()) {
+        return;
+    }
+    indices.resize(ranges.size());
+    std::vector<GfVec3d> centroids(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        indices[i] = static_cast<uint32_t>(i);
+        centroids[i] = ranges[i].GetMidpoint();
+    }
+
+    struct Task {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+    };
+    nodes.reserve(2 * ranges.size() / _maxPrimitivesPerLeaf + 1);
+    nodes.emplace_back();
+    std::vector<Task> tasks = {{0, 0, static_cast<uint32_t>(ranges.size())}};
+    while (!tasks.empty()) {
+        const Task task = tasks.back();
+        tasks.pop_back();
+
+        GfRange3d bounds;
+        GfRange3d centroidBounds;
+        for (uint32_t i = task.begin; i < task.end; ++i) {
+            bounds.UnionWith(ranges[indices[i]]);
+            centroidBounds.UnionWith(centroids[indices[i]]);
+        }
+        nodes[task.node].bounds = bounds;
+
+        // Median split on the largest axis of the centroids
+        const GfVec3d extent = centroidBounds.GetSize();
+        const int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+        if (task.end - task.begin <= _maxPrimitivesPerLeaf || extent[axis] <= 0.0) {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = task.end - task.begin;
+            continue;
+        }
+        const uint32_t middle = task.begin + (task.end - task.begin) / 2;
+        std::nth_element(indices.begin() + task.begin, indices.begin() + middle, indices.begin() + task.end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+        const uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        nodes.emplace_back();
+        nodes.emplace_back();
+        tasks.push_back({left, task.begin, middle});
+        tasks.push_back({left + 1, middle, task.end});
+    }
+}
+
+ScenePicker::ScenePicker() : ScenePicker(Parameters()) {}
+
+ScenePicker::ScenePicker(const Parameters &params) : _params(params), _timeCode(UsdTimeCode::Default()) {
+    if (_params.purposes.empty()) {
+        _params.purposes = {UsdGeomTokens->default_, UsdGeomTokens->proxy};
+    }
+}
+
+ScenePicker::~ScenePicker() { Reset(); }
+
+void ScenePicker::_OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        _AddPendingPath(path.GetAbsoluteRootOrPrimPath());
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        _AddPendingPath(path.GetAbsoluteRootOrPrimPath());
+    }
+}
+
+// Called with _pendingMutex locked, a path is pending once whatever the number of changes
+void ScenePicker::_AddPendingPath(const SdfPath &path) {
+    for (SdfPath ancestor = path; !ancestor.IsEmpty(); ancestor = ancestor.GetParentPath()) {
+        if (_pendingPaths.count(ancestor)) {
+            return;
+        }
+    }
+    // The descendants follow the path in the set
+    auto it = _pendingPaths.lower_bound(path);
+    while (it != _pendingPaths.end() && it->HasPrefix(path)) {
+        it = _pendingPaths.erase(it);
+    }
+    _pendingPaths.insert(path);
+}
+
+void ScenePicker::Update(const UsdStageRefPtr &stage, UsdTimeCode timeCode) {
+    if (_isUpdating) {
+        return;
+    }
+    if (get_pointer(_stage) != get_pointer(stage)) {
+        Reset();
+        _stage = stage;
+        if (!_stage) {
+            return;
+        }
+        _objectsChangedKey =
+            TfNotice::Register(TfCreateWeakPtr(this), &ScenePicker::_OnObjectsChanged, UsdStageWeakPtr(_stage));
+        _timeCode = timeCode;
+        _isUpdating = true;
+        _dispatcher.Run([this]() {
+            _Rebuild();
+            _isUpdating = false;
+        });
+        return;
+    }
+
+    SdfPathVector pendingPaths;
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        pendingPaths.assign(_pendingPaths.begin(), _pendingPaths.end());
+        _pendingPaths.clear();
+    }
+    if (timeCode == _timeCode && pendingPaths.empty()) {
+        return;
+    }
+    _isUpdating = true;
+    _dispatcher.Run([this, timeCode, pendingPaths = std::move(pendingPaths)]() mutable {
+        if (!pendingPaths.empty()) {
+            _UpdatePaths(std::move(pendingPaths));
+        }
+        if (timeCode != _timeCode) {
+            _UpdateTime(timeCode);
+        }
+        _isUpdating = false;
+    });
+}
+
+bool ScenePicker::IsReady(const UsdStageRefPtr &stage, UsdTimeCode timeCode) const {
+    if (_isUpdating || !_stage || get_pointer(_stage) != get_pointer(stage) || timeCode != _timeCode) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    return _pendingPaths.empty();
+}
+
+void ScenePicker::Wait() {
+    if (_isUpdating) {
+        RUNTIME_PROFILE_SCOPE("Wait scene picker");
+        _dispatcher.Wait();
+    }
+}
+
+void ScenePicker::Reset() {
+    Wait();
+    TfNotice::Revoke(_objectsChangedKey);
+    _stage = nullptr;
+    _timeCode = UsdTimeCode::Default();
+    _prims = std::vector<_Prim>();
+    _bvh = _Bvh();
+    _hiddenTimeVaryingPaths.clear();
+    _xformCache.Clear();
+    _bboxCache = nullptr;
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    _pendingPaths.clear();
+}
+
+bool ScenePicker::_IsPickablePurpose(const TfToken &purpose) const {
+    return std::find(_params.purposes.begin(), _params.purposes.end(), purpose) != _params.purposes.end();
+}
+
+bool ScenePicker::_MightBeTimeVarying(const UsdPrim &prim) const {
+    // The values of the prim itself, then the transforms and visibility of its ancestors
+    for (const UsdAttribute &attribute : prim.GetAuthoredAttributes()) {
+        if (attribute.ValueMightBeTimeVarying()) {
+            return true;
+        }
+    }
+    for (UsdPrim parent = prim.GetParent(); parent; parent = parent.GetParent()) {
+        const UsdGeomXformable xformable(parent);
+        if (xformable &&
+            (xformable.TransformMightBeTimeVarying() || xformable.GetVisibilityAttr().ValueMightBeTimeVarying())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Worker thread
+void ScenePicker::_Rebuild() {
+    RUNTIME_PROFILE_SCOPE("Scene picker build");
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        _pendingPaths.clear();
+    }
+    _prims.clear();
+    _bvh.Clear();
+    _hiddenTimeVaryingPaths.clear();
+    _xformCache.SetTime(_timeCode);
+    _xformCache.Clear();
+    _bboxCache = std::make_unique<UsdGeomBBoxCache>(_timeCode, _params.purposes);
+    if (!_stage) {
+        return;
+    }
+    _AppendPrims(_stage->GetPseudoRoot());
+    _ExtractTriangles(0);
+
+    std::vector<GfRange3d> ranges(_prims.size());
+    for (size_t i = 0; i < _prims.size(); ++i) {
+        ranges[i] = _prims[i].bounds;
+    }
+    _bvh.Build(ranges);
+}
+
+// Worker thread, the prims which might vary over time are traversed again
+void ScenePicker::_UpdateTime(UsdTimeCode timeCode) {
+    RUNTIME_PROFILE_SCOPE("Scene picker time");
+    _timeCode = timeCode;
+    _xformCache.SetTime(_timeCode);
+    _bboxCache->SetTime(_timeCode);
+    SdfPathVector paths = _hiddenTimeVaryingPaths;
+    for (const _Prim &prim : _prims) {
+        if (prim.mightBeTimeVarying) {
+            paths.push_back(prim.path);
+        }
+    }
+    if (!paths.empty()) {
+        std::sort(paths.begin(), paths.end());
+        _UpdatePaths(std::move(paths));
+    }
+}
+
+// Worker thread
+void ScenePicker::_UpdatePaths(SdfPathVector paths) {
+    RUNTIME_PROFILE_SCOPE("Scene picker update");
+    // The changes inside a pickable prim, like its subsets, recompute the whole prim.
+    // The prototypes are not traversed, a change in one of them can move any instance.
+    for (SdfPath &path : paths) {
+        UsdPrim prim = _stage->GetPrimAtPath(path);
+        if (prim && prim.IsInPrototype()) {
+            _Rebuild();
+            return;
+        }
+        for (UsdPrim parent = prim ? prim.GetParent() : UsdPrim(); parent; parent = parent.GetParent()) {
+            if (_IsPickableLeaf(parent)) {
+                path = parent.GetPath();
+            }
+        }
+    }
+    SdfPath::RemoveDescendentPaths(&paths);
+    if (paths.empty() || paths.front() == SdfPath::AbsoluteRootPath()) {
+        _Rebuild();
+        return;
+    }
+
+    // Remove the prims under the changed paths
+    const std::unordered_set<SdfPath, SdfPath::Hash> changedPaths(paths.begin(), paths.end());
+    const auto isChanged = [&](const SdfPath &primPath) {
+        for (SdfPath path = primPath; !path.IsEmpty(); path = path.GetParentPath()) {
+            if (changedPaths.count(path)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    _prims.erase(std::remove_if(_prims.begin(), _prims.end(), [&](const _Prim &prim) { return isChanged(prim.path); }),
+                 _prims.end());
+    _hiddenTimeVaryingPaths.erase(
+        std::remove_if(_hiddenTimeVaryingPaths.begin(), _hiddenTimeVaryingPaths.end(), isChanged),
+        _hiddenTimeVaryingPaths.end());
+
+    // Traverse them again with fresh caches, the ancestors are computed once
+    _xformCache.Clear();
+    _bboxCache->Clear();
+    const size_t firstNewPrim = _prims.size();
+    for (const SdfPath &path : paths) {
+        const UsdPrim prim = _stage->GetPrimAtPath(path);
+        if (!prim) {
+            continue; // Removed
+        }
+        const UsdGeomImageable imageable(prim.GetParent());
+        if (imageable && (imageable.ComputeVisibility(_timeCode) == UsdGeomTokens->invisible ||
+                          !_IsPickablePurpose(imageable.ComputePurpose()))) {
+            continue;
+        }
+        _AppendPrims(prim);
+    }
+    _ExtractTriangles(firstNewPrim);
+
+    std::vector<GfRange3d> ranges(_prims.size());
+    for (size_t i = 0; i < _prims.size(); ++i) {
+        ranges[i] = _prims[i].bounds;
+    }
+    _bvh.Build(ranges);
+}
+
+void ScenePicker::_AppendPrims(const UsdPrim &root) {
+    UsdPrimRange range(root, UsdTraverseInstanceProxies());
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        const UsdGeomImageable imageable(*it);
+        if (imageable) {
+            TfToken visibility;
+            imageable.GetVisibilityAttr().Get(&visibility, _timeCode);
+            TfToken purpose;
+            if (visibility == UsdGeomTokens->invisible ||
+                (imageable.GetPurposeAttr().Get(&purpose) && !_IsPickablePurpose(purpose))) {
+                if (imageable.GetVisibilityAttr().ValueMightBeTimeVarying()) {
+                    _hiddenTimeVaryingPaths.push_back(it->GetPath());
+                }
+                it.PruneChildren();
+                continue;
+            }
+        }
+        if (_IsPickableLeaf(*it)) {
+            const GfRange3d bounds = _bboxCache->ComputeWorldBound(*it).ComputeAlignedRange();
+            if (!bounds.IsEmpty()) {
+                _Prim prim;
+                prim.path = it->GetPath();
+                prim.bounds = bounds;
+                prim.mightBeTimeVarying = _MightBeTimeVarying(*it);
+                _prims.emplace_back(std::move(prim));
+            }
+            it.PruneChildren();
+        }
+    }
+}
+
+void ScenePicker::_ExtractTriangles(size_t firstPrim) {
+    if (!_params.pickTriangles || firstPrim >= _prims.size()) {
+        return;
+    }
+    // The transforms are computed first as the cache is not thread safe, the meshes are read in parallel
+    std::vector<std::pair<size_t, GfMatrix4d>> meshes;
+    for (size_t i = firstPrim; i < _prims.size(); ++i) {
+        const UsdPrim prim = _stage->GetPrimAtPath(_prims[i].path);
+        if (prim.IsA<UsdGeomMesh>()) {
+            meshes.emplace_back(i, _xformCache.GetLocalToWorldTransform(prim));
+        }
+    }
+    WorkParallelForN(meshes.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            _Prim &prim = _prims[meshes[i].first];
+            const UsdGeomMesh mesh(_stage->GetPrimAtPath(prim.path));
+            if (!_TriangulateMesh(mesh, _timeCode, meshes[i].second, _params.maxTrianglesPerMesh, prim.points,
+                                  prim.triangles)) {
+                prim.points = std::vector<GfVec3f>();
+                prim.triangles = std::vector<uint32_t>();
+                continue;
+            }
+            std::vector<GfRange3d> ranges(prim.triangles.size() / 3);
+            for (size_t triangle = 0; triangle < ranges.size(); ++triangle) {
+                ranges[triangle] = _TriangleRange(prim.points, &prim.triangles[3 * triangle]);
+            }
+            prim.bvh.Build(ranges);
+        }
+    });
+}
+
+bool ScenePicker::_IntersectPrim(const _Prim &prim, const GfRay &ray, double maxDistance, Hit *outHit) const {
+    if (prim.triangles.empty()) {
+        double enter = 0.0;
+        double exit = 0.0;
+        if (!ray.Intersect(prim.bounds, &enter, &exit)) {
+            return false;
+        }
+        enter = std::max(0.0, enter);
+        if (enter > maxDistance) {
+            return false;
+        }
+        outHit->distance = enter;
+        outHit->point = ray.GetPoint(enter);
+        outHit->normal = -ray.GetDirection().GetNormalized();
+        return true;
+    }
+
+    bool hit = false;
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const _Bvh::Node &node = prim.bvh.nodes[stack.back()];
+        stack.pop_back();
+        double enter = 0.0;
+        double exit = 0.0;
+        if (!ray.Intersect(node.bounds, &enter, &exit) || enter > maxDistance) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const uint32_t *triangle = &prim.triangles[3 * prim.bvh.indices[i]];
+            const GfVec3d points[3] = {GfVec3d(prim.points[triangle[0]]), GfVec3d(prim.points[triangle[1]]),
+                                       GfVec3d(prim.points[triangle[2]])};
+            double distance = 0.0;
+            if (ray.Intersect(points[0], points[1], points[2], &distance, nullptr, nullptr, maxDistance)) {
+                maxDistance = distance;
+                GfVec3d normal = GfCross(points[1] - points[0], points[2] - points[0]).GetNormalized();
+                outHit->distance = distance;
+                outHit->point = ray.GetPoint(distance);
+                outHit->normal = GfDot(normal, ray.GetDirection()) > 0.0 ? -normal : normal;
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+bool ScenePicker::_IntersectPrim(const _Prim &prim, const GfFrustum &frustum) const {
+    if (prim.triangles.empty()) {
+        return true; // The bounds were already tested
+    }
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const _Bvh::Node &node = prim.bvh.nodes[stack.back()];
+        stack.pop_back();
+        if (!frustum.Intersects(GfBBox3d(node.bounds))) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const uint32_t *triangle = &prim.triangles[3 * prim.bvh.indices[i]];
+            if (frustum.Intersects(GfVec3d(prim.points[triangle[0]]), GfVec3d(prim.points[triangle[1]]),
+                                   GfVec3d(prim.points[triangle[2]]))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool ScenePicker::IntersectRay(const GfRay &ray, Hit *outHit) const {
+    RUNTIME_PROFILE_SCOPE("Scene picker ray");
+    if (_isUpdating || _bvh.nodes.empty() || !outHit) {
+        return false;
+    }
+    const _Prim *closest = nullptr;
+    Hit closestHit;
+    closestHit.distance = std::numeric_limits<double>::infinity();
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const _Bvh::Node &node = _bvh.nodes[stack.back()];
+        stack.pop_back();
+        double enter = 0.0;
+        double exit = 0.0;
+        if (!ray.Intersect(node.bounds, &enter, &exit) || enter > closestHit.distance) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const _Prim &prim = _prims[_bvh.indices[i]];
+            Hit hit;
+            if (_IntersectPrim(prim, ray, closestHit.distance, &hit) &&
+                (hit.distance < closestHit.distance ||
+                 (hit.distance == closestHit.distance && closest && prim.path < closest->path))) {
+                closest = &prim;
+                closestHit = hit;
+            }
+        }
+    }
+    if (!closest) {
+        return false;
+    }
+    closestHit.primPath = closest->path;
+    *outHit = closestHit;
+    return true;
+}
+
+bool ScenePicker::IntersectFrustum(const GfFrustum &frustum, SdfPathVector *outPrimPaths) const {
+    RUNTIME_PROFILE_SCOPE("Scene picker frustum");
+    if (_isUpdating || _bvh.nodes.empty() || !outPrimPaths) {
+        return false;
+    }
+    const size_t firstResult = outPrimPaths->size();
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const _Bvh::Node &node = _bvh.nodes[stack.back()];
+        stack.pop_back();
+        if (!frustum.Intersects(GfBBox3d(node.bounds))) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const _Prim &prim = _prims[_bvh.indices[i]];
+            if (frustum.Intersects(GfBBox3d(prim.bounds)) && _IntersectPrim(prim, frustum)) {
+                outPrimPaths->push_back(prim.path);
+            }
+        }
+    }
+    std::sort(outPrimPaths->begin() + firstResult, outPrimPaths->end());
+    return outPrimPaths->size() > firstResult;
+}
+
+size_t ScenePicker::GetNumTriangles() const {
+    size_t numTriangles = 0;
+    for (const _Prim &prim : _prims) {
+        numTriangles += prim.triangles.size() / 3;
+    }
+    return numTriangles;
+}
+
+} // namespace runtime
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "pxr/pxr.h"
+#include "pxr/base/gf/frustum.h"
+#include "pxr/base/gf/range3d.h"
+#include "pxr/base/gf/ray.h"
+#include "pxr/base/gf/vec3d.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/tf/notice.h"
+#include "pxr/base/tf/token.h"
+#include "pxr/base/tf/weakBase.h"
+#include "pxr/base/work/dispatcher.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/usd/usd/notice.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/xformCache.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace runtime {
+
+/// \class ScenePicker
+///
+/// Picking of the prims of a stage on the CPU, without rendering and without OpenGL context.
+///
+/// A bounding volume hierarchy is built over the world bounds of the gprims, and optionally over
+/// the triangles of the meshes, each mesh having its own hierarchy over its indexed float vertices.
+/// The point instancers are picked on their bounds. The hierarchy is updated from the stage change
+/// notices: only the prims under the changed paths are recomputed before the top level hierarchy is
+/// rebuilt. When the time changes, only the prims whose values might vary over time are recomputed.
+///
+/// The hierarchy is built on a worker thread which reads the stage: Wait must be called before the
+/// stage is modified, and the queries can be used once IsReady returns true.
+///
+/// The results only depend on the stage and the query, not on the order of the updates: the closest hit
+/// wins, the ties are resolved by path and the frustum results are sorted by path.
+class ScenePicker : public pxr::TfWeakBase {
+public:
+    struct Parameters {
+        /// Intersect the triangles of the meshes instead of their bounds only
+        bool pickTriangles = true;
+        /// Meshes with more triangles are picked on their bounds
+        size_t maxTrianglesPerMesh = 4000000;
+        /// Purposes of the pickable prims, default and proxy if empty
+        pxr::TfTokenVector purposes;
+    };
+
+    struct Hit {
+        pxr::SdfPath primPath;
+        pxr::GfVec3d point;
+        pxr::GfVec3d normal;
+        double distance = 0.0;
+    };
+
+    ScenePicker();
+    explicit ScenePicker(const Parameters &params);
+    ~ScenePicker();
+
+    ScenePicker(const ScenePicker &) = delete;
+    ScenePicker &operator=(const ScenePicker &) = delete;
+
+    /// Start building the hierarchy of \p stage at \p timeCode, or updating it with the changes received since the
+    /// last call, on a worker thread. Returns immediately, does nothing while the previous update is running.
+    void Update(const pxr::UsdStageRefPtr &stage, pxr::UsdTimeCode timeCode);
+
+    /// True when the hierarchy is up to date with \p stage at \p timeCode
+    bool IsReady(const pxr::UsdStageRefPtr &stage, pxr::UsdTimeCode timeCode) const;
+
+    /// Wait for the running update
+    void Wait();
+
+    /// Stop listening to the stage and release the hierarchy
+    void Reset();
+
+    /// Closest prim hit by \p ray, in world space. False while the hierarchy is updated.
+    bool IntersectRay(const pxr::GfRay &ray, Hit *outHit) const;
+
+    /// All the prims intersecting \p frustum, sorted by path. False while the hierarchy is updated.
+    bool IntersectFrustum(const pxr::GfFrustum &frustum, pxr::SdfPathVector *outPrimPaths) const;
+
+    size_t GetNumPrims() const { return _prims.size(); }
+    size_t GetNumTriangles() const;
+
+private:
+    // Flat bounding volume hierarchy over a list of ranges, the primitives are referenced by index
+    struct _Bvh {
+        struct Node {
+            pxr::GfRange3d bounds;
+            uint32_t first = 0; // first child node for an inner node, first index for a leaf
+            uint32_t count = 0; // number of indices for a leaf, 0 for an inner node
+        };
+        std::vector<Node> nodes;
+        std::vector<uint32_t> indices;
+
+        void Build(const std::vector<pxr::GfRange3d> &ranges);
+        void Clear() {
+            nodes.clear();
+            indices.clear();
+        }
+    };
+
+    struct _Prim {
+        pxr::SdfPath path;
+        pxr::GfRange3d bounds;
+        std::vector<pxr::GfVec3f> points;  // World space vertices of the triangles
+        std::vector<uint32_t> triangles;   // 3 indices in points per triangle, empty if picked on the bounds
+        _Bvh bvh;
+        bool mightBeTimeVarying = false;   // Recomputed when the time changes
+    };
+
+    void _OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender);
+    void _AddPendingPath(const pxr::SdfPath &path);
+    void _Rebuild();
+    void _UpdateTime(pxr::UsdTimeCode timeCode);
+    void _UpdatePaths(pxr::SdfPathVector paths);
+    void _AppendPrims(const pxr::UsdPrim &root);
+    void _ExtractTriangles(size_t firstPrim);
+    bool _IsPickablePurpose(const pxr::TfToken &purpose) const;
+    bool _MightBeTimeVarying(const pxr::UsdPrim &prim) const;
+
+    bool _IntersectPrim(const _Prim &prim, const pxr::GfRay &ray, double maxDistance, Hit *outHit) const;
+    bool _IntersectPrim(const _Prim &prim, const pxr::GfFrustum &frustum) const;
+
+    Parameters _params;
+    pxr::UsdStageRefPtr _stage;
+    pxr::UsdTimeCode _timeCode;
+    pxr::TfNotice::Key _objectsChangedKey;
+    pxr::UsdGeomXformCache _xformCache;
+    std::unique_ptr<pxr::UsdGeomBBoxCache> _bboxCache;
+
+    std::vector<_Prim> _prims;
+    _Bvh _bvh;
+    // Subtrees pruned on a visibility which might vary over time, traversed again when the time changes
+    pxr::SdfPathVector _hiddenTimeVaryingPaths;
+
+    // Filled by the notice handler, without the descendants of the paths already pending
+    mutable std::mutex _pendingMutex;
+    pxr::SdfPathSet _pendingPaths;
+
+    // The members above are owned by the worker while it updates the hierarchy
+    pxr::WorkDispatcher _dispatcher;
+    std::atomic<bool> _isUpdating{false};
+};
+
+} // namespace runtime
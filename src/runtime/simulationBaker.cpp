@@ -0,0 +1,200 @@
+#include "simulationBaker.h"
+
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/imaging/hd/fabricSceneIndex.h"
+#include "pxr/imaging/hd/renderIndex.h"
+#include "pxr/imaging/hd/sceneIndexPrimView.h"
+#include "pxr/imaging/hd/xformSchema.h"
+#include "pxr/usd/sdf/attributeSpec.h"
+#include "pxr/usd/sdf/changeBlock.h"
+#include "pxr/usd/sdf/layer.h"
+#include "pxr/usd/sdf/primSpec.h"
+#include "pxr/usd/sdf/types.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/usdGeom/xformCache.h"
+#include "pxr/usd/usdGeom/xformable.h"
+#include "pxr/usd/usdPhysics/rigidBodyAPI.h"
+#include "pxr/usdImaging/usdImaging/sceneIndices.h"
+#include "pxr/usdImaging/usdImaging/stageSceneIndex.h"
+
+#include "fabric_sim/physxEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+const TfToken &_GetBakedTransformOpName() {
+    static const TfToken opName("xformOp:transform");
+    return opName;
+}
+
+// The fabric the render index owns in the editor, owned by the bake here
+using _Fabric = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<HdRenderIndex &>().fabric())>>;
+
+// Transform of a body in the fabric scene index, false if it is not simulated
+bool _GetSimulatedTransform(const HdSceneIndexBaseRefPtr &sceneIndex, const SdfPath &primPath,
+                            GfMatrix4d *outTransform) {
+    const HdSceneIndexPrim prim = sceneIndex->GetPrim(primPath);
+    if (HdMatrixDataSourceHandle matrixSource = HdXformSchema::GetFromParent(prim.dataSource).GetMatrix()) {
+        *outTransform = matrixSource->GetTypedValue(0.0f);
+        return true;
+    }
+    return false;
+}
+
+struct _BakedFrame {
+    double timeCode;
+    std::vector<GfMatrix4d> transforms; // one per body, in the same order
+};
+
+// Creates the over specs holding the baked transform on each body
+void _CreateBodySpecs(const SdfLayerRefPtr &layer, const UsdStageRefPtr &stage, const SdfPathVector &bodies) {
+    SdfChangeBlock block;
+    for (const SdfPath &bodyPath : bodies) {
+        SdfPrimSpecHandle primSpec = SdfCreatePrimInLayer(layer, bodyPath);
+        if (!primSpec) {
+            continue;
+        }
+        VtTokenArray opOrder;
+        if (UsdGeomXformable(stage->GetPrimAtPath(bodyPath)).GetResetXformStack()) {
+            opOrder.push_back(UsdGeomXformOpTypes->resetXformStack);
+        }
+        opOrder.push_back(_GetBakedTransformOpName());
+        SdfAttributeSpecHandle opOrderSpec = SdfAttributeSpec::New(primSpec, UsdGeomTokens->xformOpOrder,
+                                                                   SdfValueTypeNames->TokenArray, SdfVariabilityUniform);
+        if (opOrderSpec) {
+            opOrderSpec->SetDefaultValue(VtValue(opOrder));
+        }
+        SdfAttributeSpec::New(primSpec, _GetBakedTransformOpName(), SdfValueTypeNames->Matrix4d);
+    }
+}
+
+// Writes the buffered frames on the layer in one change block, the layer is saved once at the end of the bake
+void _WriteChunk(const SdfLayerRefPtr &layer, const SdfPathVector &bodies, std::vector<_BakedFrame> &chunk) {
+    SdfChangeBlock block;
+    for (size_t bodyIndex = 0; bodyIndex < bodies.size(); ++bodyIndex) {
+        const SdfPath attributePath = bodies[bodyIndex].AppendProperty(_GetBakedTransformOpName());
+        for (const _BakedFrame &frame : chunk) {
+            layer->SetTimeSample(attributePath, frame.timeCode, frame.transforms[bodyIndex]);
+        }
+    }
+    chunk.clear();
+}
+
+} // namespace
+
+SimulationBaker::SimulationBaker(const Parameters &params) : _params(params) {}
+
+bool SimulationBaker::Bake(const UsdStageRefPtr &stage, const std::string &outputLayerPath) {
+    using BakeClock = std::chrono::steady_clock;
+    _statistics = Statistics();
+
+    if (!stage || _params.timeStep <= 0.0 || _params.endFrame < _params.startFrame) {
+        TF_RUNTIME_ERROR("Invalid simulation bake parameters");
+        return false;
+    }
+
+    // Find the bodies to bake, in stage order so the output doesn't depend on anything else
+    SdfPathVector bodies;
+    for (const UsdPrim &prim : stage->Traverse()) {
+        if (prim.HasAPI<UsdPhysicsRigidBodyAPI>()) {
+            bodies.push_back(prim.GetPath());
+        }
+    }
+    _statistics.bodies = bodies.size();
+
+    SdfLayerRefPtr layer = SdfLayer::CreateNew(outputLayerPath);
+    if (!layer) {
+        TF_RUNTIME_ERROR("Unable to create the output layer %s", outputLayerPath.c_str());
+        return false;
+    }
+    layer->SetStartTimeCode(_params.startFrame);
+    layer->SetEndTimeCode(_params.endFrame);
+    layer->SetTimeCodesPerSecond(stage->GetTimeCodesPerSecond());
+    _CreateBodySpecs(layer, stage, bodies);
+
+    // The scene indices populate the fabric the physics engine works on, the same chain as the editor without the
+    // render index. The prims are pulled once, as the render index does when it is populated.
+    _Fabric fabric;
+    const UsdImagingSceneIndices sceneIndices = UsdImagingCreateSceneIndices(UsdImagingCreateSceneIndicesInfo());
+    sceneIndices.stageSceneIndex->SetStage(stage);
+    sceneIndices.stageSceneIndex->SetTime(UsdTimeCode(_params.startFrame));
+    FabricSceneIndexRefPtr fabricSceneIndex = FabricSceneIndex::New(sceneIndices.finalSceneIndex, fabric);
+    for (const SdfPath &primPath : HdSceneIndexPrimView(fabricSceneIndex)) {
+        fabricSceneIndex->GetPrim(primPath);
+    }
+    sim::PhysxEngine simulation(fabric);
+    simulation.Sync();
+
+    // The simulated time is accumulated, a frame duration which is not a multiple of the step doesn't drift from the
+    // time codes: the leftover of a frame is simulated with the next one
+    const double frameDuration = 1.0 / stage->GetTimeCodesPerSecond();
+    // Tolerance on the accumulated time, a duration that is a multiple of the step must not miss a step to rounding
+    const double stepTolerance = _params.timeStep * 1e-6;
+    double accumulator = 0.0;
+
+    UsdGeomXformCache xformCache(UsdTimeCode(_params.startFrame));
+    std::vector<_BakedFrame> chunk;
+    chunk.reserve(_params.chunkSize);
+    for (double frame = _params.startFrame; frame <= _params.endFrame; frame += 1.0) {
+        // The animated kinematic bodies and the parents of the bodies are read at the frame
+        xformCache.SetTime(UsdTimeCode(frame));
+
+        // The first frame is the initial state
+        const auto simulationStart = BakeClock::now();
+        if (frame > _params.startFrame) {
+            sceneIndices.stageSceneIndex->SetTime(UsdTimeCode(frame));
+            sceneIndices.stageSceneIndex->ApplyPendingUpdates();
+            accumulator += frameDuration;
+            while (accumulator + stepTolerance >= _params.timeStep) {
+                simulation.UpdateAll(static_cast<float>(_params.timeStep));
+                accumulator -= _params.timeStep;
+                _statistics.steps++;
+            }
+            fabricSceneIndex->FlushDirties();
+        }
+        _statistics.simulationSeconds += std::chrono::duration<double>(BakeClock::now() - simulationStart).count();
+
+        _BakedFrame bakedFrame{frame, std::vector<GfMatrix4d>(bodies.size(), GfMatrix4d(1.0))};
+        for (size_t bodyIndex = 0; bodyIndex < bodies.size(); ++bodyIndex) {
+            const UsdPrim body = stage->GetPrimAtPath(bodies[bodyIndex]);
+            GfMatrix4d worldTransform;
+            if (!_GetSimulatedTransform(fabricSceneIndex, bodies[bodyIndex], &worldTransform)) {
+                worldTransform = xformCache.GetLocalToWorldTransform(body);
+            }
+            // The op is authored in the parent space unless the body resets the xform stack
+            const bool resetXformStack = UsdGeomXformable(body).GetResetXformStack();
+            bakedFrame.transforms[bodyIndex] =
+                resetXformStack ? worldTransform : worldTransform * xformCache.GetParentToWorldTransform(body).GetInverse();
+        }
+        chunk.emplace_back(std::move(bakedFrame));
+        _statistics.frames++;
+
+        if (chunk.size() >= _params.chunkSize) {
+            const auto writeStart = BakeClock::now();
+            _WriteChunk(layer, bodies, chunk);
+            _statistics.writeSeconds += std::chrono::duration<double>(BakeClock::now() - writeStart).count();
+        }
+    }
+    simulation.UnSync();
+
+    const auto writeStart = BakeClock::now();
+    _WriteChunk(layer, bodies, chunk);
+    const bool saved = layer->Save();
+    _statistics.writeSeconds += std::chrono::duration<double>(BakeClock::now() - writeStart).count();
+    if (!saved) {
+        TF_RUNTIME_ERROR("Unable to save the output layer %s", outputLayerPath.c_str());
+    }
+    return saved;
+}
+
+} // namespace runtime
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "pxr/pxr.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/usd/usd/stage.h"
+
+#include <cstddef>
+#include <string>
+
+namespace runtime {
+
+/// \class SimulationBaker
+///
+/// Runs the physics simulation of a stage without a window or an OpenGL context,
+/// and bakes the simulated transforms of the rigid bodies as time samples on an
+/// output layer.
+///
+/// The simulation is stepped on the calling thread with a fixed timestep. The simulated time
+/// is accumulated like in the editor, a frame runs the steps due at its time code, so two
+/// bakes of the same stage give the same result. The samples are written on the output layer
+/// in chunks of frames to limit the change notifications, and the layer is saved once at the
+/// end. The layer holds all the samples until then.
+///
+/// The physics engine works on a fabric populated by the usd imaging scene indices, the bake
+/// owns the fabric and the scene indices itself: no render index, render delegate or task
+/// controller is created, so it runs on hosts without a GPU.
+class SimulationBaker {
+public:
+    struct Parameters {
+        double startFrame = 1.0;
+        double endFrame = 1.0;
+        /// Simulation timestep in seconds. The number of steps per frame is computed
+        /// from the stage time codes per second.
+        double timeStep = 1.0 / 240.0;
+        /// Number of frames buffered before they are written on the output layer.
+        size_t chunkSize = 50;
+    };
+
+    /// Statistics of the last bake, useful to benchmark the simulation throughput.
+    struct Statistics {
+        size_t frames = 0;
+        size_t steps = 0;
+        size_t bodies = 0;
+        double simulationSeconds = 0.0;
+        double writeSeconds = 0.0;
+    };
+
+    SimulationBaker(const Parameters &params);
+
+    /// Simulate \p stage and write the result in a new layer at \p outputLayerPath.
+    /// Returns false if the simulation couldn't be created or the layer couldn't be saved.
+    bool Bake(const pxr::UsdStageRefPtr &stage, const std::string &outputLayerPath);
+
+    const Statistics &GetStatistics() const { return _statistics; }
+
+private:
+    Parameters _params;
+    Statistics _statistics;
+};
+
+} // namespace runtime
@@ -0,0 +1,163 @@
+#include "simulationSnapshotSceneIndex.h"
+#include "profiler.h"
+
+#include "pxr/imaging/hd/overlayContainerDataSource.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
+#include "pxr/imaging/hd/xformSchema.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using namespace pxr;
+
+namespace runtime {
+
+namespace {
+
+// Samples of a matrix copied from the input, the value at a time is the closest sample
+class _SampledMatrixDataSource : public HdMatrixDataSource {
+public:
+    HD_DECLARE_DATASOURCE(_SampledMatrixDataSource);
+
+    VtValue GetValue(Time shutterOffset) override { return VtValue(GetTypedValue(shutterOffset)); }
+
+    GfMatrix4d GetTypedValue(Time shutterOffset) override {
+        size_t closest = 0;
+        for (size_t i = 1; i < _times.size(); ++i) {
+            if (std::abs(_times[i] - shutterOffset) < std::abs(_times[closest] - shutterOffset)) {
+                closest = i;
+            }
+        }
+        return _matrices[closest];
+    }
+
+    bool GetContributingSampleTimesForInterval(Time startTime, Time endTime, std::vector<Time> *outSampleTimes) override {
+        if (_times.size() < 2) {
+            return false;
+        }
+        *outSampleTimes = _times;
+        return true;
+    }
+
+private:
+    _SampledMatrixDataSource(std::vector<Time> times, std::vector<GfMatrix4d> matrices)
+        : _times(std::move(times)), _matrices(std::move(matrices)) {}
+
+    std::vector<Time> _times;
+    std::vector<GfMatrix4d> _matrices;
+};
+
+// Shutter interval covering the usual motion blur offsets
+constexpr HdSampledDataSource::Time _ShutterOpen = -1.0f;
+constexpr HdSampledDataSource::Time _ShutterClose = 1.0f;
+
+HdMatrixDataSourceHandle _CopyMatrix(const HdMatrixDataSourceHandle &matrixSource) {
+    std::vector<HdSampledDataSource::Time> times;
+    if (!matrixSource->GetContributingSampleTimesForInterval(_ShutterOpen, _ShutterClose, &times) || times.empty()) {
+        times = {0.0f};
+    }
+    std::vector<GfMatrix4d> matrices;
+    matrices.reserve(times.size());
+    for (const HdSampledDataSource::Time time : times) {
+        matrices.push_back(matrixSource->GetTypedValue(time));
+    }
+    return _SampledMatrixDataSource::New(std::move(times), std::move(matrices));
+}
+
+} // namespace
+
+SimulationSnapshotSceneIndexRefPtr SimulationSnapshotSceneIndex::New(const HdSceneIndexBaseRefPtr &inputSceneIndex) {
+    return TfCreateRefPtr(new SimulationSnapshotSceneIndex(inputSceneIndex));
+}
+
+SimulationSnapshotSceneIndex::SimulationSnapshotSceneIndex(const HdSceneIndexBaseRefPtr &inputSceneIndex)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex) {}
+
+HdSceneIndexPrim SimulationSnapshotSceneIndex::GetPrim(const SdfPath &primPath) const {
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+    const auto transform = _transforms.find(primPath);
+    if (prim.dataSource && transform != _transforms.end()) {
+        prim.dataSource = HdOverlayContainerDataSource::New(
+                HdRetainedContainerDataSource::New(
+                        HdXformSchemaTokens->xform,
+                        HdRetainedContainerDataSource::New(HdXformSchemaTokens->matrix, transform->second)),
+                prim.dataSource);
+    }
+    return prim;
+}
+
+SdfPathVector SimulationSnapshotSceneIndex::GetChildPrimPaths(const SdfPath &primPath) const {
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+void SimulationSnapshotSceneIndex::Clear() {
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    entries.reserve(_transforms.size());
+    for (const auto &transform : _transforms) {
+        entries.emplace_back(transform.first, HdXformSchema::GetDefaultLocator());
+    }
+    _transforms.clear();
+    if (!entries.empty() && _IsObserved()) {
+        _SendPrimsDirtied(entries);
+    }
+}
+
+void SimulationSnapshotSceneIndex::_PrimsAdded(const HdSceneIndexBase &sender,
+                                               const HdSceneIndexObserver::AddedPrimEntries &entries) {
+    _SendPrimsAdded(entries);
+}
+
+void SimulationSnapshotSceneIndex::_PrimsRemoved(const HdSceneIndexBase &sender,
+                                                 const HdSceneIndexObserver::RemovedPrimEntries &entries) {
+    for (const HdSceneIndexObserver::RemovedPrimEntry &entry : entries) {
+        // Removing the root removes everything
+        if (entry.primPath.IsAbsoluteRootPath()) {
+            _transforms.clear();
+            break;
+        }
+        // The descendants are removed with their ancestor
+        for (auto it = _transforms.begin(); it != _transforms.end();) {
+            it = it->first.HasPrefix(entry.primPath) ? _transforms.erase(it) : std::next(it);
+        }
+    }
+    _SendPrimsRemoved(entries);
+}
+
+// Only the dirties sent while the engine flushes the simulation results, under the simulation lock, read fabric.
+// The other dirties are forwarded unchanged.
+void SimulationSnapshotSceneIndex::_PrimsDirtied(const HdSceneIndexBase &sender,
+                                                 const HdSceneIndexObserver::DirtiedPrimEntries &entries) {
+    if (_isCapturing) {
+        RUNTIME_PROFILE_SCOPE("Simulation snapshot");
+        std::vector<size_t> xformEntries;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].dirtyLocators.Intersects(HdXformSchema::GetDefaultLocator())) {
+                xformEntries.push_back(i);
+            }
+        }
+        // The simulated prims are read in parallel, the map is updated afterwards
+        std::vector<HdMatrixDataSourceHandle> matrices(xformEntries.size());
+        WorkParallelForN(xformEntries.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(entries[xformEntries[i]].primPath);
+                if (HdMatrixDataSourceHandle matrixSource = HdXformSchema::GetFromParent(prim.dataSource).GetMatrix()) {
+                    matrices[i] = _CopyMatrix(matrixSource);
+                }
+            }
+        });
+        for (size_t i = 0; i < xformEntries.size(); ++i) {
+            const SdfPath &primPath = entries[xformEntries[i]].primPath;
+            if (matrices[i]) {
+                _transforms[primPath] = matrices[i];
+            } else {
+                _transforms.erase(primPath);
+            }
+        }
+    }
+    _SendPrimsDirtied(entries);
+}
+
+} // namespace runtime
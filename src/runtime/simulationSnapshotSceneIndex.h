@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pxr/pxr.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/imaging/hd/dataSourceTypeDefs.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <unordered_map>
+
+namespace runtime {
+
+class SimulationSnapshotSceneIndex;
+using SimulationSnapshotSceneIndexRefPtr = pxr::TfRefPtr<SimulationSnapshotSceneIndex>;
+
+/// \class SimulationSnapshotSceneIndex
+///
+/// Filtering scene index keeping a render side copy of the transforms simulated in fabric.
+///
+/// The physics engine writes the transforms in fabric on the simulation thread. The engine flushes the completed
+/// steps under the simulation lock between BeginCapture and EndCapture: only the xform dirties received during
+/// that flush are copied, with their motion samples, and hydra reads the copies during the sync. The render thread
+/// never reads the simulated transforms in fabric, so the hydra execution doesn't wait for the simulation steps.
+/// The other dirties, stage edits or time changes, are forwarded unchanged.
+///
+/// The copies are written and read on the render thread only.
+class SimulationSnapshotSceneIndex : public pxr::HdSingleInputFilteringSceneIndexBase {
+public:
+    static SimulationSnapshotSceneIndexRefPtr New(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+    pxr::HdSceneIndexPrim GetPrim(const pxr::SdfPath &primPath) const override;
+    pxr::SdfPathVector GetChildPrimPaths(const pxr::SdfPath &primPath) const override;
+
+    /// Forget the copies, the transforms are read from the input again
+    void Clear();
+
+    /// The xform dirties sent between the two calls are simulation results, their transforms are copied.
+    /// The caller holds the simulation lock.
+    void BeginCapture() { _isCapturing = true; }
+    void EndCapture() { _isCapturing = false; }
+
+protected:
+    explicit SimulationSnapshotSceneIndex(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+    void _PrimsAdded(const pxr::HdSceneIndexBase &sender,
+                     const pxr::HdSceneIndexObserver::AddedPrimEntries &entries) override;
+    void _PrimsRemoved(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries) override;
+    void _PrimsDirtied(const pxr::HdSceneIndexBase &sender,
+                       const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries) override;
+
+private:
+    std::unordered_map<pxr::SdfPath, pxr::HdMatrixDataSourceHandle, pxr::SdfPath::Hash> _transforms;
+    bool _isCapturing = false;
+};
+
+} // namespace runtime
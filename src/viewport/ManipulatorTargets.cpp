@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <unordered_set>
+#include <pxr/usd/sdf/primSpec.h>
+#include "ManipulatorTargets.h"
+#include "Commands.h"
+#include "Viewport.h"
+
+bool SetXformOpValue(const UsdGeomXformOp &op, const VtValue &value, UsdTimeCode timeCode) {
+    const TfType &opType = op.GetTypeName().GetType();
+    if (value.GetType() == opType) {
+        return op.GetAttr().Set(value, timeCode);
+    }
+    const VtValue castValue = VtValue::CastToTypeid(value, opType.GetTypeid());
+    return !castValue.IsEmpty() && op.GetAttr().Set(castValue, timeCode);
+}
+
+void ManipulatorTargets::SetSelection(Viewport &viewport) {
+    _targets.clear();
+    const UsdStageRefPtr &stage = viewport.GetCurrentStage();
+    if (!stage) {
+        return;
+    }
+    const Selection &selection = viewport.GetSelection();
+    std::vector<SdfPath> paths = selection.GetSelectedPaths(stage);
+    // Sorted, the ancestors are visited before their descendants
+    std::sort(paths.begin(), paths.end());
+
+    const SdfPath anchorPath = selection.GetAnchorPrimPath(stage);
+    std::unordered_set<SdfPath, SdfPath::Hash> targetPaths;
+    for (const SdfPath &path : paths) {
+        bool hasSelectedAncestor = false;
+        for (SdfPath parent = path.GetParentPath(); !parent.IsEmpty(); parent = parent.GetParentPath()) {
+            if (targetPaths.count(parent)) {
+                hasSelectedAncestor = true;
+                break;
+            }
+        }
+        if (hasSelectedAncestor) {
+            continue;
+        }
+        UsdGeomXformable xformable(stage->GetPrimAtPath(path));
+        if (!xformable) {
+            continue;
+        }
+        targetPaths.insert(path);
+        ManipulatorTarget target;
+        target.xformable = xformable;
+        target.xformAPI = UsdGeomXformCommonAPI(xformable.GetPrim());
+        _targets.emplace_back(std::move(target));
+    }
+
+    // The anchor is the target moving the anchor prim: the prim itself or its selected ancestor
+    for (SdfPath path = anchorPath; !path.IsEmpty(); path = path.GetParentPath()) {
+        if (targetPaths.count(path)) {
+            const auto anchor = std::find_if(_targets.begin(), _targets.end(), [&](const ManipulatorTarget &target) {
+                return target.xformable.GetPath() == path;
+            });
+            std::iter_swap(_targets.begin(), anchor);
+            break;
+        }
+    }
+}
+
+void ManipulatorTargets::BeginEdition(Viewport &viewport, UsdGeomXformCommonAPI::OpFlags opFlag) {
+    const UsdTimeCode viewportTimeCode = viewport.GetCurrentTimeCode();
+    ViewportGeometryCache &geometryCache = viewport.GetGeometryCache();
+
+    const UsdStageRefPtr &stage = viewport.GetCurrentStage();
+
+    // The ops created here are part of the undo command
+    ::BeginEdition(stage);
+
+    // The prim specs are created first: a new spec changes the prim index, and the Usd api creating the ops
+    // reads the prims. Once they exist, the ops and their values are authored in one change block
+    const UsdEditTarget &editTarget = stage->GetEditTarget();
+    const SdfLayerHandle &editLayer = editTarget.GetLayer();
+    {
+        SdfChangeBlock block;
+        for (ManipulatorTarget &target : _targets) {
+            const SdfPath specPath = editTarget.MapToSpecPath(target.xformable.GetPath());
+            if (!specPath.IsEmpty() && !editLayer->GetPrimAtPath(specPath)) {
+                SdfCreatePrimInLayer(editLayer, specPath);
+            }
+        }
+    }
+
+    SdfChangeBlock block;
+    for (ManipulatorTarget &target : _targets) {
+        const UsdPrim prim = target.xformable.GetPrim();
+        std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
+        target.xformable.GetTimeSamples(&timeSamples);
+        target.editionTimeCode = timeSamples.empty() ? UsdTimeCode::Default() : viewportTimeCode;
+
+        target.transform = geometryCache.GetLocalTransformation(prim);
+        target.parentToWorld = geometryCache.GetParentToWorldTransform(prim);
+        target.worldToParent = target.parentToWorld.GetInverse();
+        target.xformAPI.GetXformVectorsByAccumulation(&target.translation, &target.rotation, &target.scale, &target.pivot,
+                                                      &target.rotOrder, viewportTimeCode);
+
+        target.translateOp = target.rotateOp = target.scaleOp = target.transformOp = UsdGeomXformOp();
+        if (target.xformAPI) {
+            const auto ops = target.xformAPI.CreateXformOps(target.rotOrder, opFlag);
+            target.translateOp = ops.translateOp;
+            target.rotateOp = ops.rotateOp;
+            target.scaleOp = ops.scaleOp;
+        } else {
+            bool reset = false;
+            const auto ops = target.xformable.GetOrderedXformOps(&reset);
+            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
+                target.transformOp = ops[0];
+            }
+        }
+    }
+
+    // Author the current values, the updates only set values on existing specs and each value is one undo
+    // instruction for the whole drag
+    Update([](const ManipulatorTarget &target) {
+        if (target.translateOp) {
+            SetXformOpValue(target.translateOp, VtValue(target.translation), target.editionTimeCode);
+        }
+        if (target.rotateOp) {
+            SetXformOpValue(target.rotateOp, VtValue(target.rotation), target.editionTimeCode);
+        }
+        if (target.scaleOp) {
+            SetXformOpValue(target.scaleOp, VtValue(target.scale), target.editionTimeCode);
+        }
+        if (target.transformOp) {
+            SetXformOpValue(target.transformOp, VtValue(target.transform), target.editionTimeCode);
+        }
+    });
+}
+
+void ManipulatorTargets::EndEdition() { ::EndEdition(); }
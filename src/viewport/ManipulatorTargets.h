@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/usdGeom/xformCommonAPI.h>
+#include <pxr/usd/usdGeom/xformable.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+class Viewport;
+
+//
+// A prim transformed by the manipulators, with its xform ops resolved and its values saved
+// when the edition begins, so the updates only have to write the new values.
+//
+struct ManipulatorTarget {
+    UsdGeomXformable xformable;
+    UsdGeomXformCommonAPI xformAPI; // Invalid when the xform ops are not compatible with the common API
+
+    // Resolved in BeginEdition
+    UsdTimeCode editionTimeCode;
+    UsdGeomXformOp translateOp;
+    UsdGeomXformOp rotateOp;
+    UsdGeomXformOp scaleOp;
+    UsdGeomXformOp transformOp; // The single matrix op used when there is no common API
+
+    // Values when the edition begins
+    GfVec3d translation;
+    GfVec3f rotation;
+    GfVec3f scale;
+    GfVec3f pivot;
+    UsdGeomXformCommonAPI::RotationOrder rotOrder = UsdGeomXformCommonAPI::RotationOrderXYZ;
+    GfMatrix4d transform;     // Local transform
+    GfMatrix4d parentToWorld;
+    GfMatrix4d worldToParent;
+};
+
+//
+// The xformable prims of the selection the translate, rotate and scale manipulators operate on.
+// The target of the selection anchor comes first and is the one the manipulators are drawn on.
+// Selected prims with a selected ancestor are skipped as they already move with it, the anchor is then the ancestor.
+//
+// An update writes the values of all the targets in one SdfChangeBlock, and the whole drag is recorded
+// in one undo command between BeginEdition and EndEdition.
+//
+class ManipulatorTargets {
+  public:
+    /// Collect the targets from the viewport selection
+    void SetSelection(Viewport &viewport);
+
+    bool IsEmpty() const { return _targets.empty(); }
+    size_t GetSize() const { return _targets.size(); }
+
+    /// The anchor is the first target, the manipulators are drawn using its transform
+    UsdGeomXformable GetAnchorXformable() const { return _targets.empty() ? UsdGeomXformable() : _targets[0].xformable; }
+    UsdGeomXformCommonAPI GetAnchorXformAPI() const {
+        return _targets.empty() ? UsdGeomXformCommonAPI() : _targets[0].xformAPI;
+    }
+    const ManipulatorTarget &GetAnchor() const { return _targets[0]; }
+
+    /// Resolve the ops with the flag passed in argument, save the current values and start recording the undo command.
+    /// The ops missing on the targets are authored here in one change block, so the updates only set values on
+    /// existing attributes.
+    void BeginEdition(Viewport &viewport, UsdGeomXformCommonAPI::OpFlags opFlag);
+
+    /// Call func(target) on all the targets inside one change block
+    template <typename FuncT> void Update(FuncT &&func) {
+        SdfChangeBlock block;
+        for (const ManipulatorTarget &target : _targets) {
+            func(target);
+        }
+    }
+
+    /// Stop recording, the drag is one undo command
+    void EndEdition();
+
+  private:
+    std::vector<ManipulatorTarget> _targets;
+};
+
+/// Set the value of an xform op, casting it to the precision of the op
+bool SetXformOpValue(const UsdGeomXformOp &op, const VtValue &value, UsdTimeCode timeCode);
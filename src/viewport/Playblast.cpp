@@ -1,6 +1,12 @@
+#include "Commands.h"
 #include "FileBrowser.h"
 #include "Gui.h"
 #include "Playblast.h"
+#include <algorithm>
+#include <chrono>
+#include <pxr/base/work/threadLimits.h>
+#include <pxr/imaging/hd/rendererPlugin.h>
+#include <pxr/imaging/hd/rendererPluginRegistry.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usd/stage.h>
 #include <pxr/usd/usdGeom/camera.h>
@@ -16,11 +22,177 @@ namespace fs = ghc::filesystem;
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+// Time spent rendering frames per editor frame, the editor stays interactive while blasting
+static constexpr std::chrono::milliseconds PlayblastRenderBudget(30);
+
+// Returns the renderer if it supports the gpu mode, otherwise an empty token which selects the default renderer
+static TfToken GetSupportedRendererId(const TfToken &rendererPluginId, bool gpuEnabled) {
+    HdRendererPluginHandle plugin = HdRendererPluginRegistry::GetInstance().GetOrCreateRendererPlugin(rendererPluginId);
+    return plugin && plugin->IsSupported(gpuEnabled) ? rendererPluginId : TfToken();
+}
+
+PlayblastJob::PlayblastJob(UsdStageRefPtr stage, const Parameters &parameters)
+    : _stage(stage), _parameters(parameters),
+      _recorder(GetSupportedRendererId(parameters.rendererPluginId, parameters.gpuEnabled), parameters.gpuEnabled),
+      _nextFrame(parameters.isSequence ? parameters.start : 0) {
+    if (_parameters.width > 0) {
+        _recorder.SetImageWidth(_parameters.width);
+    }
+    // Color correction is only available on the GPU
+    if (_recorder.GetGPUEnabled()) {
+        _recorder.SetColorCorrectionMode(TfToken("sRGB"));
+    }
+    _recorder.SetComplexity(1.0);
+    // The renderer might differ from the requested one if it doesn't support the gpu mode
+    _rendererId = _recorder.GetCurrentRendererId();
+
+    // One image is being rendered while the others are written
+    const size_t slotCount = std::min<size_t>(WorkGetConcurrencyLimit(), 8) + 1;
+    for (size_t i = 0; i < slotCount; ++i) {
+        _slots.emplace_back(std::make_unique<FrameSlot>());
+    }
+}
+
+PlayblastJob::~PlayblastJob() {
+    Cancel();
+    _writers.Wait();
+}
+
+PlayblastJob::FrameSlot *PlayblastJob::FindAvailableSlot() {
+    for (auto &slot : _slots) {
+        if (!slot->isWriting) {
+            return slot.get();
+        }
+    }
+    return nullptr;
+}
+
+std::string PlayblastJob::GetFramePath(int frame) const {
+    const std::string frameName = _parameters.isSequence
+                                      ? _parameters.filenamePrefix + "." + std::to_string(frame) + ".jpg"
+                                      : _parameters.filenamePrefix + ".jpg";
+    return (fs::path(_parameters.directory) / frameName).string();
+}
+
+void PlayblastJob::Update() {
+    const int lastFrame = _parameters.isSequence ? _parameters.end : 0;
+    if (!_stage || _rendererId.IsEmpty() || !fs::is_directory(fs::path(_parameters.directory))) {
+        _failedFrames += lastFrame - _nextFrame + 1;
+        _nextFrame = lastFrame + 1;
+        // The queued images can't be written either
+        FrameSlot *slot = FindAvailableSlot();
+        UsdTimeCode timeCode;
+        while (slot && _recorder.TakeImage(&slot->image, &timeCode)) {
+            _failedFrames++;
+        }
+        return;
+    }
+    const UsdGeomCamera camera(_stage->GetPrimAtPath(_parameters.cameraPath));
+    const auto startTime = std::chrono::steady_clock::now();
+    while (!_isCancelled && std::chrono::steady_clock::now() - startTime < PlayblastRenderBudget) {
+        // The images are taken ReadbackLatency frames after being queued, when their GPU copy is done,
+        // the last ones are taken once all the frames are rendered
+        const bool isRendered = _nextFrame > lastFrame;
+        const size_t queuedImages = _recorder.GetQueuedImageCount();
+        if (queuedImages <= (isRendered ? 0 : runtime::UsdAppUtilsFrameRecorder::ReadbackLatency)) {
+            if (isRendered) {
+                break;
+            }
+            const int frame = _nextFrame++;
+            const UsdTimeCode timeCode = _parameters.isSequence ? UsdTimeCode(frame) : UsdTimeCode::Default();
+            if (!_recorder.QueueImage(_stage, camera, timeCode)) {
+                _failedFrames++;
+                continue;
+            }
+            const auto &frameStatistics = _recorder.GetLastFrameStatistics();
+            _renderedFrames++;
+            _renderSeconds += frameStatistics.framingSeconds + frameStatistics.renderSeconds;
+            _readbackSeconds += frameStatistics.readbackSeconds;
+            continue;
+        }
+        // All the images are waiting to be written, the writers will catch up before the next editor frame
+        FrameSlot *slot = FindAvailableSlot();
+        if (!slot) {
+            break;
+        }
+        const auto readbackStart = std::chrono::steady_clock::now();
+        UsdTimeCode timeCode;
+        const bool taken = _recorder.TakeImage(&slot->image, &timeCode);
+        _readbackSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - readbackStart).count();
+        if (!taken) {
+            _failedFrames++;
+            continue;
+        }
+        const int frame = _parameters.isSequence ? static_cast<int>(timeCode.GetValue()) : 0;
+        if (!slot->image.IsValid()) { // Written by the render products
+            _writtenFrames++;
+            continue;
+        }
+        slot->isWriting = true;
+        _pendingWrites++;
+        _writers.Run([this, slot, framePath = GetFramePath(frame)]() {
+            if (!_isCancelled) {
+                const auto writeStart = std::chrono::steady_clock::now();
+                if (slot->image.Write(framePath)) {
+                    _writtenFrames++;
+                } else {
+                    _failedFrames++;
+                }
+                _writeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - writeStart)
+                                          .count();
+            }
+            slot->isWriting = false;
+            _pendingWrites--;
+        });
+    }
+}
+
+bool PlayblastJob::IsFinished() const {
+    const int lastFrame = _parameters.isSequence ? _parameters.end : 0;
+    return (_isCancelled || (_nextFrame > lastFrame && _recorder.GetQueuedImageCount() == 0)) && _pendingWrites == 0;
+}
+
+PlayblastJob::Timings PlayblastJob::GetAverageTimings() const {
+    Timings timings;
+    if (_renderedFrames > 0) {
+        timings.render = 1000.0 * _renderSeconds / _renderedFrames;
+        timings.readback = 1000.0 * _readbackSeconds / _renderedFrames;
+    }
+    const int writtenFrames = _writtenFrames + _failedFrames;
+    if (writtenFrames > 0) {
+        timings.write = 0.001 * static_cast<double>(_writeMicroseconds) / writtenFrames;
+    }
+    return timings;
+}
+
+void DrawPlayblastProgress(PlayblastJob &job) {
+    const int frameCount = std::max(job.GetFrameCount(), 1);
+    const int doneCount = job.GetWrittenFrameCount() + job.GetFailedFrameCount();
+    const std::string overlay = job.IsCancelled() ? std::string("Cancelling")
+                                                  : std::to_string(doneCount) + "/" + std::to_string(frameCount);
+    ImGui::Text(ICON_FA_IMAGES " Playblast");
+    ImGui::ProgressBar(static_cast<float>(doneCount) / static_cast<float>(frameCount), ImVec2(150, 0), overlay.c_str());
+    if (ImGui::IsItemHovered()) {
+        const PlayblastJob::Timings timings = job.GetAverageTimings();
+        ImGui::SetTooltip("%s\nrender %.2f ms/frame\nreadback %.2f ms/frame\nwrite %.2f ms/frame",
+                          runtime::RuntimeEngine::GetRendererDisplayName(job.GetRendererId()).c_str(), timings.render,
+                          timings.readback, timings.write);
+    }
+    ImGui::BeginDisabled(job.IsCancelled());
+    if (ImGui::SmallButton("Cancel##Playblast")) {
+        job.Cancel();
+    }
+    ImGui::EndDisabled();
+}
+
 std::string PlayblastModalDialog::directory = "";
 std::string PlayblastModalDialog::filenamePrefix = "";
 int PlayblastModalDialog::start = -1;
 int PlayblastModalDialog::end = -1;
 int PlayblastModalDialog::width = 960;
+TfToken PlayblastModalDialog::rendererPluginId = TfToken("HdStormRendererPlugin");
+bool PlayblastModalDialog::gpuEnabled = true;
 
 PlayblastModalDialog::PlayblastModalDialog(UsdStagePtr stage) : _stage(stage) {
     if (directory.empty()) {
@@ -51,6 +223,9 @@ void PlayblastModalDialog::Draw() {
     // Draw available cameras
     const char *selectedCameraName = _cameraPath == SdfPath() ? "No camera" : _cameraPath.GetText();
     if (ImGui::BeginCombo("Stage camera", selectedCameraName)) {
+        if (ImGui::Selectable("No camera")) {
+            _cameraPath = SdfPath(); // The recorder frames the whole stage
+        }
         for (const SdfPath &stageCameraPath : _stageCameras) {
             if (ImGui::Selectable(stageCameraPath.GetText())) {
                 _cameraPath = stageCameraPath;
@@ -58,6 +233,19 @@ void PlayblastModalDialog::Draw() {
         }
         ImGui::EndCombo();
     }
+    if (ImGui::BeginCombo("Renderer", runtime::RuntimeEngine::GetRendererDisplayName(rendererPluginId).c_str())) {
+        for (const TfToken &plugin : runtime::RuntimeEngine::GetRendererPlugins()) {
+            if (ImGui::Selectable(runtime::RuntimeEngine::GetRendererDisplayName(plugin).c_str(), plugin == rendererPluginId)) {
+                rendererPluginId = plugin;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::Checkbox("Use GPU", &gpuEnabled);
+    if (!gpuEnabled) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(renderers without CPU support fall back to the default one)");
+    }
     ImGui::Text("Scene materials ON");
     ImGui::Text("Purposes: default+proxy");
     ImGui::InputText("Output directory", &directory);
@@ -69,33 +257,20 @@ void PlayblastModalDialog::Draw() {
     }
     ImGui::InputInt("Image width", &width);
 
-    ImGui::BeginDisabled(directory.empty() || filenamePrefix.empty() || start > end || _cameraPath == SdfPath());
+    ImGui::BeginDisabled(directory.empty() || filenamePrefix.empty() || start > end);
     ImGui::Text("Rendering to : %s\\%s.#.jpg", directory.c_str(), filenamePrefix.c_str());
     if (ImGui::Button("Blast")) {
-        if (width > 0) {
-            _recorder.SetImageWidth(width);
-        }
-        _recorder.SetRendererPlugin(TfToken("HdStormRendererPlugin"));
-        _recorder.SetColorCorrectionMode(TfToken("sRGB"));
-        _recorder.SetComplexity(1.0);
-        UsdGeomCamera camera(_stage->GetPrimAtPath(_cameraPath));
-        if (isSequence) {
-            for (int i = start; i <= end; ++i) {
-                std::string frameName = filenamePrefix + "." + std::to_string(i) + ".jpg";
-                fs::path outputFrame(directory);
-                if (fs::is_directory(outputFrame)) {
-                    outputFrame /= frameName;
-                    _recorder.Record(_stage, camera, UsdTimeCode(i), outputFrame.string());
-                }
-            }
-        } else {
-            std::string frameName = filenamePrefix + "." + ".jpg";
-            fs::path outputFrame(directory);
-            if (fs::is_directory(outputFrame)) {
-                outputFrame /= frameName;
-                _recorder.Record(_stage, camera, UsdTimeCode::Default(), outputFrame.string());
-            }
-        }
+        PlayblastJob::Parameters parameters;
+        parameters.cameraPath = _cameraPath;
+        parameters.directory = directory;
+        parameters.filenamePrefix = filenamePrefix;
+        parameters.isSequence = isSequence;
+        parameters.start = start;
+        parameters.end = end;
+        parameters.width = width;
+        parameters.rendererPluginId = rendererPluginId;
+        parameters.gpuEnabled = gpuEnabled;
+        ExecuteAfterDraw<EditorStartPlayblast>(UsdStageRefPtr(_stage), parameters);
         CloseModal();
     }
     ImGui::SameLine();
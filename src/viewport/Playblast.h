@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <pxr/base/work/dispatcher.h>
 
 #include "runtime/frameRecorder.h"
 
@@ -8,14 +13,98 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+/// Playblast job
+/// The frames are recorded in a pipeline so the editor stays usable while blasting:
+///  - the frames are rendered on the main thread, as it owns the OpenGL context, a few per editor frame,
+///  - their copy to a readback buffer is queued, and they are read back a few frames later once the GPU copy is done,
+///    in a small pool of images reused for the whole sequence,
+///  - the images are encoded and written by worker threads, while the following frames are rendered.
+/// The rendering stops when all the images of the pool are waiting to be written, which bounds the memory used.
+///
+class PlayblastJob {
+  public:
+    struct Parameters {
+        SdfPath cameraPath;
+        std::string directory;
+        std::string filenamePrefix;
+        bool isSequence = true;
+        int start = 0;
+        int end = 0;
+        int width = 960;
+        TfToken rendererPluginId = TfToken("HdStormRendererPlugin");
+        /// Without GPU the frames are rendered by a CPU renderer and read back from its render buffer
+        bool gpuEnabled = true;
+    };
+
+    /// Average time per frame spent in each stage of the pipeline, in milliseconds
+    struct Timings {
+        double render = 0.0;
+        double readback = 0.0;
+        double write = 0.0;
+    };
+
+    PlayblastJob(UsdStageRefPtr stage, const Parameters &parameters);
+
+    /// Cancels and waits for the images being written
+    ~PlayblastJob();
+
+    // Delete copy
+    PlayblastJob(const PlayblastJob &) = delete;
+    PlayblastJob &operator=(const PlayblastJob &) = delete;
+
+    /// Renders the next frames, this must be called on the thread owning the OpenGL context
+    void Update();
+
+    /// Stops rendering new frames, the images already rendered are not written
+    void Cancel() { _isCancelled = true; }
+
+    bool IsCancelled() const { return _isCancelled; }
+
+    /// Returns true when all the frames are written or when the job was cancelled and the writers are done
+    bool IsFinished() const;
+
+    int GetFrameCount() const { return _parameters.isSequence ? _parameters.end - _parameters.start + 1 : 1; }
+    int GetWrittenFrameCount() const { return _writtenFrames; }
+    int GetFailedFrameCount() const { return _failedFrames; }
+    Timings GetAverageTimings() const;
+    const TfToken &GetRendererId() const { return _rendererId; }
+
+  private:
+    struct FrameSlot {
+        runtime::UsdAppUtilsFrameRecorder::FrameImage image;
+        std::atomic<bool> isWriting{false};
+    };
+    FrameSlot *FindAvailableSlot();
+    std::string GetFramePath(int frame) const;
+
+    UsdStageRefPtr _stage;
+    Parameters _parameters;
+    runtime::UsdAppUtilsFrameRecorder _recorder;
+    std::vector<std::unique_ptr<FrameSlot>> _slots;
+    int _nextFrame = 0;
+    std::atomic<bool> _isCancelled{false};
+    std::atomic<int> _pendingWrites{0};
+    std::atomic<int> _writtenFrames{0};
+    std::atomic<int> _failedFrames{0};
+    TfToken _rendererId;
+    // Accumulated timings, the write timings are updated by the writers
+    int _renderedFrames = 0;
+    double _renderSeconds = 0.0;
+    double _readbackSeconds = 0.0;
+    std::atomic<int64_t> _writeMicroseconds{0};
+    WorkDispatcher _writers;
+};
+
+/// Draw the progress of a running playblast job with a button to cancel it
+void DrawPlayblastProgress(PlayblastJob &job);
+
 /// Playblast dialog
 /// This is a minimal implementation of a playblast dialog using UsdAppUtilsFrameRecorder.
 /// It needs some improvements as it's not possible to blast the viewport camera unless it's a stage camera,
-/// we can't select the renderer, we can't change options like loading materials or not, change the file format ...
-/// Also there is not ui for selecting the output directory, and no progress bar.
+/// we can't change options like loading materials or not, change the file format ...
+/// Also there is not ui for selecting the output directory.
 ///
-/// For all of those desirable features we need to extract the code from UsdAppUtilsFrameRecorder into another frame
-/// recorder.
+/// The dialog only collects the parameters, the frames are recorded by a PlayblastJob owned by the editor.
 ///
 struct PlayblastModalDialog : public ModalDialog {
     PlayblastModalDialog(UsdStagePtr stage);
@@ -24,7 +113,6 @@ struct PlayblastModalDialog : public ModalDialog {
     void Draw() override;
     const char *DialogId() const override { return "Playblast"; }
 
-    runtime::UsdAppUtilsFrameRecorder _recorder;
     UsdStagePtr _stage;
     SdfPath _cameraPath;
     SdfPathVector _stageCameras;
@@ -35,4 +123,6 @@ struct PlayblastModalDialog : public ModalDialog {
     static int start;
     static int end;
     static int width;
+    static TfToken rendererPluginId;
+    static bool gpuEnabled;
 };
@@ -78,22 +78,19 @@ bool PositionManipulator::IsMouseOver(const Viewport &viewport) {
 
 // Same as rotation manipulator now -- TODO : share in a common class
 void PositionManipulator::OnSelectionChange(Viewport &viewport) {
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
+    const auto &targets = viewport.GetManipulatorTargets();
+    _xformAPI = targets.GetAnchorXformAPI();
+    _xformable = targets.GetAnchorXformable();
 }
 
 GfMatrix4d PositionManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
     if (_xformable) {
-        const auto currentTime = viewport.GetCurrentTimeCode();
-        GfMatrix4d localTransform;
-        bool resetsXformStack = false;
-        _xformable.GetLocalTransformation(&localTransform, &resetsXformStack, currentTime);
+        auto &geometryCache = viewport.GetGeometryCache();
+        const GfMatrix4d localTransform = geometryCache.GetLocalTransformation(_xformable.GetPrim());
         const GfVec3d translation = localTransform.ExtractTranslation();
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         // const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot); // Do we need to get the pivot ?
-        const auto parentToWorld = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorld = geometryCache.GetParentToWorldTransform(_xformable.GetPrim());
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = /* pivotMat * */ transMat * parentToWorld; // TODO pivot ?? or not pivot ???
@@ -163,19 +160,13 @@ void PositionManipulator::OnDrawFrame(const Viewport &viewport) {
 }
 
 void PositionManipulator::OnBeginEdition(Viewport &viewport) {
-    // Save original translation values
-    GfVec3f scale, pivot, rotation;
-    GfMatrix4d localTransform;
-    bool resetsXformStack = false;
-    _xformable.GetLocalTransformation(&localTransform, &resetsXformStack, viewport.GetCurrentTimeCode());
-    _translationOnBegin = localTransform.ExtractTranslation();
+    // Save original translation values of all the selected prims
+    viewport.GetManipulatorTargets().BeginEdition(viewport, UsdGeomXformCommonAPI::OpTranslate);
 
     // Save mouse position on selected axis
     const GfMatrix4d objectTransform = ComputeManipulatorToWorldTransform(viewport);
     _axisLine = GfLine(objectTransform.ExtractTranslation(), objectTransform.GetRow3(_selectedAxis));
     ProjectMouseOnAxis(viewport, _originMouseOnAxis);
-
-    BeginEdition(viewport.GetCurrentStage());
 }
 
 Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
@@ -184,7 +175,8 @@ Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
         return viewport.GetManipulator<MouseHoverManipulator>();
     }
 
-    if (_xformable && _selectedAxis < 3) {
+    auto &targets = viewport.GetManipulatorTargets();
+    if (_xformable && !targets.IsEmpty() && _selectedAxis < 3) {
         GfVec3d mouseOnAxis;
         ProjectMouseOnAxis(viewport, mouseOnAxis);
 
@@ -195,24 +187,27 @@ Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
         _axisLine.FindClosestPoint(mouseOnAxis, &cur);
         double sign = cur > ori ? 1.0 : -1.0;
 
-        GfVec3d translation = _translationOnBegin;
-        translation[_selectedAxis] += sign * (_originMouseOnAxis - mouseOnAxis).GetLength();
-        if (_xformAPI) {
-            _xformAPI.SetTranslate(translation, GetEditionTimeCode(viewport));
-        } else {
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
-                GfMatrix4d current = ops[0].GetOpTransform(GetEditionTimeCode(viewport));
-                current.SetTranslateOnly(translation); // TODO: what happens if there is a pivot ???
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+        // The translation is computed in the parent space of the anchor, and moved to the parent space of each target
+        // through the world space
+        GfVec3d anchorTranslation(0.0);
+        anchorTranslation[_selectedAxis] = sign * (_originMouseOnAxis - mouseOnAxis).GetLength();
+        const GfVec3d worldTranslation = targets.GetAnchor().parentToWorld.TransformDir(anchorTranslation);
+        targets.Update([&](const ManipulatorTarget &target) {
+            const GfVec3d translation = target.worldToParent.TransformDir(worldTranslation);
+            if (target.translateOp) {
+                SetXformOpValue(target.translateOp, VtValue(target.translation + translation), target.editionTimeCode);
+            } else if (target.transformOp) {
+                // TODO: what happens if there is a pivot ???
+                GfMatrix4d current = target.transform;
+                current.SetTranslateOnly(target.transform.ExtractTranslation() + translation);
+                SetXformOpValue(target.transformOp, VtValue(current), target.editionTimeCode);
             }
-        }
+        });
     }
     return this;
 };
 
-void PositionManipulator::OnEndEdition(Viewport &) { EndEdition(); };
+void PositionManipulator::OnEndEdition(Viewport &viewport) { viewport.GetManipulatorTargets().EndEdition(); };
 
 ///
 void PositionManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &linePoint) {
@@ -225,14 +220,3 @@ void PositionManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &
         GfFindClosestPoints(mouseRay, _axisLine, &rayPoint, &linePoint, &a, &b);
     }
 }
-
-UsdTimeCode PositionManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return viewport.GetCurrentTimeCode();
-    }
-}
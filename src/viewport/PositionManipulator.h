@@ -35,12 +35,9 @@ class PositionManipulator : public Manipulator {
     void ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &closestPoint);
     GfMatrix4d ComputeManipulatorToWorldTransform(const Viewport &viewport);
 
-    UsdTimeCode GetEditionTimeCode(const Viewport &viewport);
-
     ManipulatorAxis _selectedAxis;
 
     GfVec3d _originMouseOnAxis;
-    GfVec3d _translationOnBegin;
     GfLine _axisLine;
 
     UsdGeomXformable _xformable;
@@ -0,0 +1,31 @@
+#include "ResolutionGovernor.h"
+#include <algorithm>
+
+// The scale takes a few fixed levels so that the render buffers are not reallocated at every frame while the frame
+// time oscillates around the budget. Below a quarter of the resolution the image is too blurry to be of any use.
+static constexpr float RenderScales[] = {0.25f, 0.375f, 0.5f, 0.75f, 1.f};
+
+static_assert(sizeof(RenderScales) / sizeof(RenderScales[0]) == ResolutionGovernor::FullResolutionLevel + 1, "");
+
+void ResolutionGovernor::Update(bool isInteracting, bool isConverged, float lastRenderTime) {
+    if (isInteracting) {
+        // No render since the last update, there is nothing to measure
+        if (lastRenderTime <= 0.f) {
+            return;
+        }
+        // The level goes down as soon as the budget is exceeded, it goes up only when the render is well under it
+        if (lastRenderTime > _frameBudget) {
+            _level = std::max(0, _level - 1);
+        } else if (lastRenderTime < _frameBudget * 0.4f) {
+            _level = std::min(FullResolutionLevel, _level + 1);
+        }
+    } else if (_level < FullResolutionLevel && isConverged) {
+        _level++;
+    }
+    _scale = RenderScales[_level];
+}
+
+void ResolutionGovernor::Reset() {
+    _level = FullResolutionLevel;
+    _scale = 1.f;
+}
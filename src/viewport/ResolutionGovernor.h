@@ -0,0 +1,35 @@
+#pragma once
+
+///
+/// Render resolution of a viewport under a frame time budget.
+/// While the user interacts with the viewport, the render scale goes down one level when the hydra render takes
+/// longer than the budget and back up when it is well under it. When the interaction stops, the scale is raised level
+/// by level to the full resolution, a level is only taken once the renderer has converged, so a progressive renderer
+/// first refines the image it is accumulating.
+///
+class ResolutionGovernor {
+  public:
+    /// Compute the render scale of the next frame from the wall clock duration of the last hydra render, zero if the
+    /// viewport was not rendered since the last update
+    void Update(bool isInteracting, bool isConverged, float lastRenderTime);
+
+    /// Forget the reduced scale, the next frame is rendered at full resolution
+    void Reset();
+
+    /// Ratio between the render buffer size and the viewport size, in ]0, 1]
+    float GetScale() const { return _scale; }
+
+    /// True until the image is rendered at full resolution
+    bool IsRefining() const { return _scale < 1.f; }
+
+    void SetFrameBudget(float frameBudget) { _frameBudget = frameBudget; }
+    float GetFrameBudget() const { return _frameBudget; }
+
+    /// Index of the full resolution in the fixed scale levels
+    static constexpr int FullResolutionLevel = 4;
+
+  private:
+    int _level = FullResolutionLevel; // Index of the scale in the fixed levels
+    float _scale = 1.f;
+    float _frameBudget = 1.f / 30.f; // In seconds
+};
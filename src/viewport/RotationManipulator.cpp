@@ -78,10 +78,9 @@ bool RotationManipulator::IsMouseOver(const Viewport &viewport) {
 
 void RotationManipulator::OnSelectionChange(Viewport &viewport) {
     // TODO: we should set here if the new selection will be editable or not
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(_xformAPI.GetPrim());
+    const auto &targets = viewport.GetManipulatorTargets();
+    _xformAPI = targets.GetAnchorXformAPI();
+    _xformable = targets.GetAnchorXformable();
 }
 
 GfMatrix4d RotationManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
@@ -97,8 +96,7 @@ GfMatrix4d RotationManipulator::ComputeManipulatorToWorldTransform(const Viewpor
 
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot);
-        // const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-        const auto parentToWorldMat = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorldMat = viewport.GetGeometryCache().GetParentToWorldTransform(_xformable.GetPrim());
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = rotMat * pivotMat * transMat * parentToWorldMat;
@@ -208,6 +206,8 @@ GfVec3d RotationManipulator::ComputeClockHandVector(Viewport &viewport) {
 }
 
 void RotationManipulator::OnBeginEdition(Viewport &viewport) {
+    // Save the rotation values of all the selected prims
+    viewport.GetManipulatorTargets().BeginEdition(viewport, UsdGeomXformCommonAPI::OpRotate);
     if (_xformable) {
         const auto manipulatorCoordinates = ComputeManipulatorToWorldTransform(viewport);
         _planeOrigin3d = manipulatorCoordinates.ExtractTranslation();
@@ -222,24 +222,14 @@ void RotationManipulator::OnBeginEdition(Viewport &viewport) {
 
         // Compute rotation starting point
         _rotateFrom = ComputeClockHandVector(viewport);
-
-        // Save the rotation values
-        GfVec3d translation;
-        GfVec3f rotation, scale, pivot;
-        UsdGeomXformCommonAPI::RotationOrder rotOrder;
-        _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale, &pivot, &rotOrder,
-                                                GetViewportTimeCode(viewport));
-
-        _rotateMatrixOnBegin =
-            UsdGeomXformOp::GetOpTransform(UsdGeomXformCommonAPI::ConvertRotationOrderToOpType(rotOrder), VtValue(rotation));
     }
-    BeginEdition(viewport.GetCurrentStage());
 }
 
 Manipulator *RotationManipulator::OnUpdate(Viewport &viewport) {
     if (ImGui::IsMouseReleased(0)) {
         return viewport.GetManipulator<MouseHoverManipulator>();
     }
+    auto &targets = viewport.GetManipulatorTargets();
     if (_xformable && _selectedAxis != None) {
 
         // Compute rotation angle in world coordinates
@@ -247,69 +237,56 @@ Manipulator *RotationManipulator::OnUpdate(Viewport &viewport) {
         const GfRotation worldRotation(_rotateFrom, rotateTo);
         const auto axisSign = _planeNormal3d * worldRotation.GetAxis() > 0 ? 1.0 : -1.0;
 
-        // Compute rotation axis in local coordinates
-        // We use the plane normal as the rotation between _rotateFrom and rotateTo might not land exactly on the rotation axis
-        const GfVec3d xAxis = _rotateMatrixOnBegin.GetRow3(0);
-        const GfVec3d yAxis = _rotateMatrixOnBegin.GetRow3(1);
-        const GfVec3d zAxis = _rotateMatrixOnBegin.GetRow3(2);
-
-        GfVec3d localPlaneNormal = xAxis; // default init
-        if (_selectedAxis == XAxis) {
-            localPlaneNormal = xAxis;
-        } else if (_selectedAxis == YAxis) {
-            localPlaneNormal = yAxis;
-        } else if (_selectedAxis == ZAxis) {
-            localPlaneNormal = zAxis;
-        }
-
-        const GfRotation deltaRotation(localPlaneNormal * axisSign, worldRotation.GetAngle());
-        // NOTE: should that be _rotateMatrixOnBegin * deltaRotation instead ? the formula for opTrans use this order
-        const GfMatrix4d resultingRotation = GfMatrix4d(1.0).SetRotate(deltaRotation) * _rotateMatrixOnBegin;
+        // Each target rotates around its own local axis by the same angle
+        targets.Update([&](const ManipulatorTarget &target) {
+            const GfMatrix4d rotateMatrixOnBegin = UsdGeomXformOp::GetOpTransform(
+                UsdGeomXformCommonAPI::ConvertRotationOrderToOpType(target.rotOrder), VtValue(target.rotation));
+
+            // Compute rotation axis in local coordinates
+            // We use the plane normal as the rotation between _rotateFrom and rotateTo might not land exactly on the rotation axis
+            const GfVec3d xAxis = rotateMatrixOnBegin.GetRow3(0);
+            const GfVec3d yAxis = rotateMatrixOnBegin.GetRow3(1);
+            const GfVec3d zAxis = rotateMatrixOnBegin.GetRow3(2);
+
+            GfVec3d localPlaneNormal = xAxis; // default init
+            if (_selectedAxis == XAxis) {
+                localPlaneNormal = xAxis;
+            } else if (_selectedAxis == YAxis) {
+                localPlaneNormal = yAxis;
+            } else if (_selectedAxis == ZAxis) {
+                localPlaneNormal = zAxis;
+            }
 
-        // Get latest rotation values to give a hint to the decompose function
-        GfVec3d translation;
-        GfVec3f rotation, scale, pivot;
-        UsdGeomXformCommonAPI::RotationOrder rotOrder;
-        _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale, &pivot, &rotOrder,
-                                                GetViewportTimeCode(viewport));
-        double thetaTw = GfDegreesToRadians(rotation[0]);
-        double thetaFB = GfDegreesToRadians(rotation[1]);
-        double thetaLR = GfDegreesToRadians(rotation[2]);
-        double thetaSw = 0.0;
-        // Decompose the matrix in angle values
-        GfRotation::DecomposeRotation(resultingRotation, xAxis, yAxis, zAxis, 1.0, &thetaTw, &thetaFB, &thetaLR, &thetaSw, true);
-        const GfVec3f newRotationValues =
-            GfVec3f(GfRadiansToDegrees(thetaTw), GfRadiansToDegrees(thetaFB), GfRadiansToDegrees(thetaLR));
-        if (_xformAPI) {
-            _xformAPI.SetRotate(newRotationValues, rotOrder, GetEditionTimeCode(viewport));
-        } else { // Modify only if we have a single matrix
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
+            const GfRotation deltaRotation(localPlaneNormal * axisSign, worldRotation.GetAngle());
+            // NOTE: should that be rotateMatrixOnBegin * deltaRotation instead ? the formula for opTrans use this order
+            const GfMatrix4d resultingRotation = GfMatrix4d(1.0).SetRotate(deltaRotation) * rotateMatrixOnBegin;
+
+            if (target.rotateOp) {
+                // The rotation values on begin are the hint of the decompose function
+                double thetaTw = GfDegreesToRadians(target.rotation[0]);
+                double thetaFB = GfDegreesToRadians(target.rotation[1]);
+                double thetaLR = GfDegreesToRadians(target.rotation[2]);
+                double thetaSw = 0.0;
+                // Decompose the matrix in angle values
+                GfRotation::DecomposeRotation(resultingRotation, xAxis, yAxis, zAxis, 1.0, &thetaTw, &thetaFB, &thetaLR,
+                                              &thetaSw, true);
+                const GfVec3f newRotationValues =
+                    GfVec3f(GfRadiansToDegrees(thetaTw), GfRadiansToDegrees(thetaFB), GfRadiansToDegrees(thetaLR));
+                SetXformOpValue(target.rotateOp, VtValue(newRotationValues), target.editionTimeCode);
+            } else if (target.transformOp) { // Modify only if we have a single matrix
                 // [ "xformOp:translate", "xformOp:translate:pivot", "xformOp:rotateXYZ",
                 // "xformOp:scale", "!invert!xformOp:translate:pivot" ] - No pivot here
-                GfMatrix4d current = GfMatrix4d().SetScale(scale) * _rotateMatrixOnBegin *
-                                     GfMatrix4d(1.0).SetRotate(deltaRotation) * GfMatrix4d().SetTranslate(translation);
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+                const GfMatrix4d current = GfMatrix4d().SetScale(target.scale) * rotateMatrixOnBegin *
+                                           GfMatrix4d(1.0).SetRotate(deltaRotation) *
+                                           GfMatrix4d().SetTranslate(target.translation);
+                SetXformOpValue(target.transformOp, VtValue(current), target.editionTimeCode);
             }
-        }
+        });
     }
 
     return this;
 };
 
-void RotationManipulator::OnEndEdition(Viewport &) { EndEdition(); }
-
-// TODO code should be shared with position manipulator
-UsdTimeCode RotationManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return GetViewportTimeCode(viewport);
-    }
-}
+void RotationManipulator::OnEndEdition(Viewport &viewport) { viewport.GetManipulatorTargets().EndEdition(); }
 
 UsdTimeCode RotationManipulator::GetViewportTimeCode(const Viewport &viewport) { return viewport.GetCurrentTimeCode(); }
@@ -31,7 +31,6 @@ class RotationManipulator : public Manipulator {
     void OnSelectionChange(Viewport &) override;
 
   private:
-    UsdTimeCode GetEditionTimeCode(const Viewport &);
     UsdTimeCode GetViewportTimeCode(const Viewport &);
 
     GfVec3d ComputeClockHandVector(Viewport &viewport);
@@ -43,7 +42,6 @@ class RotationManipulator : public Manipulator {
     UsdGeomXformable _xformable;
 
     GfVec3d _rotateFrom;
-    GfMatrix4d _rotateMatrixOnBegin;
 
     GfVec3d _planeOrigin3d; // Global
     GfVec3d _planeNormal3d; // TODO rename global
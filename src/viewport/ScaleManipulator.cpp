@@ -63,10 +63,9 @@ bool ScaleManipulator::IsMouseOver(const Viewport &viewport) {
 
 // Same as rotation manipulator now -- TODO : share in a common class
 void ScaleManipulator::OnSelectionChange(Viewport &viewport) {
-    auto &selection = viewport.GetSelection();
-    auto primPath = selection.GetAnchorPrimPath(viewport.GetCurrentStage());
-    _xformAPI = UsdGeomXformCommonAPI(viewport.GetCurrentStage()->GetPrimAtPath(primPath));
-    _xformable = UsdGeomXformable(_xformAPI.GetPrim());
+    const auto &targets = viewport.GetManipulatorTargets();
+    _xformAPI = targets.GetAnchorXformAPI();
+    _xformable = targets.GetAnchorXformable();
 }
 
 GfMatrix4d ScaleManipulator::ComputeManipulatorToWorldTransform(const Viewport &viewport) {
@@ -79,7 +78,7 @@ GfMatrix4d ScaleManipulator::ComputeManipulatorToWorldTransform(const Viewport &
         const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
         const auto pivotMat = GfMatrix4d(1.0).SetTranslate(pivot);
         const auto rotMat = _xformAPI.GetRotationTransform(rotation, rotOrder);
-        const auto parentToWorld = _xformable.ComputeParentToWorldTransform(currentTime);
+        const auto parentToWorld = viewport.GetGeometryCache().GetParentToWorldTransform(_xformable.GetPrim());
 
         // We are just interested in the pivot position and the orientation
         const GfMatrix4d toManipulator = rotMat * pivotMat * transMat * parentToWorld;
@@ -139,19 +138,13 @@ void ScaleManipulator::OnDrawFrame(const Viewport &viewport) {
 }
 
 void ScaleManipulator::OnBeginEdition(Viewport &viewport) {
-    // Save original translation values
-    GfVec3d translation;
-    GfVec3f pivot, rotation;
-    UsdGeomXformCommonAPI::RotationOrder rotOrder;
-    _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &_scaleOnBegin, &pivot, &rotOrder,
-                                            viewport.GetCurrentTimeCode());
+    // Save original scale values of all the selected prims
+    viewport.GetManipulatorTargets().BeginEdition(viewport, UsdGeomXformCommonAPI::OpScale);
 
     // Save mouse position on selected axis
     const GfMatrix4d objectTransform = ComputeManipulatorToWorldTransform(viewport);
     _axisLine = GfLine(objectTransform.ExtractTranslation(), objectTransform.GetRow3(_selectedAxis));
     ProjectMouseOnAxis(viewport, _originMouseOnAxis);
-
-    BeginEdition(viewport.GetCurrentStage());
 }
 
 Manipulator *ScaleManipulator::OnUpdate(Viewport &viewport) {
@@ -160,52 +153,35 @@ Manipulator *ScaleManipulator::OnUpdate(Viewport &viewport) {
         return viewport.GetManipulator<MouseHoverManipulator>();
     }
 
-    if (_xformable && _selectedAxis < 3) {
+    auto &targets = viewport.GetManipulatorTargets();
+    if (_xformable && _selectedAxis < 3 && _originMouseOnAxis.GetLength() > 0.0) {
         GfVec3d mouseOnAxis;
         ProjectMouseOnAxis(viewport, mouseOnAxis);
 
-        // Get the sign
-        double ori;
-        double cur;
-        _axisLine.FindClosestPoint(_originMouseOnAxis, &ori);
-        _axisLine.FindClosestPoint(mouseOnAxis, &cur);
-        double sign = cur > ori ? 1.0 : -1.0;
-
-        GfVec3f scale = _scaleOnBegin;
-
-        // TODO division per zero check
-        scale[_selectedAxis] = _scaleOnBegin[_selectedAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-
-        if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
-            scale[XAxis] = _scaleOnBegin[XAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-            scale[YAxis] = _scaleOnBegin[YAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-            scale[ZAxis] = _scaleOnBegin[XAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-        } else {
-            scale[_selectedAxis] = _scaleOnBegin[_selectedAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
-        }
-
-        if (_xformAPI) {
-            _xformAPI.SetScale(scale, GetEditionTimeCode(viewport));
-        } else {
-            bool reset = false;
-            auto ops = _xformable.GetOrderedXformOps(&reset);
-            if (ops.size() == 1 && ops[0].GetOpType() == UsdGeomXformOp::Type::TypeTransform) {
-                GfVec3d translation;
-                GfVec3f scale_, pivot, rotation;
-                UsdGeomXformCommonAPI::RotationOrder rotOrder;
-                _xformAPI.GetXformVectorsByAccumulation(&translation, &rotation, &scale_, &pivot, &rotOrder,
-                                                        GetEditionTimeCode(viewport));
-                const auto transMat = GfMatrix4d(1.0).SetTranslate(translation);
-                const auto rotMat = _xformAPI.GetRotationTransform(rotation, rotOrder);
-                GfMatrix4d current = GfMatrix4d().SetScale(scale) * rotMat * transMat;
-                ops[0].Set(current, GetEditionTimeCode(viewport));
+        // The same ratio is applied on the scale of all the targets
+        const float ratio = static_cast<float>(mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength());
+        const bool uniformScale = ImGui::IsKeyDown(ImGuiKey_LeftShift);
+        targets.Update([&](const ManipulatorTarget &target) {
+            GfVec3f scale = target.scale;
+            if (uniformScale) {
+                scale *= ratio;
+            } else {
+                scale[_selectedAxis] *= ratio;
             }
-        }
+            if (target.scaleOp) {
+                SetXformOpValue(target.scaleOp, VtValue(scale), target.editionTimeCode);
+            } else if (target.transformOp) {
+                const auto transMat = GfMatrix4d(1.0).SetTranslate(target.translation);
+                const auto rotMat = UsdGeomXformCommonAPI::GetRotationTransform(target.rotation, target.rotOrder);
+                const GfMatrix4d current = GfMatrix4d().SetScale(scale) * rotMat * transMat;
+                SetXformOpValue(target.transformOp, VtValue(current), target.editionTimeCode);
+            }
+        });
     }
     return this;
 };
 
-void ScaleManipulator::OnEndEdition(Viewport &) { EndEdition(); };
+void ScaleManipulator::OnEndEdition(Viewport &viewport) { viewport.GetManipulatorTargets().EndEdition(); };
 
 ///
 void ScaleManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &linePoint) {
@@ -218,14 +194,3 @@ void ScaleManipulator::ProjectMouseOnAxis(const Viewport &viewport, GfVec3d &lin
         GfFindClosestPoints(mouseRay, _axisLine, &rayPoint, &linePoint, &a, &b);
     }
 }
-
-UsdTimeCode ScaleManipulator::GetEditionTimeCode(const Viewport &viewport) {
-    std::vector<double> timeSamples; // TODO: is there a faster way to know it the xformable has timesamples ?
-    const auto xformable = UsdGeomXformable(_xformAPI.GetPrim());
-    xformable.GetTimeSamples(&timeSamples);
-    if (timeSamples.empty()) {
-        return UsdTimeCode::Default();
-    } else {
-        return viewport.GetCurrentTimeCode();
-    }
-}
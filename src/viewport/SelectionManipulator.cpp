@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <pxr/usd/kind/registry.h>
 #include <pxr/usd/usd/modelAPI.h>
 #include <pxr/usd/usd/prim.h>
@@ -33,19 +34,81 @@ bool SelectionManipulator::IsPickablePath(const UsdStage &stage, const SdfPath &
     return false;
 }
 
+SdfPath SelectionManipulator::GetPickablePath(const UsdStage &stage, SdfPath path) {
+    while (!IsPickablePath(stage, path)) {
+        path = path.GetParentPath();
+    }
+    return path;
+}
+
+void SelectionManipulator::OnBeginEdition(Viewport &viewport) {
+    _rectangleStart = viewport.GetMousePosition();
+    _rectangleEnd = _rectangleStart;
+    _isDrawingRectangle = false;
+}
+
 Manipulator *SelectionManipulator::OnUpdate(Viewport &viewport) {
+    if (ImGui::IsMouseDown(0)) {
+        // The rectangle starts when the mouse moves a few pixels away from the click
+        _rectangleEnd = viewport.GetMousePosition();
+        if (!_isDrawingRectangle && ImGui::IsMouseDragging(0)) {
+            _isDrawingRectangle = true;
+        }
+        return this;
+    }
+    if (_isDrawingRectangle) {
+        SelectInRectangle(viewport);
+    } else {
+        SelectUnderMouse(viewport);
+    }
+    _isDrawingRectangle = false;
+    return viewport.GetManipulator<MouseHoverManipulator>();
+}
+
+void SelectionManipulator::SelectInRectangle(Viewport &viewport) {
+    const UsdStageRefPtr &stage = viewport.GetCurrentStage();
+    if (!stage) {
+        return;
+    }
+    const bool addToSelection = ImGui::IsKeyDown(ImGuiKey_LeftShift);
+    SdfPathVector hitPrimPaths;
+    viewport.TestAreaIntersection(_rectangleStart, _rectangleEnd, hitPrimPaths);
+
+    // Replace the hits by their pickable ancestor, the consecutive duplicates are skipped early.
+    // The hits without a pickable ancestor resolve to the root and are dropped, they would select the whole stage
+    SdfPathVector selectedPaths;
+    selectedPaths.reserve(hitPrimPaths.size());
+    for (const SdfPath &hitPrimPath : hitPrimPaths) {
+        const SdfPath pickablePath = GetPickablePath(*stage, hitPrimPath);
+        if (pickablePath == SdfPath::AbsoluteRootPath()) {
+            continue;
+        }
+        if (selectedPaths.empty() || selectedPaths.back() != pickablePath) {
+            selectedPaths.push_back(pickablePath);
+        }
+    }
+    std::sort(selectedPaths.begin(), selectedPaths.end());
+    selectedPaths.erase(std::unique(selectedPaths.begin(), selectedPaths.end()), selectedPaths.end());
+    if (!selectedPaths.empty() || !addToSelection) {
+        ExecuteAfterDraw<EditorSetSelectedPaths>(stage, std::move(selectedPaths), addToSelection);
+    }
+}
+
+void SelectionManipulator::SelectUnderMouse(Viewport &viewport) {
     Selection &selection = viewport.GetSelection();
     auto mousePosition = viewport.GetMousePosition();
     SdfPath outHitPrimPath;
     SdfPath outHitInstancerPath;
     int outHitInstanceIndex = 0;
     viewport.TestIntersection(mousePosition, outHitPrimPath, outHitInstancerPath, outHitInstanceIndex);
-    if (!outHitPrimPath.IsEmpty()) {
-        if (viewport.GetCurrentStage()) {
-            while (!IsPickablePath(*viewport.GetCurrentStage(), outHitPrimPath)) {
-                outHitPrimPath = outHitPrimPath.GetParentPath();
-            }
+    // A hit without a pickable ancestor is like a click in the void, it doesn't select the root
+    if (!outHitPrimPath.IsEmpty() && viewport.GetCurrentStage()) {
+        outHitPrimPath = GetPickablePath(*viewport.GetCurrentStage(), outHitPrimPath);
+        if (outHitPrimPath == SdfPath::AbsoluteRootPath()) {
+            outHitPrimPath = SdfPath();
         }
+    }
+    if (!outHitPrimPath.IsEmpty()) {
 
         if (ImGui::IsKeyDown(ImGuiKey_LeftShift)) {
             // TODO: a command
@@ -56,11 +119,22 @@ Manipulator *SelectionManipulator::OnUpdate(Viewport &viewport) {
     } else if (outHitInstancerPath.IsEmpty()) {
         selection.Clear(viewport.GetCurrentStage());
     }
-    return viewport.GetManipulator<MouseHoverManipulator>();
 }
 
 void SelectionManipulator::OnDrawFrame(const Viewport &) {
-    // Draw a rectangle for the selection
+    if (!_isDrawingRectangle) {
+        return;
+    }
+    // Normalized coordinates to texture coordinates, like the other manipulators
+    const ImGuiViewport *viewport = ImGui::GetMainViewport();
+    const auto toScreen = [&](const GfVec2d &position) {
+        return ImVec2((position[0] * 0.5 + 0.5) * viewport->WorkSize[0], (-position[1] * 0.5 + 0.5) * viewport->WorkSize[1]);
+    };
+    const ImVec2 start = toScreen(_rectangleStart);
+    const ImVec2 end = toScreen(_rectangleEnd);
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(ImMin(start, end), ImMax(start, end), ImColor(ImVec4(0.3, 0.5, 1.0, 0.15)));
+    drawList->AddRect(ImMin(start, end), ImMax(start, end), ImColor(ImVec4(0.3, 0.5, 1.0, 0.8)));
 }
 
 void DrawPickMode(SelectionManipulator &manipulator) {
@@ -1,15 +1,19 @@
 #pragma once
+#include <pxr/base/gf/vec2d.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
 #include "Manipulator.h"
 
-/// The selection manipulator will help selecting a region of the viewport, drawing a rectangle.
+/// The selection manipulator selects the prim under the mouse when clicking, or all the prims
+/// inside the rectangle drawn when dragging.
 class SelectionManipulator : public Manipulator {
   public:
     SelectionManipulator() = default;
     ~SelectionManipulator() = default;
 
+    void OnBeginEdition(Viewport &) override;
+
     void OnDrawFrame(const Viewport &) override;
 
     Manipulator *OnUpdate(Viewport &) override;
@@ -22,7 +26,19 @@ class SelectionManipulator : public Manipulator {
   private:
     // Returns true
     bool IsPickablePath(const class UsdStage &stage, const class SdfPath &path);
+
+    // Returns the closest pickable ancestor of path, or path itself
+    SdfPath GetPickablePath(const class UsdStage &stage, SdfPath path);
+
+    void SelectUnderMouse(Viewport &viewport);
+    void SelectInRectangle(Viewport &viewport);
+
     PickMode _pickMode = PickMode::Prim;
+
+    // Rectangle selection, in normalized viewport coordinates
+    GfVec2d _rectangleStart;
+    GfVec2d _rectangleEnd;
+    bool _isDrawingRectangle = false;
 };
 
 /// Draw an ImGui menu to select the picking mode
@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <pxr/imaging/garch/glApi.h>
+#include <pxr/imaging/hdx/pickTask.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdGeom/bboxCache.h>
 #include <pxr/usd/usdGeom/boundable.h>
@@ -16,6 +19,7 @@
 #include "Shortcuts.h"
 #include "UsdPrimEditor.h" // DrawUsdPrimEditTarget
 #include "Viewport.h"
+#include "runtime/profiler.h"
 
 namespace clk = std::chrono;
 
@@ -25,6 +29,8 @@ void Viewport::DrawMenuBar() {
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("Renderer")) {
             if (_renderer) {
+                // The renderer, its settings and its AOV can change at any frame while the menu is opened
+                _sharedRenderer->sceneVersion++;
                 DrawRendererControls(*_renderer);
                 DrawRendererSelectionCombo(*_renderer);
                 DrawColorCorrection(*_renderer, _imagingSettings);
@@ -41,6 +47,8 @@ void Viewport::DrawMenuBar() {
             if (_renderer) {
                 DrawImagingSettings(*_renderer, _imagingSettings);
                 ImGui::Checkbox("Show UI", &_imagingSettings.showUI);
+                ImGui::Checkbox("CPU picking", &_cpuPicking);
+                ImGui::Checkbox("Adaptive resolution", &_adaptiveResolution);
             }
             ImGui::EndMenu();
         }
@@ -59,6 +67,8 @@ Viewport::Viewport(UsdStageRefPtr stage, Selection &selection)
     : _stage(stage), _cameraManipulator({InitialWindowWidth, InitialWindowHeight}),
       _currentEditingState(new MouseHoverManipulator()), _activeManipulator(&_positionManipulator), _selection(selection),
       _textureSize(1, 1), _viewportName("Viewport 1") {
+    _geometryCache.SetStage(_stage);
+    _geometryCache.SetTime(GetCurrentTimeCode());
 
     // Viewport draw target
     _cameraManipulator.ResetPosition(GetEditableCamera());
@@ -73,16 +83,83 @@ Viewport::Viewport(UsdStageRefPtr stage, Selection &selection)
 }
 
 Viewport::~Viewport() {
-    if (_renderer) {
-        _renderer = nullptr; // will be deleted in the map
-    }
     // Delete renderers
     _drawTarget->Bind();
-    _renderer = nullptr;
-    _renderStage = nullptr;
+    ReleaseRenderer();
     _drawTarget->Unbind();
 }
 
+// The viewports displaying the same stage share a renderer. The map doesn't keep the renderers alive, a renderer is
+// deleted with the last viewport using it.
+static std::map<UsdStage *, std::weak_ptr<ViewportRenderer>> sharedRenderers;
+
+void Viewport::AcquireRenderer() {
+    ReleaseRenderer();
+    auto &sharedRenderer = sharedRenderers[get_pointer(GetCurrentStage())];
+    _sharedRenderer = sharedRenderer.lock();
+    if (!_sharedRenderer) {
+        SdfPathVector excludedPaths;
+        _sharedRenderer = std::make_shared<ViewportRenderer>();
+        _sharedRenderer->engine =
+            std::make_unique<runtime::RuntimeEngine>(GetCurrentStage()->GetPseudoRoot().GetPath(), excludedPaths);
+        // The first viewport of the stage gives its scene display settings
+        _sharedRenderer->complexity = _imagingSettings.complexity;
+        _sharedRenderer->enableSceneMaterials = _imagingSettings.enableSceneMaterials;
+        _sharedRenderer->enableSceneLights = _imagingSettings.enableSceneLights;
+        _sharedRenderer->engine->SetSceneDisplaySettings(_imagingSettings.complexity, _imagingSettings.enableSceneMaterials,
+                                                         _imagingSettings.enableSceneLights);
+        sharedRenderer = _sharedRenderer;
+    }
+    _renderer = _sharedRenderer->engine.get();
+    _rendererView = _renderer->AddView();
+    _renderer->SetActiveView(_rendererView);
+    _sceneDisplayVersion = _sharedRenderer->sceneDisplayVersion;
+    _imagingSettings.complexity = _sharedRenderer->complexity;
+    _imagingSettings.enableSceneMaterials = _sharedRenderer->enableSceneMaterials;
+    _imagingSettings.enableSceneLights = _sharedRenderer->enableSceneLights;
+    _renderStage = GetCurrentStage();
+    _isRenderDirty = true;
+}
+
+void Viewport::ReleaseRenderer() {
+    if (_renderer) {
+        _renderer->RemoveView(_rendererView);
+        _renderer = nullptr;
+    }
+    // Releasing the last reference deletes the engine and its physics engine
+    _sharedRenderer = nullptr;
+    for (auto it = sharedRenderers.begin(); it != sharedRenderers.end();) {
+        it = it->second.expired() ? sharedRenderers.erase(it) : std::next(it);
+    }
+    _renderStage = nullptr;
+}
+
+void Viewport::ActivateRendererView() {
+    if (_renderer) {
+        _renderer->SetActiveView(_rendererView);
+    }
+}
+
+void Viewport::SyncSceneDisplaySettings() {
+    ViewportRenderer &shared = *_sharedRenderer;
+    // The settings of a viewport having seen the last shared ones differ only when they were edited in this viewport
+    const bool isEdited = _imagingSettings.complexity != shared.complexity ||
+                          _imagingSettings.enableSceneMaterials != shared.enableSceneMaterials ||
+                          _imagingSettings.enableSceneLights != shared.enableSceneLights;
+    if (isEdited && _sceneDisplayVersion == shared.sceneDisplayVersion) {
+        shared.complexity = _imagingSettings.complexity;
+        shared.enableSceneMaterials = _imagingSettings.enableSceneMaterials;
+        shared.enableSceneLights = _imagingSettings.enableSceneLights;
+        shared.sceneDisplayVersion++;
+        shared.sceneVersion++;
+        _renderer->SetSceneDisplaySettings(shared.complexity, shared.enableSceneMaterials, shared.enableSceneLights);
+    }
+    _imagingSettings.complexity = shared.complexity;
+    _imagingSettings.enableSceneMaterials = shared.enableSceneMaterials;
+    _imagingSettings.enableSceneLights = shared.enableSceneLights;
+    _sceneDisplayVersion = shared.sceneDisplayVersion;
+}
+
 static void DrawOpenedStages() {
     ScopedStyleColor defaultStyle(DefaultColorStyle);
     const UsdStageCache &stageCache = UsdUtilsStageCache::Get();
@@ -96,6 +173,8 @@ static void DrawOpenedStages() {
 
 /// Draw the viewport widget
 void Viewport::Draw() {
+    // The menus and the manipulators edit and pick with the view of this viewport
+    ActivateRendererView();
     if (_imagingSettings.showViewportMenu) {
         DrawMenuBar();
     }
@@ -137,6 +216,7 @@ void Viewport::DrawToolBar(const ImVec2 widgetPosition) {
     ImGui::SameLine();
     ImGui::Button(ICON_FA_USER_COG);
     if (_renderer && ImGui::BeginPopupContextItem(nullptr, flags)) {
+        _sharedRenderer->sceneVersion++;
         DrawRendererControls(*_renderer);
         DrawRendererSelectionCombo(*_renderer);
         DrawColorCorrection(*_renderer, _imagingSettings);
@@ -156,6 +236,7 @@ void Viewport::DrawToolBar(const ImVec2 widgetPosition) {
     if (_renderer && ImGui::BeginPopupContextItem(nullptr, flags)) {
         DrawImagingSettings(*_renderer, _imagingSettings);
         ImGui::Checkbox("Show menu bar", &_imagingSettings.showViewportMenu);
+        ImGui::Checkbox("CPU picking", &_cpuPicking);
         ImGui::EndPopup();
     }
     if (ImGui::IsItemHovered() && GImGui->HoveredIdTimer > 1) {
@@ -206,7 +287,7 @@ void Viewport::DrawToolBar(const ImVec2 widgetPosition) {
     ImGui::SameLine();
     ImGui::Button(ICON_FA_ROBOT);
     if (_renderer && ImGui::BeginPopupContextItem(nullptr, flags)) {
-        _physicsSettings.DrawSettings();
+        _sharedRenderer->physicsSettings.DrawSettings();
         ImGui::EndPopup();
     }
     if (ImGui::IsItemHovered() && GImGui->HoveredIdTimer > 1) {
@@ -260,12 +341,7 @@ void Viewport::DrawManipulatorToolbox(const ImVec2 widgetPosition) {
 /// Frame the viewport using the bounding box of the selection
 void Viewport::FrameCameraOnSelection(const Selection &selection) { // Camera manipulator ???
     if (GetCurrentStage() && !selection.IsSelectionEmpty(GetCurrentStage())) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
-        GfBBox3d bbox;
-        for (const auto &primPath : selection.GetSelectedPaths(GetCurrentStage())) {
-            bbox = GfBBox3d::Combine(bboxcache.ComputeWorldBound(GetCurrentStage()->GetPrimAtPath(primPath)), bbox);
-        }
-        auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
+        const GfBBox3d bbox = _geometryCache.ComputeWorldBound(selection.GetSelectedPaths(GetCurrentStage()));
         _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bbox);
     }
 }
@@ -273,30 +349,23 @@ void Viewport::FrameCameraOnSelection(const Selection &selection) { // Camera ma
 /// Frame the viewport using the bounding box of the root prim
 void Viewport::FrameCameraOnRootPrim() {
     if (GetCurrentStage()) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
         auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
         if (defaultPrim) {
-            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bboxcache.ComputeWorldBound(defaultPrim));
+            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), _geometryCache.ComputeWorldBound(defaultPrim));
         } else {
             auto rootPrim = GetCurrentStage()->GetPrimAtPath(SdfPath("/"));
-            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), bboxcache.ComputeWorldBound(rootPrim));
+            _cameraManipulator.FrameBoundingBox(GetEditableCamera(), _geometryCache.ComputeWorldBound(rootPrim));
         }
     }
 }
 
 void Viewport::FrameAllCameras() {
     if (GetCurrentStage()) {
-        UsdGeomBBoxCache bboxcache(_imagingSettings.frame, UsdGeomImageable::GetOrderedPurposeTokens());
+        // The bound is computed once and shared by all the cameras
         auto defaultPrim = GetCurrentStage()->GetDefaultPrim();
-        if (defaultPrim) {
-            for (GfCamera *camera : _cameras.GetEditableCameras(GetCurrentStage())) {
-                _cameraManipulator.FrameBoundingBox(*camera, bboxcache.ComputeWorldBound(defaultPrim));
-            }
-        } else {
-            for (GfCamera *camera : _cameras.GetEditableCameras(GetCurrentStage())) {
-                auto rootPrim = GetCurrentStage()->GetPrimAtPath(SdfPath("/"));
-                _cameraManipulator.FrameBoundingBox(*camera, bboxcache.ComputeWorldBound(rootPrim));
-            }
+        const GfBBox3d bbox = _geometryCache.ComputeWorldBound(defaultPrim ? defaultPrim : GetCurrentStage()->GetPseudoRoot());
+        for (GfCamera *camera : _cameras.GetEditableCameras(GetCurrentStage())) {
+            _cameraManipulator.FrameBoundingBox(*camera, bbox);
         }
     }
 }
@@ -383,17 +452,26 @@ void Viewport::HandleManipulationEvents() {
     ImGuiContext *g = ImGui::GetCurrentContext();
     ImGuiIO &io = ImGui::GetIO();
 
+    // The selection rectangle keeps being drawn while the button is held outside of the image, up to its border
+    const bool isSelectingOutside = !ImGui::IsItemHovered() && _currentEditingState == &_selectionManipulator &&
+                                    ImGui::IsMouseDown(ImGuiMouseButton_Left);
+
     // Check the mouse is over this widget
-    if (ImGui::IsItemHovered()) {
-        const GfVec2i drawTargetSize = _drawTarget->GetSize();
-        if (drawTargetSize[0] == 0 || drawTargetSize[1] == 0)
+    if (ImGui::IsItemHovered() || isSelectingOutside) {
+        // The image size is used as the draw target is not resized until the window size is stable
+        const ImVec2 imageSize = g->LastItemData.Rect.GetSize();
+        if (imageSize.x <= 0.f || imageSize.y <= 0.f)
             return;
         _mousePosition[0] =
-            2.0 * (static_cast<double>(io.MousePos.x - (g->LastItemData.Rect.Min.x)) / static_cast<double>(drawTargetSize[0])) -
+            2.0 * (static_cast<double>(io.MousePos.x - (g->LastItemData.Rect.Min.x)) / static_cast<double>(imageSize.x)) -
             1.0;
         _mousePosition[1] =
-            -2.0 * (static_cast<double>(io.MousePos.y - (g->LastItemData.Rect.Min.y)) / static_cast<double>(drawTargetSize[1])) +
+            -2.0 * (static_cast<double>(io.MousePos.y - (g->LastItemData.Rect.Min.y)) / static_cast<double>(imageSize.y)) +
             1.0;
+        if (isSelectingOutside) {
+            _mousePosition[0] = std::clamp(_mousePosition[0], -1.0, 1.0);
+            _mousePosition[1] = std::clamp(_mousePosition[1], -1.0, 1.0);
+        }
 
         /// This works like a Finite state machine
         /// where every manipulator/editor is a state
@@ -418,6 +496,10 @@ void Viewport::HandleManipulationEvents() {
 
 GfVec2i Viewport::GetViewportSize() const { return _drawTarget->GetSize(); }
 
+bool Viewport::IsInteracting() const {
+    return _currentEditingState && _currentEditingState != &_mouseHover && _currentEditingState != &_selectionManipulator;
+}
+
 GfCamera &Viewport::GetEditableCamera() { return _cameras.GetEditableCamera(); }
 const GfCamera &Viewport::GetCurrentCamera() const { return _cameras.GetCurrentCamera(); }
 
@@ -470,18 +552,32 @@ void Viewport::BeginHydraUI(int width, int height) {
 
 void Viewport ::EndHydraUI() { ImGui::End(); }
 
-void Viewport::Render() {
+bool Viewport::Render() {
+    RUNTIME_PROFILE_SCOPE("Viewport render");
+    ActivateRendererView();
     GfVec2i renderSize = _drawTarget->GetSize();
     int width = renderSize[0];
     int height = renderSize[1];
 
     if (width == 0 || height == 0)
-        return;
+        return false;
+
+    // Nothing changed, the texture still has the last image
+    ViewportRenderState renderState = GetRenderState(width, height);
+    if (!_isRenderDirty && renderState == _renderState) {
+        return false;
+    }
+    _renderState = std::move(renderState);
+    _isRenderDirty = false;
 
     // Draw active manipulator and HUD
     if (_imagingSettings.showGizmos) {
         BeginHydraUI(width, height);
         GetActiveManipulator().OnDrawFrame(*this);
+        // The selection rectangle is drawn while it is the current state
+        if (_currentEditingState == GetManipulator<SelectionManipulator>()) {
+            _currentEditingState->OnDrawFrame(*this);
+        }
         // DrawHUD(this);
         EndHydraUI();
     }
@@ -494,6 +590,19 @@ void Viewport::Render() {
     glViewport(0, 0, width, height);
 
     if (_renderer && GetCurrentStage()) {
+        // Hydra renders in a smaller draw target when the resolution is reduced, it is stretched on the draw target
+        // before the grid and the gizmos are drawn at full resolution
+        const float renderScale = _resolutionGovernor.GetScale();
+        const GfVec2i scaledSize(std::max(1, static_cast<int>(width * renderScale)),
+                                 std::max(1, static_cast<int>(height * renderScale)));
+        const bool isScaled = scaledSize != renderSize;
+        if (isScaled) {
+            BindScaledDrawTarget(scaledSize);
+            renderSize = scaledSize;
+            width = scaledSize[0];
+            height = scaledSize[1];
+        }
+
         // Render hydra
         // Set camera and lighting state
         _imagingSettings.SetLightPositionFromCamera(GetCurrentCamera());
@@ -529,7 +638,24 @@ void Viewport::Render() {
         _renderer->SetCameraState(viewportCamera.GetFrustum().ComputeViewMatrix(),
                                   viewportCamera.GetFrustum().ComputeProjectionMatrix());
         //      }
+        const auto renderStart = clk::steady_clock::now();
         _renderer->Render(GetCurrentStage()->GetPseudoRoot(), _imagingSettings);
+        _lastRenderTime = std::chrono::duration<float>(clk::steady_clock::now() - renderStart).count();
+        // A progressive renderer is rendered until it converges
+        _isRenderDirty = !_renderer->IsConverged();
+
+        if (isScaled) {
+            renderSize = _drawTarget->GetSize();
+            width = renderSize[0];
+            height = renderSize[1];
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, _scaledDrawTarget->GetFramebufferId());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _drawTarget->GetFramebufferId());
+            glBlitFramebuffer(0, 0, scaledSize[0], scaledSize[1], 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            // The depth can't be interpolated, the grid is still depth tested against the scene
+            glBlitFramebuffer(0, 0, scaledSize[0], scaledSize[1], 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            _scaledDrawTarget->Unbind();
+            glViewport(0, 0, width, height);
+        }
     } else {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
@@ -544,9 +670,93 @@ void Viewport::Render() {
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
     _drawTarget->Unbind();
+    return true;
+}
+
+bool Viewport::IsSimulating() const {
+    return _renderer && _sharedRenderer && _sharedRenderer->physicsSettings.update && GetCurrentStage();
 }
 
-void Viewport::SetCurrentTimeCode(const UsdTimeCode &tc) { _imagingSettings.frame = tc; }
+ViewportRenderState Viewport::GetRenderState(int width, int height) const {
+    ViewportRenderState state;
+    state.stage = get_pointer(GetCurrentStage());
+    state.camera = GetViewportCamera(width, height);
+    state.size = GfVec2i(width, height);
+    state.scale = _resolutionGovernor.GetScale();
+    state.imagingSettings = _imagingSettings;
+    state.selectionVersion = _selection.GetVersion(GetCurrentStage());
+    state.stageVersion = _geometryCache.GetStageVersion();
+    state.sceneVersion = _sharedRenderer ? _sharedRenderer->sceneVersion : 0;
+    // The mouse only changes the image when it moves a gizmo, highlights one of its axes or draws the selection rectangle
+    const bool isMouseOverGizmo = _currentEditingState == &_mouseHover && _imagingSettings.showGizmos &&
+                                  _activeManipulator && _activeManipulator->IsMouseOver(*this);
+    if (isMouseOverGizmo || (_currentEditingState && _currentEditingState != &_mouseHover &&
+                             _currentEditingState != &_cameraManipulator)) {
+        state.mousePosition = _mousePosition;
+    }
+    state.activeManipulator = _activeManipulator;
+    state.editingState = _currentEditingState;
+    return state;
+}
+
+bool ViewportRenderState::operator==(const ViewportRenderState &other) const {
+    // The lights are computed from the camera and the settings
+    const ImagingSettings &settings = imagingSettings;
+    const ImagingSettings &otherSettings = other.imagingSettings;
+    return stage == other.stage && camera == other.camera && size == other.size && scale == other.scale &&
+           selectionVersion == other.selectionVersion && stageVersion == other.stageVersion &&
+           sceneVersion == other.sceneVersion && mousePosition == other.mousePosition &&
+           activeManipulator == other.activeManipulator && editingState == other.editingState &&
+           static_cast<const runtime::UsdImagingGLRenderParams &>(settings) == otherSettings &&
+           settings.enableCameraLight == otherSettings.enableCameraLight && settings._material == otherSettings._material &&
+           settings._ambient == otherSettings._ambient && settings.showGrid == otherSettings.showGrid &&
+           settings.showGizmos == otherSettings.showGizmos;
+}
+
+void Viewport::BindScaledDrawTarget(const GfVec2i &size) {
+    if (!_scaledDrawTarget) {
+        _scaledDrawTarget = GlfDrawTarget::New(size, false);
+        _scaledDrawTarget->Bind();
+        _scaledDrawTarget->AddAttachment("color", GL_RGBA, GL_FLOAT, GL_RGBA);
+        _scaledDrawTarget->AddAttachment("depth", GL_DEPTH_COMPONENT, GL_FLOAT, GL_DEPTH_COMPONENT32F);
+    } else {
+        _scaledDrawTarget->Bind();
+        if (_scaledDrawTarget->GetSize() != size) {
+            _scaledDrawTarget->SetSize(size);
+        }
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, size[0], size[1]);
+}
+
+void Viewport::SetCurrentTimeCode(const UsdTimeCode &tc) {
+    _imagingSettings.frame = tc;
+    _geometryCache.SetTime(tc);
+}
+
+void Viewport::PrefetchPlayback(size_t memoryBudget) {
+    if (_renderer) {
+        _renderer->PrefetchPlayback(GetCurrentTimeCode(), memoryBudget);
+    }
+}
+
+void Viewport::WaitStageReads() {
+    if (_renderer) {
+        _renderer->WaitPlaybackPrefetch();
+    }
+    _scenePicker.Wait();
+}
+
+void Viewport::ClearPlaybackCache() {
+    if (_renderer) {
+        _renderer->ClearPlaybackCache();
+    }
+}
+
+void Viewport::SetCurrentStage(UsdStageRefPtr stage) {
+    _stage = stage;
+    _geometryCache.SetStage(stage);
+}
 
 /// Update anything that could have change after a frame render
 void Viewport::Update() {
@@ -554,12 +764,9 @@ void Viewport::Update() {
         bool firstTimeStageLoaded = false;
         if (_renderStage != GetCurrentStage()) {
             firstTimeStageLoaded = true;
-            SdfPathVector excludedPaths;
-
-            // must clear first to release physics engine
-            _renderer = nullptr;
-            _renderer = std::make_unique<runtime::RuntimeEngine>(GetCurrentStage()->GetPseudoRoot().GetPath(), excludedPaths);
-            _renderStage = GetCurrentStage();
+            AcquireRenderer();
+            _lastSelectionVersion = 0;
+            _scenePickerTimeCode = GetCurrentTimeCode();
 
             _cameraManipulator.SetZIsUp(UsdGeomGetStageUpAxis(GetCurrentStage()) == "Z");
             _grid.SetZIsUp(UsdGeomGetStageUpAxis(GetCurrentStage()) == "Z");
@@ -583,30 +790,82 @@ void Viewport::Update() {
         }
     }
 
+    // Resizing the draw target reallocates the render buffers, it is not done at every frame while the window is
+    // resized but when its size has not changed for a moment. The image is stretched in the meantime.
+    if (_textureSize != _requestedTextureSize) {
+        _requestedTextureSize = _textureSize;
+        _textureSizeChangeTime = clk::steady_clock::now();
+    }
     const GfVec2i &currentSize = _drawTarget->GetSize();
-    if (currentSize != _textureSize) {
+    if (currentSize != _textureSize &&
+        (currentSize == GfVec2i(1, 1) || clk::steady_clock::now() - _textureSizeChangeTime > clk::milliseconds(150))) {
         _drawTarget->Bind();
         _drawTarget->SetSize(_textureSize);
         _drawTarget->Unbind();
     }
 
-    if (_renderer && _selection.UpdateSelectionHash(GetCurrentStage(), _lastSelectionHash)) {
-        _renderer->ClearSelected();
-        _renderer->SetSelected(_selection.GetSelectedPaths(GetCurrentStage()));
+    if (_renderer) {
+        SyncSceneDisplaySettings();
+    }
 
-        // Tell the manipulators the selection has changed
-        _positionManipulator.OnSelectionChange(*this);
-        _rotationManipulator.OnSelectionChange(*this);
-        _scaleManipulator.OnSelectionChange(*this);
+    // The CPU picking hierarchy is updated in the background, hydra picks until it is ready.
+    // It stays at the time of the last pick, the playback doesn't recompute the time varying prims at every frame
+    if (_cpuPicking && GetCurrentStage()) {
+        _scenePicker.Update(GetCurrentStage(), _scenePickerTimeCode);
+    } else {
+        _scenePicker.Reset();
     }
 
+    // The shared renderer is updated by the first viewport of the frame
+    if (_renderer && _sharedRenderer->updatedFrame != ImGui::GetFrameCount()) {
+        _sharedRenderer->updatedFrame = ImGui::GetFrameCount();
 
-    if (_renderer) {
-        _renderer->SyncSettings(_physicsSettings);
-        if (_physicsSettings.update) {
-            _renderer->Update(1.0 / 60);
+        // Send the paths added and removed since the last frame to the renderer
+        SelectionChanges selectionChanges;
+        if (_selection.GetChanges(GetCurrentStage(), _sharedRenderer->selectionVersion, selectionChanges)) {
+            if (selectionChanges.cleared) {
+                _renderer->ClearSelected();
+            }
+            _renderer->RemoveSelected(selectionChanges.removed);
+            _renderer->AddSelected(selectionChanges.added);
+        }
+
+        PhysicsSettings &physicsSettings = _sharedRenderer->physicsSettings;
+        _renderer->SyncSettings(physicsSettings);
+        // The physics is stepped on the simulation thread at a fixed rate, here we only
+        // consume the steps completed since the last frame.
+        if (physicsSettings.update) {
+            _renderer->StartSimulation();
+        } else {
+            _renderer->StopSimulation();
+        }
+        if (_renderer->ConsumeSimulationResults()) {
+            _sharedRenderer->sceneVersion++;
+        }
+        if (_renderer->PollForAsynchronousUpdates()) {
+            _sharedRenderer->sceneVersion++;
         }
     }
+
+    // Lower the resolution while the view is moving and refine it when it stops, the render time is consumed once
+    const float lastRenderTime = _lastRenderTime;
+    _lastRenderTime = 0.f;
+    if (_renderer && _adaptiveResolution) {
+        ActivateRendererView();
+        _resolutionGovernor.Update(IsInteracting(), _renderer->IsConverged(), lastRenderTime);
+    } else {
+        _resolutionGovernor.Reset();
+    }
+
+    // Tell the manipulators the selection has changed
+    const SelectionVersion selectionVersion = _selection.GetVersion(GetCurrentStage());
+    if (_renderer && selectionVersion != _lastSelectionVersion) {
+        _lastSelectionVersion = selectionVersion;
+        _manipulatorTargets.SetSelection(*this);
+        _positionManipulator.OnSelectionChange(*this);
+        _rotationManipulator.OnSelectionChange(*this);
+        _scaleManipulator.OnSelectionChange(*this);
+    }
 }
 
 void Viewport::SyncFabric() {
@@ -621,14 +880,38 @@ void Viewport::FlushDirties() {
     _renderer->FlushDirties();
 }
 
+// True when the CPU picker is up to date with the current time. Otherwise it is moved to the current time in the
+// next updates, and hydra picks in the meantime
+bool Viewport::UseScenePicker() {
+    if (!_cpuPicking || !GetCurrentStage()) {
+        return false;
+    }
+    if (_scenePicker.IsReady(GetCurrentStage(), GetCurrentTimeCode())) {
+        return true;
+    }
+    _scenePickerTimeCode = GetCurrentTimeCode();
+    return false;
+}
+
 bool Viewport::TestIntersection(GfVec2d clickedPoint, SdfPath &outHitPrimPath, SdfPath &outHitInstancerPath,
                                 int &outHitInstanceIndex) {
-
+    ActivateRendererView();
     GfVec2i renderSize = _drawTarget->GetSize();
     double width = static_cast<double>(renderSize[0]);
     double height = static_cast<double>(renderSize[1]);
 
     GfCamera viewportCamera = GetViewportCamera(width, height);
+    if (UseScenePicker()) {
+        // Ray cast on the bvh of the stage, the hydra render index is not used
+        runtime::ScenePicker::Hit hit;
+        if (_scenePicker.IntersectRay(viewportCamera.GetFrustum().ComputeRay(clickedPoint), &hit)) {
+            outHitPrimPath = hit.primPath;
+            outHitInstancerPath = SdfPath();
+            outHitInstanceIndex = -1;
+            return true;
+        }
+        return false;
+    }
     GfFrustum pixelFrustum = viewportCamera.GetFrustum().ComputeNarrowedFrustum(clickedPoint, GfVec2d(1.0 / width, 1.0 / height));
     GfVec3d outHitPoint;
     GfVec3d outHitNormal;
@@ -637,3 +920,46 @@ bool Viewport::TestIntersection(GfVec2d clickedPoint, SdfPath &outHitPrimPath, S
                                         GetCurrentStage()->GetPseudoRoot(), _imagingSettings, &outHitPoint, &outHitNormal,
                                         &outHitPrimPath, &outHitInstancerPath, &outHitInstanceIndex));
 }
+
+bool Viewport::TestAreaIntersection(GfVec2d corner1, GfVec2d corner2, SdfPathVector &outHitPrimPaths) {
+    ActivateRendererView();
+    outHitPrimPaths.clear();
+    if (!GetCurrentStage()) {
+        return false;
+    }
+    GfVec2i renderSize = _drawTarget->GetSize();
+    double width = static_cast<double>(renderSize[0]);
+    double height = static_cast<double>(renderSize[1]);
+
+    // The narrowed frustum takes the center and the half size of the area, at least one pixel
+    const GfVec2d center = (corner1 + corner2) * 0.5;
+    const GfVec2d halfSize(std::max(std::abs(corner2[0] - corner1[0]) * 0.5, 1.0 / width),
+                           std::max(std::abs(corner2[1] - corner1[1]) * 0.5, 1.0 / height));
+    GfCamera viewportCamera = GetViewportCamera(width, height);
+    GfFrustum areaFrustum = viewportCamera.GetFrustum().ComputeNarrowedFrustum(center, halfSize);
+    if (UseScenePicker()) {
+        return _scenePicker.IntersectFrustum(areaFrustum, &outHitPrimPaths);
+    }
+
+    // One deep pick returns all the prims in the area
+    runtime::RuntimeEngine::IntersectionResultVector results;
+    // The picking buffers have the pixel size of the area, the small prims are not missed in a large area
+    runtime::RuntimeEngine::PickParams pickParams = {HdxPickTokens->resolveDeep};
+    pickParams.resolution = GfVec2i(std::max(1, static_cast<int>(std::ceil(halfSize[0] * width))),
+                                    std::max(1, static_cast<int>(std::ceil(halfSize[1] * height))));
+    if (!_renderer ||
+        !_renderer->TestIntersection(pickParams, viewportCamera.GetFrustum().ComputeViewMatrix(),
+                                     areaFrustum.ComputeProjectionMatrix(), GetCurrentStage()->GetPseudoRoot(),
+                                     _imagingSettings, &results)) {
+        return false;
+    }
+    outHitPrimPaths.reserve(results.size());
+    for (const auto &result : results) {
+        if (!result.hitPrimPath.IsEmpty()) {
+            outHitPrimPaths.push_back(result.hitPrimPath);
+        }
+    }
+    std::sort(outHitPrimPaths.begin(), outHitPrimPaths.end());
+    outHitPrimPaths.erase(std::unique(outHitPrimPaths.begin(), outHitPrimPaths.end()), outHitPrimPaths.end());
+    return !outHitPrimPaths.empty();
+}
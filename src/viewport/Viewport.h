@@ -16,13 +16,57 @@
 #include "Selection.h"
 #include "Grid.h"
 #include "ViewportCameras.h"
+#include "ViewportGeometryCache.h"
+#include "ManipulatorTargets.h"
+#include "ResolutionGovernor.h"
 #include <pxr/imaging/glf/drawTarget.h>
 #include <pxr/usd/usd/stage.h>
 #include "runtime/engine.h"
+#include "runtime/scenePicker.h"
 #include "physicsSettings.h"
 
 #include <ImagingSettings.h>
 
+/// Renderer shared by the viewports displaying the same stage.
+/// Each viewport renders with its own view of the engine: its own camera, render buffers and AOVs, but the render
+/// index, the scene indices and the physics world exist once, so multiple viewports cost one scene. The selection
+/// and the physics are updated once per frame by the first viewport updated.
+struct ViewportRenderer {
+    std::unique_ptr<runtime::RuntimeEngine> engine;
+    PhysicsSettings physicsSettings;
+    SelectionVersion selectionVersion = 0; // Selection sent to the engine
+    int updatedFrame = -1;
+    // Incremented when the image changes without a stage edit: simulation steps, asynchronous scene processing and
+    // renderer settings
+    size_t sceneVersion = 0;
+    // The complexity and the scene materials and lights change the shared scene indices, the last viewport editing
+    // them sets them for all the viewports of the stage
+    float complexity = 1.f;
+    bool enableSceneMaterials = true;
+    bool enableSceneLights = true;
+    size_t sceneDisplayVersion = 0;
+};
+
+/// What a viewport image depends on. The viewport is rendered again only when it differs from the state of the last
+/// render, otherwise the last image is reused.
+struct ViewportRenderState {
+    const UsdStage *stage = nullptr;
+    GfCamera camera;
+    GfVec2i size;
+    float scale = 0.f;
+    ImagingSettings imagingSettings;
+    SelectionVersion selectionVersion = 0;
+    size_t stageVersion = 0;
+    size_t sceneVersion = 0;
+    // Only set while the mouse is over a gizmo or edits with it, the image does not depend on it otherwise
+    GfVec2d mousePosition = GfVec2d(0.0);
+    const Manipulator *activeManipulator = nullptr;
+    const Manipulator *editingState = nullptr;
+
+    bool operator==(const ViewportRenderState &other) const;
+    bool operator!=(const ViewportRenderState &other) const { return !(*this == other); }
+};
+
 class Viewport final {
   public:
     Viewport(UsdStageRefPtr stage, Selection &);
@@ -32,8 +76,12 @@ class Viewport final {
     Viewport(const Viewport &) = delete;
     Viewport &operator=(const Viewport &) = delete;
 
-    /// Render hydra image on a texture
-    void Render();
+    /// Render hydra image on a texture, returns false when nothing changed since the last render and the last image
+    /// is kept
+    bool Render();
+
+    /// True while the physics of the stage is stepped, the simulation thread does not wake up the event loop
+    bool IsSimulating() const;
 
     /// Update internal data: selection, current renderer
     void Update();
@@ -48,6 +96,14 @@ class Viewport final {
     UsdTimeCode GetCurrentTimeCode() const { return _imagingSettings.frame; }
     void SetCurrentTimeCode(const UsdTimeCode &tc);
 
+    /// Playback cache of the renderer: the next frames are read on worker threads while the widgets are drawn
+    void PrefetchPlayback(size_t memoryBudget);
+    void ClearPlaybackCache();
+
+    /// Wait for the worker threads reading the stage, the playback prefetch and the CPU picking update. Must be called
+    /// before the stage is modified
+    void WaitStageReads();
+
     /// Camera framing
     void FrameCameraOnSelection(const Selection &);
     void FrameCameraOnRootPrim();
@@ -79,6 +135,9 @@ class Viewport final {
 
     // Picking
     bool TestIntersection(GfVec2d clickedPoint, SdfPath &outHitPrimPath, SdfPath &outHitInstancerPath, int &outHitInstanceIndex);
+    /// Returns all the prims inside the rectangle between two corners in normalized coordinates, even if they are hidden
+    /// by other prims. The prims are sorted and unique.
+    bool TestAreaIntersection(GfVec2d corner1, GfVec2d corner2, SdfPathVector &outHitPrimPaths);
     GfVec2d GetPickingBoundarySize() const;
 
     // Utility function for compute a scale for the manipulators. It uses the distance between the camera
@@ -115,7 +174,15 @@ class Viewport final {
     UsdStageRefPtr GetCurrentStage() { return _stage; }
     const UsdStageRefPtr & GetCurrentStage() const { return _stage; };
 
-    void SetCurrentStage(UsdStageRefPtr stage) { _stage = stage; }
+    void SetCurrentStage(UsdStageRefPtr stage);
+
+    /// Transforms and bounds of the current stage at the viewport time, shared by the manipulators, the framing
+    /// and the picking. It is mutable as the manipulators only see a const viewport when they draw.
+    ViewportGeometryCache &GetGeometryCache() const { return _geometryCache; }
+
+    /// Xformable prims of the selection edited by the translate, rotate and scale manipulators
+    ManipulatorTargets &GetManipulatorTargets() { return _manipulatorTargets; }
+    const ManipulatorTargets &GetManipulatorTargets() const { return _manipulatorTargets; }
 
     Selection &GetSelection() { return _selection; }
 
@@ -129,6 +196,21 @@ class Viewport final {
     
     /// Returns the current camera updated to match the viewport ratio
     GfCamera GetViewportCamera(double width, double height) const;
+
+    /// Shared renderer of the current stage, the functions of the engine apply to the view of this viewport once
+    /// it is activated
+    void AcquireRenderer();
+    void ReleaseRenderer();
+    void ActivateRendererView();
+    void SyncSceneDisplaySettings();
+
+    /// True while the camera or a manipulator is moved
+    bool IsInteracting() const;
+
+    /// Bind and clear the draw target hydra renders in when the resolution is reduced
+    void BindScaledDrawTarget(const GfVec2i &size);
+
+    ViewportRenderState GetRenderState(int width, int height) const;
     
     // Viewport ID
     std::string _viewportName;
@@ -146,27 +228,48 @@ class Viewport final {
     MouseHoverManipulator _mouseHover;
     ScaleManipulator _scaleManipulator;
     SelectionManipulator _selectionManipulator;
+    ManipulatorTargets _manipulatorTargets;
 
     Selection &_selection;
-    SelectionHash _lastSelectionHash = 0;
+    SelectionVersion _lastSelectionVersion = 0;
 
     // Hydra canvas
     void BeginHydraUI(int width, int height);
     void EndHydraUI();
     GfVec2i _textureSize;
+    GfVec2i _requestedTextureSize; // The draw target is resized when the requested size is stable
+    std::chrono::steady_clock::time_point _textureSizeChangeTime;
     GfVec2d _mousePosition;
     Grid _grid;
 
     UsdStageRefPtr _stage;
+    mutable ViewportGeometryCache _geometryCache;
 
     // Renderer
     GLuint _textureId = 0;
     UsdStageRefPtr _renderStage;
-    std::unique_ptr<runtime::RuntimeEngine> _renderer;
+    std::shared_ptr<ViewportRenderer> _sharedRenderer;
+    runtime::RuntimeEngine *_renderer = nullptr; // Engine of the shared renderer
+    runtime::RuntimeEngine::ViewId _rendererView = 0;
+    size_t _sceneDisplayVersion = 0; // Scene display settings of the shared renderer copied in the imaging settings
+    runtime::ScenePicker _scenePicker; // CPU picking, built in the background while it is enabled
+    UsdTimeCode _scenePickerTimeCode;  // Time of the picker, moved to the current time by the first pick after a change
+    bool _cpuPicking = false;
+    bool UseScenePicker();
     ImagingSettings _imagingSettings;
-    PhysicsSettings _physicsSettings;
     GlfDrawTargetRefPtr _drawTarget;
 
+    // Render resolution, hydra renders in the scaled draw target which is stretched on the draw target
+    ResolutionGovernor _resolutionGovernor;
+    float _lastRenderTime = 0.f; // Wall clock duration of the last hydra render, in seconds
+
+    // State of the last render, the viewport is forced to render when it is dirty
+    ViewportRenderState _renderState;
+    bool _isRenderDirty = true;
+
+    bool _adaptiveResolution = true;
+    GlfDrawTargetRefPtr _scaledDrawTarget;
+
 };
 
 template <> inline Manipulator *Viewport::GetManipulator<PositionManipulator>() { return &_positionManipulator; }
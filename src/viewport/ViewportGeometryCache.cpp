@@ -0,0 +1,99 @@
+#include <pxr/usd/usdGeom/imageable.h>
+#include <pxr/usd/usdGeom/xformable.h>
+
+#include "ViewportGeometryCache.h"
+
+ViewportGeometryCache::ViewportGeometryCache()
+    : _time(UsdTimeCode::Default()), _xformCache(UsdTimeCode::Default()),
+      _bboxCache(UsdTimeCode::Default(), UsdGeomImageable::GetOrderedPurposeTokens()), _xformCacheDirty(false),
+      _bboxCacheDirty(false), _stageVersion(0) {}
+
+ViewportGeometryCache::~ViewportGeometryCache() { TfNotice::Revoke(_objectsChangedKey); }
+
+void ViewportGeometryCache::SetStage(const UsdStageRefPtr &stage) {
+    if (get_pointer(_stage) == get_pointer(stage)) {
+        return;
+    }
+    TfNotice::Revoke(_objectsChangedKey);
+    _stage = stage;
+    _xformCache.Clear();
+    _bboxCache.Clear();
+    _xformCacheDirty = false;
+    _bboxCacheDirty = false;
+    _stageVersion++;
+    if (_stage) {
+        _objectsChangedKey = TfNotice::Register(TfCreateWeakPtr(this), &ViewportGeometryCache::OnObjectsChanged,
+                                                UsdStageWeakPtr(_stage));
+    }
+}
+
+void ViewportGeometryCache::SetTime(UsdTimeCode time) {
+    if (time != _time) {
+        _time = time;
+        // Both caches clear themselves when the time is different
+        _xformCache.SetTime(time);
+        _bboxCache.SetTime(time);
+    }
+}
+
+void ViewportGeometryCache::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    _stageVersion++;
+    _bboxCacheDirty = true;
+    if (_xformCacheDirty) {
+        return;
+    }
+    if (!notice.GetResyncedPaths().empty()) {
+        _xformCacheDirty = true;
+        return;
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        if (!path.IsPropertyPath() || UsdGeomXformable::IsTransformationAffectedByAttrNamed(path.GetNameToken())) {
+            _xformCacheDirty = true;
+            return;
+        }
+    }
+}
+
+void ViewportGeometryCache::ClearIfDirty() {
+    if (_xformCacheDirty.exchange(false)) {
+        _xformCache.Clear();
+    }
+    if (_bboxCacheDirty.exchange(false)) {
+        _bboxCache.Clear();
+    }
+}
+
+GfMatrix4d ViewportGeometryCache::GetLocalToWorldTransform(const UsdPrim &prim) {
+    ClearIfDirty();
+    return prim ? _xformCache.GetLocalToWorldTransform(prim) : GfMatrix4d(1.0);
+}
+
+GfMatrix4d ViewportGeometryCache::GetParentToWorldTransform(const UsdPrim &prim) {
+    ClearIfDirty();
+    return prim ? _xformCache.GetParentToWorldTransform(prim) : GfMatrix4d(1.0);
+}
+
+GfMatrix4d ViewportGeometryCache::GetLocalTransformation(const UsdPrim &prim, bool *resetsXformStack) {
+    ClearIfDirty();
+    bool resets = false;
+    const GfMatrix4d localTransform = prim ? _xformCache.GetLocalTransformation(prim, &resets) : GfMatrix4d(1.0);
+    if (resetsXformStack) {
+        *resetsXformStack = resets;
+    }
+    return localTransform;
+}
+
+GfBBox3d ViewportGeometryCache::ComputeWorldBound(const UsdPrim &prim) {
+    ClearIfDirty();
+    return prim ? _bboxCache.ComputeWorldBound(prim) : GfBBox3d();
+}
+
+GfBBox3d ViewportGeometryCache::ComputeWorldBound(const SdfPathVector &paths) {
+    GfBBox3d bbox;
+    if (_stage) {
+        for (const SdfPath &path : paths) {
+            bbox = GfBBox3d::Combine(ComputeWorldBound(_stage->GetPrimAtPath(path)), bbox);
+        }
+    }
+    return bbox;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+#include <pxr/usd/usdGeom/xformCache.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+//
+// Transforms and bounds of the prims seen by a viewport, at the viewport time.
+// The manipulators, the framing functions and the picking helpers query this cache instead
+// of computing the transforms from the xformables, so the ancestor chains are only walked once
+// between two stage edits, whatever the number of prims or queries per frame.
+//
+// The cache is cleared when the time or the stage change, and when the stage sends an ObjectsChanged notice:
+// the xform cache is only cleared by resyncs and transform changes, the bound cache by any change.
+//
+class ViewportGeometryCache : public TfWeakBase {
+  public:
+    ViewportGeometryCache();
+    ~ViewportGeometryCache();
+
+    // Delete copy
+    ViewportGeometryCache(const ViewportGeometryCache &) = delete;
+    ViewportGeometryCache &operator=(const ViewportGeometryCache &) = delete;
+
+    void SetStage(const UsdStageRefPtr &stage);
+    void SetTime(UsdTimeCode time);
+    UsdTimeCode GetTime() const { return _time; }
+
+    // Incremented by the stage changes, the viewport renders again when it differs from the rendered one
+    size_t GetStageVersion() const { return _stageVersion; }
+
+    // Transforms
+    GfMatrix4d GetLocalToWorldTransform(const UsdPrim &prim);
+    GfMatrix4d GetParentToWorldTransform(const UsdPrim &prim);
+    GfMatrix4d GetLocalTransformation(const UsdPrim &prim, bool *resetsXformStack = nullptr);
+
+    // Bounds, using the ordered purposes like the framing always did
+    GfBBox3d ComputeWorldBound(const UsdPrim &prim);
+    GfBBox3d ComputeWorldBound(const SdfPathVector &paths);
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+    void ClearIfDirty();
+
+    UsdStageRefPtr _stage;
+    TfNotice::Key _objectsChangedKey;
+    UsdTimeCode _time;
+    UsdGeomXformCache _xformCache;
+    UsdGeomBBoxCache _bboxCache;
+
+    // Set by the notice handler which can be called from any thread, the caches are cleared at the next query
+    std::atomic<bool> _xformCacheDirty;
+    std::atomic<bool> _bboxCacheDirty;
+    std::atomic<size_t> _stageVersion;
+};
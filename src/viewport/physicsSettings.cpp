@@ -8,8 +8,15 @@
 #include "fabric_sim/tokens.h"
 #include "Gui.h"
 
+#include <algorithm>
+
 void PhysicsSettings::DrawSettings() {
     ImGui::Checkbox("Enable Update", &update);
+    float stepsPerSecond = 1.f / timeStep;
+    if (ImGui::SliderFloat("Steps per second", &stepsPerSecond, 10.f, 1000.f, "%.0f")) {
+        timeStep = 1.f / std::max(stepsPerSecond, 1.f);
+    }
+    ImGui::SliderInt("Max substeps", &maxSubSteps, 1, 16);
 
     ImGui::Separator();
 
@@ -11,6 +11,10 @@
 struct PhysicsSettings {
     bool update{true};
 
+    // Fixed timestep of the simulation thread, in seconds
+    float timeStep{1.f / 60.f};
+    int maxSubSteps{4};
+
     float scale = 0;
     bool world_axes{false};
     bool body_axes{false};
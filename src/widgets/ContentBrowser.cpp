@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <regex>
@@ -13,6 +14,7 @@
 #include "TextFilter.h"
 #include "ModalDialogs.h"
 #include "FileBrowser.h"
+#include "LayerRegistry.h"
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
@@ -89,50 +91,147 @@ void DrawLayerTooltip(SdfLayerHandle layer) {
     }
 }
 
-static bool PassOptionsFilter(SdfLayerHandle layer, const ContentBrowserOptions &options, bool isStage) {
+static bool PassOptionsFilter(const LayerRecord &record, const ContentBrowserOptions &options) {
     if (!options._filterAnonymous) {
-        if (layer->IsAnonymous())
+        if (record.isAnonymous)
             return false;
     }
     if (!options._filterFiles) {
-        if (!layer->IsAnonymous())
+        if (!record.isAnonymous)
             return false;
     }
     if (!options._filterModified) {
-        if (layer->IsDirty())
+        if (record.isDirty)
             return false;
     }
     if (!options._filterUnmodified) {
-        if (!layer->IsDirty())
+        if (!record.isDirty)
             return false;
     }
-    if (!options._filterStage && isStage) {
+    if (!options._filterStage && record.isStage) {
         return false;
     }
-    if (!options._filterLayer && !isStage) {
+    if (!options._filterLayer && !record.isStage) {
         return false;
     }
     return true;
 }
 
-static const std::string &LayerNameFromOptions(const SdfLayerHandle &layer, const ContentBrowserOptions &options) {
+static const std::string &LayerNameFromOptions(const LayerRecord &record, const ContentBrowserOptions &options) {
     // GetDisplayName proved to be really slow when the number of layers is high.
-    // We maintain a map to store the displayName and avoid allocating and releasing memory
-    static std::unordered_map<void const *, std::string> displayNames;
+    // The records keep a copy of the names
     if (options._showAssetName) {
-        return layer->GetAssetName();
+        return record.GetAssetName();
     } else if (options._showDisplayName) {
-        auto displayNameIt = displayNames.find(layer->GetUniqueIdentifier());
-        if (displayNameIt == displayNames.end()) {
-            displayNames[layer->GetUniqueIdentifier()] = layer->GetDisplayName();
-        }
-        return displayNames[layer->GetUniqueIdentifier()];
+        return record.GetDisplayName();
     } else if (options._showRealPath) {
-        return layer->GetRealPath();
+        return record.GetRealPath();
     }
-    return layer->GetIdentifier();
+    return record.identifier;
 }
 
+//
+// Filtered and sorted list of the layers of the registry.
+// It is rebuilt when the filter or the options change, otherwise only the records changed in the registry since
+// the last frame are removed and inserted again in the sorted list. Each entry keeps the name it was sorted with,
+// a renamed record is found with a binary search on its previous name.
+//
+class ContentBrowserLayerList {
+  public:
+    void Update(const LayerRegistry &registry, const TextFilter &filter, const ContentBrowserOptions &options) {
+        const size_t filterHash = filter.GetHash();
+        const size_t optionsHash = std::hash<ContentBrowserOptions>()(options);
+        _filter = &filter;
+        _options = options;
+        if (!_isBuilt || filterHash != _filterHash || optionsHash != _optionsHash) {
+            Rebuild(registry.GetRecords());
+            _registryVersion = registry.GetVersion();
+            _filterHash = filterHash;
+            _optionsHash = optionsHash;
+            _isBuilt = true;
+            return;
+        }
+        LayerRegistryChanges changes;
+        if (!registry.GetChanges(_registryVersion, changes)) {
+            return;
+        }
+        if (changes.reset) {
+            Rebuild(changes.added);
+            return;
+        }
+        for (const LayerRecordPtr &record : changes.removed) {
+            Erase(record);
+        }
+        for (const LayerRecordPtr &record : changes.modified) {
+            Erase(record);
+            Insert(record);
+        }
+        for (const LayerRecordPtr &record : changes.added) {
+            Insert(record);
+        }
+    }
+
+    int GetSize() const { return static_cast<int>(_layers.size()); }
+    const LayerRecordPtr &operator[](int index) const { return _layers[index].record; }
+
+  private:
+    struct Entry {
+        std::string name; // Name when the record was inserted
+        LayerRecordPtr record;
+    };
+
+    static bool Less(const Entry &a, const Entry &b) {
+        const int compare = a.name.compare(b.name);
+        return compare < 0 || (compare == 0 && a.record.get() < b.record.get());
+    }
+
+    bool Pass(const LayerRecord &record) const {
+        return _filter->PassFilter(LayerNameFromOptions(record, _options).c_str()) && PassOptionsFilter(record, _options);
+    }
+
+    void Rebuild(const std::vector<LayerRecordPtr> &records) {
+        _layers.clear();
+        _names.clear();
+        for (const LayerRecordPtr &record : records) {
+            if (Pass(*record)) {
+                _layers.push_back({LayerNameFromOptions(*record, _options), record});
+                _names[record.get()] = _layers.back().name;
+            }
+        }
+        std::sort(_layers.begin(), _layers.end(), Less);
+    }
+
+    void Insert(const LayerRecordPtr &record) {
+        if (Pass(*record)) {
+            Entry entry{LayerNameFromOptions(*record, _options), record};
+            _names[record.get()] = entry.name;
+            _layers.insert(std::upper_bound(_layers.begin(), _layers.end(), entry, Less), std::move(entry));
+        }
+    }
+
+    void Erase(const LayerRecordPtr &record) {
+        const auto name = _names.find(record.get());
+        if (name == _names.end()) {
+            return;
+        }
+        const Entry entry{name->second, record};
+        const auto it = std::lower_bound(_layers.begin(), _layers.end(), entry, Less);
+        if (it != _layers.end() && it->record == record) {
+            _layers.erase(it);
+        }
+        _names.erase(name);
+    }
+
+    std::vector<Entry> _layers;
+    std::unordered_map<const LayerRecord *, std::string> _names; // Name of the records in the list
+    LayerRegistryVersion _registryVersion = 0;
+    const TextFilter *_filter = nullptr;
+    ContentBrowserOptions _options;
+    size_t _filterHash = 0;
+    size_t _optionsHash = 0;
+    bool _isBuilt = false;
+};
+
 static inline void DrawSaveButton(SdfLayerHandle layer) {
     ScopedStyleColor style(ImGuiCol_Button, ImVec4(ColorTransparent), ImGuiCol_Text,
                            layer->IsAnonymous() ? ImVec4(ColorTransparent)
@@ -171,60 +270,35 @@ static inline void DrawLayerDescriptionRow(SdfLayerHandle layer, bool isStage, c
     }
 }
 
-inline size_t ComputeLayerSetHash(SdfLayerHandleSet &layerSet) {
-    size_t seed = 0;
-    for (auto it = layerSet.begin(); it != layerSet.end(); ++it) {
-        seed ^= hash_value(*it) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-    }
-    return seed;
-}
-
-
-void DrawLayerSet(UsdStageCache &cache, SdfLayerHandleSet &layerSet, SdfLayerHandle *selectedLayer, SdfLayerHandle *selectedStage,
-                  const ContentBrowserOptions &options, const ImVec2 &listSize = ImVec2(0, -10)) {
+void DrawLayerSet(UsdStageCache &cache, LayerRegistry &layerRegistry, SdfLayerHandle *selectedLayer,
+                  SdfLayerHandle *selectedStage, const ContentBrowserOptions &options, const ImVec2 &listSize = ImVec2(0, -10)) {
 
-    static std::vector<SdfLayerHandle> sortedLayerList;
-    static std::vector<SdfLayerHandle>::iterator endOfPartition = sortedLayerList.end();
-    static size_t pastLayerSetHash = 0;
+    static ContentBrowserLayerList layerList;
     static TextFilter filter;
-    static size_t pastTextFilterHash;
-    static size_t pastOptionFilterHash;
     filter.Draw();
 
     ImGui::PushItemWidth(-1);
     if (ImGui::BeginListBox("##DrawLayerSet", listSize)) {
-        // Filter and sort the layer set. This is done only when the layer set or the filter have changed, otherwise it can be
-        // really costly to do it at every frame, mainly because of the string creation and deletion.
-        // We check if anything has changed using a hash which should be relatively quick to compute.
-        size_t currentLayerSetHash = ComputeLayerSetHash(layerSet);
-        size_t currentTextFilterHash = filter.GetHash();
-        size_t currentOptionFilterHash = std::hash<ContentBrowserOptions>()(options);
-        if (currentLayerSetHash != pastLayerSetHash || currentTextFilterHash != pastTextFilterHash ||
-            currentOptionFilterHash != pastOptionFilterHash) {
-            sortedLayerList.assign(layerSet.begin(), layerSet.end());
-            endOfPartition = partition(sortedLayerList.begin(), sortedLayerList.end(), [&](const auto &layer) {
-                const bool isStage = cache.FindOneMatching(layer);
-                return filter.PassFilter(LayerNameFromOptions(layer, options).c_str()) &&
-                       PassOptionsFilter(layer, options, isStage);
-            });
-
-            std::sort(sortedLayerList.begin(), endOfPartition, [&](const auto &t1, const auto &t2) {
-                return LayerNameFromOptions(t1, options) < LayerNameFromOptions(t2, options);
-            });
-            pastLayerSetHash = currentLayerSetHash;
-            pastTextFilterHash = currentTextFilterHash;
-            pastOptionFilterHash = currentOptionFilterHash;
-        }
+        // Filter and sort the layers. The list is rebuilt only when the filter or the options have changed, otherwise
+        // only the layers changed in the registry are moved in the list.
+        layerList.Update(layerRegistry, filter, options);
         //
         // Actual drawing of the listed layers using a clipper, we only draw the visible lines
         //
         ImGuiListClipper clipper;
-        clipper.Begin(static_cast<int>(std::distance(sortedLayerList.begin(), endOfPartition)));
+        clipper.Begin(layerList.GetSize());
         while (clipper.Step()) {
             for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
-                const auto &layer = sortedLayerList[row];
-                const std::string &layerName = LayerNameFromOptions(layer, options);
-                const UsdStageRefPtr isStage = cache.FindOneMatching(layer);
+                const LayerRecord &record = *layerList[row];
+                const SdfLayerHandle &layer = record.layer;
+                const std::string &layerName = LayerNameFromOptions(record, options);
+                if (!layer) {
+                    // The layer was released since the registry was updated
+                    layerRegistry.Invalidate();
+                    ImGui::TextDisabled("%s", layerName.c_str());
+                    continue;
+                }
+                const UsdStageRefPtr isStage = record.isStage ? cache.FindOneMatching(layer) : UsdStageRefPtr();
                 ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, ImGui::GetStyle().ItemSpacing.y));
                 ImGui::PushID(layer->GetUniqueIdentifier());
                 DrawSelectStageButton(layer, isStage, selectedStage);
@@ -308,8 +382,9 @@ void DrawContentBrowser(Editor &editor) {
     // TODO: we might want to remove completely the editor here, just pass as selected layer and a selected stage
     SdfLayerHandle selectedLayer(editor.GetCurrentLayer());
     SdfLayerHandle selectedStage(editor.GetCurrentStage() ? editor.GetCurrentStage()->GetRootLayer() : SdfLayerHandle());
-    auto layers = SdfLayer::GetLoadedLayers();
-    DrawLayerSet(editor.GetStageCache(), layers, &selectedLayer, &selectedStage, options);
+    LayerRegistry &layerRegistry = LayerRegistry::GetInstance();
+    layerRegistry.Update(editor.GetStageCache());
+    DrawLayerSet(editor.GetStageCache(), layerRegistry, &selectedLayer, &selectedStage, options);
     if (selectedLayer != editor.GetCurrentLayer()) {
         ExecuteAfterDraw<EditorSetSelection>(selectedLayer, SdfPath::AbsoluteRootPath());
     }
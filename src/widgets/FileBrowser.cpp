@@ -1,7 +1,7 @@
 /// File browser
 /// This is a first quick and dirty implementation,
-/// it should be improved to avoid using globals,
-/// split the ui and filesystem code, remove the polling timer, etc.
+/// it should be improved to avoid using globals.
+/// The directories are listed by the DirectoryScanner on a worker thread.
 
 #include <iostream>
 #include <functional>
@@ -19,19 +19,11 @@ namespace fs = ghc::filesystem;
 #endif
 
 #include "FileBrowser.h"
+#include "DirectoryScanner.h"
 #include "Constants.h"
 #include "ImGuiHelpers.h"
 #include "Gui.h"
 
-namespace clk = std::chrono;
-
-// Convert different time representation to time_t
-template <typename TimePointT> std::time_t toTimet(TimePointT timePoint) {
-    const auto sysClockTimePoint =
-        clk::time_point_cast<clk::system_clock::duration>(timePoint - TimePointT::clock::now() + clk::system_clock::now());
-    return clk::system_clock::to_time_t(sysClockTimePoint);
-}
-
 using DrivesListT = std::vector<std::pair<std::string, std::string>>;
 
 #ifdef _WIN64
@@ -100,21 +92,19 @@ namespace {
 /// Browser returned file path, not thread safe
 static std::string filePath;
 static bool fileExists = false;
-static std::vector<std::string> validExts;
 static std::string lineEditBuffer;
+static bool lineEditBufferChanged = false;
 static fs::path displayedDirectory = fs::current_path();
 };
 
-void SetValidExtensions(const std::vector<std::string> &extensions) { validExts = extensions; }
+// The scanner thread is started the first time the file browser is used
+static DirectoryScanner &GetDirectoryScanner() {
+    static DirectoryScanner directoryScanner;
+    return directoryScanner;
+}
 
-// Using a timer to avoid querying the filesytem at every frame
-static void EverySecond(const std::function<void()> &deferedFunction) {
-    static auto last = clk::steady_clock::now();
-    auto now = clk::steady_clock::now();
-    if ((now - last).count() > 1e9) {
-        deferedFunction();
-        last = now;
-    }
+void SetValidExtensions(const std::vector<std::string> &extensions) {
+    GetDirectoryScanner().SetValidExtensions(extensions);
 }
 
 inline void ConvertToDirectory(const fs::path &path, std::string &directory) {
@@ -192,39 +182,6 @@ static bool DrawRefreshButton() {
     return false;
 }
 
-static inline bool FileNameStartsWithDot(const fs::path &path) {
-    const std::string &filename = path.filename().string();
-    return filename.size() > 0 && filename[0] == '.';
-}
-
-static bool ShouldBeDisplayed(const fs::directory_entry &p) {
-    const auto &filename = p.path().filename();
-    const auto startsWithDot = FileNameStartsWithDot(p.path());
-    bool endsWithValidExt = true;
-    if (!validExts.empty()) {
-        endsWithValidExt = false;
-        for (auto ext : validExts) { // we could stop the loop when the extension is found
-            endsWithValidExt |= filename.extension() == ext;
-        }
-    }
-
-    try {
-        const bool isDirectory = fs::is_directory(p);
-        return !startsWithDot && (isDirectory || endsWithValidExt) && !fs::is_symlink(p);
-    } catch (fs::filesystem_error &) {
-        return false;
-    }
-}
-
-// Compare function for sorting directories before files
-static bool compareDirectoryThenFile(const fs::directory_entry &a, const fs::directory_entry &b) {
-    if (fs::is_directory(a) == fs::is_directory(b)) {
-        return a < b;
-    } else {
-        return fs::is_directory(a) > fs::is_directory(b);
-    }
-}
-
 static void DrawFileSize(uintmax_t fileSize) {
     static const char *format[6] = {"%juB", "%juK", "%juM", "%juG", "%juT", "%juP"};
     constexpr int nbFormat = sizeof(format) / sizeof(const char *);
@@ -240,10 +197,10 @@ void DrawFileBrowser(int gutterSize) {
 
 
     static fs::path displayedFileName;
-    static std::vector<fs::directory_entry> directoryContent;
     static fs::path directoryContentPath;
     static bool mustUpdateDirectoryContent = true;
     static bool mustUpdateChosenFileName = false;
+    DirectoryScanner &directoryScanner = GetDirectoryScanner();
 
     // Parse the line buffer containing the user input and try to make sense of it
     auto ParseLineBufferEdit = [&]() {
@@ -272,15 +229,9 @@ void DrawFileBrowser(int gutterSize) {
         }
     };
 
-    // Update the list of entries for the chosen directory
-    auto UpdateDirectoryContent = [&]() {
-        directoryContent.clear();
-        for (auto &item : fs::directory_iterator(displayedDirectory, fs::directory_options::skip_permission_denied)) {
-            if (ShouldBeDisplayed(item)) {
-                directoryContent.push_back(item);
-            };
-        }
-        std::sort(directoryContent.begin(), directoryContent.end(), compareDirectoryThenFile);
+    // Request the list of entries for the chosen directory, the refresh button rescans it
+    auto UpdateDirectoryContent = [&](bool forceRescan) {
+        directoryScanner.Scan(displayedDirectory.string(), forceRescan);
         mustUpdateDirectoryContent = false;
         directoryContentPath = displayedDirectory;
     };
@@ -297,17 +248,23 @@ void DrawFileBrowser(int gutterSize) {
         mustUpdateChosenFileName = false;
     }
 
-    // We scan the line buffer edit every second, no need to do it at every frame
-    EverySecond(ParseLineBufferEdit);
+    // The line buffer edit is parsed only when it has changed
+    if (lineEditBufferChanged) {
+        ParseLineBufferEdit();
+        lineEditBufferChanged = false;
+    }
     mustUpdateDirectoryContent |= directoryContentPath != displayedDirectory;
-    mustUpdateDirectoryContent |= DrawRefreshButton();
+    const bool mustRescanDirectory = DrawRefreshButton();
     ImGui::SameLine();
     mustUpdateDirectoryContent |= DrawNavigationBar(displayedDirectory);
 
-    if (mustUpdateDirectoryContent) {
-        UpdateDirectoryContent();
+    if (mustUpdateDirectoryContent || mustRescanDirectory) {
+        UpdateDirectoryContent(mustRescanDirectory);
     }
 
+    // The snapshot stays valid for the frame even if the scanner publishes a new one
+    const std::shared_ptr<const DirectorySnapshot> directoryContent = directoryScanner.GetSnapshot();
+
     // Get window size
     ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
     // TODO: 190 should be computed or passed in parameter as there might be other widget taking height
@@ -321,49 +278,52 @@ void DrawFileBrowser(int gutterSize) {
             ImGui::TableSetupColumn("Date modified", ImGuiTableColumnFlags_WidthStretch);
             ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthStretch);
             ImGui::TableHeadersRow();
-            int i = 0;
             ImGui::PushID("direntries");
-            for (auto dirEntry : directoryContent) {
-                const bool isDirectory = dirEntry.is_directory();
-                ImGui::TableNextRow();
-                ImGui::TableSetColumnIndex(0);
-                ImGui::PushID(i++);
-                // makes the line selectable, and when selected copy the path
-                // to the line edit buffer
-                if (ImGui::Selectable("", false, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap)) {
+            const int entryCount = directoryContent ? static_cast<int>(directoryContent->entries.size()) : 0;
+            ImGuiListClipper clipper;
+            clipper.Begin(entryCount);
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                    const DirectoryEntry &dirEntry = directoryContent->entries[i];
+                    const bool isDirectory = dirEntry.isDirectory;
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::PushID(i);
+                    // makes the line selectable, and when selected copy the path
+                    // to the line edit buffer
+                    if (ImGui::Selectable("", false, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap)) {
+                        if (isDirectory) {
+                            displayedDirectory = dirEntry.path;
+                            mustUpdateDirectoryContent = true;
+                        } else {
+                            displayedFileName = dirEntry.path;
+                            lineEditBuffer = dirEntry.path;
+                            mustUpdateChosenFileName = true;
+                        }
+                    }
+                    ImGui::PopID();
+                    ImGui::SameLine();
                     if (isDirectory) {
-                        displayedDirectory = dirEntry.path();
-                        mustUpdateDirectoryContent = true;
+                        ImGui::TextColored(ImVec4(1.0, 1.0, 0.0, 1.0), "%s ", ICON_FA_FOLDER);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::TextColored(ImVec4(1.0, 1.0, 1.0, 1.0), "%s", dirEntry.fileName.c_str());
                     } else {
-                        displayedFileName = dirEntry.path();
-                        lineEditBuffer = dirEntry.path().string();
-                        mustUpdateChosenFileName = true;
+                        ImGui::TextColored(ImVec4(0.9, 0.9, 0.9, 1.0), "%s ", ICON_FA_FILE);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::TextColored(ImVec4(0.5, 1.0, 0.5, 1.0), "%s", dirEntry.fileName.c_str());
+                    }
+                    ImGui::TableSetColumnIndex(2);
+                    if (dirEntry.lastModified != -1) {
+                        struct tm lt; // Convert to local time
+                        localtime_(&lt, &dirEntry.lastModified);
+                        ImGui::Text("%04d/%02d/%02d %02d:%02d", 1900 + lt.tm_year, lt.tm_mon + 1, lt.tm_mday, lt.tm_hour, lt.tm_min);
+                    } else {
+                        ImGui::Text("Error reading file");
+                    }
+                    ImGui::TableSetColumnIndex(3);
+                    if (!isDirectory) {
+                        DrawFileSize(dirEntry.fileSize);
                     }
-                }
-                ImGui::PopID();
-                ImGui::SameLine();
-                if (isDirectory) {
-                    ImGui::TextColored(ImVec4(1.0, 1.0, 0.0, 1.0), "%s ", ICON_FA_FOLDER);
-                    ImGui::TableSetColumnIndex(1); // the following line is allocating string for each directory/files, this is BAD
-                    ImGui::TextColored(ImVec4(1.0, 1.0, 1.0, 1.0), "%s", dirEntry.path().filename().string().c_str());
-                } else {
-                    ImGui::TextColored(ImVec4(0.9, 0.9, 0.9, 1.0), "%s ", ICON_FA_FILE);
-                    ImGui::TableSetColumnIndex(1);
-                    ImGui::TextColored(ImVec4(0.5, 1.0, 0.5, 1.0), "%s", dirEntry.path().filename().string().c_str());
-                }
-                ImGui::TableSetColumnIndex(2);
-                try {
-                    const auto lastModified = last_write_time(dirEntry.path());
-                    const time_t cftime = toTimet(lastModified);
-                    struct tm lt; // Convert to local time
-                    localtime_(&lt, &cftime);
-                    ImGui::Text("%04d/%02d/%02d %02d:%02d", 1900 + lt.tm_year, lt.tm_mon + 1, lt.tm_mday, lt.tm_hour, lt.tm_min);
-                } catch (const std::exception &) {
-                    ImGui::Text("Error reading file");
-                }
-                ImGui::TableSetColumnIndex(3);
-                if (!isDirectory) {
-                    DrawFileSize(dirEntry.file_size());
                 }
             }
             ImGui::PopID(); // direntries
@@ -373,7 +333,10 @@ void DrawFileBrowser(int gutterSize) {
     }
 
     ImGui::PopItemWidth();
-    ImGui::InputText("File name", &lineEditBuffer);
+    if (directoryContent && !directoryContent->isComplete) {
+        ImGui::Text("Scanning %s ...", directoryContent->directory.c_str());
+    }
+    lineEditBufferChanged |= ImGui::InputText("File name", &lineEditBuffer);
 }
 
 bool FilePathExists() { return fileExists; }
@@ -421,6 +384,7 @@ void EnsureFileBrowserExtension(const std::string &ext) {
 void ResetFileBrowserFilePath() {
     filePath = "";
     lineEditBuffer = "";
+    lineEditBufferChanged = true;
 }
 
 
@@ -432,4 +396,5 @@ void SetFileBrowserDirectory(const std::string &directory) {
 
 void SetFileBrowserFilePath(const std::string &path) {
     lineEditBuffer = path;
+    lineEditBufferChanged = true;
 }
@@ -68,6 +68,10 @@ void DrawTreeNodePopup(SdfPrimSpecHandle &primSpec) {
     }
     if (ImGui::BeginMenu("Add blueprint")) {
         DrawBlueprintMenus(primSpec, "");
+        // The menus are filled while the blueprints are read
+        if (Blueprints::GetInstance().IsIndexing()) {
+            ImGui::MenuItem("Reading blueprints...", nullptr, false, false);
+        }
         ImGui::EndMenu();
     }
     if (ImGui::MenuItem("Duplicate")) {
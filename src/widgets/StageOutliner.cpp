@@ -1,8 +1,13 @@
 #include <iostream>
 
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
 #include <pxr/usd/pcp/layerStack.h>
+#include <pxr/usd/usd/notice.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdGeom/gprim.h>
 
@@ -10,6 +15,7 @@
 #include "Constants.h"
 #include "Gui.h"
 #include "ImGuiHelpers.h"
+#include "PrimSearchIndex.h"
 #include "UsdPrimEditor.h" // for DrawUsdPrimEditTarget
 #include "StageOutliner.h"
 #include "VtValueEditor.h"
@@ -50,6 +56,11 @@ class StageOutlinerDisplayOptions {
     bool GetShowAbstract() const { return _showAbstract; }
     bool GetShowUndefined() const { return _showUndefined; }
 
+    bool operator==(const StageOutlinerDisplayOptions &other) const {
+        return _displayPredicate == other._displayPredicate && _showPrototypes == other._showPrototypes;
+    }
+    bool operator!=(const StageOutlinerDisplayOptions &other) const { return !(*this == other); }
+
   private:
     // Default is:
     // UsdPrimIsActive && UsdPrimIsDefined && UsdPrimIsLoaded && !UsdPrimIsAbstract
@@ -171,25 +182,317 @@ static inline const char *GetVisibilityIcon(const TfToken &visibility) {
     return ICON_FA_EYE;
 }
 
-static void DrawVisibilityButton(const UsdPrim &prim) {
+/// Flattened list of the rows displayed by the outliner, the stage prims under the opened tree nodes.
+/// The rows cache what is drawn for each prim, so drawing costs only the visible rows. They are updated
+/// incrementally: the UsdNotice::ObjectsChanged resynced paths re-traverse only the subtree of the nearest
+/// displayed ancestor, the top level prims are inserted or removed alone, and the info only changes update
+/// the cached data of the displayed prims. The row indices are patched where the rows changed.
+class StageOutlinerIndex : public TfWeakBase {
+  public:
+    struct Row {
+        SdfPath path;
+        TfToken typeName;
+        TfToken visibility;
+        ImVec4 color;
+        bool hasChildren = false;
+        bool isImageable = false;
+        bool hasAuthoredVisibility = false;
+    };
+
+    ~StageOutlinerIndex() { TfNotice::Revoke(_noticeKey); }
+
+    /// Apply the changes since the last frame. This must be called inside the table scope to read the opened tree nodes.
+    void Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions);
+
+    /// Re-traverse the subtrees of the tree nodes opened or closed by the ui
+    void UpdateToggledPaths(SdfPathVector toggledPaths);
+
+    /// Rebuild all the rows at the next update, when the stage tree node is opened or closed
+    void Invalidate() { _needsRebuild = true; }
+
+    const std::vector<Row> &GetRows() const { return _rows; }
+
+    /// Returns the index of the row displaying path or -1 if it is not displayed
+    int GetRowIndex(const SdfPath &path) const {
+        const auto found = _rowIndices.find(path);
+        return found != _rowIndices.end() ? found->second : -1;
+    }
+
+  private:
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender);
+    void Rebuild();
+    void ResyncSubtree(const SdfPath &path);
+    void ResyncTopLevelPrim(const SdfPath &path);
+    void TraverseOpenedPaths(UsdPrimRange &range, std::vector<Row> &rows) const;
+    void UpdateRow(const UsdPrim &prim, Row &row) const;
+    void UpdateRowIndices();
+    void ReplaceRows(int first, int last, std::vector<Row> rows);
+    int GetSubtreeEnd(int first) const;
+    bool IsStageOpen() const;
+
+    UsdStageWeakPtr _stage;
+    TfNotice::Key _noticeKey;
+    StageOutlinerDisplayOptions _displayOptions;
+    std::vector<Row> _rows;
+    std::unordered_map<SdfPath, int, SdfPath::Hash> _rowIndices;
+    bool _needsRebuild = true;
+
+    // The notices might be sent by other threads, they are processed at the next update
+    std::mutex _pendingChangesMutex;
+    SdfPathVector _pendingResyncedPaths;
+    SdfPathVector _pendingChangedInfoPaths;
+};
+
+void StageOutlinerIndex::Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions) {
+    if (!_stage || get_pointer(_stage) != get_pointer(stage)) {
+        TfNotice::Revoke(_noticeKey);
+        _stage = stage;
+        if (stage) {
+            _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &StageOutlinerIndex::OnObjectsChanged, _stage);
+        }
+        _needsRebuild = true;
+    }
+    if (displayOptions != _displayOptions) {
+        _displayOptions = displayOptions;
+        _needsRebuild = true;
+    }
+
+    SdfPathVector resyncedPaths;
+    SdfPathVector changedInfoPaths;
+    {
+        std::lock_guard<std::mutex> lock(_pendingChangesMutex);
+        std::swap(resyncedPaths, _pendingResyncedPaths);
+        std::swap(changedInfoPaths, _pendingChangedInfoPaths);
+    }
+
+    if (_needsRebuild) {
+        Rebuild();
+        return;
+    }
+
+    // Resync the highest paths only, the subtrees of the others are traversed with them
+    SdfPath::RemoveDescendentPaths(&resyncedPaths);
+    for (const SdfPath &resyncedPath : resyncedPaths) {
+        ResyncSubtree(resyncedPath);
+        if (_needsRebuild) {
+            Rebuild();
+            return;
+        }
+    }
+
+    for (const SdfPath &changedPath : changedInfoPaths) {
+        const int rowIndex = GetRowIndex(changedPath);
+        if (rowIndex >= 0) {
+            UpdateRow(_stage->GetPrimAtPath(changedPath), _rows[rowIndex]);
+        }
+    }
+}
+
+void StageOutlinerIndex::UpdateToggledPaths(SdfPathVector toggledPaths) {
+    SdfPath::RemoveDescendentPaths(&toggledPaths);
+    for (const SdfPath &toggledPath : toggledPaths) {
+        ResyncSubtree(toggledPath);
+    }
+    if (_needsRebuild) {
+        Rebuild();
+    }
+}
+
+void StageOutlinerIndex::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice, const UsdStageWeakPtr &sender) {
+    std::lock_guard<std::mutex> lock(_pendingChangesMutex);
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        // A resynced property can change the visibility or the color but not the hierarchy
+        if (path.IsPrimPath() || path.IsAbsoluteRootPath()) {
+            _pendingResyncedPaths.push_back(path);
+        } else {
+            _pendingChangedInfoPaths.push_back(path.GetPrimPath());
+        }
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        _pendingChangedInfoPaths.push_back(path.GetPrimPath());
+    }
+}
+
+void StageOutlinerIndex::Rebuild() {
+    _needsRebuild = false;
+    _rows.clear();
+    if (!_stage) {
+        UpdateRowIndices();
+        return;
+    }
+    if (IsStageOpen()) {
+        // Stage
+        auto range = UsdPrimRange::Stage(_stage, _displayOptions.GetPrimFlagsPredicate());
+        TraverseOpenedPaths(range, _rows);
+        // Prototypes
+        if (_displayOptions.GetShowPrototypes()) {
+            for (const auto &proto : _stage->GetPrototypes()) {
+                auto range = UsdPrimRange(proto, _displayOptions.GetPrimFlagsPredicate());
+                TraverseOpenedPaths(range, _rows);
+            }
+        }
+    }
+    UpdateRowIndices();
+}
+
+bool StageOutlinerIndex::IsStageOpen() const {
+    ImGuiContext &g = *GImGui;
+    ImGuiStorage *storage = g.CurrentWindow->DC.StateStorage;
+    return storage->GetInt(IdOf(GetHash(SdfPath::AbsoluteRootPath())), 0) != 0;
+}
+
+// Replace the rows of the subtree of the nearest displayed ancestor of path
+void StageOutlinerIndex::ResyncSubtree(const SdfPath &path) {
+    if (path.IsEmpty() || path.IsAbsoluteRootPath()) {
+        _needsRebuild = true;
+        return;
+    }
+    SdfPath subtreeRoot = path;
+    while (!subtreeRoot.IsAbsoluteRootPath() && GetRowIndex(subtreeRoot) < 0) {
+        subtreeRoot = subtreeRoot.GetParentPath();
+    }
+    if (subtreeRoot.IsAbsoluteRootPath()) {
+        ResyncTopLevelPrim(path);
+        return;
+    }
+    const int first = GetRowIndex(subtreeRoot);
+    const int last = GetSubtreeEnd(first);
+    const UsdPrim prim = _stage->GetPrimAtPath(subtreeRoot);
+    std::vector<Row> subtreeRows;
+    if (prim && _displayOptions.GetPrimFlagsPredicate()(prim)) {
+        auto range = UsdPrimRange(prim, _displayOptions.GetPrimFlagsPredicate());
+        TraverseOpenedPaths(range, subtreeRows);
+    } else {
+        // Removed or filtered out, the parent row might have no children anymore
+        const int parentRow = GetRowIndex(subtreeRoot.GetParentPath());
+        if (parentRow >= 0) {
+            UpdateRow(_stage->GetPrimAtPath(subtreeRoot.GetParentPath()), _rows[parentRow]);
+        }
+    }
+    ReplaceRows(first, last, std::move(subtreeRows));
+}
+
+// Insert the rows of a new top level prim after its previous displayed sibling
+void StageOutlinerIndex::ResyncTopLevelPrim(const SdfPath &path) {
+    if (!IsStageOpen()) {
+        return;
+    }
+    const SdfPath topLevelPath = path.GetPrefixes().front();
+    // The prototypes are listed after the prims of the stage
+    if (UsdPrim::IsPrototypePath(topLevelPath)) {
+        _needsRebuild = _needsRebuild || _displayOptions.GetShowPrototypes();
+        return;
+    }
+    // The top level prim of path is not displayed, nor its descendants
+    if (path != topLevelPath) {
+        return;
+    }
+    const UsdPrim prim = _stage->GetPrimAtPath(path);
+    if (!prim || !_displayOptions.GetPrimFlagsPredicate()(prim)) {
+        return;
+    }
+    int first = 0;
+    for (const UsdPrim &sibling : _stage->GetPseudoRoot().GetFilteredChildren(_displayOptions.GetPrimFlagsPredicate())) {
+        if (sibling.GetPath() == path) {
+            break;
+        }
+        const int siblingRow = GetRowIndex(sibling.GetPath());
+        if (siblingRow >= 0) {
+            first = GetSubtreeEnd(siblingRow);
+        }
+    }
+    std::vector<Row> subtreeRows;
+    auto range = UsdPrimRange(prim, _displayOptions.GetPrimFlagsPredicate());
+    TraverseOpenedPaths(range, subtreeRows);
+    ReplaceRows(first, first, std::move(subtreeRows));
+}
+
+int StageOutlinerIndex::GetSubtreeEnd(int first) const {
+    const SdfPath &subtreeRoot = _rows[first].path;
+    int last = first + 1;
+    while (last < static_cast<int>(_rows.size()) && _rows[last].path.HasPrefix(subtreeRoot)) {
+        last++;
+    }
+    return last;
+}
+
+// Replace the rows in [first, last) and patch their indices, the following rows are shifted only when the number of
+// rows changes
+void StageOutlinerIndex::ReplaceRows(int first, int last, std::vector<Row> rows) {
+    for (int i = first; i < last; ++i) {
+        _rowIndices.erase(_rows[i].path);
+    }
+    const int newLast = first + static_cast<int>(rows.size());
+    _rows.erase(_rows.begin() + first, _rows.begin() + last);
+    _rows.insert(_rows.begin() + first, std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+    const int end = newLast != last ? static_cast<int>(_rows.size()) : newLast;
+    for (int i = first; i < end; ++i) {
+        _rowIndices[_rows[i].path] = i;
+    }
+}
+
+void StageOutlinerIndex::TraverseOpenedPaths(UsdPrimRange &range, std::vector<Row> &rows) const {
+    ImGuiContext &g = *GImGui;
+    ImGuiStorage *storage = g.CurrentWindow->DC.StateStorage;
+    for (auto iter = range.begin(); iter != range.end(); ++iter) {
+        const auto &path = iter->GetPath();
+        const ImGuiID pathHash = IdOf(GetHash(path));
+        const bool isOpen = storage->GetInt(pathHash, 0) != 0;
+        if (!isOpen) {
+            iter.PruneChildren();
+        }
+        // The SdfPath of the instance proxies used to be recreated between each frame, invalidating the hash value
+        // and the opened state of the tree nodes. This problems appears on versions > 21.11
+        // https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
+        // The rows keep the paths alive between the frames which works around this issue.
+        rows.emplace_back();
+        rows.back().path = path;
+        UpdateRow(*iter, rows.back());
+    }
+}
+
+void StageOutlinerIndex::UpdateRow(const UsdPrim &prim, Row &row) const {
+    if (!prim) {
+        return;
+    }
+    row.typeName = prim.GetTypeName();
+    row.color = GetPrimColor(prim);
+    const auto children = prim.GetFilteredChildren(_displayOptions.GetPrimFlagsPredicate());
+    row.hasChildren = children.begin() != children.end();
     // TODO: this should work with animation
     UsdGeomImageable imageable(prim);
-    if (imageable) {
-        ImGui::PushID(IdOf(prim.GetPath().GetHash()));
-        // Get visibility value
+    row.isImageable = static_cast<bool>(imageable);
+    row.visibility = TfToken();
+    row.hasAuthoredVisibility = false;
+    if (row.isImageable) {
         auto attr = imageable.GetVisibilityAttr();
-        VtValue visibleValue;
-        attr.Get(&visibleValue);
-        TfToken visibilityToken = visibleValue.Get<TfToken>();
-        const char *visibilityIcon = GetVisibilityIcon(visibilityToken);
+        attr.Get(&row.visibility);
+        row.hasAuthoredVisibility = attr.HasAuthoredValue();
+    }
+}
+
+void StageOutlinerIndex::UpdateRowIndices() {
+    _rowIndices.clear();
+    _rowIndices.reserve(_rows.size());
+    for (int i = 0; i < static_cast<int>(_rows.size()); ++i) {
+        _rowIndices[_rows[i].path] = i;
+    }
+}
+
+static void DrawVisibilityButton(const UsdStageRefPtr &stage, const StageOutlinerIndex::Row &row) {
+    if (row.isImageable) {
+        ImGui::PushID(IdOf(row.path.GetHash()));
+        const char *visibilityIcon = GetVisibilityIcon(row.visibility);
         {
             ScopedStyleColor buttonColor(
-                ImGuiCol_Text, attr.HasAuthoredValue() ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
+                ImGuiCol_Text, row.hasAuthoredVisibility ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
             ImGui::SmallButton(visibilityIcon);
             // Menu to select the new visibility
             {
                 ScopedStyleColor menuTextColor(ImGuiCol_Text, ImVec4(1.0, 1.0, 1.0, 1.0));
                 if (ImGui::BeginPopupContextItem(nullptr, ImGuiPopupFlags_MouseButtonLeft)) {
+                    const UsdPrim prim = stage->GetPrimAtPath(row.path);
+                    auto attr = UsdGeomImageable(prim).GetVisibilityAttr();
                     if (attr.HasAuthoredValue() && ImGui::MenuItem("clear visibiliy")) {
                         ExecuteAfterDraw(&UsdPrim::RemoveProperty, prim, attr.GetName());
                     }
@@ -211,7 +514,7 @@ static void DrawVisibilityButton(const UsdPrim &prim) {
 }
 
 // This is pretty similar to DrawBackgroundSelection in the SdfLayerSceneGraphEditor
-static void DrawBackgroundSelection(const UsdPrim &prim, bool selected) {
+static void DrawBackgroundSelection(bool selected) {
 
     ImVec4 colorSelected = selected ? ImVec4(ColorPrimSelectedBg) : ImVec4(0.75, 0.60, 0.33, 0.2);
     ScopedStyleColor scopedStyle(ImGuiCol_HeaderHovered, selected ? colorSelected : ImVec4(ColorTransparent),
@@ -225,70 +528,75 @@ static void DrawBackgroundSelection(const UsdPrim &prim, bool selected) {
 
 
 
-static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, StageOutlinerDisplayOptions &displayOptions) {
+static void DrawPrimTreeRow(const UsdStageRefPtr &stage, const StageOutlinerIndex::Row &row, Selection &selectedPaths,
+                            SdfPathVector &toggledPaths) {
     ImGuiTreeNodeFlags flags =
         ImGuiTreeNodeFlags_OpenOnArrow |
         ImGuiTreeNodeFlags_AllowItemOverlap; // for testing worse case scenario add | ImGuiTreeNodeFlags_DefaultOpen;
 
-    // Another way ???
-    const auto &children = prim.GetFilteredChildren(displayOptions.GetPrimFlagsPredicate());
-    if (children.empty()) {
+    if (!row.hasChildren) {
         flags |= ImGuiTreeNodeFlags_Leaf;
     }
 
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
-    DrawBackgroundSelection(prim, selectedPaths.IsSelected(prim.GetStage(), prim.GetPath()));
+    DrawBackgroundSelection(selectedPaths.IsSelected(stage, row.path));
     bool unfolded = true;
     {
         {
-            TreeIndenter<StageOutlinerSeed, SdfPath> indenter(prim.GetPath());
-            ScopedStyleColor primColor(ImGuiCol_Text, GetPrimColor(prim), ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
-            const ImGuiID pathHash = IdOf(GetHash(prim.GetPath()));
+            TreeIndenter<StageOutlinerSeed, SdfPath> indenter(row.path);
+            ScopedStyleColor primColor(ImGuiCol_Text, row.color, ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
+            const ImGuiID pathHash = IdOf(GetHash(row.path));
 
-            unfolded = ImGui::TreeNodeBehavior(pathHash, flags, prim.GetName().GetText());
+            unfolded = ImGui::TreeNodeBehavior(pathHash, flags, row.path.GetName().c_str());
+            if (ImGui::IsItemToggledOpen()) {
+                toggledPaths.push_back(row.path);
+            }
             // TreeSelectionBehavior(selectedPaths, &prim);
             if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
                 // TODO selection, should go in commands, ultimately the selection is passed
                 // as const
                 if (ImGui::IsKeyDown(ImGuiKey_LeftCtrl)) {
-                    if (selectedPaths.IsSelected(prim.GetStage(), prim.GetPath())) {
-                        selectedPaths.RemoveSelected(prim.GetStage(), prim.GetPath());
+                    if (selectedPaths.IsSelected(stage, row.path)) {
+                        selectedPaths.RemoveSelected(stage, row.path);
                     } else {
-                        selectedPaths.AddSelected(prim.GetStage(), prim.GetPath());
+                        selectedPaths.AddSelected(stage, row.path);
                     }
                 } else {
-                    ExecuteAfterDraw<EditorSetSelection>(prim.GetStage(), prim.GetPath());
+                    ExecuteAfterDraw<EditorSetSelection>(stage, row.path);
                 }
             }
         }
         {
             ScopedStyleColor popupColor(ImGuiCol_Text, ImVec4(ColorPrimDefault));
             if (ImGui::BeginPopupContextItem()) {
-                DrawUsdPrimEditMenuItems(prim);
+                DrawUsdPrimEditMenuItems(stage->GetPrimAtPath(row.path));
                 ImGui::EndPopup();
             }
         }
         // Visibility
         ImGui::TableSetColumnIndex(1);
-        DrawVisibilityButton(prim);
+        DrawVisibilityButton(stage, row);
 
         // Type
         ImGui::TableSetColumnIndex(2);
-        ImGui::Text("%s", prim.GetTypeName().GetText());
+        ImGui::Text("%s", row.typeName.GetText());
     }
     if (unfolded) {
         ImGui::TreePop();
     }
 }
 
-static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths, StageOutlinerIndex &outlinerIndex) {
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
 
     ImGuiTreeNodeFlags nodeflags = ImGuiTreeNodeFlags_OpenOnArrow;
     std::string stageDisplayName(stage->GetRootLayer()->GetDisplayName());
     auto unfolded = ImGui::TreeNodeBehavior(IdOf(GetHash(SdfPath::AbsoluteRootPath())), nodeflags, stageDisplayName.c_str());
+    if (ImGui::IsItemToggledOpen()) {
+        outlinerIndex.Invalidate();
+    }
 
     ImGui::TableSetColumnIndex(2);
     ImGui::SmallButton(ICON_FA_PEN);
@@ -305,83 +613,31 @@ static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPat
     }
 }
 
-/// This function should be called only when the Selection has changed
-/// It modifies the internal imgui tree graph state.
-static void OpenSelectedPaths(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+/// This function should be called only with the paths added to the Selection
+/// It modifies the internal imgui tree graph state and returns the tree nodes it opened
+static SdfPathVector OpenSelectedPaths(const SdfPathVector &addedPaths) {
     ImGuiContext &g = *GImGui;
     ImGuiWindow *window = g.CurrentWindow;
     ImGuiStorage *storage = window->DC.StateStorage;
-    for (const auto &path : selectedPaths.GetSelectedPaths(stage)) {
+    SdfPathVector openedPaths;
+    for (const auto &path : addedPaths) {
         for (const auto &element : path.GetParentPath().GetPrefixes()) {
             ImGuiID id = IdOf(GetHash(element)); // This has changed with the optim one
-            storage->SetInt(id, true);
-        }
-    }
-}
-
-static void TraverseRange(UsdPrimRange &range, std::vector<SdfPath> &paths) {
-    static std::set<SdfPath> retainedPath; // to fix a bug with instanced prim which recreates the path at every call and give a different hash
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
-    for (auto iter = range.begin(); iter != range.end(); ++iter) {
-        const auto &path = iter->GetPath();
-        const ImGuiID pathHash = IdOf(GetHash(path));
-        const bool isOpen = storage->GetInt(pathHash, 0) != 0;
-        if (!isOpen) {
-            iter.PruneChildren();
-        }
-        // This bit of code is to avoid a bug. It appears that the SdfPath of instance proxies are not kept and the underlying memory
-        // is deleted and recreated between each frame, invalidating the hash value. So for the same path we have different hash every frame :s not cool.
-        // This problems appears on versions > 21.11
-        // a look at the changelog shows that they were lots of changes on the SdfPath side:
-        // https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
-        //
-        // In the end we workaround this issue by keeping the instance proxy paths alive:
-        if (iter->IsInstanceProxy()) {
-            retainedPath.insert(path);
-        }
-        paths.push_back(path);
-    }
-}
-
-// Traverse the stage skipping the paths closed by the tree ui.
-static void TraverseOpenedPaths(UsdStageRefPtr stage, std::vector<SdfPath> &paths, StageOutlinerDisplayOptions &displayOptions) {
-    if (!stage)
-        return;
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
-    paths.clear();
-    const SdfPath &rootPath = SdfPath::AbsoluteRootPath();
-    const bool rootPathIsOpen = storage->GetInt(IdOf(GetHash(rootPath)), 0) != 0;
-
-    if (rootPathIsOpen) {
-        // Stage
-        auto range = UsdPrimRange::Stage(stage, displayOptions.GetPrimFlagsPredicate());
-        TraverseRange(range, paths);
-        // Prototypes
-        if (displayOptions.GetShowPrototypes()) {
-            for(const auto &proto: stage->GetPrototypes()) {
-                auto range = UsdPrimRange(proto, displayOptions.GetPrimFlagsPredicate());
-                TraverseRange(range, paths);
+            if (!storage->GetInt(id, false)) {
+                storage->SetInt(id, true);
+                openedPaths.push_back(element);
             }
         }
     }
+    return openedPaths;
 }
 
-static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const std::vector<SdfPath> &paths,
+static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const StageOutlinerIndex &outlinerIndex,
                                        ImGuiListClipper &clipper) {
-    // linear search! it happens only when the selection has changed. We might want to maintain a map instead
-    // if the hierarchies are big.
-    for (int i = 0; i < paths.size(); ++i) {
-        if (paths[i] == selectedPath) {
-            // scroll only if the item is not visible
-            if (i < clipper.DisplayStart || i > clipper.DisplayEnd) {
-                ImGui::SetScrollY(clipper.ItemsHeight * i + 1);
-            }
-            return;
-        }
+    const int i = outlinerIndex.GetRowIndex(selectedPath);
+    // scroll only if the item is not visible
+    if (i >= 0 && (i < clipper.DisplayStart || i > clipper.DisplayEnd)) {
+        ImGui::SetScrollY(clipper.ItemsHeight * i + 1);
     }
 }
 
@@ -425,7 +681,8 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
     auto rootPrim = stage->GetPseudoRoot();
     auto layer = stage->GetSessionLayer();
 
-    static SelectionHash lastSelectionHash = 0;
+    static SelectionVersion lastSelectionVersion = 0;
+    static StageOutlinerIndex outlinerIndex;
 
     ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
     ImVec2 tableOuterSize(0, currentWindow->Size[1] - 100); // TODO: set the correct size
@@ -436,50 +693,71 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
         ImGui::TableSetupColumn("V", ImGuiTableColumnFlags_WidthFixed, 40);
         ImGui::TableSetupColumn("Type");
 
-        // Unfold the selected path
-        const bool selectionHasChanged = selectedPaths.UpdateSelectionHash(stage, lastSelectionHash);
-        if (selectionHasChanged) {            // We could use the imgui id as well instead of a static ??
-            OpenSelectedPaths(stage, selectedPaths); // Also we could have a UsdTweakFrame which contains all the changes that happened
-                                              // between the last frame and the new one
-        }
+        // Update the opened paths with the changes of the stage since the last frame
+        outlinerIndex.Update(stage, displayOptions); // This must be inside the table scope to get the correct treenode hash table
 
-        // Find all the opened paths
-        std::vector<SdfPath> paths;
-        paths.reserve(1024);
-        TraverseOpenedPaths(stage, paths, displayOptions); // This must be inside the table scope to get the correct treenode hash table
+        // Unfold the parents of the paths added to the selection, only the subtrees of the opened nodes are recomputed
+        SelectionChanges selectionChanges;
+        const bool selectionHasChanged = selectedPaths.GetChanges(stage, lastSelectionVersion, selectionChanges);
+        if (selectionHasChanged) {
+            outlinerIndex.UpdateToggledPaths(OpenSelectedPaths(selectionChanges.added));
+        }
 
         // Draw the tree root node, the layer
-        DrawStageTreeRow(stage, selectedPaths);
+        DrawStageTreeRow(stage, selectedPaths, outlinerIndex);
 
         // Display only the visible paths with a clipper
+        const auto &rows = outlinerIndex.GetRows();
+        SdfPathVector toggledPaths;
         ImGuiListClipper clipper;
-        clipper.Begin(static_cast<int>(paths.size()));
+        clipper.Begin(static_cast<int>(rows.size()));
         while (clipper.Step()) {
             for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
                 ImGui::PushID(row);
-                const SdfPath &path = paths[row];
-                const auto &prim = stage->GetPrimAtPath(path);
-                DrawPrimTreeRow(prim, selectedPaths, displayOptions);
+                DrawPrimTreeRow(stage, rows[row], selectedPaths, toggledPaths);
                 ImGui::PopID();
             }
         }
         if (selectionHasChanged) {
             // This function can only be called in this context and after the clipper.Step()
-            FocusedOnFirstSelectedPath(selectedPaths.GetAnchorPrimPath(stage), paths, clipper);
+            FocusedOnFirstSelectedPath(selectedPaths.GetAnchorPrimPath(stage), outlinerIndex, clipper);
         }
+        // The rows are only modified once they are all drawn
+        outlinerIndex.UpdateToggledPaths(toggledPaths);
         ImGui::EndTable();
         
     }
 
     // Search prim bar
     static char patternBuffer[256];
-    static bool useRegex = false;
+    static PrimSearchQuery searchQuery;
     auto enterPressed = ImGui::InputTextWithHint("##SearchPrims", "Find prim", patternBuffer, 256, ImGuiInputTextFlags_EnterReturnsTrue);
+    searchQuery.pattern = patternBuffer;
     ImGui::SameLine();
-    ImGui::Checkbox("use regex", &useRegex);
+    const char *matchModes[] = {"Exact", "Wildcard", "Regex"};
+    int matchMode = searchQuery.matchMode;
+    ImGui::SetNextItemWidth(90);
+    if (ImGui::Combo("##SearchMatchMode", &matchMode, matchModes, IM_ARRAYSIZE(matchModes))) {
+        searchQuery.matchMode = static_cast<PrimSearchQuery::MatchMode>(matchMode);
+    }
     ImGui::SameLine();
-    if (ImGui::Button("Select next") || enterPressed) {
-        ExecuteAfterDraw<EditorFindPrim>(std::string(patternBuffer), useRegex);
+    if (ImGui::Button(ICON_FA_ARROW_UP)) {
+        ExecuteAfterDraw<EditorFindPrim>(searchQuery, SelectPreviousMatch);
     }
+    ImGui::SameLine();
+    if (ImGui::Button(ICON_FA_ARROW_DOWN) || enterPressed) {
+        ExecuteAfterDraw<EditorFindPrim>(searchQuery, SelectNextMatch);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Select all")) {
+        ExecuteAfterDraw<EditorFindPrim>(searchQuery, SelectAllMatches);
+    }
+    ImGui::CheckboxFlags("Name", &searchQuery.fields, PrimSearchQuery::FieldName);
+    ImGui::SameLine();
+    ImGui::CheckboxFlags("Type", &searchQuery.fields, PrimSearchQuery::FieldType);
+    ImGui::SameLine();
+    ImGui::CheckboxFlags("Kind", &searchQuery.fields, PrimSearchQuery::FieldKind);
+    ImGui::SameLine();
+    ImGui::CheckboxFlags("Path", &searchQuery.fields, PrimSearchQuery::FieldPath);
 
 }
@@ -3,36 +3,424 @@
 #include "Gui.h"
 #include "ImGuiHelpers.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/notice.h>
+
 // The following include contains the code which writes usd to text, but it's not
 // distributed with the api
 //#include <pxr/usd/sdf/fileIO_Common.h>
 
-void DrawTextEditor(SdfLayerRefPtr layer) {
-    static std::string layerText;
-    ImGuiIO &io = ImGui::GetIO();
-    ImGuiWindow *window = ImGui::GetCurrentWindow();
-    if (window->SkipItems) {
+// Size of the chunks of text, they are cut at the end of a line
+static constexpr size_t TextChunkSize = 64 * 1024;
+
+// Lines longer than this are truncated when drawn, the arrays of big meshes are written on a single line
+static constexpr size_t MaxDrawnLineLength = 2048;
+
+// The prim blocks bigger than this are not editable, the nested prims can be edited instead
+static constexpr size_t MaxEditedBlockLines = 50000;
+
+// The whole layer is edited in a single text input, only when it is small enough to keep the editor responsive
+static constexpr size_t MaxEditedLayerSize = 4 * 1024 * 1024;
+
+/// Text of a layer split in chunks of whole lines, so a line can be found without scanning the whole text.
+/// The line offsets of a chunk are computed the first time one of its lines is drawn.
+class LayerTextBuffer {
+  public:
+    void Assign(const std::string &text) {
+        _chunks.clear();
+        _lineCount = 0;
+        _size = text.size();
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = std::min(begin + TextChunkSize, text.size());
+            const size_t endOfLine = text.find('\n', end - 1);
+            end = endOfLine == std::string::npos ? text.size() : endOfLine + 1;
+            _chunks.emplace_back();
+            Chunk &chunk = _chunks.back();
+            chunk.text.assign(text, begin, end - begin);
+            chunk.firstLine = _lineCount;
+            chunk.lineCount = std::count(chunk.text.begin(), chunk.text.end(), '\n') + (chunk.text.back() != '\n' ? 1 : 0);
+            _lineCount += chunk.lineCount;
+            begin = end;
+        }
+    }
+
+    size_t GetLineCount() const { return _lineCount; }
+    size_t GetSize() const { return _size; }
+
+    /// Returns the line without its end of line characters
+    std::pair<const char *, const char *> GetLine(size_t line) {
+        auto chunk = std::upper_bound(_chunks.begin(), _chunks.end(), line,
+                                      [](size_t line, const Chunk &chunk) { return line < chunk.firstLine; });
+        if (chunk == _chunks.begin() || line >= _lineCount) {
+            return {nullptr, nullptr};
+        }
+        --chunk;
+        if (chunk->lineOffsets.empty()) {
+            chunk->lineOffsets.reserve(chunk->lineCount);
+            chunk->lineOffsets.push_back(0);
+            for (size_t i = 0; i + 1 < chunk->text.size(); ++i) {
+                if (chunk->text[i] == '\n') {
+                    chunk->lineOffsets.push_back(static_cast<uint32_t>(i + 1));
+                }
+            }
+        }
+        const size_t lineInChunk = line - chunk->firstLine;
+        const char *begin = chunk->text.data() + chunk->lineOffsets[lineInChunk];
+        const char *end = lineInChunk + 1 < chunk->lineOffsets.size() ? chunk->text.data() + chunk->lineOffsets[lineInChunk + 1]
+                                                                     : chunk->text.data() + chunk->text.size();
+        while (end > begin && (end[-1] == '\n' || end[-1] == '\r')) {
+            --end;
+        }
+        return {begin, end};
+    }
+
+  private:
+    struct Chunk {
+        std::string text;
+        size_t firstLine = 0;
+        size_t lineCount = 0;
+        std::vector<uint32_t> lineOffsets;
+    };
+    std::vector<Chunk> _chunks;
+    size_t _lineCount = 0;
+    size_t _size = 0;
+};
+
+/// Lines of a prim definition in the layer text
+struct PrimTextBlock {
+    SdfPath path; // Empty when the prim is not addressable by a prim path, under a variant for example
+    size_t firstLine = 0;
+    size_t lastLine = 0;
+    size_t indent = 0;
+    size_t parent = NoParent; // Index of the enclosing prim block
+    bool Contains(size_t line) const { return !path.IsEmpty() && line >= firstLine && line <= lastLine; }
+
+    static constexpr size_t NoParent = std::numeric_limits<size_t>::max();
+};
+
+static size_t GetIndent(const char *begin, const char *end) {
+    const char *it = begin;
+    while (it < end && *it == ' ') {
+        ++it;
+    }
+    return it == end ? std::numeric_limits<size_t>::max() : static_cast<size_t>(it - begin);
+}
+
+static bool IsBraceLine(const char *begin, const char *end, char brace) {
+    const size_t indent = GetIndent(begin, end);
+    return indent != std::numeric_limits<size_t>::max() && begin + indent + 1 == end && begin[indent] == brace;
+}
+
+// Parses a prim definition line like: def Xform "World" (
+static bool ParsePrimHeader(const char *begin, const char *end, std::string &name) {
+    const char *it = begin + GetIndent(begin, end);
+    const std::string line(it, end);
+    if (line.compare(0, 4, "def ") != 0 && line.compare(0, 5, "over ") != 0 && line.compare(0, 6, "class ") != 0) {
+        return false;
+    }
+    const size_t nameBegin = line.find('"');
+    const size_t nameEnd = nameBegin == std::string::npos ? std::string::npos : line.find('"', nameBegin + 1);
+    if (nameEnd == std::string::npos) {
+        return false;
+    }
+    name = line.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+    return SdfPath::IsValidIdentifier(name);
+}
+
+// Finds the prim definitions of the exported text in one pass, in the order of their first line. The scopes are
+// matched with their indentation: the body of a prim is between braces with the same indentation as its definition,
+// the other lines ending with a brace open a variant set, a variant, a dictionary or time samples.
+static std::vector<PrimTextBlock> ParsePrimTextBlocks(LayerTextBuffer &buffer) {
+    struct Scope {
+        size_t block; // NoParent when the scope is not a prim
+        size_t indent;
+        bool isInBody;
+    };
+    std::vector<PrimTextBlock> blocks;
+    std::vector<Scope> scopes;
+    for (size_t l = 0; l < buffer.GetLineCount(); ++l) {
+        const auto text = buffer.GetLine(l);
+        const size_t indent = GetIndent(text.first, text.second);
+        if (indent == std::numeric_limits<size_t>::max()) {
+            continue;
+        }
+        std::string name;
+        if (ParsePrimHeader(text.first, text.second, name)) {
+            PrimTextBlock block;
+            block.firstLine = block.lastLine = l;
+            block.indent = indent;
+            if (scopes.empty()) {
+                block.path = SdfPath::AbsoluteRootPath().AppendChild(TfToken(name));
+            } else if (scopes.back().block != PrimTextBlock::NoParent && scopes.back().isInBody) {
+                const PrimTextBlock &parent = blocks[scopes.back().block];
+                block.path = parent.path.IsEmpty() ? SdfPath() : parent.path.AppendChild(TfToken(name));
+            }
+            for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+                if (scope->block != PrimTextBlock::NoParent) {
+                    block.parent = scope->block;
+                    break;
+                }
+            }
+            scopes.push_back({blocks.size(), indent, false});
+            blocks.push_back(std::move(block));
+        } else if (IsBraceLine(text.first, text.second, '{') && !scopes.empty() && scopes.back().indent == indent &&
+                   scopes.back().block != PrimTextBlock::NoParent && !scopes.back().isInBody) {
+            scopes.back().isInBody = true;
+        } else if (text.first[indent] == '}') {
+            while (!scopes.empty() && scopes.back().indent > indent) {
+                scopes.pop_back();
+            }
+            if (!scopes.empty() && scopes.back().indent == indent) {
+                if (scopes.back().block != PrimTextBlock::NoParent) {
+                    blocks[scopes.back().block].lastLine = l;
+                }
+                scopes.pop_back();
+            }
+        } else if (text.second[-1] == '{') {
+            scopes.push_back({PrimTextBlock::NoParent, indent, true});
+        }
+    }
+    return blocks;
+}
+
+// Find the innermost prim definition containing line which can be addressed by a prim path
+static const PrimTextBlock *FindPrimTextBlock(const std::vector<PrimTextBlock> &blocks, size_t line) {
+    auto candidate = std::upper_bound(blocks.begin(), blocks.end(), line,
+                                      [](size_t line, const PrimTextBlock &block) { return line < block.firstLine; });
+    if (candidate == blocks.begin()) {
+        return nullptr;
+    }
+    // The blocks are nested, the one containing the line is the last block starting before it or one of its parents
+    size_t index = static_cast<size_t>(std::distance(blocks.begin(), candidate)) - 1;
+    while (index != PrimTextBlock::NoParent) {
+        if (blocks[index].Contains(line)) {
+            return &blocks[index];
+        }
+        index = blocks[index].parent;
+    }
+    return nullptr;
+}
+
+/// Text of the layer exported only when the layer has changed.
+/// The changes are counted with the layer notices.
+class LayerTextView : public TfWeakBase {
+  public:
+    ~LayerTextView() { TfNotice::Revoke(_noticeKey); }
+
+    // The view doesn't own the layer, it is released when it is closed in the editor
+    void SetLayer(const SdfLayerHandle &layer) {
+        if (layer == _layer) {
+            return;
+        }
+        TfNotice::Revoke(_noticeKey);
+        _layer = layer;
+        if (_layer) {
+            _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerTextView::OnLayerDidChange, _layer);
+        }
+        _selectedBlock = PrimTextBlock();
+        _isEditingBlock = false;
+        _isEditingLayer = false;
+        _changeCount++;
+    }
+
+    void Update() {
+        const size_t changeCount = _changeCount;
+        if (changeCount != _exportedChangeCount) {
+            std::string layerText;
+            if (_layer) {
+                _layer->ExportToString(&layerText);
+            }
+            _buffer.Assign(layerText);
+            _blocks = ParsePrimTextBlocks(_buffer);
+            _exportedChangeCount = changeCount;
+            // The lines have moved
+            if (!_isEditingBlock) {
+                _selectedBlock = PrimTextBlock();
+            }
+        }
+    }
+
+    void Draw();
+
+  private:
+    void OnLayerDidChange(const SdfNotice::LayersDidChangeSentPerLayer &notice, const SdfLayerHandle &sender) {
+        _changeCount++;
+    }
+    void DrawLines(const ImVec2 &size);
+    void DrawBlockEditor();
+    void DrawLayerEditor();
+    void SelectLine(size_t line, bool edit);
+    void EditLayer();
+
+    SdfLayerHandle _layer;
+    TfNotice::Key _noticeKey;
+    std::atomic<size_t> _changeCount{0};
+    size_t _exportedChangeCount = 0;
+    LayerTextBuffer _buffer;
+    std::vector<PrimTextBlock> _blocks; // Prim definitions of the exported text
+
+    PrimTextBlock _selectedBlock;
+    bool _isEditingBlock = false;
+    bool _isEditingLayer = false;
+    std::string _editedText;
+};
+
+// The lines outside of the prims, the layer header and metadata, are edited with the whole layer
+void LayerTextView::SelectLine(size_t line, bool edit) {
+    const PrimTextBlock *block = FindPrimTextBlock(_blocks, line);
+    if (!block || !_layer->GetPrimAtPath(block->path)) {
+        _selectedBlock = PrimTextBlock();
+        if (edit) {
+            EditLayer();
+        }
+        return;
+    }
+    _selectedBlock = *block;
+    if (edit && _selectedBlock.lastLine - _selectedBlock.firstLine < MaxEditedBlockLines) {
+        // The block is edited without its indentation
+        _editedText.clear();
+        for (size_t l = _selectedBlock.firstLine; l <= _selectedBlock.lastLine; ++l) {
+            const auto text = _buffer.GetLine(l);
+            const size_t indent = std::min(GetIndent(text.first, text.second), _selectedBlock.indent);
+            if (text.first + indent < text.second) {
+                _editedText.append(text.first + indent, text.second);
+            }
+            _editedText.push_back('\n');
+        }
+        _isEditingBlock = true;
+    }
+}
+
+void LayerTextView::EditLayer() {
+    if (_buffer.GetSize() > MaxEditedLayerSize) {
         return;
     }
-    ImGui::Text("WARNING: this will slow down the application if the layer is big");
-    ImGui::Text("        and will consume lots of memory. Use with care for now");
-    if (layer) {
-        layer->ExportToString(&layerText);
-        ImGui::Text("%s", layer->GetDisplayName().c_str());
+    _layer->ExportToString(&_editedText);
+    _isEditingLayer = true;
+}
+
+void LayerTextView::DrawLines(const ImVec2 &size) {
+    ImGuiIO &io = ImGui::GetIO();
+    ImGui::PushFont(io.Fonts->Fonts[1]);
+    ScopedStyleColor color(ImGuiCol_ChildBg, ImVec4{0.0, 0.0, 0.0, 1.0});
+    if (ImGui::BeginChild("##LayerTextLines", size, false, ImGuiWindowFlags_HorizontalScrollbar)) {
+        const int lineNumberDigits = static_cast<int>(std::to_string(_buffer.GetLineCount()).size());
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(_buffer.GetLineCount()));
+        while (clipper.Step()) {
+            for (int line = clipper.DisplayStart; line < clipper.DisplayEnd; ++line) {
+                ImGui::PushID(line);
+                const float rowStartX = ImGui::GetCursorPosX();
+                const auto selectableFlags = ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_AllowItemOverlap;
+                if (ImGui::Selectable("##Line", _selectedBlock.Contains(line), selectableFlags)) {
+                    if (!_isEditingBlock && !_isEditingLayer) {
+                        SelectLine(line, ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left));
+                    }
+                }
+                ImGui::SameLine(rowStartX);
+                ImGui::TextDisabled("%*d", lineNumberDigits, line + 1);
+                ImGui::SameLine();
+                const auto text = _buffer.GetLine(line);
+                if (text.second - text.first > static_cast<ptrdiff_t>(MaxDrawnLineLength)) {
+                    ImGui::TextUnformatted(text.first, text.first + MaxDrawnLineLength);
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("... (%zu characters)", static_cast<size_t>(text.second - text.first));
+                } else {
+                    ImGui::TextUnformatted(text.first, text.second);
+                }
+                ImGui::PopID();
+            }
+        }
     }
-    ImGui::PushItemWidth(-FLT_MIN);
-    ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
-    ImVec2 sizeArg(0, currentWindow->Size[1] - 120);
+    ImGui::EndChild();
+    ImGui::PopFont();
+}
+
+void LayerTextView::DrawBlockEditor() {
+    ImGuiIO &io = ImGui::GetIO();
+    ImGui::Text("Editing %s", _selectedBlock.path.GetText());
     ImGui::PushFont(io.Fonts->Fonts[1]);
     {
         ScopedStyleColor color(ImGuiCol_FrameBg, ImVec4{0.0, 0.0, 0.0, 1.0});
-        ImGui::InputTextMultiline("###TextEditor", &layerText, sizeArg,
-                                  ImGuiInputTextFlags_None | ImGuiInputTextFlags_NoUndoRedo);
-        if (layer && ImGui::IsItemDeactivatedAfterEdit()) {
-            ExecuteAfterDraw<LayerTextEdit>(layer, layerText);
-        }
+        ImGui::InputTextMultiline("##PrimTextBlock", &_editedText, ImVec2(-FLT_MIN, 300), ImGuiInputTextFlags_NoUndoRedo);
+    }
+    ImGui::PopFont();
+    if (ImGui::Button("Apply")) {
+        ExecuteAfterDraw<LayerPrimTextEdit>(SdfLayerRefPtr(_layer), _selectedBlock.path, _editedText);
+        _isEditingBlock = false;
+        _selectedBlock = PrimTextBlock();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) {
+        _isEditingBlock = false;
+    }
+}
+
+void LayerTextView::DrawLayerEditor() {
+    ImGuiIO &io = ImGui::GetIO();
+    ImGui::Text("Editing the whole layer");
+    ImGui::PushFont(io.Fonts->Fonts[1]);
+    {
+        ScopedStyleColor color(ImGuiCol_FrameBg, ImVec4{0.0, 0.0, 0.0, 1.0});
+        ImGui::InputTextMultiline("##LayerText", &_editedText, ImVec2(-FLT_MIN, 300), ImGuiInputTextFlags_NoUndoRedo);
     }
     ImGui::PopFont();
-    ImGui::PopItemWidth();
-    ImGui::Text("Ctrl+Enter to apply your change");
+    if (ImGui::Button("Apply")) {
+        ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr(_layer), _editedText);
+        _isEditingLayer = false;
+        _editedText.clear();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) {
+        _isEditingLayer = false;
+        _editedText.clear();
+    }
+}
+
+void LayerTextView::Draw() {
+    if (!_layer) {
+        return;
+    }
+    ImGui::Text("%s, %zu lines, %.1f MB", _layer->GetDisplayName().c_str(), _buffer.GetLineCount(),
+                static_cast<double>(_buffer.GetSize()) / (1024.0 * 1024.0));
+    const bool isEditing = _isEditingBlock || _isEditingLayer;
+    const float editorHeight = isEditing ? 300.f + 3.f * ImGui::GetFrameHeightWithSpacing() : ImGui::GetFrameHeightWithSpacing();
+    DrawLines(ImVec2(0, std::max(ImGui::GetContentRegionAvail().y - editorHeight - ImGui::GetTextLineHeightWithSpacing(), 50.f)));
+    if (_isEditingBlock) {
+        DrawBlockEditor();
+    } else if (_isEditingLayer) {
+        DrawLayerEditor();
+    } else {
+        if (!_selectedBlock.path.IsEmpty() && _selectedBlock.lastLine - _selectedBlock.firstLine >= MaxEditedBlockLines) {
+            ImGui::Text("%s is too big to be edited as text, select one of its children", _selectedBlock.path.GetText());
+        } else {
+            ImGui::Text("Double click on a prim to edit its text, or outside of the prims to edit the whole layer");
+        }
+        if (_buffer.GetSize() <= MaxEditedLayerSize) {
+            if (ImGui::Button("Edit layer")) {
+                EditLayer();
+            }
+        } else {
+            ImGui::TextDisabled("The layer is too big to be edited as a whole");
+        }
+    }
+}
+
+void DrawTextEditor(SdfLayerRefPtr layer) {
+    static LayerTextView textView;
+    ImGuiWindow *window = ImGui::GetCurrentWindow();
+    if (window->SkipItems) {
+        return;
+    }
+    textView.SetLayer(layer);
+    textView.Update();
+    textView.Draw();
 }